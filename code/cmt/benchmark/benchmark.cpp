@@ -0,0 +1,438 @@
+/**
+ * Measures the time needed by the most important methods of all models, tools
+ * and preconditioners over a grid of input dimensionalities, numbers of
+ * components and numbers of threads. Results are written to standard output as
+ * JSON, so that they can be collected and compared across machines and
+ * revisions.
+ *
+ * Usage: benchmark [options]
+ *
+ *   -d, --num_data        number of data points (default: 10000)
+ *   -r, --repetitions     number of repetitions of each measurement (default: 3)
+ *   -i, --dim_in          comma-separated input dimensionalities (default: 8,32)
+ *   -c, --num_components  comma-separated numbers of components (default: 2,8)
+ *   -t, --threads         comma-separated numbers of threads (default: powers
+ *                         of two up to the number of available threads)
+ *   -s, --image_size      width and height of images used by tools (default: 64)
+ *   -f, --filter          only run benchmarks whose name contains this string
+ */
+
+#ifdef _WIN32
+	#include <gettimeofday.h>
+#else
+	#include <sys/time.h>
+	#include <unistd.h>
+#endif
+
+#ifdef _OPENMP
+	#include <omp.h>
+#endif
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include "lbfgs.h"
+#include "exception.h"
+#include "utils.h"
+#include "tools.h"
+#include "mcgsm.h"
+#include "mcbm.h"
+#include "stm.h"
+#include "glm.h"
+#include "mlr.h"
+#include "mogsm.h"
+#include "whiteningpreconditioner.h"
+#include "pcapreconditioner.h"
+using CMT::Exception;
+using CMT::Trainable;
+using CMT::MCGSM;
+using CMT::MCBM;
+using CMT::STM;
+using CMT::GLM;
+using CMT::MLR;
+using CMT::MoGSM;
+using CMT::Preconditioner;
+using CMT::WhiteningPreconditioner;
+using CMT::PCAPreconditioner;
+using CMT::ArrayXXb;
+using CMT::sampleNormal;
+using CMT::numThreads;
+
+#include "Eigen/Core"
+using Eigen::MatrixXd;
+using Eigen::ArrayXXd;
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+#include <utility>
+using std::pair;
+
+struct Options {
+	Options();
+
+	int numData;
+	int repetitions;
+	int imageSize;
+	vector<int> dimIn;
+	vector<int> numComponents;
+	vector<int> threads;
+	string filter;
+};
+
+struct Result {
+	string name;
+	int dimIn;
+	int numComponents;
+	int threads;
+	double seconds;
+};
+
+static Options options;
+static vector<Result> results;
+
+
+
+Options::Options() :
+	numData(10000),
+	repetitions(3),
+	imageSize(64)
+{
+	dimIn.push_back(8);
+	dimIn.push_back(32);
+	numComponents.push_back(2);
+	numComponents.push_back(8);
+
+	for(int t = 1; t < numThreads(); t *= 2)
+		threads.push_back(t);
+	threads.push_back(numThreads());
+}
+
+
+
+static double wallTime() {
+	timeval time;
+	gettimeofday(&time, 0);
+	return time.tv_sec + time.tv_usec / 1e6;
+}
+
+
+
+static void setNumThreads(int threads) {
+#ifdef _OPENMP
+	omp_set_num_threads(threads);
+#endif
+}
+
+
+
+static bool selected(const string& name) {
+	return name.find(options.filter) != string::npos;
+}
+
+
+
+/**
+ * Runs a function once to warm up caches and lazily allocated memory, then
+ * records the average time of the remaining repetitions. Benchmarks which do
+ * not depend on the number of components are recorded with zero components.
+ * Methods which are not available for a model are skipped.
+ */
+template <class Function>
+static void measure(
+	const string& name,
+	int dimIn,
+	int numComponents,
+	int threads,
+	Function function)
+{
+	if(!selected(name))
+		return;
+
+	try {
+		function();
+	} catch(Exception& exception) {
+		fprintf(stderr, "Skipping %s: %s\n", name.c_str(), exception.message());
+		return;
+	}
+
+	double start = wallTime();
+
+	for(int r = 0; r < options.repetitions; ++r)
+		function();
+
+	Result result = {
+		name,
+		dimIn,
+		numComponents,
+		threads,
+		(wallTime() - start) / options.repetitions};
+	results.push_back(result);
+}
+
+
+
+/**
+ * Measures log-likelihoods, parameter gradients, samples and data gradients of
+ * a trainable model.
+ */
+static void benchmarkTrainable(
+	const string& name,
+	const Trainable& model,
+	const Trainable::Parameters& params,
+	const MatrixXd& input,
+	const MatrixXd& output,
+	int numComponents,
+	int threads)
+{
+	int dimIn = input.rows();
+
+	measure(name + ".logLikelihood", dimIn, numComponents, threads,
+		[&]() { model.logLikelihood(input, output); });
+
+	if(selected(name + ".parameterGradient")) {
+		lbfgsfloatval_t* x = model.parameters(params);
+		lbfgsfloatval_t* g = lbfgs_malloc(model.numParameters(params));
+
+		measure(name + ".parameterGradient", dimIn, numComponents, threads,
+			[&]() { model.parameterGradient(input, output, x, g, params); });
+
+		lbfgs_free(g);
+		lbfgs_free(x);
+	}
+
+	measure(name + ".sample", dimIn, numComponents, threads,
+		[&]() { model.sample(input); });
+	measure(name + ".computeDataGradient", dimIn, numComponents, threads,
+		[&]() { model.computeDataGradient(input, output); });
+}
+
+
+
+static void benchmarkModels(int dimIn, int numComponents, int threads) {
+	MatrixXd input = sampleNormal(dimIn, options.numData);
+	MatrixXd outputReal = sampleNormal(1, options.numData);
+	MatrixXd outputBinary = (ArrayXXd::Random(1, options.numData) > 0.).cast<double>();
+
+	// one-hot encoded labels
+	MatrixXd outputLabels = MatrixXd::Zero(numComponents, options.numData);
+	for(int j = 0; j < options.numData; ++j)
+		outputLabels(rand() % numComponents, j) = 1.;
+
+	benchmarkTrainable("MCGSM",
+		MCGSM(dimIn, 1, numComponents),
+		MCGSM::Parameters(),
+		input, outputReal, numComponents, threads);
+	benchmarkTrainable("MCBM",
+		MCBM(dimIn, numComponents),
+		MCBM::Parameters(),
+		input, outputBinary, numComponents, threads);
+	benchmarkTrainable("STM",
+		STM(dimIn - dimIn / 2, dimIn / 2, numComponents),
+		STM::Parameters(),
+		input, outputBinary, numComponents, threads);
+	benchmarkTrainable("MLR",
+		MLR(dimIn, numComponents),
+		MLR::Parameters(),
+		input, outputLabels, numComponents, threads);
+
+	MoGSM mogsm(dimIn, numComponents);
+
+	measure("MoGSM.logLikelihood", dimIn, numComponents, threads,
+		[&]() { mogsm.logLikelihood(input); });
+	measure("MoGSM.sample", dimIn, numComponents, threads,
+		[&]() { mogsm.sample(options.numData); });
+}
+
+
+
+/**
+ * Benchmarks which do not depend on the number of components.
+ */
+static void benchmarkWithoutComponents(int dimIn, int threads) {
+	MatrixXd input = sampleNormal(dimIn, options.numData);
+	MatrixXd outputBinary = (ArrayXXd::Random(1, options.numData) > 0.).cast<double>();
+	MatrixXd outputReal = sampleNormal(2, options.numData);
+
+	benchmarkTrainable("GLM",
+		GLM(dimIn),
+		GLM::Parameters(),
+		input, outputBinary, 0, threads);
+
+	measure("WhiteningPreconditioner.construct", dimIn, 0, threads,
+		[&]() { WhiteningPreconditioner(input, outputReal); });
+	measure("PCAPreconditioner.construct", dimIn, 0, threads,
+		[&]() { PCAPreconditioner(input, outputReal); });
+
+	WhiteningPreconditioner whitening(input, outputReal);
+	PCAPreconditioner pca(input, outputReal);
+
+	const Preconditioner* preconditioners[] = {&whitening, &pca};
+	const char* names[] = {"WhiteningPreconditioner", "PCAPreconditioner"};
+
+	for(int i = 0; i < 2; ++i) {
+		const Preconditioner& preconditioner = *preconditioners[i];
+
+		pair<ArrayXXd, ArrayXXd> data = preconditioner(input, outputReal);
+
+		measure(string(names[i]) + ".transform", dimIn, 0, threads,
+			[&]() { preconditioner(input, outputReal); });
+		measure(string(names[i]) + ".inverse", dimIn, 0, threads,
+			[&]() { preconditioner.inverse(data.first, data.second); });
+		measure(string(names[i]) + ".logJacobian", dimIn, 0, threads,
+			[&]() { preconditioner.logJacobian(input, outputReal); });
+	}
+
+	// causal neighborhood with at least dimIn pixels above and to the left of the center
+	int size = 3;
+	while((size * size - 1) / 2 < dimIn)
+		size += 2;
+
+	ArrayXXb inputMask = ArrayXXb::Zero(size, size);
+	ArrayXXb outputMask = ArrayXXb::Zero(size, size);
+	inputMask.topRows(size / 2).setConstant(true);
+	inputMask.row(size / 2).head(size / 2).setConstant(true);
+	outputMask(size / 2, size / 2) = true;
+
+	int dimNeighborhood = (size * size - 1) / 2;
+
+	ArrayXXd img = sampleNormal(options.imageSize, options.imageSize);
+	MCGSM model(dimNeighborhood, 1, 4);
+
+	measure("tools.generateDataFromImage", dimNeighborhood, 0, threads,
+		[&]() { CMT::generateDataFromImage(img, inputMask, outputMask); });
+	measure("tools.sampleImage", dimNeighborhood, 0, threads,
+		[&]() { CMT::sampleImage(img, model, inputMask, outputMask); });
+	measure("tools.densityGradient", dimNeighborhood, 0, threads,
+		[&]() { CMT::densityGradient(img, model, inputMask, outputMask); });
+}
+
+
+
+static bool parseList(const char* str, vector<int>& list) {
+	list.clear();
+
+	while(*str) {
+		char* end;
+		long value = strtol(str, &end, 10);
+
+		if(end == str || value < 1)
+			return false;
+
+		if(*end && *end != ',')
+			return false;
+
+		list.push_back(value);
+
+		str = *end ? end + 1 : end;
+	}
+
+	return !list.empty();
+}
+
+
+
+static bool parseOptions(int argc, char** argv) {
+	for(int i = 1; i < argc; ++i) {
+		string option = argv[i];
+
+		if(i + 1 >= argc)
+			return false;
+
+		const char* value = argv[++i];
+
+		if(option == "-d" || option == "--num_data")
+			options.numData = atoi(value);
+		else if(option == "-r" || option == "--repetitions")
+			options.repetitions = atoi(value);
+		else if(option == "-s" || option == "--image_size")
+			options.imageSize = atoi(value);
+		else if(option == "-f" || option == "--filter")
+			options.filter = value;
+		else if(option == "-i" || option == "--dim_in") {
+			if(!parseList(value, options.dimIn))
+				return false;
+		} else if(option == "-c" || option == "--num_components") {
+			if(!parseList(value, options.numComponents))
+				return false;
+		} else if(option == "-t" || option == "--threads") {
+			if(!parseList(value, options.threads))
+				return false;
+		} else
+			return false;
+	}
+
+	return options.numData > 0 && options.repetitions > 0 && options.imageSize > 0;
+}
+
+
+
+static void printJSON() {
+	char hostname[256] = "";
+#ifndef _WIN32
+	gethostname(hostname, sizeof(hostname) - 1);
+#endif
+
+	char date[32];
+	time_t now = time(0);
+	strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+
+	printf("{\n");
+	printf("\t\"host\": \"%s\",\n", hostname);
+	printf("\t\"date\": \"%s\",\n", date);
+	printf("\t\"num_data\": %d,\n", options.numData);
+	printf("\t\"repetitions\": %d,\n", options.repetitions);
+	printf("\t\"image_size\": %d,\n", options.imageSize);
+	printf("\t\"results\": [");
+
+	for(int i = 0; i < results.size(); ++i) {
+		const Result& result = results[i];
+
+		printf(i > 0 ? ",\n\t\t{" : "\n\t\t{");
+		printf("\"name\": \"%s\", ", result.name.c_str());
+		printf("\"dim_in\": %d, ", result.dimIn);
+		if(result.numComponents > 0)
+			printf("\"num_components\": %d, ", result.numComponents);
+		else
+			printf("\"num_components\": null, ");
+		printf("\"threads\": %d, ", result.threads);
+		printf("\"seconds\": %.9g}", result.seconds);
+	}
+
+	printf("\n\t]\n}\n");
+}
+
+
+
+int main(int argc, char** argv) {
+	if(!parseOptions(argc, argv)) {
+		fprintf(stderr, "Usage: %s [-d num_data] [-r repetitions] [-i dim_in,...] "
+			"[-c num_components,...] [-t threads,...] [-s image_size] [-f filter]\n", argv[0]);
+		return 1;
+	}
+
+	try {
+		for(int t = 0; t < options.threads.size(); ++t) {
+			setNumThreads(options.threads[t]);
+
+			for(int i = 0; i < options.dimIn.size(); ++i) {
+				benchmarkWithoutComponents(options.dimIn[i], options.threads[t]);
+
+				for(int k = 0; k < options.numComponents.size(); ++k)
+					benchmarkModels(options.dimIn[i], options.numComponents[k], options.threads[t]);
+			}
+		}
+	} catch(Exception& exception) {
+		fprintf(stderr, "%s\n", exception.message());
+		return 1;
+	}
+
+	printJSON();
+
+	return 0;
+}
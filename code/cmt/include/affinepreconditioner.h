@@ -43,6 +43,19 @@ namespace CMT {
 			virtual ArrayXXd operator()(const ArrayXXd& input) const;
 			virtual ArrayXXd inverse(const ArrayXXd& input) const;
 
+			virtual void transform(
+				const Ref<const MatrixXd>& input,
+				Ref<MatrixXd> inputPre) const;
+			virtual void transform(
+				const Ref<const MatrixXd>& input,
+				const Ref<const MatrixXd>& output,
+				Ref<MatrixXd> inputPre,
+				Ref<MatrixXd> outputPre) const;
+			virtual void inverseTransform(
+				const Ref<const MatrixXd>& inputPre,
+				const Ref<const MatrixXd>& outputPre,
+				Ref<MatrixXd> output) const;
+
 			virtual Array<double, 1, Dynamic> logJacobian(const ArrayXXd& input, const ArrayXXd& output) const;
 
 			virtual pair<ArrayXXd, ArrayXXd> adjustGradient(
@@ -51,11 +64,12 @@ namespace CMT {
 
 			inline VectorXd meanIn() const;
 			inline VectorXd meanOut() const;
-			inline MatrixXd preIn() const;
-			inline MatrixXd preInInv() const;
+			virtual MatrixXd preIn() const;
+			virtual MatrixXd preInInv() const;
 			inline MatrixXd preOut() const;
 			inline MatrixXd preOutInv() const;
 			inline MatrixXd predictor() const;
+			inline double logJacobianConstant() const;
 
 		protected:
 			VectorXd mMeanIn;
@@ -86,18 +100,6 @@ VectorXd CMT::AffinePreconditioner::meanOut() const {
 
 
 
-MatrixXd CMT::AffinePreconditioner::preIn() const {
-	return mPreIn;
-}
-
-
-
-MatrixXd CMT::AffinePreconditioner::preInInv() const {
-	return mPreInInv;
-}
-
-
-
 MatrixXd CMT::AffinePreconditioner::preOut() const {
 	return mPreOut;
 }
@@ -114,4 +116,10 @@ MatrixXd CMT::AffinePreconditioner::predictor() const {
 	return mPredictor;
 }
 
+
+
+double CMT::AffinePreconditioner::logJacobianConstant() const {
+	return mLogJacobian;
+}
+
 #endif
@@ -16,6 +16,7 @@ namespace CMT {
 
 			using AffinePreconditioner::operator();
 			using AffinePreconditioner::inverse;
+			using AffinePreconditioner::transform;
 
 			virtual pair<ArrayXXd, ArrayXXd> operator()(
 				const ArrayXXd& input,
@@ -24,6 +25,16 @@ namespace CMT {
 				const ArrayXXd& input,
 				const ArrayXXd& output) const;
 
+			virtual void transform(
+				const Ref<const MatrixXd>& input,
+				const Ref<const MatrixXd>& output,
+				Ref<MatrixXd> inputPre,
+				Ref<MatrixXd> outputPre) const;
+			virtual void inverseTransform(
+				const Ref<const MatrixXd>& inputPre,
+				const Ref<const MatrixXd>& outputPre,
+				Ref<MatrixXd> output) const;
+
 			virtual pair<ArrayXXd, ArrayXXd> adjustGradient(
 				const ArrayXXd& inputGradient,
 				const ArrayXXd& outputGradient) const;
@@ -0,0 +1,98 @@
+#ifndef CMT_BINARYMATRIX_H
+#define CMT_BINARYMATRIX_H
+
+#include <stdint.h>
+#include <vector>
+#include "Eigen/Core"
+#include "exception.h"
+
+namespace CMT {
+	using std::vector;
+
+	using Eigen::Array;
+	using Eigen::Dynamic;
+	using Eigen::MatrixXd;
+
+	/**
+	 * A matrix of zeros and ones stored column-wise as bit-packed 64-bit words.
+	 *
+	 * Products with dense matrices are computed as sums over the active (or, for
+	 * columns with mostly ones, inactive) bits of each column, which replaces
+	 * multiplications by additions and requires 64 times less memory than a
+	 * dense matrix of doubles.
+	 */
+	class BinaryMatrix {
+		public:
+			typedef uint64_t Word;
+
+			BinaryMatrix(int rows = 0, int cols = 0);
+			explicit BinaryMatrix(const MatrixXd& matrix);
+
+			inline int rows() const;
+			inline int cols() const;
+			inline int numWords() const;
+
+			inline bool operator()(int i, int j) const;
+			inline void set(int i, int j, bool value = true);
+
+			inline const Word* col(int j) const;
+
+			BinaryMatrix middleCols(int j, int n) const;
+			MatrixXd toDense() const;
+
+			Array<int, 1, Dynamic> colSum() const;
+
+			MatrixXd leftProduct(const MatrixXd& lhs) const;
+			MatrixXd leftProductTranspose(const MatrixXd& lhs) const;
+
+			static bool isBinary(const MatrixXd& matrix);
+
+		private:
+			int mRows;
+			int mCols;
+			int mNumWords;
+			vector<Word> mWords;
+	};
+}
+
+
+
+inline int CMT::BinaryMatrix::rows() const {
+	return mRows;
+}
+
+
+
+inline int CMT::BinaryMatrix::cols() const {
+	return mCols;
+}
+
+
+
+inline int CMT::BinaryMatrix::numWords() const {
+	return mNumWords;
+}
+
+
+
+inline bool CMT::BinaryMatrix::operator()(int i, int j) const {
+	return (mWords[j * mNumWords + i / 64] >> (i % 64)) & 1;
+}
+
+
+
+inline void CMT::BinaryMatrix::set(int i, int j, bool value) {
+	Word mask = static_cast<Word>(1) << (i % 64);
+	if(value)
+		mWords[j * mNumWords + i / 64] |= mask;
+	else
+		mWords[j * mNumWords + i / 64] &= ~mask;
+}
+
+
+
+inline const CMT::BinaryMatrix::Word* CMT::BinaryMatrix::col(int j) const {
+	return mWords.data() + j * mNumWords;
+}
+
+#endif
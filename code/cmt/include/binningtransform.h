@@ -6,9 +6,30 @@
 namespace CMT {
 	class BinningTransform : public AffineTransform {
 		public:
+			using AffineTransform::operator();
+			using AffineTransform::inverse;
+			using AffineTransform::transform;
+			using AffineTransform::adjustGradient;
+
 			BinningTransform(int binning, int dimIn, int dimOut = 1);
 
-			int binning();
+			virtual int dimInPre() const;
+
+			virtual MatrixXd preIn() const;
+			virtual MatrixXd preInInv() const;
+
+			virtual ArrayXXd operator()(const ArrayXXd& input) const;
+			virtual ArrayXXd inverse(const ArrayXXd& input) const;
+
+			virtual void transform(
+				const Ref<const MatrixXd>& input,
+				Ref<MatrixXd> inputPre) const;
+
+			virtual pair<ArrayXXd, ArrayXXd> adjustGradient(
+				const ArrayXXd& inputGradient,
+				const ArrayXXd& outputGradient) const;
+
+			int binning() const;
 
 		private:
 			int mBinning;
@@ -17,7 +38,7 @@ namespace CMT {
 
 
 
-inline int CMT::BinningTransform::binning() {
+inline int CMT::BinningTransform::binning() const {
 	return mBinning;
 }
 
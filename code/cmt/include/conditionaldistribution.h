@@ -12,6 +12,7 @@ namespace CMT {
 	using Eigen::Array;
 	using Eigen::Dynamic;
 	using Eigen::ArrayXXd;
+	using Eigen::Ref;
 
 	class ConditionalDistribution {
 		public:
@@ -37,8 +38,8 @@ namespace CMT {
 					const Preconditioner& preconditioner) const;
 
 			virtual pair<pair<ArrayXXd, ArrayXXd>, Array<double, 1, Dynamic> > computeDataGradient(
-				const MatrixXd& input,
-				const MatrixXd& output) const = 0;
+				const Ref<const MatrixXd>& input,
+				const Ref<const MatrixXd>& output) const = 0;
 	};
 }
 
@@ -23,6 +23,7 @@ namespace CMT {
 					bool trainWeights;
 					bool trainBias;
 					bool trainNonlinearity;
+					bool newton;
 					Regularizer regularizeWeights;
 					Regularizer regularizeBias;
 
@@ -32,6 +33,7 @@ namespace CMT {
 			};
 
 			using Trainable::logLikelihood;
+			using Trainable::train;
 
 			GLM(
 				int dimIn,
@@ -58,13 +60,21 @@ namespace CMT {
 			virtual Array<double, 1, Dynamic> logLikelihood(
 				const MatrixXd& input,
 				const MatrixXd& output) const;
+			virtual Array<double, 1, Dynamic> logLikelihood(
+				const SparseMatrixXd& input,
+				const MatrixXd& output) const;
+			virtual Array<double, 1, Dynamic> logLikelihood(
+				const WindowedTimeSeries& input,
+				const MatrixXd& output) const;
 
 			virtual MatrixXd sample(const MatrixXd& input) const;
+			virtual MatrixXd sample(const SparseMatrixXd& input) const;
 			virtual MatrixXd predict(const MatrixXd& input) const;
+			virtual MatrixXd predict(const SparseMatrixXd& input) const;
 
 			virtual pair<pair<ArrayXXd, ArrayXXd>, Array<double, 1, Dynamic> > computeDataGradient(
-				const MatrixXd& input,
-				const MatrixXd& output) const;
+				const Ref<const MatrixXd>& input,
+				const Ref<const MatrixXd>& output) const;
 
 			virtual int numParameters(
 				const Trainable::Parameters& params = Parameters()) const;
@@ -73,12 +83,32 @@ namespace CMT {
 			virtual void setParameters(
 				const lbfgsfloatval_t* x,
 				const Trainable::Parameters& params = Parameters());
+			virtual vector<pair<string, int> > parameterBlocks(
+				const Trainable::Parameters& params = Parameters()) const;
 			virtual double parameterGradient(
 				const MatrixXd& input,
 				const MatrixXd& output,
 				const lbfgsfloatval_t* x,
 				lbfgsfloatval_t* g,
 				const Trainable::Parameters& params) const;
+			virtual double parameterGradient(
+				const MatrixXd& inputDense,
+				const SparseMatrixXd& inputSparse,
+				const MatrixXd& output,
+				const lbfgsfloatval_t* x,
+				lbfgsfloatval_t* g,
+				const Trainable::Parameters& params) const;
+			virtual double parameterGradient(
+				const MatrixXd& inputDense,
+				const WindowedTimeSeries& inputWindows,
+				const MatrixXd& output,
+				const lbfgsfloatval_t* x,
+				lbfgsfloatval_t* g,
+				const Trainable::Parameters& params) const;
+			virtual MatrixXd perExampleGradients(
+				const MatrixXd& input,
+				const MatrixXd& output,
+				const Trainable::Parameters& params = Parameters()) const;
 
 		protected:
 			static Nonlinearity* const defaultNonlinearity;
@@ -89,6 +119,34 @@ namespace CMT {
 			double mBias;
 			Nonlinearity* mNonlinearity;
 			UnivariateDistribution* mDistribution;
+
+			virtual bool train(
+				const MatrixXd& input,
+				const MatrixXd& output,
+				const MatrixXd* inputVal,
+				const MatrixXd* outputVal,
+				const Trainable::Parameters& params);
+
+			virtual Trainable* copy() const;
+
+			virtual bool newtonDirection(
+				const MatrixXd& input,
+				const MatrixXd& output,
+				const lbfgsfloatval_t* x,
+				const lbfgsfloatval_t* g,
+				lbfgsfloatval_t* d,
+				const Trainable::Parameters& params) const;
+
+			virtual double logBaseMeasure(const MatrixXd& output) const;
+
+			double computeParameterGradient(
+				const MatrixXd& inputDense,
+				const SparseMatrixXd* inputSparse,
+				const WindowedTimeSeries* inputWindows,
+				const MatrixXd& output,
+				const lbfgsfloatval_t* x,
+				lbfgsfloatval_t* g,
+				const Trainable::Parameters& params) const;
 	};
 }
 
@@ -6,16 +6,33 @@
 #include "Eigen/LU"
 #include "mixture.h"
 #include "exception.h"
+#include "utils.h"
 #include <cmath>
 
 namespace CMT {
 	using Eigen::VectorXd;
 	using Eigen::MatrixXd;
+	using Eigen::Ref;
 
 	using std::pow;
 
 	class GSM : public Mixture::Component {
 		public:
+			struct Statistics : public Mixture::Component::Statistics {
+				public:
+					// point relative to which moments are computed
+					VectorXd center;
+					VectorXd firstMoment;
+					MatrixXd secondMoment;
+					VectorXd scaleWeights;
+					VectorXd scaleNorms;
+
+					void recenter(const VectorXd& center);
+
+					virtual Statistics& operator+=(const Mixture::Component::Statistics& statistics);
+					virtual Statistics& operator*=(double factor);
+			};
+
 			GSM(int dim = 1, int numScales = 6);
 
 			virtual GSM* copy();
@@ -42,6 +59,8 @@ namespace CMT {
 			virtual MatrixXd sample(int numSamples = 1) const;
 			virtual Array<double, 1, Dynamic> logLikelihood(
 				const MatrixXd& data) const;
+			virtual Array<double, 1, Dynamic> logLikelihood(
+				const Ref<const MatrixXd>& data) const;
 
 			virtual void initialize(
 				const MatrixXd& data,
@@ -53,6 +72,15 @@ namespace CMT {
 				const MatrixXd& data,
 				const Array<double, 1, Dynamic>& weights,
 				const Parameters& parameters = Parameters());
+			virtual bool train(
+				const Mixture::Component::Statistics& statistics,
+				const Parameters& parameters = Parameters());
+
+			virtual Statistics* createStatistics() const;
+			virtual void accumulate(
+				const Ref<const MatrixXd>& data,
+				const Array<double, 1, Dynamic>& weights,
+				Mixture::Component::Statistics& statistics) const;
 
 		protected:
 			int mDim;
@@ -154,7 +182,7 @@ void CMT::GSM::setCovariance(const MatrixXd& covariance) {
 		throw Exception("Covariance matrix has wrong dimensionality.");
 
 	// compute Cholesky factor of precision matrix
-	mCholesky = covariance.inverse().llt().matrixL();
+	mCholesky = choleskyPrecision(covariance);
 }
 
 #endif
@@ -5,6 +5,7 @@
 #include "exception.h"
 #include "trainable.h"
 #include "regularizer.h"
+#include "binarymatrix.h"
 
 namespace CMT {
 	using Eigen::VectorXd;
@@ -65,6 +66,7 @@ namespace CMT {
 			inline void setOutputBias(const VectorXd& outputBias);
 
 			virtual MatrixXd sample(const MatrixXd& input) const;
+			virtual MatrixXd sample(const BinaryMatrix& input) const;
 			virtual Array<int, 1, Dynamic> samplePrior(const MatrixXd& input) const;
 			virtual Array<int, 1, Dynamic> samplePosterior(
 				const MatrixXd& input,
@@ -73,6 +75,9 @@ namespace CMT {
 			virtual Array<double, 1, Dynamic> logLikelihood(
 				const MatrixXd& input,
 				const MatrixXd& output) const;
+			virtual Array<double, 1, Dynamic> logLikelihood(
+				const BinaryMatrix& input,
+				const MatrixXd& output) const;
 
 			virtual int numParameters(
 				const Trainable::Parameters& params = Parameters()) const;
@@ -81,16 +86,29 @@ namespace CMT {
 			virtual void setParameters(
 				const lbfgsfloatval_t* x,
 				const Trainable::Parameters& params = Parameters());
+			virtual vector<pair<string, int> > parameterBlocks(
+				const Trainable::Parameters& params = Parameters()) const;
 			virtual double parameterGradient(
 				const MatrixXd& input,
 				const MatrixXd& output,
 				const lbfgsfloatval_t* x,
 				lbfgsfloatval_t* g,
 				const Trainable::Parameters& params = Parameters()) const;
+			virtual double parameterGradient(
+				const BinaryMatrix& input,
+				const MatrixXd& output,
+				const lbfgsfloatval_t* x,
+				lbfgsfloatval_t* g,
+				const Trainable::Parameters& params = Parameters()) const;
 
-			virtual pair<pair<ArrayXXd, ArrayXXd>, Array<double, 1, Dynamic> > computeDataGradient(
+			virtual MatrixXd perExampleGradients(
 				const MatrixXd& input,
-				const MatrixXd& output) const;
+				const MatrixXd& output,
+				const Trainable::Parameters& params = Parameters()) const;
+
+			virtual pair<pair<ArrayXXd, ArrayXXd>, Array<double, 1, Dynamic> > computeDataGradient(
+				const Ref<const MatrixXd>& input,
+				const Ref<const MatrixXd>& output) const;
 
 		protected:
 			int mDimIn;
@@ -104,12 +122,30 @@ namespace CMT {
 			MatrixXd mInputBias;
 			VectorXd mOutputBias;
 
+			template <class InputType>
+			ArrayXXd logProbabilities(const InputType& input) const;
+			template <class InputType>
+			double computeParameterGradient(
+				const InputType& input,
+				const MatrixXd& output,
+				const lbfgsfloatval_t* x,
+				lbfgsfloatval_t* g,
+				const Parameters& params) const;
+
 			virtual bool train(
 				const MatrixXd& input,
 				const MatrixXd& output,
 				const MatrixXd* inputVal = 0,
 				const MatrixXd* outputVal = 0,
 				const Trainable::Parameters& params = Trainable::Parameters());
+			virtual bool train(
+				const BinaryMatrix& input,
+				const MatrixXd& output,
+				const MatrixXd* inputVal,
+				const MatrixXd* outputVal,
+				const Trainable::Parameters& params);
+
+			virtual Trainable* copy() const;
 	};
 }
 
@@ -109,18 +109,23 @@ namespace CMT {
 				const Array<int, 1, Dynamic>& labels) const;
 
 			virtual pair<pair<ArrayXXd, ArrayXXd>, Array<double, 1, Dynamic> > computeDataGradient(
-				const MatrixXd& input,
-				const MatrixXd& output) const;
+				const Ref<const MatrixXd>& input,
+				const Ref<const MatrixXd>& output) const;
 
 			virtual int numParameters(const Trainable::Parameters& params = Parameters()) const;
 			virtual lbfgsfloatval_t* parameters(const Trainable::Parameters& params = Parameters()) const;
 			virtual void setParameters(const lbfgsfloatval_t* x, const Trainable::Parameters& params = Parameters());
+			virtual vector<pair<string, int> > parameterBlocks(const Trainable::Parameters& params = Parameters()) const;
 			virtual double parameterGradient(
 				const MatrixXd& input,
 				const MatrixXd& output,
 				const lbfgsfloatval_t* x,
 				lbfgsfloatval_t* g,
 				const Trainable::Parameters& params = Parameters()) const;
+			virtual MatrixXd perExampleGradients(
+				const MatrixXd& input,
+				const MatrixXd& output,
+				const Trainable::Parameters& params = Parameters()) const;
 
 		protected:
 			// hyperparameters
@@ -146,6 +151,8 @@ namespace CMT {
 				const MatrixXd* inputVal = 0,
 				const MatrixXd* outputVal = 0,
 				const Trainable::Parameters& params = Trainable::Parameters());
+
+			virtual Trainable* copy() const;
 	};
 }
 
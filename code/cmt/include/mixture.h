@@ -10,6 +10,7 @@ namespace CMT {
 	using Eigen::VectorXd;
 	using Eigen::MatrixXd;
 	using Eigen::ArrayXXd;
+	using Eigen::Ref;
 
 	using std::vector;
 
@@ -36,9 +37,30 @@ namespace CMT {
 							Parameters();
 					};
 
+					/**
+					 * Sufficient statistics of weighted data, which are created
+					 * by and specific to each type of component.
+					 */
+					struct Statistics {
+						public:
+							// sum of weights of the accumulated data points
+							double weightSum;
+
+							Statistics();
+							virtual ~Statistics();
+
+							virtual Statistics& operator+=(const Statistics& statistics);
+							virtual Statistics& operator*=(double factor);
+					};
+
+					using Distribution::logLikelihood;
+
 					virtual Component* copy() = 0;
 					virtual Component& operator=(const Component& component) = 0;
 
+					virtual Array<double, 1, Dynamic> logLikelihood(
+						const Ref<const MatrixXd>& data) const;
+
 					virtual void initialize(
 						const MatrixXd& data,
 						const Parameters& parameters = Parameters());
@@ -49,6 +71,23 @@ namespace CMT {
 						const MatrixXd& data,
 						const Array<double, 1, Dynamic>& weights,
 						const Parameters& parameters = Parameters()) = 0;
+					virtual bool train(
+						const Statistics& statistics,
+						const Parameters& parameters = Parameters()) = 0;
+
+					virtual Statistics* createStatistics() const = 0;
+					virtual void accumulate(
+						const Ref<const MatrixXd>& data,
+						const Array<double, 1, Dynamic>& weights,
+						Statistics& statistics) const = 0;
+			};
+
+			class Stream {
+				public:
+					virtual ~Stream();
+
+					// stores the next batch of data, returns false if there is none
+					virtual bool next(MatrixXd& batch) = 0;
 			};
 
 			struct Parameters {
@@ -62,6 +101,9 @@ namespace CMT {
 					bool trainPriors;
 					bool trainComponents;
 					double regularizePriors;
+					int batchSize;
+					double stepSizeOffset;
+					double stepSizeDecay;
 
 					Parameters();
 			};
@@ -100,12 +142,37 @@ namespace CMT {
 				const MatrixXd& dataValid,
 				const Parameters& parameters = Parameters(),
 				const Component::Parameters& componentParameters = Component::Parameters());
+			virtual bool trainOnline(
+				Stream& stream,
+				const Parameters& parameters = Parameters(),
+				const Component::Parameters& componentParameters = Component::Parameters());
+			virtual bool trainOnline(
+				Stream& stream,
+				const MatrixXd& dataValid,
+				const Parameters& parameters = Parameters(),
+				const Component::Parameters& componentParameters = Component::Parameters());
 
 		protected:
 			int mDim;
 			VectorXd mPriors;
 			vector<Component*> mComponents;
 			bool mInitialized;
+
+			ArrayXXd logJoint(const Ref<const MatrixXd>& data) const;
+			double expectation(
+				const MatrixXd& data,
+				vector<Component::Statistics*>& statistics,
+				const Parameters& parameters) const;
+			void maximization(
+				const vector<Component::Statistics*>& statistics,
+				int numData,
+				const Parameters& parameters,
+				const Component::Parameters& componentParameters);
+			bool trainOnline(
+				Stream& stream,
+				const MatrixXd* dataValid,
+				const Parameters& parameters,
+				const Component::Parameters& componentParameters);
 	};
 }
 
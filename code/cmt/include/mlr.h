@@ -21,6 +21,7 @@ namespace CMT {
 				public:
 					bool trainWeights;
 					bool trainBiases;
+					bool newton;
 					Regularizer regularizeWeights;
 					Regularizer regularizeBiases;
 
@@ -30,6 +31,7 @@ namespace CMT {
 			};
 
 			using Trainable::logLikelihood;
+			using Trainable::train;
 
 			MLR(int dimIn, int dimOut);
 			virtual ~MLR();
@@ -46,9 +48,14 @@ namespace CMT {
 			virtual Array<double, 1, Dynamic> logLikelihood(
 				const MatrixXd& input,
 				const MatrixXd& output) const;
+			virtual Array<double, 1, Dynamic> logLikelihood(
+				const SparseMatrixXd& input,
+				const MatrixXd& output) const;
 
 			virtual MatrixXd sample(const MatrixXd& input) const;
+			virtual MatrixXd sample(const SparseMatrixXd& input) const;
 			virtual MatrixXd predict(const MatrixXd& input) const;
+			virtual MatrixXd predict(const SparseMatrixXd& input) const;
 
 			virtual int numParameters(
 				const Trainable::Parameters& params = Parameters()) const;
@@ -57,16 +64,29 @@ namespace CMT {
 			virtual void setParameters(
 				const lbfgsfloatval_t* x,
 				const Trainable::Parameters& params = Parameters());
+			virtual vector<pair<string, int> > parameterBlocks(
+				const Trainable::Parameters& params = Parameters()) const;
 			virtual double parameterGradient(
 				const MatrixXd& input,
 				const MatrixXd& output,
 				const lbfgsfloatval_t* x,
 				lbfgsfloatval_t* g,
 				const Trainable::Parameters& params) const;
+			virtual double parameterGradient(
+				const MatrixXd& inputDense,
+				const SparseMatrixXd& inputSparse,
+				const MatrixXd& output,
+				const lbfgsfloatval_t* x,
+				lbfgsfloatval_t* g,
+				const Trainable::Parameters& params) const;
+			virtual MatrixXd perExampleGradients(
+				const MatrixXd& input,
+				const MatrixXd& output,
+				const Trainable::Parameters& params = Parameters()) const;
 
 			virtual pair<pair<ArrayXXd, ArrayXXd>, Array<double, 1, Dynamic> > computeDataGradient(
-				const MatrixXd& input,
-				const MatrixXd& output) const;
+				const Ref<const MatrixXd>& input,
+				const Ref<const MatrixXd>& output) const;
 
 			virtual double evaluate(const MatrixXd& input, const MatrixXd& output) const;
 			virtual double evaluate(
@@ -78,12 +98,39 @@ namespace CMT {
 					const pair<ArrayXXd, ArrayXXd>& data,
 					const Preconditioner& preconditioner) const;
 
+		protected:
+			virtual bool train(
+				const MatrixXd& input,
+				const MatrixXd& output,
+				const MatrixXd* inputVal,
+				const MatrixXd* outputVal,
+				const Trainable::Parameters& params);
+
+			virtual Trainable* copy() const;
+
+			virtual bool newtonDirection(
+				const MatrixXd& input,
+				const MatrixXd& output,
+				const lbfgsfloatval_t* x,
+				const lbfgsfloatval_t* g,
+				lbfgsfloatval_t* d,
+				const Trainable::Parameters& params) const;
+
 		private:
 			int mDimIn;
 			int mDimOut;
 
 			MatrixXd mWeights;
 			VectorXd mBiases;
+
+			MatrixXd sampleOutputs(const ArrayXXd& prob) const;
+			double computeParameterGradient(
+				const MatrixXd& inputDense,
+				const SparseMatrixXd* inputSparse,
+				const MatrixXd& output,
+				const lbfgsfloatval_t* x,
+				lbfgsfloatval_t* g,
+				const Trainable::Parameters& params) const;
 	};
 }
 
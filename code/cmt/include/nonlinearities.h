@@ -7,6 +7,7 @@
 namespace CMT {
 	using Eigen::ArrayXXd;
 	using Eigen::ArrayXd;
+	using Eigen::ArrayXXi;
 	using std::vector;
 
 	class Nonlinearity {
@@ -49,6 +50,8 @@ namespace CMT {
 			virtual ArrayXXd inverse(const ArrayXXd& data) const;
 			virtual double inverse(double data) const;
 
+			inline double epsilon() const;
+
 		protected:
 			double mEpsilon;
 	};
@@ -65,6 +68,8 @@ namespace CMT {
 			virtual ArrayXXd inverse(const ArrayXXd& data) const;
 			virtual double inverse(double data) const;
 
+			inline double epsilon() const;
+
 		protected:
 			double mEpsilon;
 	};
@@ -110,6 +115,10 @@ namespace CMT {
 			virtual int numParameters() const;
 			virtual ArrayXXd gradient(const ArrayXXd& inputs) const;
 
+			ArrayXXi bins(const ArrayXXd& inputs) const;
+			ArrayXXd evaluate(const ArrayXXi& bins) const;
+			ArrayXd gradient(const ArrayXXi& bins, const ArrayXXd& weights) const;
+
 		protected:
 			double mEpsilon;
 			vector<double> mBinEdges;
@@ -173,6 +182,18 @@ namespace CMT {
 
 
 
+double CMT::LogisticFunction::epsilon() const {
+	return mEpsilon;
+}
+
+
+
+double CMT::ExponentialFunction::epsilon() const {
+	return mEpsilon;
+}
+
+
+
 double CMT::HistogramNonlinearity::epsilon() const {
 	return mEpsilon;
 }
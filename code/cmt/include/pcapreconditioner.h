@@ -2,6 +2,7 @@
 #define CMT_PCAPRECONDITIONER_H
 
 #include "affinepreconditioner.h"
+#include "utils.h"
 
 namespace CMT {
 	class PCAPreconditioner : public AffinePreconditioner {
@@ -10,7 +11,15 @@ namespace CMT {
 				const ArrayXXd& input,
 				const ArrayXXd& output,
 				double varExplained = 99.,
-				int numPCs = -1);
+				int numPCs = -1,
+				double tolerance = 1e-8);
+			template <class StreamType>
+			PCAPreconditioner(
+				StreamType& stream,
+				int dimIn,
+				double varExplained = 99.,
+				int numPCs = -1,
+				double tolerance = 1e-8);
 			PCAPreconditioner(
 				const VectorXd& eigenvalues,
 				const VectorXd& meanIn,
@@ -25,11 +34,40 @@ namespace CMT {
 
 		protected:
 			VectorXd mEigenvalues;
+
+			void initialize(
+				const Moments& moments,
+				int dimIn,
+				double varExplained,
+				int numPCs,
+				double tolerance);
 	};
 }
 
 
 
+/**
+ * Computes the preconditioner from a stream of data without keeping all data
+ * in memory. Each batch contains inputs stacked on top of outputs.
+ *
+ * @param stream any object with a method C{bool next(MatrixXd&)}
+ * @param dimIn number of rows of each batch which correspond to inputs
+ */
+template <class StreamType>
+CMT::PCAPreconditioner::PCAPreconditioner(
+	StreamType& stream,
+	int dimIn,
+	double varExplained,
+	int numPCs,
+	double tolerance)
+{
+	Moments moments;
+	moments.addBatches(stream);
+	initialize(moments, dimIn, varExplained, numPCs, tolerance);
+}
+
+
+
 VectorXd CMT::PCAPreconditioner::eigenvalues() const {
 	return mEigenvalues;
 }
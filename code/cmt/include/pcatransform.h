@@ -2,6 +2,7 @@
 #define CMT_PCATRANSFORM_H
 
 #include "affinetransform.h"
+#include "utils.h"
 
 namespace CMT {
 	class PCATransform : public AffineTransform {
@@ -10,12 +11,21 @@ namespace CMT {
 				const ArrayXXd& input,
 				const ArrayXXd& output,
 				double varExplained = 99.,
-				int numPCs = -1);
+				int numPCs = -1,
+				double tolerance = 1e-8);
 			PCATransform(
 				const ArrayXXd& input,
 				double varExplained = 99.,
 				int numPCs = -1,
-				int dimOut = 1);
+				int dimOut = 1,
+				double tolerance = 1e-8);
+			template <class StreamType>
+			PCATransform(
+				StreamType& stream,
+				int dimIn,
+				double varExplained = 99.,
+				int numPCs = -1,
+				double tolerance = 1e-8);
 			PCATransform(
 				const VectorXd& eigenvalues,
 				const VectorXd& meanIn,
@@ -31,15 +41,39 @@ namespace CMT {
 
 		private:
 			void initialize(
-				const ArrayXXd& input,
+				const Moments& moments,
+				int dimIn,
 				double varExplained,
 				int numPCs,
-				int dimOut);
+				int dimOut,
+				double tolerance);
 	};
 }
 
 
 
+/**
+ * Computes the transform from a stream of data without keeping all data in
+ * memory. Each batch contains inputs stacked on top of outputs.
+ *
+ * @param stream any object with a method C{bool next(MatrixXd&)}
+ * @param dimIn number of rows of each batch which correspond to inputs
+ */
+template <class StreamType>
+CMT::PCATransform::PCATransform(
+	StreamType& stream,
+	int dimIn,
+	double varExplained,
+	int numPCs,
+	double tolerance)
+{
+	Moments moments;
+	moments.addBatches(stream);
+	initialize(moments, dimIn, varExplained, numPCs, moments.dim() - dimIn, tolerance);
+}
+
+
+
 VectorXd CMT::PCATransform::eigenvalues() const {
 	return mEigenvalues;
 }
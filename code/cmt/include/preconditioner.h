@@ -9,8 +9,12 @@ namespace CMT {
 	using std::make_pair;
 
 	using Eigen::ArrayXXd;
+	using Eigen::MatrixXd;
 	using Eigen::Array;
 	using Eigen::Dynamic;
+	using Eigen::Ref;
+
+	class ConditionalDistribution;
 
 	class Preconditioner {
 		public:
@@ -36,6 +40,25 @@ namespace CMT {
 			virtual ArrayXXd operator()(const ArrayXXd& input) const = 0;
 			virtual ArrayXXd inverse(const ArrayXXd& input) const = 0;
 
+			virtual void transform(
+				const Ref<const MatrixXd>& input,
+				Ref<MatrixXd> inputPre) const;
+			virtual void transform(
+				const Ref<const MatrixXd>& input,
+				const Ref<const MatrixXd>& output,
+				Ref<MatrixXd> inputPre,
+				Ref<MatrixXd> outputPre) const;
+			virtual void inverseTransform(
+				const Ref<const MatrixXd>& inputPre,
+				const Ref<const MatrixXd>& outputPre,
+				Ref<MatrixXd> output) const;
+
+			void sample(
+				const ConditionalDistribution& model,
+				const Ref<const MatrixXd>& input,
+				MatrixXd& inputPre,
+				Ref<MatrixXd> output) const;
+
 			virtual Array<double, 1, Dynamic> logJacobian(
 				const ArrayXXd& input,
 				const ArrayXXd& output) const = 0;
@@ -13,8 +13,12 @@ namespace CMT {
 			Regularizer(double strength = 0., Norm norm = L2);
 			Regularizer(MatrixXd transform, Norm norm = L2, double strength = 1.);
 
+			inline Norm norm() const;
+			inline double strength() const;
+
 			double evaluate(const MatrixXd& parameters) const;
 			MatrixXd gradient(const MatrixXd& parameters) const;
+			MatrixXd hessian(int dim) const;
 
 		private:
 			bool mUseMatrix;
@@ -25,4 +29,16 @@ namespace CMT {
 	};
 }
 
+
+
+inline CMT::Regularizer::Norm CMT::Regularizer::norm() const {
+	return mNorm;
+}
+
+
+
+inline double CMT::Regularizer::strength() const {
+	return mStrength;
+}
+
 #endif
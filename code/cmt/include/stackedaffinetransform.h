@@ -0,0 +1,66 @@
+#ifndef CMT_STACKEDAFFINETRANSFORM_H
+#define CMT_STACKEDAFFINETRANSFORM_H
+
+#include <vector>
+#include "affinetransform.h"
+
+namespace CMT {
+	using std::vector;
+
+	/**
+	 * Applies affine transforms to consecutive parts of the input.
+	 *
+	 * The transform is equivalent to an affine transform with a block-diagonal
+	 * matrix, but each block is applied by its own transform, so that
+	 * structured transforms such as binning never touch the zeros. The
+	 * block-diagonal matrix is only built when it is requested.
+	 */
+	class StackedAffineTransform : public AffineTransform {
+		public:
+			using AffineTransform::operator();
+			using AffineTransform::inverse;
+			using AffineTransform::transform;
+			using AffineTransform::adjustGradient;
+
+			StackedAffineTransform(
+				const vector<const AffineTransform*>& transforms,
+				int dimOut = 1);
+			StackedAffineTransform(const StackedAffineTransform& transform);
+			virtual ~StackedAffineTransform();
+
+			StackedAffineTransform& operator=(const StackedAffineTransform& transform);
+
+			virtual int dimInPre() const;
+
+			virtual MatrixXd preIn() const;
+			virtual MatrixXd preInInv() const;
+
+			virtual ArrayXXd operator()(const ArrayXXd& input) const;
+			virtual ArrayXXd inverse(const ArrayXXd& input) const;
+
+			virtual void transform(
+				const Ref<const MatrixXd>& input,
+				Ref<MatrixXd> inputPre) const;
+
+			virtual pair<ArrayXXd, ArrayXXd> adjustGradient(
+				const ArrayXXd& inputGradient,
+				const ArrayXXd& outputGradient) const;
+
+			inline const vector<AffineTransform*>& transforms() const;
+
+		protected:
+			int mDimInPre;
+			vector<AffineTransform*> mTransforms;
+
+		private:
+			void initialize(const vector<const AffineTransform*>& transforms, int dimOut);
+	};
+}
+
+
+
+inline const std::vector<CMT::AffineTransform*>& CMT::StackedAffineTransform::transforms() const {
+	return mTransforms;
+}
+
+#endif
@@ -85,6 +85,15 @@ namespace CMT {
 			virtual Array<double, 1, Dynamic> response(
 				const MatrixXd& inputNonlinear,
 				const MatrixXd& inputLinear) const;
+			virtual Array<double, 1, Dynamic> response(
+				const MatrixXd& inputNonlinear,
+				const SparseMatrixXd& inputLinear) const;
+			virtual Array<double, 1, Dynamic> response(
+				const MatrixXd& inputNonlinear,
+				const WindowedTimeSeries& inputLinear) const;
+			virtual Array<double, 1, Dynamic> response(
+				const WindowedTimeSeries& inputNonlinear,
+				const WindowedTimeSeries& inputLinear) const;
 			virtual ArrayXXd nonlinearResponses(
 				const MatrixXd& input) const;
 			virtual ArrayXXd linearResponse(
@@ -94,10 +103,16 @@ namespace CMT {
 			virtual MatrixXd sample(
 				const MatrixXd& inputNonlinear,
 				const MatrixXd& inputLinear) const;
+			virtual MatrixXd sample(
+				const MatrixXd& inputNonlinear,
+				const SparseMatrixXd& inputLinear) const;
 			virtual MatrixXd predict(const MatrixXd& input) const;
 			virtual MatrixXd predict(
 				const MatrixXd& inputNonlinear,
 				const MatrixXd& inputLinear) const;
+			virtual MatrixXd predict(
+				const MatrixXd& inputNonlinear,
+				const SparseMatrixXd& inputLinear) const;
 
 			virtual Array<double, 1, Dynamic> logLikelihood(
 				const MatrixXd& input,
@@ -106,6 +121,14 @@ namespace CMT {
 				const MatrixXd& inputNonlinear,
 				const MatrixXd& inputLinear,
 				const MatrixXd& output) const;
+			virtual Array<double, 1, Dynamic> logLikelihood(
+				const MatrixXd& inputNonlinear,
+				const SparseMatrixXd& inputLinear,
+				const MatrixXd& output) const;
+			virtual Array<double, 1, Dynamic> logLikelihood(
+				const MatrixXd& inputNonlinear,
+				const WindowedTimeSeries& inputLinear,
+				const MatrixXd& output) const;
 
 			virtual bool train(
 				const MatrixXd& inputNonlinear,
@@ -120,6 +143,16 @@ namespace CMT {
 				const MatrixXd& inputLinearVal,
 				const MatrixXd& outputVal,
 				const Parameters& params = Parameters());
+			virtual bool train(
+				const MatrixXd& inputNonlinear,
+				const SparseMatrixXd& inputLinear,
+				const MatrixXd& output,
+				const Trainable::Parameters& params = Parameters());
+			virtual bool train(
+				const MatrixXd& inputNonlinear,
+				const WindowedTimeSeries& inputLinear,
+				const MatrixXd& output,
+				const Trainable::Parameters& params = Parameters());
 
 			virtual int numParameters(
 				const Trainable::Parameters& params = Parameters()) const;
@@ -128,16 +161,37 @@ namespace CMT {
 			virtual void setParameters(
 				const lbfgsfloatval_t* x,
 				const Trainable::Parameters& params = Parameters());
+			virtual vector<pair<string, int> > parameterBlocks(
+				const Trainable::Parameters& params = Parameters()) const;
 			virtual double parameterGradient(
 				const MatrixXd& input,
 				const MatrixXd& output,
 				const lbfgsfloatval_t* x,
 				lbfgsfloatval_t* g,
 				const Trainable::Parameters& params = Parameters()) const;
+			virtual double parameterGradient(
+				const MatrixXd& inputNonlinear,
+				const SparseMatrixXd& inputLinear,
+				const MatrixXd& output,
+				const lbfgsfloatval_t* x,
+				lbfgsfloatval_t* g,
+				const Trainable::Parameters& params = Parameters()) const;
+			virtual double parameterGradient(
+				const MatrixXd& inputNonlinear,
+				const WindowedTimeSeries& inputLinear,
+				const MatrixXd& output,
+				const lbfgsfloatval_t* x,
+				lbfgsfloatval_t* g,
+				const Trainable::Parameters& params = Parameters()) const;
 
-			virtual pair<pair<ArrayXXd, ArrayXXd>, Array<double, 1, Dynamic> > computeDataGradient(
+			virtual MatrixXd perExampleGradients(
 				const MatrixXd& input,
-				const MatrixXd& output) const;
+				const MatrixXd& output,
+				const Trainable::Parameters& params = Parameters()) const;
+
+			virtual pair<pair<ArrayXXd, ArrayXXd>, Array<double, 1, Dynamic> > computeDataGradient(
+				const Ref<const MatrixXd>& input,
+				const Ref<const MatrixXd>& output) const;
 
 		protected:
 			static Nonlinearity* const defaultNonlinearity;
@@ -164,6 +218,29 @@ namespace CMT {
 				const MatrixXd* inputVal,
 				const MatrixXd* outputVal,
 				const Trainable::Parameters& params);
+
+			template <class LinearInputType>
+			bool trainGLM(
+				const MatrixXd& inputNonlinear,
+				const LinearInputType* inputLinear,
+				const MatrixXd& output,
+				const MatrixXd* inputVal,
+				const MatrixXd* outputVal,
+				const Trainable::Parameters& params);
+
+			virtual Trainable* copy() const;
+
+			virtual double logBaseMeasure(const MatrixXd& output) const;
+
+			double computeParameterGradient(
+				const MatrixXd& input,
+				const SparseMatrixXd* inputLinear,
+				const WindowedTimeSeries* inputLinearWindows,
+				const WindowedTimeSeries* inputNonlinearWindows,
+				const MatrixXd& output,
+				const lbfgsfloatval_t* x,
+				lbfgsfloatval_t* g,
+				const Trainable::Parameters& params) const;
 	};
 }
 
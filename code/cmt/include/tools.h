@@ -6,6 +6,7 @@
 #include "conditionaldistribution.h"
 #include "mcgsm.h"
 #include "preconditioner.h"
+#include "binarymatrix.h"
 #include "Eigen/Core"
 
 namespace Eigen {
@@ -71,6 +72,15 @@ namespace CMT {
 		const vector<ArrayXXb>& outputMask,
 		int numSamples);
 
+	/**
+	 * Like generateDataFromImage, but for binary images. Inputs are directly
+	 * extracted into a bit-packed matrix.
+	 */
+	pair<BinaryMatrix, ArrayXXd> generateBinaryDataFromImage(
+		const ArrayXXd& img,
+		const ArrayXXb& inputMask,
+		const ArrayXXb& outputMask);
+
 	pair<ArrayXXd, ArrayXXd> generateDataFromVideo(
 		const vector<ArrayXXd>& video,
 		const vector<ArrayXXb>& inputMask,
@@ -169,6 +179,12 @@ namespace CMT {
 		const ConditionalDistribution& model,
 		int spikeHistory = 0,
 		const Preconditioner* preconditioner = 0);
+	ArrayXXd sampleSpikeTrains(
+		const ArrayXXd& stimuli,
+		const ConditionalDistribution& model,
+		int numTrials,
+		int spikeHistory = 0,
+		const Preconditioner* preconditioner = 0);
 }
 
 #endif
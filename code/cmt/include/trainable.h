@@ -2,19 +2,29 @@
 #define CMT_TRAINABLE_H
 
 #include <utility>
+#include <vector>
+#include <string>
 #include "Eigen/Core"
+#include "Eigen/SparseCore"
 #include "lbfgs.h"
 #include "conditionaldistribution.h"
+#include "windowedtimeseries.h"
+#include "binarymatrix.h"
 
 namespace CMT {
 	using std::pair;
+	using std::vector;
+	using std::string;
 
 	using Eigen::Dynamic;
 	using Eigen::Matrix;
 	using Eigen::Map;
 	using Eigen::MatrixXd;
+	using Eigen::VectorXd;
 	using Eigen::ArrayXXd;
 
+	typedef Eigen::SparseMatrix<double> SparseMatrixXd;
+
 	class Trainable : public ConditionalDistribution {
 		public:
 			class Callback {
@@ -35,6 +45,7 @@ namespace CMT {
 					int cbIter;
 					int valIter;
 					int valLookAhead;
+					bool valAsync;
 					bool stationary;
 
 					ArrayXXd* valInput;
@@ -46,8 +57,41 @@ namespace CMT {
 					virtual Parameters& operator=(const Parameters& params);
 			};
 
+			/**
+			 * Measurements taken during the last optimization of the parameters.
+			 * Times are cumulative wall-clock times in seconds.
+			 */
+			struct Telemetry {
+				public:
+					int numIterations;
+					int numEvaluations;
+					int numData;
+					int batchSize;
+
+					// evaluations of the objective in each iteration's line search
+					vector<int> lineSearchEvaluations;
+
+					// increase of the peak resident memory of the process
+					long peakMemoryIncrease;
+
+					double totalTime;
+					double gradientTime;
+					double validationTime;
+					double callbackTime;
+					double setParametersTime;
+
+					Telemetry();
+					Telemetry& operator+=(const Telemetry& telemetry);
+
+					double throughput() const;
+					double batchThroughput() const;
+			};
+
+			Trainable();
 			virtual ~Trainable();
 
+			const Telemetry& telemetry() const;
+
 			virtual void initialize(const MatrixXd& input, const MatrixXd& output);
 			virtual void initialize(const pair<ArrayXXd, ArrayXXd>& data);
 
@@ -64,6 +108,34 @@ namespace CMT {
 			virtual bool train(
 				const pair<ArrayXXd, ArrayXXd>& data,
 				const Parameters& params = Parameters());
+			virtual bool train(
+				const SparseMatrixXd& input,
+				const MatrixXd& output,
+				const Parameters& params = Parameters());
+			virtual bool train(
+				const MatrixXd& inputDense,
+				const SparseMatrixXd& inputSparse,
+				const MatrixXd& output,
+				const Parameters& params = Parameters());
+			virtual bool train(
+				const WindowedTimeSeries& input,
+				const MatrixXd& output,
+				const Parameters& params = Parameters());
+			virtual bool train(
+				const MatrixXd& inputDense,
+				const WindowedTimeSeries& inputWindows,
+				const MatrixXd& output,
+				const Parameters& params = Parameters());
+			virtual bool train(
+				const BinaryMatrix& input,
+				const MatrixXd& output,
+				const Parameters& params = Parameters());
+			virtual bool train(
+				const BinaryMatrix& input,
+				const MatrixXd& output,
+				const MatrixXd& inputVal,
+				const MatrixXd& outputVal,
+				const Parameters& params = Parameters());
 			virtual bool train(
 				const pair<ArrayXXd, ArrayXXd>& data,
 				const pair<ArrayXXd, ArrayXXd>& dataVal,
@@ -74,6 +146,12 @@ namespace CMT {
 				const MatrixXd& output,
 				double epsilon = 1e-5,
 				const Parameters& params = Parameters());
+			virtual vector<pair<string, double> > checkDirectionalDerivatives(
+				const MatrixXd& input,
+				const MatrixXd& output,
+				int numDirections = 5,
+				double epsilon = 1e-5,
+				const Parameters& params = Parameters());
 			virtual double checkPerformance(
 				const MatrixXd& input,
 				const MatrixXd& output,
@@ -85,6 +163,7 @@ namespace CMT {
 			virtual void setParameters(
 				const lbfgsfloatval_t* x,
 				const Parameters& params) = 0;
+			virtual vector<pair<string, int> > parameterBlocks(const Parameters& params) const;
 
 			virtual double parameterGradient(
 				const MatrixXd& input,
@@ -92,6 +171,31 @@ namespace CMT {
 				const lbfgsfloatval_t* x,
 				lbfgsfloatval_t* g,
 				const Parameters& params) const = 0;
+			virtual double parameterGradient(
+				const MatrixXd& inputDense,
+				const SparseMatrixXd& inputSparse,
+				const MatrixXd& output,
+				const lbfgsfloatval_t* x,
+				lbfgsfloatval_t* g,
+				const Parameters& params) const;
+			virtual double parameterGradient(
+				const MatrixXd& inputDense,
+				const WindowedTimeSeries& inputWindows,
+				const MatrixXd& output,
+				const lbfgsfloatval_t* x,
+				lbfgsfloatval_t* g,
+				const Parameters& params) const;
+			virtual double parameterGradient(
+				const BinaryMatrix& input,
+				const MatrixXd& output,
+				const lbfgsfloatval_t* x,
+				lbfgsfloatval_t* g,
+				const Parameters& params) const;
+
+			virtual MatrixXd perExampleGradients(
+				const MatrixXd& input,
+				const MatrixXd& output,
+				const Parameters& params = Parameters()) const;
 
 			virtual MatrixXd fisherInformation(
 				const MatrixXd& input,
@@ -99,9 +203,14 @@ namespace CMT {
 				const Parameters& params = Parameters());
 
 		protected:
+			// measurements of the last training run
+			Telemetry mTelemetry;
+
 			typedef Map<Matrix<lbfgsfloatval_t, Dynamic, Dynamic> > MatrixLBFGS;
 			typedef Map<Matrix<lbfgsfloatval_t, Dynamic, 1> > VectorLBFGS;
 
+			struct AsyncValidation;
+
 			struct InstanceLBFGS {
 				Trainable* cd;
 				const Parameters* params;
@@ -109,6 +218,15 @@ namespace CMT {
 				const MatrixXd* input;
 				const MatrixXd* output;
 
+				// sparse part of inputs stacked below dense part
+				const SparseMatrixXd* inputSparse;
+
+				// windows of time series stacked below dense part
+				const WindowedTimeSeries* inputWindows;
+
+				// bit-packed binary inputs used instead of dense inputs
+				const BinaryMatrix* inputBinary;
+
 				// used for validation error based early stopping
 				const MatrixXd* inputVal;
 				const MatrixXd* outputVal;
@@ -117,6 +235,12 @@ namespace CMT {
 				lbfgsfloatval_t* parameters;
 				double fx;
 
+				// evaluates validation error in the background if not null
+				AsyncValidation* validation;
+
+				// records evaluations and timings if not null
+				Telemetry* telemetry;
+
 				InstanceLBFGS(
 					Trainable* cd,
 					const Trainable::Parameters* params,
@@ -129,6 +253,25 @@ namespace CMT {
 					const MatrixXd* output,
 					const MatrixXd* inputVal,
 					const MatrixXd* outputVal);
+				InstanceLBFGS(
+					Trainable* cd,
+					const Trainable::Parameters* params,
+					const MatrixXd* inputDense,
+					const SparseMatrixXd* inputSparse,
+					const MatrixXd* output);
+				InstanceLBFGS(
+					Trainable* cd,
+					const Trainable::Parameters* params,
+					const MatrixXd* inputDense,
+					const WindowedTimeSeries* inputWindows,
+					const MatrixXd* output);
+				InstanceLBFGS(
+					Trainable* cd,
+					const Trainable::Parameters* params,
+					const BinaryMatrix* inputBinary,
+					const MatrixXd* output,
+					const MatrixXd* inputVal,
+					const MatrixXd* outputVal);
 				~InstanceLBFGS();
 			};
 
@@ -142,6 +285,13 @@ namespace CMT {
 				const lbfgsfloatval_t,
 				int, int, int);
 
+			static bool validate(
+				InstanceLBFGS* inst,
+				const lbfgsfloatval_t* x,
+				double logLoss,
+				int iteration,
+				double fx);
+
 			static lbfgsfloatval_t evaluateLBFGS(
 				void*,
 				const lbfgsfloatval_t* x,
@@ -154,6 +304,58 @@ namespace CMT {
 				const MatrixXd* inputVal = 0,
 				const MatrixXd* outputVal = 0,
 				const Parameters& params = Parameters());
+			virtual bool train(
+				const BinaryMatrix& input,
+				const MatrixXd& output,
+				const MatrixXd* inputVal,
+				const MatrixXd* outputVal,
+				const Parameters& params);
+
+			bool optimize(
+				InstanceLBFGS& instance,
+				const Parameters& params);
+
+			virtual Trainable* copy() const;
+
+			VectorXd numericalDerivatives(
+				const MatrixXd& input,
+				const MatrixXd& output,
+				const SparseMatrixXd& directions,
+				double epsilon,
+				const Parameters& params);
+
+			virtual bool newtonDirection(
+				const MatrixXd& input,
+				const MatrixXd& output,
+				const lbfgsfloatval_t* x,
+				const lbfgsfloatval_t* g,
+				lbfgsfloatval_t* d,
+				const Parameters& params) const;
+
+			bool trainNewton(
+				const MatrixXd& input,
+				const MatrixXd& output,
+				const Parameters& params);
+
+			virtual double logBaseMeasure(const MatrixXd& output) const;
+			double cachedLogBaseMeasure(const MatrixXd& output) const;
+
+		private:
+			// outputs currently being trained on and their log base measure
+			const MatrixXd* mCachedOutput;
+			double mCachedLogBaseMeasure;
+
+			void setCache(const MatrixXd* output);
+
+			// caches the log base measure while in scope, also if training throws
+			class CacheGuard {
+				public:
+					CacheGuard(Trainable* model, const MatrixXd* output);
+					~CacheGuard();
+
+				private:
+					Trainable* mModel;
+			};
 	};
 }
 
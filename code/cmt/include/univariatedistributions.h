@@ -3,6 +3,7 @@
 
 #include "Eigen/Core"
 #include "distribution.h"
+#include "nonlinearities.h"
 #include "exception.h"
 
 namespace CMT {
@@ -30,6 +31,47 @@ namespace CMT {
 				const Array<double, 1, Dynamic>& data,
 				const Array<double, 1, Dynamic>& means) const = 0;
 
+			/**
+			 * Terms of the log-likelihood which only depend on the data, such as
+			 * normalization constants of count distributions.
+			 *
+			 * @param data data points for which to evaluate log base measure
+			 */
+			virtual Array<double, 1, Dynamic> logBaseMeasure(
+				const Array<double, 1, Dynamic>& data) const;
+
+			/**
+			 * Log-likelihood without the log base measure. Since the log base
+			 * measure does not depend on the means, it only needs to be computed
+			 * once for a given set of data points.
+			 *
+			 * @param data data points for which to evaluate log-likelihood
+			 * @param means parameters for which to evaluate log-likelihood
+			 */
+			virtual Array<double, 1, Dynamic> logKernel(
+				const Array<double, 1, Dynamic>& data,
+				const Array<double, 1, Dynamic>& means) const;
+
+			/**
+			 * Log-likelihood without the log base measure, evaluated for the
+			 * responses of a nonlinearity. Distributions can override this to
+			 * avoid computing the means for nonlinearities they know about, such
+			 * as their canonical inverse link functions.
+			 *
+			 * If a gradient is requested, the nonlinearity has to be
+			 * differentiable.
+			 *
+			 * @param data data points for which to evaluate log-likelihood
+			 * @param responses inputs to the nonlinearity
+			 * @param nonlinearity maps responses to means
+			 * @param gradient if given, derivative of the *negative* log-likelihood with respect to the responses
+			 */
+			virtual Array<double, 1, Dynamic> logKernel(
+				const Array<double, 1, Dynamic>& data,
+				const Array<double, 1, Dynamic>& responses,
+				const Nonlinearity& nonlinearity,
+				Array<double, 1, Dynamic>* gradient) const;
+
 			/**
 			 * Generate sample using different parameter settings.
 			 *
@@ -52,6 +94,8 @@ namespace CMT {
 
 	class Bernoulli : public UnivariateDistribution {
 		public:
+			using UnivariateDistribution::logKernel;
+
 			Bernoulli(double prob = 0.5);
 
 			inline double probability() const;
@@ -70,6 +114,12 @@ namespace CMT {
 				const Array<double, 1, Dynamic>& data,
 				const Array<double, 1, Dynamic>& means) const;
 
+			virtual Array<double, 1, Dynamic> logKernel(
+				const Array<double, 1, Dynamic>& data,
+				const Array<double, 1, Dynamic>& responses,
+				const Nonlinearity& nonlinearity,
+				Array<double, 1, Dynamic>* gradient) const;
+
 			virtual Array<double, 1, Dynamic> gradient(
 				const Array<double, 1, Dynamic>& data,
 				const Array<double, 1, Dynamic>& means) const;
@@ -80,6 +130,8 @@ namespace CMT {
 
 	class Poisson : public UnivariateDistribution {
 		public:
+			using UnivariateDistribution::logKernel;
+
 			Poisson(double lambda = 1.);
 
 			virtual double mean() const;
@@ -94,6 +146,17 @@ namespace CMT {
 			virtual Array<double, 1, Dynamic> logLikelihood(
 				const Array<double, 1, Dynamic>& data,
 				const Array<double, 1, Dynamic>& means) const;
+			virtual Array<double, 1, Dynamic> logBaseMeasure(
+				const Array<double, 1, Dynamic>& data) const;
+			virtual Array<double, 1, Dynamic> logKernel(
+				const Array<double, 1, Dynamic>& data,
+				const Array<double, 1, Dynamic>& means) const;
+
+			virtual Array<double, 1, Dynamic> logKernel(
+				const Array<double, 1, Dynamic>& data,
+				const Array<double, 1, Dynamic>& responses,
+				const Nonlinearity& nonlinearity,
+				Array<double, 1, Dynamic>* gradient) const;
 
 			virtual Array<double, 1, Dynamic> gradient(
 				const Array<double, 1, Dynamic>& data,
@@ -105,6 +168,8 @@ namespace CMT {
 
 	class Binomial : public UnivariateDistribution {
 		public:
+			using UnivariateDistribution::logKernel;
+
 			Binomial(int n = 10, double p = .5);
 
 			inline double probability() const;
@@ -125,6 +190,11 @@ namespace CMT {
 			virtual Array<double, 1, Dynamic> logLikelihood(
 				const Array<double, 1, Dynamic>& data,
 				const Array<double, 1, Dynamic>& means) const;
+			virtual Array<double, 1, Dynamic> logBaseMeasure(
+				const Array<double, 1, Dynamic>& data) const;
+			virtual Array<double, 1, Dynamic> logKernel(
+				const Array<double, 1, Dynamic>& data,
+				const Array<double, 1, Dynamic>& means) const;
 
 			virtual Array<double, 1, Dynamic> gradient(
 				const Array<double, 1, Dynamic>& data,
@@ -15,6 +15,7 @@ namespace CMT {
 	using Eigen::Dynamic;
 	using Eigen::MatrixXd;
 	using Eigen::MatrixXi;
+	using Eigen::Ref;
 	using Eigen::VectorXd;
 	using Eigen::VectorXi;
 
@@ -30,12 +31,15 @@ namespace CMT {
 	double lnGamma(double x);
 	ArrayXXd gamma(const ArrayXXd& arr);
 	ArrayXXd lnGamma(const ArrayXXd& arr);
+	ArrayXXd lnFactorial(const ArrayXXd& arr);
 
 	ArrayXXd tanh(const ArrayXXd& arr);
 	ArrayXXd cosh(const ArrayXXd& arr);
 	ArrayXXd sinh(const ArrayXXd& arr);
 	ArrayXXd sech(const ArrayXXd& arr);
 
+	void setSeed(unsigned int seed);
+
 	ArrayXXd sampleNormal(int m = 1, int n = 1);
 	ArrayXXd sampleGamma(int m = 1, int n = 1, int k = 1);
 	ArrayXXi samplePoisson(int m = 1, int n = 1, double lambda = 1.);
@@ -51,13 +55,133 @@ namespace CMT {
 	MatrixXd normalize(const MatrixXd& matrix);
 	MatrixXd pInverse(const MatrixXd& matrix);
 
+	MatrixXd choleskyPrecision(const MatrixXd& covariance);
+	void largestEigenvectors(
+		const MatrixXd& matrix,
+		VectorXd& eigenvalues,
+		MatrixXd& eigenvectors,
+		int numEigenvalues = -1,
+		double varExplained = 100.,
+		double tolerance = 1e-8);
 	double logDetPD(const MatrixXd& matrix);
 
 	MatrixXd deleteRows(const MatrixXd& matrix, vector<int> indices);
 	MatrixXd deleteCols(const MatrixXd& matrix, vector<int> indices);
 
+	int numThreads();
+	int threadID();
+
+	template <class PartialType>
+	void reduceSum(vector<PartialType>& partials);
+
 	template <class ArrayType>
 	ArrayType concatenate(const vector<ArrayType>& data, int axis=1);
+
+	template <class MatrixType1, class MatrixType2>
+	bool overlap(const MatrixType1& a, const MatrixType2& b);
+
+	/**
+	 * Accumulates the mean and covariance of data which is added in chunks,
+	 * without ever creating a centered copy of all the data.
+	 */
+	class Moments {
+		public:
+			Moments(int dim = 0);
+
+			inline int dim() const;
+			inline double numData() const;
+
+			void add(const Ref<const MatrixXd>& data);
+			void add(const Ref<const MatrixXd>& input, const Ref<const MatrixXd>& output);
+
+			template <class StreamType>
+			void addBatches(StreamType& stream);
+
+			Moments& operator+=(const Moments& moments);
+
+			inline VectorXd mean() const;
+			MatrixXd covariance() const;
+
+		protected:
+			double mNumData;
+			VectorXd mMean;
+
+			// lower triangle of the sum of outer products of centered data
+			MatrixXd mScatter;
+	};
+}
+
+
+
+inline int CMT::Moments::dim() const {
+	return mMean.size();
+}
+
+
+
+inline double CMT::Moments::numData() const {
+	return mNumData;
+}
+
+
+
+inline Eigen::VectorXd CMT::Moments::mean() const {
+	return mMean;
+}
+
+
+
+/**
+ * Adds all batches of a stream, such as L{Mixture::Stream}, one at a time. If
+ * the moments do not have a dimensionality yet, it is taken from the first batch.
+ *
+ * @param stream any object with a method C{bool next(MatrixXd&)}
+ */
+template <class StreamType>
+void CMT::Moments::addBatches(StreamType& stream) {
+	MatrixXd batch;
+	while(stream.next(batch)) {
+		if(!dim() && mNumData <= 0.)
+			*this = Moments(batch.rows());
+		add(batch);
+	}
+}
+
+
+
+/**
+ * Sums partial results pairwise in a fixed order and stores the result in the
+ * first element. Unlike accumulating into a shared variable, the result only
+ * depends on the number of partial results and not on the order in which
+ * threads finish.
+ *
+ * @param partials any objects implementing C{operator+=}
+ */
+template <class PartialType>
+void CMT::reduceSum(vector<PartialType>& partials) {
+	int numPartials = static_cast<int>(partials.size());
+
+	for(int stride = 1; stride < numPartials; stride *= 2)
+		#pragma omp parallel for
+		for(int i = 0; i < numPartials - stride; i += 2 * stride)
+			partials[i] += partials[i + stride];
+}
+
+
+
+/**
+ * Tests whether two column-major matrices share memory, in which case results
+ * written to one of them have to be computed in a temporary first.
+ */
+template <class MatrixType1, class MatrixType2>
+bool CMT::overlap(const MatrixType1& a, const MatrixType2& b) {
+	if(!a.size() || !b.size())
+		return false;
+
+	const double* aEnd = a.data() + a.outerStride() * (a.cols() - 1) + a.rows();
+	const double* bEnd = b.data() + b.outerStride() * (b.cols() - 1) + b.rows();
+
+	return a.data() < bEnd && b.data() < aEnd;
 }
 
 
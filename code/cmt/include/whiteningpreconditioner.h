@@ -2,11 +2,14 @@
 #define CMT_WHITENINGPRECONDITIONER_H
 
 #include "affinepreconditioner.h"
+#include "utils.h"
 
 namespace CMT {
 	class WhiteningPreconditioner : public AffinePreconditioner {
 		public:
 			WhiteningPreconditioner(const ArrayXXd& input, const ArrayXXd& output);
+			template <class StreamType>
+			WhiteningPreconditioner(StreamType& stream, int dimIn);
 			WhiteningPreconditioner(
 				const VectorXd& meanIn,
 				const VectorXd& meanOut,
@@ -15,7 +18,26 @@ namespace CMT {
 				const MatrixXd& preOut,
 				const MatrixXd& preOutInv,
 				const MatrixXd& predictor);
+
+		protected:
+			void initialize(const Moments& moments, int dimIn);
 	};
 }
 
+
+
+/**
+ * Computes the preconditioner from a stream of data without keeping all data
+ * in memory. Each batch contains inputs stacked on top of outputs.
+ *
+ * @param stream any object with a method C{bool next(MatrixXd&)}
+ * @param dimIn number of rows of each batch which correspond to inputs
+ */
+template <class StreamType>
+CMT::WhiteningPreconditioner::WhiteningPreconditioner(StreamType& stream, int dimIn) {
+	Moments moments;
+	moments.addBatches(stream);
+	initialize(moments, dimIn);
+}
+
 #endif
@@ -0,0 +1,86 @@
+#ifndef CMT_WINDOWEDTIMESERIES_H
+#define CMT_WINDOWEDTIMESERIES_H
+
+#include <vector>
+#include "Eigen/Core"
+#include "exception.h"
+
+namespace CMT {
+	using std::vector;
+
+	using Eigen::MatrixXd;
+
+	/**
+	 * Represents the matrix of windows extracted from one or several time
+	 * series without storing it.
+	 *
+	 * Each column contains one window of each time series, stacked in the same
+	 * order as by extractWindows(). Windows of different time series are
+	 * aligned at their end, so that the last column contains the last window of
+	 * every time series. Products with dense matrices are computed as sums of
+	 * one product per time lag, i.e., as direct convolutions and
+	 * cross-correlations with the time series.
+	 */
+	class WindowedTimeSeries {
+		public:
+			WindowedTimeSeries();
+			WindowedTimeSeries(const MatrixXd& timeSeries, int windowLength);
+			WindowedTimeSeries(
+				const vector<MatrixXd>& timeSeries,
+				const vector<int>& windowLengths);
+
+			inline int rows() const;
+			inline int cols() const;
+
+			inline int numTimeSeries() const;
+			inline const MatrixXd& timeSeries(int i) const;
+			inline int windowLength(int i) const;
+
+			WindowedTimeSeries middleCols(int j, int n) const;
+			WindowedTimeSeries middleTimeSeries(int i, int n) const;
+			MatrixXd toDense() const;
+
+			MatrixXd leftProduct(const MatrixXd& lhs) const;
+			MatrixXd leftProductTranspose(const MatrixXd& lhs) const;
+
+		private:
+			int mRows;
+			int mCols;
+
+			// only the part of each time series which is covered by windows
+			vector<MatrixXd> mTimeSeries;
+			vector<int> mWindowLengths;
+	};
+}
+
+
+
+inline int CMT::WindowedTimeSeries::rows() const {
+	return mRows;
+}
+
+
+
+inline int CMT::WindowedTimeSeries::cols() const {
+	return mCols;
+}
+
+
+
+inline int CMT::WindowedTimeSeries::numTimeSeries() const {
+	return static_cast<int>(mTimeSeries.size());
+}
+
+
+
+inline const Eigen::MatrixXd& CMT::WindowedTimeSeries::timeSeries(int i) const {
+	return mTimeSeries[i];
+}
+
+
+
+inline int CMT::WindowedTimeSeries::windowLength(int i) const {
+	return mWindowLengths[i];
+}
+
+#endif
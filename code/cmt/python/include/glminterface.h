@@ -48,13 +48,19 @@ int GLM_set_nonlinearity(GLMObject*, PyObject*, void*);
 PyObject* GLM_distribution(GLMObject*, void*);
 int GLM_set_distribution(GLMObject*, PyObject*, void*);
 
+PyObject* GLM_sample(GLMObject*, PyObject*, PyObject*);
+PyObject* GLM_predict(GLMObject*, PyObject*, PyObject*);
+PyObject* GLM_loglikelihood(GLMObject*, PyObject*, PyObject*);
+
 PyObject* GLM_train(GLMObject*, PyObject*, PyObject*);
 
 PyObject* GLM_parameters(GLMObject*, PyObject*, PyObject*);
 PyObject* GLM_set_parameters(GLMObject*, PyObject*, PyObject*);
 PyObject* GLM_parameter_gradient(GLMObject*, PyObject*, PyObject*);
+PyObject* GLM_per_example_gradients(GLMObject*, PyObject*, PyObject*);
 PyObject* GLM_fisher_information(GLMObject*, PyObject*, PyObject*);
 PyObject* GLM_check_gradient(GLMObject*, PyObject*, PyObject*);
+PyObject* GLM_check_directional_derivatives(GLMObject*, PyObject*, PyObject*);
 PyObject* GLM_check_performance(GLMObject* self, PyObject* args, PyObject* kwds);
 
 PyObject* GLM_reduce(GLMObject*, PyObject*);
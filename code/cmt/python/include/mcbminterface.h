@@ -68,10 +68,15 @@ int MCBM_set_output_bias(MCBMObject*, PyObject*, void*);
 
 PyObject* MCBM_train(MCBMObject*, PyObject*, PyObject*);
 
+PyObject* MCBM_sample(MCBMObject*, PyObject*, PyObject*);
+PyObject* MCBM_loglikelihood(MCBMObject*, PyObject*, PyObject*);
+
 PyObject* MCBM_parameters(MCBMObject*, PyObject*, PyObject*);
 PyObject* MCBM_set_parameters(MCBMObject*, PyObject*, PyObject*);
 PyObject* MCBM_parameter_gradient(MCBMObject*, PyObject*, PyObject*);
+PyObject* MCBM_per_example_gradients(MCBMObject*, PyObject*, PyObject*);
 PyObject* MCBM_check_gradient(MCBMObject*, PyObject*, PyObject*);
+PyObject* MCBM_check_directional_derivatives(MCBMObject*, PyObject*, PyObject*);
 PyObject* MCBM_check_performance(MCBMObject* self, PyObject* args, PyObject* kwds);
 
 PyObject* MCBM_sample_posterior(MCBMObject*, PyObject*, PyObject*);
@@ -80,6 +80,7 @@ int MCGSM_set_means(MCGSMObject*, PyObject*, void*);
 PyObject* MCGSM_train(MCGSMObject*, PyObject*, PyObject*);
 
 PyObject* MCGSM_check_gradient(MCGSMObject*, PyObject*, PyObject*);
+PyObject* MCGSM_check_directional_derivatives(MCGSMObject*, PyObject*, PyObject*);
 PyObject* MCGSM_check_performance(MCGSMObject*, PyObject*, PyObject*);
 
 PyObject* MCGSM_loglikelihood(MCGSMObject*, PyObject*, PyObject*);
@@ -93,6 +94,7 @@ PyObject* MCGSM_posterior(MCGSMObject*, PyObject*, PyObject*);
 PyObject* MCGSM_parameters(MCGSMObject*, PyObject*, PyObject*);
 PyObject* MCGSM_set_parameters(MCGSMObject*, PyObject*, PyObject*);
 PyObject* MCGSM_parameter_gradient(MCGSMObject*, PyObject*, PyObject*);
+PyObject* MCGSM_per_example_gradients(MCGSMObject*, PyObject*, PyObject*);
 
 PyObject* MCGSM_compute_data_gradient(MCGSMObject*, PyObject*, PyObject*);
 
@@ -36,6 +36,7 @@ extern PyTypeObject GSM_type;
 
 extern const char* Mixture_doc;
 extern const char* Mixture_train_doc;
+extern const char* Mixture_train_online_doc;
 extern const char* Mixture_initialize_doc;
 extern const char* MixtureComponent_doc;
 extern const char* MixtureComponent_train_doc;
@@ -47,6 +48,7 @@ int MoGSM_init(MoGSMObject*, PyObject*, PyObject*);
 
 PyObject* Mixture_add_component(MixtureObject*, PyObject*, PyObject*);
 PyObject* Mixture_train(MixtureObject*, PyObject*, PyObject*);
+PyObject* Mixture_train_online(MixtureObject*, PyObject*, PyObject*);
 PyObject* Mixture_initialize(MixtureObject*, PyObject*, PyObject*);
 PyObject* Mixture_subscript(MixtureObject*, PyObject*);
 PyObject* Mixture_num_components(MixtureObject*, void*);
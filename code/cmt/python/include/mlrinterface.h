@@ -33,12 +33,18 @@ int MLR_set_weights(MLRObject*, PyObject*, void*);
 PyObject* MLR_biases(MLRObject*, void*);
 int MLR_set_biases(MLRObject*, PyObject*, void*);
 
+PyObject* MLR_sample(MLRObject*, PyObject*, PyObject*);
+PyObject* MLR_predict(MLRObject*, PyObject*, PyObject*);
+PyObject* MLR_loglikelihood(MLRObject*, PyObject*, PyObject*);
+
 PyObject* MLR_train(MLRObject*, PyObject*, PyObject*);
 
 PyObject* MLR_parameters(MLRObject*, PyObject*, PyObject*);
 PyObject* MLR_set_parameters(MLRObject*, PyObject*, PyObject*);
 PyObject* MLR_parameter_gradient(MLRObject*, PyObject*, PyObject*);
+PyObject* MLR_per_example_gradients(MLRObject*, PyObject*, PyObject*);
 PyObject* MLR_check_gradient(MLRObject*, PyObject*, PyObject*);
+PyObject* MLR_check_directional_derivatives(MLRObject*, PyObject*, PyObject*);
 PyObject* MLR_check_performance(MLRObject* self, PyObject* args, PyObject* kwds);
 
 PyObject* MLR_reduce(MLRObject*, PyObject*);
@@ -30,6 +30,13 @@ using CMT::PCATransform;
 #include "binningtransform.h"
 using CMT::BinningTransform;
 
+#include "stackedaffinetransform.h"
+using CMT::StackedAffineTransform;
+
+extern PyTypeObject AffineTransform_type;
+extern PyTypeObject BinningTransform_type;
+extern PyTypeObject StackedAffineTransform_type;
+
 struct PreconditionerObject {
 	PyObject_HEAD
 	Preconditioner* preconditioner;
@@ -78,10 +85,21 @@ struct BinningTransformObject {
 	bool owner;
 };
 
+struct StackedAffineTransformObject {
+	PyObject_HEAD
+	StackedAffineTransform* preconditioner;
+	bool owner;
+};
+
+extern PyTypeObject CD_type;
+
 extern const char* Preconditioner_doc;
 extern const char* Preconditioner_inverse_doc;
 extern const char* Preconditioner_logjacobian_doc;
 extern const char* Preconditioner_adjust_gradient_doc;
+extern const char* Preconditioner_transform_doc;
+extern const char* Preconditioner_inverse_transform_doc;
+extern const char* Preconditioner_sample_doc;
 extern const char* AffinePreconditioner_doc;
 extern const char* AffineTransform_doc;
 extern const char* WhiteningPreconditioner_doc;
@@ -89,6 +107,7 @@ extern const char* WhiteningTransform_doc;
 extern const char* PCAPreconditioner_doc;
 extern const char* PCATransform_doc;
 extern const char* BinningTransform_doc;
+extern const char* StackedAffineTransform_doc;
 
 int Preconditioner_init(WhiteningPreconditionerObject*, PyObject*, PyObject*);
 
@@ -98,6 +117,10 @@ PyObject* Preconditioner_inverse(PreconditionerObject*, PyObject*, PyObject*);
 PyObject* Preconditioner_logjacobian(PreconditionerObject*, PyObject*, PyObject*);
 PyObject* Preconditioner_adjust_gradient(PreconditionerObject*, PyObject*, PyObject*);
 
+PyObject* Preconditioner_transform(PreconditionerObject*, PyObject*, PyObject*);
+PyObject* Preconditioner_inverse_transform(PreconditionerObject*, PyObject*, PyObject*);
+PyObject* Preconditioner_sample(PreconditionerObject*, PyObject*, PyObject*);
+
 PyObject* Preconditioner_new(PyTypeObject*, PyObject*, PyObject*);
 void Preconditioner_dealloc(PreconditionerObject*);
 
@@ -114,6 +137,7 @@ PyObject* AffinePreconditioner_mean_out(AffinePreconditionerObject*, void*);
 PyObject* AffinePreconditioner_pre_in(AffinePreconditionerObject*, void*);
 PyObject* AffinePreconditioner_pre_out(AffinePreconditionerObject*, void*);
 PyObject* AffinePreconditioner_predictor(AffinePreconditionerObject*, void*);
+PyObject* AffinePreconditioner_log_jacobian_constant(AffinePreconditionerObject*, void*);
 
 PyObject* AffinePreconditioner_reduce(AffinePreconditionerObject*, PyObject*);
 PyObject* AffinePreconditioner_setstate(AffinePreconditionerObject*, PyObject*);
@@ -136,4 +160,8 @@ int BinningTransform_init(BinningTransformObject*, PyObject*, PyObject*);
 PyObject* BinningTransform_binning(BinningTransformObject*, void*);
 PyObject* BinningTransform_reduce(BinningTransformObject*, PyObject*);
 
+int StackedAffineTransform_init(StackedAffineTransformObject*, PyObject*, PyObject*);
+PyObject* StackedAffineTransform_transforms(StackedAffineTransformObject*, void*);
+PyObject* StackedAffineTransform_reduce(StackedAffineTransformObject*, PyObject*);
+
 #endif
@@ -11,12 +11,14 @@
 using std::vector;
 
 #include "Eigen/Core"
+#include "Eigen/SparseCore"
 using Eigen::Matrix;
 using Eigen::MatrixXd;
 using Eigen::MatrixXi;
 using Eigen::Array;
 using Eigen::ArrayXXd;
 using Eigen::Dynamic;
+using Eigen::Map;
 
 #include "cmt/tools"
 using CMT::Tuples;
@@ -24,22 +26,44 @@ using CMT::Tuples;
 #include "cmt/utils"
 using CMT::Regularizer;
 
+#include "cmt/models"
+using CMT::Mixture;
+
 typedef Matrix<bool, Dynamic, Dynamic> MatrixXb;
 typedef Array<bool, Dynamic, Dynamic> ArrayXXb;
+typedef Eigen::SparseMatrix<double> SparseMatrixXd;
 
 PyObject* PyArray_FromMatrixXd(const MatrixXd& mat);
 PyObject* PyArray_FromMatrixXi(const MatrixXi& mat);
 PyObject* PyArray_FromMatrixXb(const MatrixXb& mat);
 MatrixXd PyArray_ToMatrixXd(PyObject* array);
+Map<MatrixXd> PyArray_ToMapXd(PyObject* array, bool writeable = true);
 MatrixXi PyArray_ToMatrixXi(PyObject* array);
 MatrixXb PyArray_ToMatrixXb(PyObject* array);
 vector<ArrayXXd> PyArray_ToArraysXXd(PyObject* array);
 vector<ArrayXXb> PyArray_ToArraysXXb(PyObject* array);
 PyObject* PyArray_FromArraysXXd(const vector<ArrayXXd>& channels);
 
+bool PyObject_IsSparseMatrix(PyObject* object);
+SparseMatrixXd PyObject_ToSparseMatrixXd(PyObject* object);
+
 Tuples PyList_AsTuples(PyObject* list);
 PyObject* PyList_FromTuples(const Tuples& tuples);
 
 Regularizer PyObject_ToRegularizer(PyObject* regularizer);
 
+/**
+ * Reads batches of data from a Python iterator.
+ */
+class PyIteratorStream : public Mixture::Stream {
+	public:
+		PyIteratorStream(PyObject* iterator);
+		virtual ~PyIteratorStream();
+
+		virtual bool next(MatrixXd& batch);
+
+	private:
+		PyObject* mIterator;
+};
+
 #endif
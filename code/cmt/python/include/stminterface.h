@@ -73,13 +73,19 @@ int STM_set_distribution(STMObject*, PyObject*, void*);
 PyObject* STM_linear_response(STMObject*, PyObject*, PyObject*);
 PyObject* STM_nonlinear_responses(STMObject*, PyObject*, PyObject*);
 
+PyObject* STM_sample(STMObject*, PyObject*, PyObject*);
+PyObject* STM_predict(STMObject*, PyObject*, PyObject*);
+PyObject* STM_loglikelihood(STMObject*, PyObject*, PyObject*);
+
 PyObject* STM_train(STMObject*, PyObject*, PyObject*);
 
 PyObject* STM_parameters(STMObject*, PyObject*, PyObject*);
 PyObject* STM_set_parameters(STMObject*, PyObject*, PyObject*);
 PyObject* STM_parameter_gradient(STMObject*, PyObject*, PyObject*);
+PyObject* STM_per_example_gradients(STMObject*, PyObject*, PyObject*);
 PyObject* STM_fisher_information(STMObject*, PyObject*, PyObject*);
 PyObject* STM_check_gradient(STMObject*, PyObject*, PyObject*);
+PyObject* STM_check_directional_derivatives(STMObject*, PyObject*, PyObject*);
 PyObject* STM_check_performance(STMObject* self, PyObject* args, PyObject* kwds);
 
 PyObject* STM_reduce(STMObject*, PyObject*);
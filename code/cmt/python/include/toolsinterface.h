@@ -8,6 +8,22 @@
 #include <arrayobject.h>
 #include "pyutils.h"
 
+#include "cmt/tools"
+using CMT::WindowedTimeSeries;
+using CMT::BinaryMatrix;
+
+struct WindowedTimeSeriesObject {
+	PyObject_HEAD
+	WindowedTimeSeries* windows;
+};
+
+struct BinaryMatrixObject {
+	PyObject_HEAD
+	BinaryMatrix* matrix;
+};
+
+extern PyTypeObject WindowedTimeSeries_type;
+extern PyTypeObject BinaryMatrix_type;
 extern PyTypeObject Preconditioner_type;
 extern PyTypeObject CD_type;
 extern PyTypeObject MCGSM_type;
@@ -19,13 +35,19 @@ extern const char* sample_image_conditionally_doc;
 extern const char* sample_labels_conditionally_doc;
 extern const char* sample_video_doc;
 extern const char* generate_data_from_image_doc;
+extern const char* generate_binary_data_from_image_doc;
 extern const char* generate_data_from_video_doc;
 extern const char* fill_in_image_doc;
 extern const char* extract_windows_doc;
 extern const char* sample_spike_train_doc;
+extern const char* WindowedTimeSeries_doc;
+extern const char* WindowedTimeSeries_to_dense_doc;
+extern const char* BinaryMatrix_doc;
+extern const char* BinaryMatrix_to_dense_doc;
 
 PyObject* random_select(PyObject*, PyObject*, PyObject*);
 PyObject* generate_data_from_image(PyObject*, PyObject*, PyObject*);
+PyObject* generate_binary_data_from_image(PyObject*, PyObject*, PyObject*);
 PyObject* generate_data_from_video(PyObject*, PyObject*, PyObject*);
 PyObject* density_gradient(PyObject*, PyObject*, PyObject*);
 PyObject* sample_image(PyObject*, PyObject*, PyObject*);
@@ -37,4 +59,16 @@ PyObject* fill_in_image_map(PyObject*, PyObject*, PyObject*);
 PyObject* extract_windows(PyObject*, PyObject*, PyObject*);
 PyObject* sample_spike_train(PyObject*, PyObject*, PyObject*);
 
+PyObject* WindowedTimeSeries_new(PyTypeObject*, PyObject*, PyObject*);
+int WindowedTimeSeries_init(WindowedTimeSeriesObject*, PyObject*, PyObject*);
+void WindowedTimeSeries_dealloc(WindowedTimeSeriesObject*);
+PyObject* WindowedTimeSeries_shape(WindowedTimeSeriesObject*, void*);
+PyObject* WindowedTimeSeries_to_dense(WindowedTimeSeriesObject*);
+
+PyObject* BinaryMatrix_new(PyTypeObject*, PyObject*, PyObject*);
+int BinaryMatrix_init(BinaryMatrixObject*, PyObject*, PyObject*);
+void BinaryMatrix_dealloc(BinaryMatrixObject*);
+PyObject* BinaryMatrix_shape(BinaryMatrixObject*, void*);
+PyObject* BinaryMatrix_to_dense(BinaryMatrixObject*);
+
 #endif
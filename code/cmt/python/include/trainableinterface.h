@@ -22,9 +22,12 @@ extern const char* Trainable_initialize_doc;
 extern const char* Trainable_parameters_doc;
 extern const char* Trainable_set_parameters_doc;
 extern const char* Trainable_parameter_gradient_doc;
+extern const char* Trainable_per_example_gradients_doc;
 extern const char* Trainable_fisher_information_doc;
 extern const char* Trainable_check_gradient_doc;
+extern const char* Trainable_check_directional_derivatives_doc;
 extern const char* Trainable_check_performance_doc;
+extern const char* Trainable_telemetry_doc;
 
 Trainable::Parameters* PyObject_ToParameters(
 	PyObject* parameters,
@@ -32,12 +35,35 @@ Trainable::Parameters* PyObject_ToParameters(
 Trainable::Parameters* PyObject_ToParameters(PyObject* parameters);
 
 PyObject* Trainable_initialize(TrainableObject* self, PyObject* args, PyObject* kwds);
+PyObject* Trainable_telemetry(TrainableObject* self, void*);
 
 PyObject* Trainable_train(
 	TrainableObject* self,
 	PyObject* args,
 	PyObject* kwds,
 	Trainable::Parameters* (*PyObject_ToParameters)(PyObject*));
+PyObject* Trainable_train_sparse(
+	TrainableObject* self,
+	PyObject* input,
+	PyObject* output,
+	bool validation,
+	PyObject* parameters,
+	Trainable::Parameters* (*PyObject_ToParameters)(PyObject*));
+PyObject* Trainable_train_windows(
+	TrainableObject* self,
+	PyObject* input,
+	PyObject* output,
+	bool validation,
+	PyObject* parameters,
+	Trainable::Parameters* (*PyObject_ToParameters)(PyObject*));
+PyObject* Trainable_train_binary(
+	TrainableObject* self,
+	PyObject* input,
+	PyObject* output,
+	PyObject* input_val,
+	PyObject* output_val,
+	PyObject* parameters,
+	Trainable::Parameters* (*PyObject_ToParameters)(PyObject*));
 
 PyObject* Trainable_parameters(
 	TrainableObject* self,
@@ -57,12 +83,24 @@ PyObject* Trainable_check_gradient(
 	PyObject* kwds,
 	Trainable::Parameters* (*PyObject_ToParameters)(PyObject*));
 
+PyObject* Trainable_check_directional_derivatives(
+	TrainableObject* self,
+	PyObject* args,
+	PyObject* kwds,
+	Trainable::Parameters* (*PyObject_ToParameters)(PyObject*));
+
 PyObject* Trainable_parameter_gradient(
 	TrainableObject* self,
 	PyObject* args,
 	PyObject* kwds,
 	Trainable::Parameters* (*PyObject_ToParameters)(PyObject*));
 
+PyObject* Trainable_per_example_gradients(
+	TrainableObject* self,
+	PyObject* args,
+	PyObject* kwds,
+	Trainable::Parameters* (*PyObject_ToParameters)(PyObject*));
+
 PyObject* Trainable_fisher_information(
 	TrainableObject* self,
 	PyObject* args,
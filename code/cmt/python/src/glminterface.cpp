@@ -2,6 +2,8 @@
 #include "distributioninterface.h"
 #include "trainableinterface.h"
 #include "callbackinterface.h"
+#include "conditionaldistributioninterface.h"
+#include "toolsinterface.h"
 
 #include "cmt/utils"
 using CMT::Exception;
@@ -40,6 +42,13 @@ Trainable::Parameters* PyObject_ToGLMParameters(PyObject* parameters) {
 			else
 				throw Exception("train_nonlinearity should be of type `bool`.");
 
+		PyObject* newton = PyDict_GetItemString(parameters, "newton");
+		if(newton)
+			if(PyBool_Check(newton))
+				params->newton = (newton == Py_True);
+			else
+				throw Exception("newton should be of type `bool`.");
+
 		PyObject* regularize_weights = PyDict_GetItemString(parameters, "regularize_weights");
 		if(regularize_weights)
 			params->regularizeWeights = PyObject_ToRegularizer(regularize_weights);
@@ -320,9 +329,11 @@ const char* GLM_train_doc =
 	"\t>>> \t'cb_iter': 25,\n"
 	"\t>>> \t'val_iter': 5,\n"
 	"\t>>> \t'val_look_ahead': 20,\n"
+	"\t>>> \t'val_async': False,\n"
 	"\t>>> \t'train_weights': True,\n"
 	"\t>>> \t'train_bias': True,\n"
 	"\t>>> \t'train_nonlinearity': False,\n"
+	"\t>>> \t'newton': False,\n"
 	"\t>>> \t'regularize_weights': {\n"
 	"\t>>> \t\t'strength': 0.,\n"
 	"\t>>> \t\t'transform': None,\n"
@@ -347,6 +358,16 @@ const char* GLM_train_doc =
 	"The parameter C{batch_size} has no effect on the solution of the optimization but\n"
 	"can affect speed by reducing the number of cache misses.\n"
 	"\n"
+	"If C{newton} is set, the parameters are optimized using Newton's method (iteratively\n"
+	"reweighted least squares) instead of L-BFGS, which typically converges within a few\n"
+	"iterations. This requires a logistic nonlinearity with a Bernoulli distribution or an\n"
+	"exponential nonlinearity with a Poisson distribution. In all other cases, as well as for\n"
+	"L1 regularization or if validation data is given, L-BFGS is used.\n"
+	"\n"
+	"If C{val_async} is set and validation data is given, the validation error is evaluated on a\n"
+	"copy of the model in a separate thread while the optimization continues. Early stopping then\n"
+	"takes effect up to C{val_iter} iterations later.\n"
+	"\n"
 	"If a callback function is given, it will be called every C{cb_iter} iterations. The first\n"
 	"argument to callback will be the current iteration, the second argument will be a I{copy} of\n"
 	"the model.\n"
@@ -354,7 +375,12 @@ const char* GLM_train_doc =
 	"\t>>> def callback(i, glm):\n"
 	"\t>>> \tprint i\n"
 	"\n"
-	"@type  input: C{ndarray}\n"
+	"Inputs may also be given as a SciPy sparse matrix, in which case they are not converted\n"
+	"into a dense matrix and the cost of training scales with the number of non-zero entries.\n"
+	"Similarly, inputs given as L{WindowedTimeSeries<tools.WindowedTimeSeries>} are never\n"
+	"extracted. Validation data is not supported for sparse or windowed inputs.\n"
+	"\n"
+	"@type  input: C{ndarray}/C{spmatrix}/C{WindowedTimeSeries}\n"
 	"@param input: inputs stored in columns\n"
 	"\n"
 	"@type  output: C{ndarray}\n"
@@ -372,6 +398,92 @@ const char* GLM_train_doc =
 	"@rtype: C{bool}\n"
 	"@return: C{True} if training converged, otherwise C{False}";
 
+PyObject* GLM_sample(GLMObject* self, PyObject* args, PyObject* kwds) {
+	const char* kwlist[] = {"input", 0};
+
+	PyObject* input;
+
+	if(!PyArg_ParseTupleAndKeywords(args, kwds, "O", const_cast<char**>(kwlist), &input))
+		return 0;
+
+	if(!PyObject_IsSparseMatrix(input))
+		return CD_sample(reinterpret_cast<CDObject*>(self), args, kwds);
+
+	try {
+		return PyArray_FromMatrixXd(self->glm->sample(PyObject_ToSparseMatrixXd(input)));
+	} catch(Exception exception) {
+		PyErr_SetString(PyExc_RuntimeError, exception.message());
+		return 0;
+	}
+
+	return 0;
+}
+
+
+
+PyObject* GLM_predict(GLMObject* self, PyObject* args, PyObject* kwds) {
+	const char* kwlist[] = {"input", 0};
+
+	PyObject* input;
+
+	if(!PyArg_ParseTupleAndKeywords(args, kwds, "O", const_cast<char**>(kwlist), &input))
+		return 0;
+
+	if(!PyObject_IsSparseMatrix(input))
+		return CD_predict(reinterpret_cast<CDObject*>(self), args, kwds);
+
+	try {
+		return PyArray_FromMatrixXd(self->glm->predict(PyObject_ToSparseMatrixXd(input)));
+	} catch(Exception exception) {
+		PyErr_SetString(PyExc_RuntimeError, exception.message());
+		return 0;
+	}
+
+	return 0;
+}
+
+
+
+PyObject* GLM_loglikelihood(GLMObject* self, PyObject* args, PyObject* kwds) {
+	const char* kwlist[] = {"input", "output", 0};
+
+	PyObject* input;
+	PyObject* output;
+
+	if(!PyArg_ParseTupleAndKeywords(args, kwds, "OO", const_cast<char**>(kwlist), &input, &output))
+		return 0;
+
+	bool windowed = PyObject_TypeCheck(input, &WindowedTimeSeries_type);
+
+	if(!windowed && !PyObject_IsSparseMatrix(input))
+		return CD_loglikelihood(reinterpret_cast<CDObject*>(self), args, kwds);
+
+	output = PyArray_FROM_OTF(output, NPY_DOUBLE, NPY_F_CONTIGUOUS | NPY_ALIGNED);
+
+	if(!output) {
+		PyErr_SetString(PyExc_TypeError, "Outputs have to be stored in a NumPy array.");
+		return 0;
+	}
+
+	try {
+		PyObject* result = PyArray_FromMatrixXd(windowed ?
+			self->glm->logLikelihood(
+				*reinterpret_cast<WindowedTimeSeriesObject*>(input)->windows,
+				PyArray_ToMatrixXd(output)) :
+			self->glm->logLikelihood(PyObject_ToSparseMatrixXd(input), PyArray_ToMatrixXd(output)));
+		Py_DECREF(output);
+		return result;
+	} catch(Exception exception) {
+		Py_DECREF(output);
+		PyErr_SetString(PyExc_RuntimeError, exception.message());
+		return 0;
+	}
+
+	return 0;
+}
+
+
+
 PyObject* GLM_train(GLMObject* self, PyObject* args, PyObject* kwds) {
 	return Trainable_train(
 		reinterpret_cast<TrainableObject*>(self), 
@@ -412,6 +524,16 @@ PyObject* GLM_parameter_gradient(GLMObject* self, PyObject* args, PyObject* kwds
 
 
 
+PyObject* GLM_per_example_gradients(GLMObject* self, PyObject* args, PyObject* kwds) {
+	return Trainable_per_example_gradients(
+		reinterpret_cast<TrainableObject*>(self),
+		args,
+		kwds,
+		&PyObject_ToGLMParameters);
+}
+
+
+
 PyObject* GLM_fisher_information(GLMObject* self, PyObject* args, PyObject* kwds) {
 	return Trainable_fisher_information(
 		reinterpret_cast<TrainableObject*>(self), 
@@ -432,6 +554,16 @@ PyObject* GLM_check_gradient(GLMObject* self, PyObject* args, PyObject* kwds) {
 
 
 
+PyObject* GLM_check_directional_derivatives(GLMObject* self, PyObject* args, PyObject* kwds) {
+	return Trainable_check_directional_derivatives(
+		reinterpret_cast<TrainableObject*>(self), 
+		args, 
+		kwds,
+		&PyObject_ToGLMParameters);
+}
+
+
+
 PyObject* GLM_check_performance(GLMObject* self, PyObject* args, PyObject* kwds) {
 	return Trainable_check_performance(
 		reinterpret_cast<TrainableObject*>(self),
@@ -4,6 +4,7 @@
 #include "patchmodelinterface.h"
 #include "preconditionerinterface.h"
 #include "mcbminterface.h"
+#include "toolsinterface.h"
 
 #include <utility>
 using std::make_pair;
@@ -386,6 +387,7 @@ const char* MCBM_train_doc =
 	"\t>>> \t'cb_iter': 25,\n"
 	"\t>>> \t'val_iter': 5,\n"
 	"\t>>> \t'val_look_ahead': 20,\n"
+	"\t>>> \t'val_async': False,\n"
 	"\t>>> \t'train_priors': True,\n"
 	"\t>>> \t'train_weights': True,\n"
 	"\t>>> \t'train_features': True,\n"
@@ -419,9 +421,18 @@ const char* MCBM_train_doc =
 	"to the average log-likelihood, where $\\eta$ is given by C{strength}, $\\mathbf{A}$ is\n"
 	"given by C{transform}, and $p$ is controlled by C{norm}, which has to be either C{'L1'} or C{'L2'}.\n"
 	"\n"
+	"Inputs containing only zeros and ones are packed into bits for the duration of training, "
+	"which saves memory and time. Binary inputs can also be passed as a L{BinaryMatrix}, in which "
+	"case they are never unpacked into a dense matrix. Validation data is always given as dense "
+	"arrays.\n"
+	"\n"
 	"The parameter C{batch_size} has no effect on the solution of the optimization but "
 	"can affect speed by reducing the number of cache misses.\n"
 	"\n"
+	"If C{val_async} is set and validation data is given, the validation error is evaluated on a "
+	"copy of the model in a separate thread while the optimization continues. Early stopping then "
+	"takes effect up to C{val_iter} iterations later.\n"
+	"\n"
 	"If a callback function is given, it will be called every C{cb_iter} iterations. The first "
 	"argument to callback will be the current iteration, the second argument will be a I{copy} of "
 	"the model.\n"
@@ -429,7 +440,7 @@ const char* MCBM_train_doc =
 	"\t>>> def callback(i, mcbm):\n"
 	"\t>>> \tprint i\n"
 	"\n"
-	"@type  input: C{ndarray}\n"
+	"@type  input: C{ndarray}/L{BinaryMatrix}\n"
 	"@param input: inputs stored in columns\n"
 	"\n"
 	"@type  output: C{ndarray}\n"
@@ -457,6 +468,66 @@ PyObject* MCBM_train(MCBMObject* self, PyObject* args, PyObject* kwds) {
 
 
 
+PyObject* MCBM_sample(MCBMObject* self, PyObject* args, PyObject* kwds) {
+	const char* kwlist[] = {"input", 0};
+
+	PyObject* input;
+
+	if(!PyArg_ParseTupleAndKeywords(args, kwds, "O", const_cast<char**>(kwlist), &input))
+		return 0;
+
+	if(!PyObject_TypeCheck(input, &BinaryMatrix_type))
+		return CD_sample(reinterpret_cast<CDObject*>(self), args, kwds);
+
+	try {
+		return PyArray_FromMatrixXd(
+			self->mcbm->sample(*reinterpret_cast<BinaryMatrixObject*>(input)->matrix));
+	} catch(Exception exception) {
+		PyErr_SetString(PyExc_RuntimeError, exception.message());
+		return 0;
+	}
+
+	return 0;
+}
+
+
+
+PyObject* MCBM_loglikelihood(MCBMObject* self, PyObject* args, PyObject* kwds) {
+	const char* kwlist[] = {"input", "output", 0};
+
+	PyObject* input;
+	PyObject* output;
+
+	if(!PyArg_ParseTupleAndKeywords(args, kwds, "OO", const_cast<char**>(kwlist), &input, &output))
+		return 0;
+
+	if(!PyObject_TypeCheck(input, &BinaryMatrix_type))
+		return CD_loglikelihood(reinterpret_cast<CDObject*>(self), args, kwds);
+
+	output = PyArray_FROM_OTF(output, NPY_DOUBLE, NPY_F_CONTIGUOUS | NPY_ALIGNED);
+
+	if(!output) {
+		PyErr_SetString(PyExc_TypeError, "Outputs have to be stored in a NumPy array.");
+		return 0;
+	}
+
+	try {
+		PyObject* result = PyArray_FromMatrixXd(self->mcbm->logLikelihood(
+			*reinterpret_cast<BinaryMatrixObject*>(input)->matrix,
+			PyArray_ToMatrixXd(output)));
+		Py_DECREF(output);
+		return result;
+	} catch(Exception exception) {
+		Py_DECREF(output);
+		PyErr_SetString(PyExc_RuntimeError, exception.message());
+		return 0;
+	}
+
+	return 0;
+}
+
+
+
 const char* MCBM_sample_posterior_doc =
 	"sample_posterior(self, input, output)\n"
 	"\n"
@@ -542,6 +613,16 @@ PyObject* MCBM_parameter_gradient(MCBMObject* self, PyObject* args, PyObject* kw
 
 
 
+PyObject* MCBM_per_example_gradients(MCBMObject* self, PyObject* args, PyObject* kwds) {
+	return Trainable_per_example_gradients(
+		reinterpret_cast<TrainableObject*>(self),
+		args,
+		kwds,
+		&PyObject_ToMCBMParameters);
+}
+
+
+
 PyObject* MCBM_check_gradient(MCBMObject* self, PyObject* args, PyObject* kwds) {
 	return Trainable_check_gradient(
 		reinterpret_cast<TrainableObject*>(self), 
@@ -552,6 +633,16 @@ PyObject* MCBM_check_gradient(MCBMObject* self, PyObject* args, PyObject* kwds)
 
 
 
+PyObject* MCBM_check_directional_derivatives(MCBMObject* self, PyObject* args, PyObject* kwds) {
+	return Trainable_check_directional_derivatives(
+		reinterpret_cast<TrainableObject*>(self), 
+		args, 
+		kwds,
+		&PyObject_ToMCBMParameters);
+}
+
+
+
 PyObject* MCBM_check_performance(MCBMObject* self, PyObject* args, PyObject* kwds) {
 	return Trainable_check_performance(
 		reinterpret_cast<TrainableObject*>(self), 
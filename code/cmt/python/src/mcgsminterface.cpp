@@ -546,6 +546,7 @@ const char* MCGSM_train_doc =
 	"\t>>> \t'cb_iter': 25,\n"
 	"\t>>> \t'val_iter': 5,\n"
 	"\t>>> \t'val_look_ahead': 20,\n"
+	"\t>>> \t'val_async': False,\n"
 	"\t>>> \t'train_priors': True,\n"
 	"\t>>> \t'train_scales': True,\n"
 	"\t>>> \t'train_weights': True,\n"
@@ -592,6 +593,10 @@ const char* MCGSM_train_doc =
 	"The parameter C{batch_size} has no effect on the solution of the optimization but "
 	"can affect speed by reducing the number of cache misses.\n"
 	"\n"
+	"If C{val_async} is set and validation data is given, the validation error is evaluated on a "
+	"copy of the model in a separate thread while the optimization continues. Early stopping then "
+	"takes effect up to C{val_iter} iterations later.\n"
+	"\n"
 	"If a callback function is given, it will be called every C{cb_iter} iterations. The first "
 	"argument to callback will be the current iteration, the second argument will be a I{copy} of "
 	"the model.\n"
@@ -647,6 +652,16 @@ PyObject* MCGSM_check_gradient(MCGSMObject* self, PyObject* args, PyObject* kwds
 
 
 
+PyObject* MCGSM_check_directional_derivatives(MCGSMObject* self, PyObject* args, PyObject* kwds) {
+	return Trainable_check_directional_derivatives(
+		reinterpret_cast<TrainableObject*>(self), 
+		args, 
+		kwds,
+		&PyObject_ToMCGSMParameters);
+}
+
+
+
 const char* MCGSM_loglikelihood_doc =
 	"loglikelihood(self, input, output, labels=None)\n"
 	"\n"
@@ -1027,6 +1042,16 @@ PyObject* MCGSM_parameter_gradient(MCGSMObject* self, PyObject* args, PyObject*
 
 
 
+PyObject* MCGSM_per_example_gradients(MCGSMObject* self, PyObject* args, PyObject* kwds) {
+	return Trainable_per_example_gradients(
+		reinterpret_cast<TrainableObject*>(self),
+		args,
+		kwds,
+		&PyObject_ToMCGSMParameters);
+}
+
+
+
 PyObject* MCGSM_compute_data_gradient(MCGSMObject* self, PyObject* args, PyObject* kwds) {
 	const char* kwlist[] = {"input", "output", 0};
 
@@ -272,6 +272,33 @@ Mixture::Parameters* PyObject_ToMixtureParameters(PyObject* parameters) {
 				params->regularizePriors = static_cast<double>(PyFloat_AsDouble(regularize_priors));
 			else
 				throw Exception("regularize_priors should be of type `float`.");
+
+		PyObject* batch_size = PyDict_GetItemString(parameters, "batch_size");
+		if(batch_size)
+			if(PyInt_Check(batch_size))
+				params->batchSize = PyInt_AsLong(batch_size);
+			else if(PyFloat_Check(batch_size))
+				params->batchSize = static_cast<int>(PyFloat_AsDouble(batch_size));
+			else
+				throw Exception("batch_size should be of type `int`.");
+
+		PyObject* step_size_offset = PyDict_GetItemString(parameters, "step_size_offset");
+		if(step_size_offset)
+			if(PyFloat_Check(step_size_offset))
+				params->stepSizeOffset = PyFloat_AsDouble(step_size_offset);
+			else if(PyInt_Check(step_size_offset))
+				params->stepSizeOffset = static_cast<double>(PyFloat_AsDouble(step_size_offset));
+			else
+				throw Exception("step_size_offset should be of type `float`.");
+
+		PyObject* step_size_decay = PyDict_GetItemString(parameters, "step_size_decay");
+		if(step_size_decay)
+			if(PyFloat_Check(step_size_decay))
+				params->stepSizeDecay = PyFloat_AsDouble(step_size_decay);
+			else if(PyInt_Check(step_size_decay))
+				params->stepSizeDecay = static_cast<double>(PyFloat_AsDouble(step_size_decay));
+			else
+				throw Exception("step_size_decay should be of type `float`.");
 	}
 
 	return params;
@@ -297,6 +324,7 @@ const char* Mixture_train_doc =
 	"\t>>> \t\t'train_priors': True,\n"
 	"\t>>> \t\t'train_components': True,\n"
 	"\t>>> \t\t'regularize_priors': 0.,\n"
+	"\t>>> \t\t'batch_size': 2000,\n"
 	"\t>>> \t},\n"
 	"\t>>> \tcomponent_parameters={\n"
 	"\t>>> \t\t'verbosity': 0,\n"
@@ -312,6 +340,12 @@ const char* Mixture_train_doc =
 	"\t>>> \t},\n"
 	"\t>>> })\n"
 	"\n"
+	"Each iteration reads the data once. The data is processed in batches of C{batch_size} data\n"
+	"points, for which all components accumulate sufficient statistics weighted by their\n"
+	"posterior probabilities. The components are then fit to these statistics, which for\n"
+	"L{GSMs<models.GSM>} means that the scales are updated once per iteration using squared\n"
+	"norms computed with the parameters of the previous iteration.\n"
+	"\n"
 	"@type  data: C{ndarray}\n"
 	"@param data: data points stored in columns\n"
 	"\n"
@@ -398,6 +432,128 @@ PyObject* Mixture_train(MixtureObject* self, PyObject* args, PyObject* kwds) {
 
 
 
+const char* Mixture_train_online_doc =
+	"train_online(self, data, data_valid=None, parameters=None, component_parameters=None)\n"
+	"\n"
+	"Fits the parameters of the mixture distribution to a stream of data using stepwise EM.\n"
+	"\n"
+	"Instead of a single array, C{data} can be any iterable yielding arrays with data points stored\n"
+	"in columns, for example a generator producing batches of image patches. Only sufficient\n"
+	"statistics are kept between batches, so that memory does not grow with the number of batches.\n"
+	"\n"
+	"\t>>> def patches():\n"
+	"\t>>> \twhile True:\n"
+	"\t>>> \t\tyield sample_patches(1000)\n"
+	"\t>>>\n"
+	"\t>>> model.train_online(patches(), data_valid,\n"
+	"\t>>> \tparameters={\n"
+	"\t>>> \t\t'max_iter': 1000,\n"
+	"\t>>> \t\t'val_iter': 10,\n"
+	"\t>>> \t\t'val_look_ahead': 5,\n"
+	"\t>>> \t\t'step_size_offset': 2.,\n"
+	"\t>>> \t\t'step_size_decay': 0.7,\n"
+	"\t>>> \t})\n"
+	"\n"
+	"After the $t$-th batch, the statistics are replaced by a weighted average of the previous\n"
+	"statistics and the statistics of the batch, where the batch is given weight\n"
+	"$(t + t_0)^{-\\kappa}$. Here, $t_0$ is C{step_size_offset} and $\\kappa$ is C{step_size_decay},\n"
+	"which should be between 0.5 and 1. Afterwards, the prior weights and components are updated.\n"
+	"C{max_iter} limits the number of batches and C{val_iter} counts batches between evaluations\n"
+	"on the validation data. All other parameters are the same as for L{train()}.\n"
+	"\n"
+	"@type  data: C{iterable}\n"
+	"@param data: yields batches of data points stored in columns\n"
+	"\n"
+	"@type  data_valid: C{ndarray}\n"
+	"@param data_valid: validation data used for early stopping\n"
+	"\n"
+	"@type  parameters: C{dict}\n"
+	"@param parameters: hyperparameters controlling optimization and regularization\n"
+	"\n"
+	"@type  component_parameters: C{dict}\n"
+	"@param component_parameters: hyperparameters passed down to components during M-step\n"
+	"\n"
+	"@rtype: C{bool}\n"
+	"@return: C{True} if training was stopped early, otherwise C{False}";
+
+PyObject* Mixture_train_online(MixtureObject* self, PyObject* args, PyObject* kwds) {
+	const char* kwlist[] = {"data", "data_valid", "parameters", "component_parameters", 0};
+
+	PyObject* data;
+	PyObject* data_valid = 0;
+	PyObject* parameters = 0;
+	PyObject* component_parameters = 0;
+
+	if(!PyArg_ParseTupleAndKeywords(args, kwds, "O|OOO", const_cast<char**>(kwlist),
+		&data, &data_valid, &parameters, &component_parameters))
+		return 0;
+
+	if(data_valid == Py_None)
+		data_valid = 0;
+
+	data = PyObject_GetIter(data);
+
+	if(!data) {
+		PyErr_SetString(PyExc_TypeError, "Data should be iterable.");
+		return 0;
+	}
+
+	if(data_valid) {
+		data_valid = PyArray_FROM_OTF(data_valid, NPY_DOUBLE, NPY_F_CONTIGUOUS | NPY_ALIGNED);
+
+		if(!data_valid) {
+			PyErr_SetString(PyExc_TypeError, "Validation data should be stored in a Numpy array.");
+			Py_DECREF(data);
+			return 0;
+		}
+	}
+
+	bool converged;
+
+	// released when training throws, e.g. because the iterator yields invalid data
+	Mixture::Parameters* params = 0;
+	Mixture::Component::Parameters* component_params = 0;
+
+	try {
+		params = PyObject_ToMixtureParameters(parameters);
+		component_params = PyObject_ToMixtureComponentParameters(component_parameters);
+
+		PyIteratorStream stream(data);
+
+		if(data_valid)
+			converged = self->mixture->trainOnline(
+				stream,
+				PyArray_ToMatrixXd(data_valid),
+				*params,
+				*component_params);
+		else
+			converged = self->mixture->trainOnline(stream, *params, *component_params);
+
+		delete params;
+		delete component_params;
+	} catch(Exception exception) {
+		delete params;
+		delete component_params;
+		Py_DECREF(data);
+		Py_XDECREF(data_valid);
+		PyErr_SetString(PyExc_RuntimeError, exception.message());
+		return 0;
+	}
+
+	Py_DECREF(data);
+	Py_XDECREF(data_valid);
+
+	if(converged) {
+		Py_INCREF(Py_True);
+		return Py_True;
+	} else {
+		Py_INCREF(Py_False);
+		return Py_False;
+	}
+}
+
+
+
 const char* Mixture_initialize_doc =
 	"train(self, data, parameters=None, component_parameters=None)\n"
 	"\n"
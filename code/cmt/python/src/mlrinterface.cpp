@@ -2,6 +2,7 @@
 #include "distributioninterface.h"
 #include "trainableinterface.h"
 #include "callbackinterface.h"
+#include "conditionaldistributioninterface.h"
 
 #include "cmt/utils"
 using CMT::Exception;
@@ -33,6 +34,13 @@ Trainable::Parameters* PyObject_ToMLRParameters(PyObject* parameters) {
 			else
 				throw Exception("train_biases should be of type `bool`.");
 
+		PyObject* newton = PyDict_GetItemString(parameters, "newton");
+		if(newton)
+			if(PyBool_Check(newton))
+				params->newton = (newton == Py_True);
+			else
+				throw Exception("newton should be of type `bool`.");
+
 		PyObject* regularize_weights = PyDict_GetItemString(parameters, "regularize_weights");
 		if(regularize_weights)
 			params->regularizeWeights = PyObject_ToRegularizer(regularize_weights);
@@ -189,8 +197,10 @@ const char* MLR_train_doc =
 	"\t>>> \t'cb_iter': 25,\n"
 	"\t>>> \t'val_iter': 5,\n"
 	"\t>>> \t'val_look_ahead': 20,\n"
+	"\t>>> \t'val_async': False,\n"
 	"\t>>> \t'train_weights': True,\n"
 	"\t>>> \t'train_biases': True,\n"
+	"\t>>> \t'newton': False,\n"
 	"\t>>> \t'regularize_weights': {\n"
 	"\t>>> \t\t'strength': 0.,\n"
 	"\t>>> \t\t'transform': None,\n"
@@ -215,6 +225,14 @@ const char* MLR_train_doc =
 	"The parameter C{batch_size} has no effect on the solution of the optimization but\n"
 	"can affect speed by reducing the number of cache misses.\n"
 	"\n"
+	"If C{newton} is set, the parameters are optimized using Newton's method with a\n"
+	"block-diagonal approximation of the Hessian (one block per output) instead of L-BFGS.\n"
+	"L-BFGS is still used for L1 regularization or if validation data is given.\n"
+	"\n"
+	"If C{val_async} is set and validation data is given, the validation error is evaluated on a\n"
+	"copy of the model in a separate thread while the optimization continues. Early stopping then\n"
+	"takes effect up to C{val_iter} iterations later.\n"
+	"\n"
 	"If a callback function is given, it will be called every C{cb_iter} iterations. The first\n"
 	"argument to callback will be the current iteration, the second argument will be a I{copy} of\n"
 	"the model.\n"
@@ -222,7 +240,11 @@ const char* MLR_train_doc =
 	"\t>>> def callback(i, mlr):\n"
 	"\t>>> \tprint i\n"
 	"\n"
-	"@type  input: C{ndarray}\n"
+	"Inputs may also be given as a SciPy sparse matrix, in which case they are not converted\n"
+	"into a dense matrix and the cost of training scales with the number of non-zero entries.\n"
+	"Validation data is not supported for sparse inputs.\n"
+	"\n"
+	"@type  input: C{ndarray}/C{spmatrix}\n"
 	"@param input: inputs stored in columns\n"
 	"\n"
 	"@type  output: C{ndarray}\n"
@@ -240,6 +262,87 @@ const char* MLR_train_doc =
 	"@rtype: C{bool}\n"
 	"@return: C{True} if training converged, otherwise C{False}";
 
+PyObject* MLR_sample(MLRObject* self, PyObject* args, PyObject* kwds) {
+	const char* kwlist[] = {"input", 0};
+
+	PyObject* input;
+
+	if(!PyArg_ParseTupleAndKeywords(args, kwds, "O", const_cast<char**>(kwlist), &input))
+		return 0;
+
+	if(!PyObject_IsSparseMatrix(input))
+		return CD_sample(reinterpret_cast<CDObject*>(self), args, kwds);
+
+	try {
+		return PyArray_FromMatrixXd(self->mlr->sample(PyObject_ToSparseMatrixXd(input)));
+	} catch(Exception exception) {
+		PyErr_SetString(PyExc_RuntimeError, exception.message());
+		return 0;
+	}
+
+	return 0;
+}
+
+
+
+PyObject* MLR_predict(MLRObject* self, PyObject* args, PyObject* kwds) {
+	const char* kwlist[] = {"input", 0};
+
+	PyObject* input;
+
+	if(!PyArg_ParseTupleAndKeywords(args, kwds, "O", const_cast<char**>(kwlist), &input))
+		return 0;
+
+	if(!PyObject_IsSparseMatrix(input))
+		return CD_predict(reinterpret_cast<CDObject*>(self), args, kwds);
+
+	try {
+		return PyArray_FromMatrixXd(self->mlr->predict(PyObject_ToSparseMatrixXd(input)));
+	} catch(Exception exception) {
+		PyErr_SetString(PyExc_RuntimeError, exception.message());
+		return 0;
+	}
+
+	return 0;
+}
+
+
+
+PyObject* MLR_loglikelihood(MLRObject* self, PyObject* args, PyObject* kwds) {
+	const char* kwlist[] = {"input", "output", 0};
+
+	PyObject* input;
+	PyObject* output;
+
+	if(!PyArg_ParseTupleAndKeywords(args, kwds, "OO", const_cast<char**>(kwlist), &input, &output))
+		return 0;
+
+	if(!PyObject_IsSparseMatrix(input))
+		return CD_loglikelihood(reinterpret_cast<CDObject*>(self), args, kwds);
+
+	output = PyArray_FROM_OTF(output, NPY_DOUBLE, NPY_F_CONTIGUOUS | NPY_ALIGNED);
+
+	if(!output) {
+		PyErr_SetString(PyExc_TypeError, "Outputs have to be stored in a NumPy array.");
+		return 0;
+	}
+
+	try {
+		PyObject* result = PyArray_FromMatrixXd(
+			self->mlr->logLikelihood(PyObject_ToSparseMatrixXd(input), PyArray_ToMatrixXd(output)));
+		Py_DECREF(output);
+		return result;
+	} catch(Exception exception) {
+		Py_DECREF(output);
+		PyErr_SetString(PyExc_RuntimeError, exception.message());
+		return 0;
+	}
+
+	return 0;
+}
+
+
+
 PyObject* MLR_train(MLRObject* self, PyObject* args, PyObject* kwds) {
 	return Trainable_train(
 		reinterpret_cast<TrainableObject*>(self), 
@@ -280,6 +383,16 @@ PyObject* MLR_parameter_gradient(MLRObject* self, PyObject* args, PyObject* kwds
 
 
 
+PyObject* MLR_per_example_gradients(MLRObject* self, PyObject* args, PyObject* kwds) {
+	return Trainable_per_example_gradients(
+		reinterpret_cast<TrainableObject*>(self),
+		args,
+		kwds,
+		&PyObject_ToMLRParameters);
+}
+
+
+
 PyObject* MLR_check_gradient(MLRObject* self, PyObject* args, PyObject* kwds) {
 	return Trainable_check_gradient(
 		reinterpret_cast<TrainableObject*>(self), 
@@ -290,6 +403,16 @@ PyObject* MLR_check_gradient(MLRObject* self, PyObject* args, PyObject* kwds) {
 
 
 
+PyObject* MLR_check_directional_derivatives(MLRObject* self, PyObject* args, PyObject* kwds) {
+	return Trainable_check_directional_derivatives(
+		reinterpret_cast<TrainableObject*>(self), 
+		args, 
+		kwds,
+		&PyObject_ToMLRParameters);
+}
+
+
+
 PyObject* MLR_check_performance(MLRObject* self, PyObject* args, PyObject* kwds) {
 	return Trainable_check_performance(
 		reinterpret_cast<TrainableObject*>(self),
@@ -185,6 +185,9 @@ static PyGetSetDef MCGSM_getset[] = {
 		(getter)MCGSM_means,
 		(setter)MCGSM_set_means,
 		"Means of outputs, $\\mathbf{u}_c$."},
+	{"telemetry",
+		(getter)Trainable_telemetry, 0,
+		const_cast<char*>(Trainable_telemetry_doc)},
 	{0}
 };
 
@@ -222,6 +225,10 @@ static PyMethodDef MCGSM_methods[] = {
 		(PyCFunction)MCGSM_check_gradient,
 		METH_VARARGS | METH_KEYWORDS,
 		Trainable_check_gradient_doc},
+	{"_check_directional_derivatives",
+		(PyCFunction)MCGSM_check_directional_derivatives,
+		METH_VARARGS | METH_KEYWORDS,
+		Trainable_check_directional_derivatives_doc},
 	{"_check_performance",
 		(PyCFunction)MCGSM_check_performance,
 		METH_VARARGS | METH_KEYWORDS, 
@@ -238,6 +245,10 @@ static PyMethodDef MCGSM_methods[] = {
 		(PyCFunction)MCGSM_parameter_gradient,
 		METH_VARARGS | METH_KEYWORDS,
 		Trainable_parameter_gradient_doc},
+	{"_per_example_gradients",
+		(PyCFunction)MCGSM_per_example_gradients,
+		METH_VARARGS | METH_KEYWORDS,
+		Trainable_per_example_gradients_doc},
 	{"__reduce__", (PyCFunction)MCGSM_reduce, METH_NOARGS, MCGSM_reduce_doc},
 	{"__setstate__", (PyCFunction)MCGSM_setstate, METH_VARARGS, MCGSM_setstate_doc},
 	{0}
@@ -313,11 +324,16 @@ static PyGetSetDef MCBM_getset[] = {
 		(getter)MCBM_output_bias,
 		(setter)MCBM_set_output_bias,
 		"Output biases, $v_c$."},
+	{"telemetry",
+		(getter)Trainable_telemetry, 0,
+		const_cast<char*>(Trainable_telemetry_doc)},
 	{0}
 };
 
 static PyMethodDef MCBM_methods[] = {
 	{"train", (PyCFunction)MCBM_train, METH_VARARGS | METH_KEYWORDS, MCBM_train_doc},
+	{"sample", (PyCFunction)MCBM_sample, METH_VARARGS | METH_KEYWORDS, CD_sample_doc},
+	{"loglikelihood", (PyCFunction)MCBM_loglikelihood, METH_VARARGS | METH_KEYWORDS, CD_loglikelihood_doc},
 	{"sample_posterior",
 		(PyCFunction)MCBM_sample_posterior,
 		METH_VARARGS | METH_KEYWORDS,
@@ -334,6 +350,10 @@ static PyMethodDef MCBM_methods[] = {
 		(PyCFunction)MCBM_parameter_gradient,
 		METH_VARARGS | METH_KEYWORDS,
 		Trainable_parameter_gradient_doc},
+	{"_per_example_gradients",
+		(PyCFunction)MCBM_per_example_gradients,
+		METH_VARARGS | METH_KEYWORDS,
+		Trainable_per_example_gradients_doc},
 	{"_check_performance",
 		(PyCFunction)MCBM_check_performance,
 		METH_VARARGS | METH_KEYWORDS,
@@ -342,6 +362,10 @@ static PyMethodDef MCBM_methods[] = {
 		(PyCFunction)MCBM_check_gradient,
 		METH_VARARGS | METH_KEYWORDS,
 		Trainable_check_gradient_doc},
+	{"_check_directional_derivatives",
+		(PyCFunction)MCBM_check_directional_derivatives,
+		METH_VARARGS | METH_KEYWORDS,
+		Trainable_check_directional_derivatives_doc},
 	{"__reduce__", (PyCFunction)MCBM_reduce, METH_NOARGS, MCBM_reduce_doc},
 	{"__setstate__", (PyCFunction)MCBM_setstate, METH_VARARGS, MCBM_setstate_doc},
 	{0}
@@ -427,6 +451,9 @@ static PyGetSetDef STM_getset[] = {
 		(getter)STM_distribution,
 		(setter)STM_set_distribution,
 		"Distribution whose average value is determined by output of nonlinearity."},
+	{"telemetry",
+		(getter)Trainable_telemetry, 0,
+		const_cast<char*>(Trainable_telemetry_doc)},
 	{0}
 };
 
@@ -443,6 +470,9 @@ static PyMethodDef STM_methods[] = {
 		(PyCFunction)STM_nonlinear_responses,
 		METH_VARARGS | METH_KEYWORDS,
 		STM_nonlinear_responses_doc},
+	{"sample", (PyCFunction)STM_sample, METH_VARARGS | METH_KEYWORDS, CD_sample_doc},
+	{"predict", (PyCFunction)STM_predict, METH_VARARGS | METH_KEYWORDS, CD_predict_doc},
+	{"loglikelihood", (PyCFunction)STM_loglikelihood, METH_VARARGS | METH_KEYWORDS, CD_loglikelihood_doc},
 	{"train", (PyCFunction)STM_train, METH_VARARGS | METH_KEYWORDS, STM_train_doc},
 	{"_parameters",
 		(PyCFunction)STM_parameters,
@@ -456,6 +486,10 @@ static PyMethodDef STM_methods[] = {
 		(PyCFunction)STM_parameter_gradient,
 		METH_VARARGS | METH_KEYWORDS,
 		Trainable_parameter_gradient_doc},
+	{"_per_example_gradients",
+		(PyCFunction)STM_per_example_gradients,
+		METH_VARARGS | METH_KEYWORDS,
+		Trainable_per_example_gradients_doc},
 	{"_fisher_information",
 		(PyCFunction)STM_fisher_information,
 		METH_VARARGS | METH_KEYWORDS, 
@@ -468,6 +502,10 @@ static PyMethodDef STM_methods[] = {
 		(PyCFunction)STM_check_gradient,
 		METH_VARARGS | METH_KEYWORDS,
 		Trainable_check_gradient_doc},
+	{"_check_directional_derivatives",
+		(PyCFunction)STM_check_directional_derivatives,
+		METH_VARARGS | METH_KEYWORDS,
+		Trainable_check_directional_derivatives_doc},
 	{"__reduce__", (PyCFunction)STM_reduce, METH_NOARGS, STM_reduce_doc},
 	{"__setstate__", (PyCFunction)STM_setstate, METH_VARARGS, STM_setstate_doc},
 	{0}
@@ -534,6 +572,7 @@ static PyGetSetDef Mixture_getset[] = {
 
 static PyMethodDef Mixture_methods[] = {
 	{"train", (PyCFunction)Mixture_train, METH_VARARGS | METH_KEYWORDS, Mixture_train_doc},
+	{"train_online", (PyCFunction)Mixture_train_online, METH_VARARGS | METH_KEYWORDS, Mixture_train_online_doc},
 	{"initialize", (PyCFunction)Mixture_initialize, METH_VARARGS | METH_KEYWORDS, Mixture_initialize_doc},
 	{"add_component", (PyCFunction)Mixture_add_component, METH_VARARGS | METH_KEYWORDS, 0},
 	{"__reduce__", (PyCFunction)Mixture_reduce, METH_NOARGS, 0},
@@ -955,10 +994,16 @@ static PyGetSetDef GLM_getset[] = {
 		(getter)GLM_distribution,
 		(setter)GLM_set_distribution,
 		"Distribution whose average value is determined by output of nonlinearity."},
+	{"telemetry",
+		(getter)Trainable_telemetry, 0,
+		const_cast<char*>(Trainable_telemetry_doc)},
 	{0}
 };
 
 static PyMethodDef GLM_methods[] = {
+	{"sample", (PyCFunction)GLM_sample, METH_VARARGS | METH_KEYWORDS, CD_sample_doc},
+	{"predict", (PyCFunction)GLM_predict, METH_VARARGS | METH_KEYWORDS, CD_predict_doc},
+	{"loglikelihood", (PyCFunction)GLM_loglikelihood, METH_VARARGS | METH_KEYWORDS, CD_loglikelihood_doc},
 	{"train", (PyCFunction)GLM_train, METH_VARARGS | METH_KEYWORDS, GLM_train_doc},
 	{"_parameters",
 		(PyCFunction)GLM_parameters,
@@ -972,6 +1017,10 @@ static PyMethodDef GLM_methods[] = {
 		(PyCFunction)GLM_parameter_gradient,
 		METH_VARARGS | METH_KEYWORDS, 
 		Trainable_parameter_gradient_doc},
+	{"_per_example_gradients",
+		(PyCFunction)GLM_per_example_gradients,
+		METH_VARARGS | METH_KEYWORDS,
+		Trainable_per_example_gradients_doc},
 	{"_fisher_information",
 		(PyCFunction)GLM_fisher_information,
 		METH_VARARGS | METH_KEYWORDS, 
@@ -980,6 +1029,10 @@ static PyMethodDef GLM_methods[] = {
 		(PyCFunction)GLM_check_gradient,
 		METH_VARARGS | METH_KEYWORDS,
 		Trainable_check_gradient_doc},
+	{"_check_directional_derivatives",
+		(PyCFunction)GLM_check_directional_derivatives,
+		METH_VARARGS | METH_KEYWORDS,
+		Trainable_check_directional_derivatives_doc},
 	{"_check_performance",
 		(PyCFunction)GLM_check_performance,
 		METH_VARARGS | METH_KEYWORDS,
@@ -1039,10 +1092,16 @@ static PyGetSetDef MLR_getset[] = {
 		(getter)MLR_biases,
 		(setter)MLR_set_biases,
 		"Bias terms, $b_i$."},
+	{"telemetry",
+		(getter)Trainable_telemetry, 0,
+		const_cast<char*>(Trainable_telemetry_doc)},
 	{0}
 };
 
 static PyMethodDef MLR_methods[] = {
+	{"sample", (PyCFunction)MLR_sample, METH_VARARGS | METH_KEYWORDS, CD_sample_doc},
+	{"predict", (PyCFunction)MLR_predict, METH_VARARGS | METH_KEYWORDS, CD_predict_doc},
+	{"loglikelihood", (PyCFunction)MLR_loglikelihood, METH_VARARGS | METH_KEYWORDS, CD_loglikelihood_doc},
 	{"train", (PyCFunction)MLR_train, METH_VARARGS | METH_KEYWORDS, MLR_train_doc},
 	{"_parameters",
 		(PyCFunction)MLR_parameters,
@@ -1055,10 +1114,18 @@ static PyMethodDef MLR_methods[] = {
 	{"_parameter_gradient",
 		(PyCFunction)MLR_parameter_gradient,
 		METH_VARARGS | METH_KEYWORDS, 0},
+	{"_per_example_gradients",
+		(PyCFunction)MLR_per_example_gradients,
+		METH_VARARGS | METH_KEYWORDS,
+		Trainable_per_example_gradients_doc},
 	{"_check_gradient",
 		(PyCFunction)MLR_check_gradient,
 		METH_VARARGS | METH_KEYWORDS,
 		Trainable_check_gradient_doc},
+	{"_check_directional_derivatives",
+		(PyCFunction)MLR_check_directional_derivatives,
+		METH_VARARGS | METH_KEYWORDS,
+		Trainable_check_directional_derivatives_doc},
 	{"_check_performance",
 		(PyCFunction)STM_check_performance,
 		METH_VARARGS | METH_KEYWORDS,
@@ -1756,6 +1823,9 @@ static PyMethodDef Preconditioner_methods[] = {
 	{"inverse", (PyCFunction)Preconditioner_inverse, METH_VARARGS | METH_KEYWORDS, Preconditioner_inverse_doc},
 	{"logjacobian", (PyCFunction)Preconditioner_logjacobian, METH_VARARGS | METH_KEYWORDS, Preconditioner_logjacobian_doc},
 	{"adjust_gradient", (PyCFunction)Preconditioner_adjust_gradient, METH_VARARGS | METH_KEYWORDS, Preconditioner_adjust_gradient_doc},
+	{"_transform", (PyCFunction)Preconditioner_transform, METH_VARARGS | METH_KEYWORDS, Preconditioner_transform_doc},
+	{"_inverse_transform", (PyCFunction)Preconditioner_inverse_transform, METH_VARARGS | METH_KEYWORDS, Preconditioner_inverse_transform_doc},
+	{"_sample", (PyCFunction)Preconditioner_sample, METH_VARARGS | METH_KEYWORDS, Preconditioner_sample_doc},
 	{0}
 };
 
@@ -1806,6 +1876,7 @@ static PyGetSetDef AffinePreconditioner_getset[] = {
 	{"pre_in", (getter)AffinePreconditioner_pre_in, 0, 0},
 	{"pre_out", (getter)AffinePreconditioner_pre_out, 0, 0},
 	{"predictor", (getter)AffinePreconditioner_predictor, 0, 0},
+	{"log_jacobian_constant", (getter)AffinePreconditioner_log_jacobian_constant, 0, 0},
 	{0}
 };
 
@@ -2137,6 +2208,159 @@ PyTypeObject BinningTransform_type = {
 	Preconditioner_new,                 /*tp_new*/
 };
 
+static PyGetSetDef StackedAffineTransform_getset[] = {
+	{"transforms", (getter)StackedAffineTransform_transforms, 0, "Copies of the stacked transforms."},
+	{0}
+};
+
+static PyMethodDef StackedAffineTransform_methods[] = {
+	{"__reduce__", (PyCFunction)StackedAffineTransform_reduce, METH_NOARGS, 0},
+	{0}
+};
+
+PyTypeObject StackedAffineTransform_type = {
+	PyVarObject_HEAD_INIT(0, 0)
+	"cmt.transforms.StackedAffineTransform", /*tp_name*/
+	sizeof(StackedAffineTransformObject),    /*tp_basicsize*/
+	0,                                       /*tp_itemsize*/
+	(destructor)Preconditioner_dealloc,      /*tp_dealloc*/
+	0,                                       /*tp_print*/
+	0,                                       /*tp_getattr*/
+	0,                                       /*tp_setattr*/
+	0,                                       /*tp_compare*/
+	0,                                       /*tp_repr*/
+	0,                                       /*tp_as_number*/
+	0,                                       /*tp_as_sequence*/
+	0,                                       /*tp_as_mapping*/
+	0,                                       /*tp_hash */
+	0,                                       /*tp_call*/
+	0,                                       /*tp_str*/
+	0,                                       /*tp_getattro*/
+	0,                                       /*tp_setattro*/
+	0,                                       /*tp_as_buffer*/
+	Py_TPFLAGS_DEFAULT,                      /*tp_flags*/
+	StackedAffineTransform_doc,              /*tp_doc*/
+	0,                                       /*tp_traverse*/
+	0,                                       /*tp_clear*/
+	0,                                       /*tp_richcompare*/
+	0,                                       /*tp_weaklistoffset*/
+	0,                                       /*tp_iter*/
+	0,                                       /*tp_iternext*/
+	StackedAffineTransform_methods,          /*tp_methods*/
+	0,                                       /*tp_members*/
+	StackedAffineTransform_getset,           /*tp_getset*/
+	&AffineTransform_type,                   /*tp_base*/
+	0,                                       /*tp_dict*/
+	0,                                       /*tp_descr_get*/
+	0,                                       /*tp_descr_set*/
+	0,                                       /*tp_dictoffset*/
+	(initproc)StackedAffineTransform_init,   /*tp_init*/
+	0,                                       /*tp_alloc*/
+	Preconditioner_new,                      /*tp_new*/
+};
+
+static PyGetSetDef WindowedTimeSeries_getset[] = {
+	{"shape", (getter)WindowedTimeSeries_shape, 0, "Shape of the matrix of windows."},
+	{0}
+};
+
+static PyMethodDef WindowedTimeSeries_methods[] = {
+	{"to_dense", (PyCFunction)WindowedTimeSeries_to_dense, METH_NOARGS, WindowedTimeSeries_to_dense_doc},
+	{0}
+};
+
+PyTypeObject WindowedTimeSeries_type = {
+	PyVarObject_HEAD_INIT(0, 0)
+	"cmt.tools.WindowedTimeSeries",         /*tp_name*/
+	sizeof(WindowedTimeSeriesObject),       /*tp_basicsize*/
+	0,                                      /*tp_itemsize*/
+	(destructor)WindowedTimeSeries_dealloc, /*tp_dealloc*/
+	0,                                      /*tp_print*/
+	0,                                      /*tp_getattr*/
+	0,                                      /*tp_setattr*/
+	0,                                      /*tp_compare*/
+	0,                                      /*tp_repr*/
+	0,                                      /*tp_as_number*/
+	0,                                      /*tp_as_sequence*/
+	0,                                      /*tp_as_mapping*/
+	0,                                      /*tp_hash */
+	0,                                      /*tp_call*/
+	0,                                      /*tp_str*/
+	0,                                      /*tp_getattro*/
+	0,                                      /*tp_setattro*/
+	0,                                      /*tp_as_buffer*/
+	Py_TPFLAGS_DEFAULT,                     /*tp_flags*/
+	WindowedTimeSeries_doc,                 /*tp_doc*/
+	0,                                      /*tp_traverse*/
+	0,                                      /*tp_clear*/
+	0,                                      /*tp_richcompare*/
+	0,                                      /*tp_weaklistoffset*/
+	0,                                      /*tp_iter*/
+	0,                                      /*tp_iternext*/
+	WindowedTimeSeries_methods,             /*tp_methods*/
+	0,                                      /*tp_members*/
+	WindowedTimeSeries_getset,              /*tp_getset*/
+	0,                                      /*tp_base*/
+	0,                                      /*tp_dict*/
+	0,                                      /*tp_descr_get*/
+	0,                                      /*tp_descr_set*/
+	0,                                      /*tp_dictoffset*/
+	(initproc)WindowedTimeSeries_init,      /*tp_init*/
+	0,                                      /*tp_alloc*/
+	WindowedTimeSeries_new,                 /*tp_new*/
+};
+
+static PyGetSetDef BinaryMatrix_getset[] = {
+	{"shape", (getter)BinaryMatrix_shape, 0, "Shape of the matrix."},
+	{0}
+};
+
+static PyMethodDef BinaryMatrix_methods[] = {
+	{"to_dense", (PyCFunction)BinaryMatrix_to_dense, METH_NOARGS, BinaryMatrix_to_dense_doc},
+	{0}
+};
+
+PyTypeObject BinaryMatrix_type = {
+	PyVarObject_HEAD_INIT(0, 0)
+	"cmt.tools.BinaryMatrix",               /*tp_name*/
+	sizeof(BinaryMatrixObject),             /*tp_basicsize*/
+	0,                                      /*tp_itemsize*/
+	(destructor)BinaryMatrix_dealloc,       /*tp_dealloc*/
+	0,                                      /*tp_print*/
+	0,                                      /*tp_getattr*/
+	0,                                      /*tp_setattr*/
+	0,                                      /*tp_compare*/
+	0,                                      /*tp_repr*/
+	0,                                      /*tp_as_number*/
+	0,                                      /*tp_as_sequence*/
+	0,                                      /*tp_as_mapping*/
+	0,                                      /*tp_hash */
+	0,                                      /*tp_call*/
+	0,                                      /*tp_str*/
+	0,                                      /*tp_getattro*/
+	0,                                      /*tp_setattro*/
+	0,                                      /*tp_as_buffer*/
+	Py_TPFLAGS_DEFAULT,                     /*tp_flags*/
+	BinaryMatrix_doc,                       /*tp_doc*/
+	0,                                      /*tp_traverse*/
+	0,                                      /*tp_clear*/
+	0,                                      /*tp_richcompare*/
+	0,                                      /*tp_weaklistoffset*/
+	0,                                      /*tp_iter*/
+	0,                                      /*tp_iternext*/
+	BinaryMatrix_methods,                   /*tp_methods*/
+	0,                                      /*tp_members*/
+	BinaryMatrix_getset,                    /*tp_getset*/
+	0,                                      /*tp_base*/
+	0,                                      /*tp_dict*/
+	0,                                      /*tp_descr_get*/
+	0,                                      /*tp_descr_set*/
+	0,                                      /*tp_dictoffset*/
+	(initproc)BinaryMatrix_init,            /*tp_init*/
+	0,                                      /*tp_alloc*/
+	BinaryMatrix_new,                       /*tp_new*/
+};
+
 static const char* cmt_doc =
 	"This module provides fast implementations of different probabilistic models.";
 
@@ -2146,7 +2370,7 @@ PyObject* seed(PyObject* self, PyObject* args, PyObject* kwds) {
 	if(!PyArg_ParseTuple(args, "i", &seed))
 		return 0;
 
-	srand(seed);
+	CMT::setSeed(seed);
 
 	Py_INCREF(Py_None);
 	return Py_None;
@@ -2156,6 +2380,7 @@ static PyMethodDef cmt_methods[] = {
 	{"seed", (PyCFunction)seed, METH_VARARGS, 0},
 	{"random_select", (PyCFunction)random_select, METH_VARARGS | METH_KEYWORDS, random_select_doc},
 	{"generate_data_from_image", (PyCFunction)generate_data_from_image, METH_VARARGS | METH_KEYWORDS, generate_data_from_image_doc},
+	{"generate_binary_data_from_image", (PyCFunction)generate_binary_data_from_image, METH_VARARGS | METH_KEYWORDS, generate_binary_data_from_image_doc},
 	{"generate_data_from_video", (PyCFunction)generate_data_from_video, METH_VARARGS | METH_KEYWORDS, generate_data_from_video_doc},
 	{"density_gradient", (PyCFunction)density_gradient, METH_VARARGS | METH_KEYWORDS, density_gradient_doc},
 	{"sample_image", (PyCFunction)sample_image, METH_VARARGS | METH_KEYWORDS, sample_image_doc},
@@ -2212,6 +2437,8 @@ PyMODINIT_FUNC init_cmt() {
 		return RETVAL;
 	if(PyType_Ready(&Bernoulli_type) < 0)
 		return RETVAL;
+	if(PyType_Ready(&BinaryMatrix_type) < 0)
+		return RETVAL;
 	if(PyType_Ready(&BinningTransform_type) < 0)
 		return RETVAL;
 	if(PyType_Ready(&Binomial_type) < 0)
@@ -2268,6 +2495,8 @@ PyMODINIT_FUNC init_cmt() {
 		return RETVAL;
 	if(PyType_Ready(&STM_type) < 0)
 		return RETVAL;
+	if(PyType_Ready(&StackedAffineTransform_type) < 0)
+		return RETVAL;
 	if(PyType_Ready(&TanhBlobNonlinearity_type) < 0)
 		return RETVAL;
 	if(PyType_Ready(&TrainableNonlinearity_type) < 0)
@@ -2278,6 +2507,8 @@ PyMODINIT_FUNC init_cmt() {
 		return RETVAL;
 	if(PyType_Ready(&WhiteningTransform_type) < 0)
 		return RETVAL;
+	if(PyType_Ready(&WindowedTimeSeries_type) < 0)
+		return RETVAL;
 
 	// initialize Eigen
 	Eigen::initParallel();
@@ -2286,6 +2517,7 @@ PyMODINIT_FUNC init_cmt() {
 	Py_INCREF(&AffinePreconditioner_type);
 	Py_INCREF(&AffineTransform_type);
 	Py_INCREF(&Bernoulli_type);
+	Py_INCREF(&BinaryMatrix_type);
 	Py_INCREF(&BinningTransform_type);
 	Py_INCREF(&Binomial_type);
 	Py_INCREF(&BlobNonlinearity_type);
@@ -2314,15 +2546,18 @@ PyMODINIT_FUNC init_cmt() {
 	Py_INCREF(&Poisson_type);
 	Py_INCREF(&Preconditioner_type);
 	Py_INCREF(&STM_type);
+	Py_INCREF(&StackedAffineTransform_type);
 	Py_INCREF(&TanhBlobNonlinearity_type);
 	Py_INCREF(&TrainableNonlinearity_type);
 	Py_INCREF(&UnivariateDistribution_type);
 	Py_INCREF(&WhiteningPreconditioner_type);
 	Py_INCREF(&WhiteningTransform_type);
+	Py_INCREF(&WindowedTimeSeries_type);
 
 	PyModule_AddObject(module, "AffinePreconditioner", reinterpret_cast<PyObject*>(&AffinePreconditioner_type));
 	PyModule_AddObject(module, "AffineTransform", reinterpret_cast<PyObject*>(&AffineTransform_type));
 	PyModule_AddObject(module, "Bernoulli", reinterpret_cast<PyObject*>(&Bernoulli_type));
+	PyModule_AddObject(module, "BinaryMatrix", reinterpret_cast<PyObject*>(&BinaryMatrix_type));
 	PyModule_AddObject(module, "BinningTransform", reinterpret_cast<PyObject*>(&BinningTransform_type));
 	PyModule_AddObject(module, "Binomial", reinterpret_cast<PyObject*>(&Binomial_type));
 	PyModule_AddObject(module, "BlobNonlinearity", reinterpret_cast<PyObject*>(&BlobNonlinearity_type));
@@ -2351,11 +2586,13 @@ PyMODINIT_FUNC init_cmt() {
 	PyModule_AddObject(module, "Poisson", reinterpret_cast<PyObject*>(&Poisson_type));
 	PyModule_AddObject(module, "Preconditioner", reinterpret_cast<PyObject*>(&Preconditioner_type));
 	PyModule_AddObject(module, "STM", reinterpret_cast<PyObject*>(&STM_type));
+	PyModule_AddObject(module, "StackedAffineTransform", reinterpret_cast<PyObject*>(&StackedAffineTransform_type));
 	PyModule_AddObject(module, "TanhBlobNonlinearity", reinterpret_cast<PyObject*>(&TanhBlobNonlinearity_type));
 	PyModule_AddObject(module, "TrainableNonlinearity", reinterpret_cast<PyObject*>(&TrainableNonlinearity_type));
 	PyModule_AddObject(module, "UnivariateDistribution", reinterpret_cast<PyObject*>(&UnivariateDistribution_type));
 	PyModule_AddObject(module, "WhiteningPreconditioner", reinterpret_cast<PyObject*>(&WhiteningPreconditioner_type));
 	PyModule_AddObject(module, "WhiteningTransform", reinterpret_cast<PyObject*>(&WhiteningTransform_type));
+	PyModule_AddObject(module, "WindowedTimeSeries", reinterpret_cast<PyObject*>(&WindowedTimeSeries_type));
 
 	#if PY_MAJOR_VERSION >= 3
 	return module;
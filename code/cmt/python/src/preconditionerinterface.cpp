@@ -1,4 +1,5 @@
 #include "preconditionerinterface.h"
+#include "conditionaldistributioninterface.h"
 
 #include <utility>
 using std::pair;
@@ -7,11 +8,15 @@ using std::make_pair;
 #include <new>
 using std::bad_alloc;
 
+#include <vector>
+using std::vector;
+
 #include "cmt/utils"
 using CMT::Exception;
 
 #if PY_MAJOR_VERSION >= 3
 	#define PyInt_FromLong PyLong_FromLong
+	#define PyInt_AsLong PyLong_AsLong
 #endif
 
 PyObject* Preconditioner_call(PreconditionerObject* self, PyObject* args, PyObject* kwds) {
@@ -273,6 +278,162 @@ PyObject* Preconditioner_adjust_gradient(PreconditionerObject* self, PyObject* a
 
 
 
+const char* Preconditioner_transform_doc =
+	"_transform(self, input, input_pre, output=None, output_pre=None)\n"
+	"\n"
+	"Preconditions data and writes the result into existing arrays instead of allocating new\n"
+	"ones. The arrays have to be stored in Fortran order and may be the same arrays as the\n"
+	"data, so that data is transformed in place. C{input_pre} and C{output_pre} may not overlap.\n"
+	"\n"
+	"@type  input: C{ndarray}\n"
+	"@param input: inputs stored in columns\n"
+	"\n"
+	"@type  input_pre: C{ndarray}\n"
+	"@param input_pre: array into which preconditioned inputs are written\n"
+	"\n"
+	"@type  output: C{ndarray}\n"
+	"@param output: outputs stored in columns\n"
+	"\n"
+	"@type  output_pre: C{ndarray}\n"
+	"@param output_pre: array into which preconditioned outputs are written";
+
+PyObject* Preconditioner_transform(PreconditionerObject* self, PyObject* args, PyObject* kwds) {
+	const char* kwlist[] = {"input", "input_pre", "output", "output_pre", 0};
+
+	PyObject* input;
+	PyObject* input_pre;
+	PyObject* output = 0;
+	PyObject* output_pre = 0;
+
+	if(!PyArg_ParseTupleAndKeywords(args, kwds, "OO|OO", const_cast<char**>(kwlist),
+		&input, &input_pre, &output, &output_pre))
+		return 0;
+
+	if(output == Py_None)
+		output = 0;
+	if(output_pre == Py_None)
+		output_pre = 0;
+
+	if(!output != !output_pre) {
+		PyErr_SetString(PyExc_TypeError, "Outputs and preconditioned outputs should be given together.");
+		return 0;
+	}
+
+	try {
+		// arrays are mapped instead of copied, so that results are written into them
+		Map<MatrixXd> inputMap = PyArray_ToMapXd(input, false);
+		Map<MatrixXd> inputPreMap = PyArray_ToMapXd(input_pre);
+
+		if(output) {
+			Map<MatrixXd> outputMap = PyArray_ToMapXd(output, false);
+			Map<MatrixXd> outputPreMap = PyArray_ToMapXd(output_pre);
+
+			self->preconditioner->transform(inputMap, outputMap, inputPreMap, outputPreMap);
+		} else {
+			self->preconditioner->transform(inputMap, inputPreMap);
+		}
+	} catch(Exception exception) {
+		PyErr_SetString(PyExc_RuntimeError, exception.message());
+		return 0;
+	}
+
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+
+
+const char* Preconditioner_inverse_transform_doc =
+	"_inverse_transform(self, input_pre, output_pre, output)\n"
+	"\n"
+	"Computes original outputs from preconditioned inputs and outputs and writes them into an\n"
+	"existing array, which has to be stored in Fortran order and may be one of the given arrays.\n"
+	"\n"
+	"@type  input_pre: C{ndarray}\n"
+	"@param input_pre: preconditioned inputs stored in columns\n"
+	"\n"
+	"@type  output_pre: C{ndarray}\n"
+	"@param output_pre: preconditioned outputs stored in columns\n"
+	"\n"
+	"@type  output: C{ndarray}\n"
+	"@param output: array into which outputs are written";
+
+PyObject* Preconditioner_inverse_transform(PreconditionerObject* self, PyObject* args, PyObject* kwds) {
+	const char* kwlist[] = {"input_pre", "output_pre", "output", 0};
+
+	PyObject* input_pre;
+	PyObject* output_pre;
+	PyObject* output;
+
+	if(!PyArg_ParseTupleAndKeywords(args, kwds, "OOO", const_cast<char**>(kwlist),
+		&input_pre, &output_pre, &output))
+		return 0;
+
+	try {
+		Map<MatrixXd> inputPreMap = PyArray_ToMapXd(input_pre, false);
+		Map<MatrixXd> outputPreMap = PyArray_ToMapXd(output_pre, false);
+		Map<MatrixXd> outputMap = PyArray_ToMapXd(output);
+
+		self->preconditioner->inverseTransform(inputPreMap, outputPreMap, outputMap);
+	} catch(Exception exception) {
+		PyErr_SetString(PyExc_RuntimeError, exception.message());
+		return 0;
+	}
+
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+
+
+const char* Preconditioner_sample_doc =
+	"_sample(self, model, input, output)\n"
+	"\n"
+	"Preconditions inputs, samples outputs from a model trained on preconditioned data and\n"
+	"transforms the samples back. Samples are written into an existing array, which has to be\n"
+	"stored in Fortran order and may be the array holding the inputs.\n"
+	"\n"
+	"@type  model: L{ConditionalDistribution<models.ConditionalDistribution>}\n"
+	"@param model: model of preconditioned data\n"
+	"\n"
+	"@type  input: C{ndarray}\n"
+	"@param input: inputs stored in columns\n"
+	"\n"
+	"@type  output: C{ndarray}\n"
+	"@param output: array into which sampled outputs are written";
+
+PyObject* Preconditioner_sample(PreconditionerObject* self, PyObject* args, PyObject* kwds) {
+	const char* kwlist[] = {"model", "input", "output", 0};
+
+	PyObject* model;
+	PyObject* input;
+	PyObject* output;
+
+	if(!PyArg_ParseTupleAndKeywords(args, kwds, "O!OO", const_cast<char**>(kwlist),
+		&CD_type, &model, &input, &output))
+		return 0;
+
+	try {
+		Map<MatrixXd> inputMap = PyArray_ToMapXd(input, false);
+		Map<MatrixXd> outputMap = PyArray_ToMapXd(output);
+		MatrixXd inputPre;
+
+		self->preconditioner->sample(
+			*reinterpret_cast<CDObject*>(model)->cd,
+			inputMap,
+			inputPre,
+			outputMap);
+	} catch(Exception exception) {
+		PyErr_SetString(PyExc_RuntimeError, exception.message());
+		return 0;
+	}
+
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+
+
 PyObject* Preconditioner_new(PyTypeObject* type, PyObject*, PyObject*) {
 	PyObject* self = type->tp_alloc(type, 0);
 
@@ -601,6 +762,12 @@ PyObject* AffinePreconditioner_predictor(AffinePreconditionerObject* self, void*
 
 
 
+PyObject* AffinePreconditioner_log_jacobian_constant(AffinePreconditionerObject* self, void*) {
+	return PyFloat_FromDouble(self->preconditioner->logJacobianConstant());
+}
+
+
+
 PyObject* AffinePreconditioner_reduce(AffinePreconditionerObject* self, PyObject*) {
 	PyObject* meanIn = PyArray_FromMatrixXd(self->preconditioner->meanIn());
 	PyObject* meanOut = PyArray_FromMatrixXd(self->preconditioner->meanOut());
@@ -672,11 +839,24 @@ PyObject* AffineTransform_reduce(AffineTransformObject* self, PyObject*) {
 const char* WhiteningPreconditioner_doc =
 	"Decorrelates inputs and outputs.\n"
 	"\n"
+	"Instead of inputs and outputs, an iterator over batches of data can be given.\n"
+	"Each batch contains inputs stacked on top of outputs, so that the preconditioner\n"
+	"can be computed without keeping all data in memory.\n"
+	"\n"
+	"\t>>> pre = WhiteningPreconditioner(input, output)\n"
+	"\t>>> pre = WhiteningPreconditioner(batches, dim_in=input.shape[0])\n"
+	"\n"
 	"@type  input: C{ndarray}\n"
 	"@param input: inputs stored in columns\n"
 	"\n"
 	"@type  output: C{ndarray}\n"
-	"@param output: outputs stored in columns";
+	"@param output: outputs stored in columns\n"
+	"\n"
+	"@type  data: C{iterable}\n"
+	"@param data: batches of inputs stacked on top of outputs\n"
+	"\n"
+	"@type  dim_in: C{int}\n"
+	"@param dim_in: number of rows of each batch corresponding to inputs";
 
 int WhiteningPreconditioner_init(WhiteningPreconditionerObject* self, PyObject* args, PyObject* kwds) {
 	PyObject* meanIn;
@@ -740,6 +920,42 @@ int WhiteningPreconditioner_init(WhiteningPreconditionerObject* self, PyObject*
 	} else {
 		PyErr_Clear();
 
+		const char* kwlistStream[] = {"data", "dim_in", 0};
+
+		PyObject* data;
+		int dimIn;
+
+		// test if preconditioner is computed from a stream of batches
+		if(PyArg_ParseTupleAndKeywords(args, kwds, "Oi", const_cast<char**>(kwlistStream), &data, &dimIn)
+			&& !PyArray_Check(data))
+		{
+			data = PyObject_GetIter(data);
+
+			if(!data) {
+				PyErr_SetString(PyExc_TypeError, "Data should be an iterable over batches of data.");
+				return -1;
+			}
+
+			try {
+				PyIteratorStream stream(data);
+				self->preconditioner = new WhiteningPreconditioner(stream, dimIn);
+			} catch(Exception& exception) {
+				Py_DECREF(data);
+				PyErr_SetString(PyExc_RuntimeError, exception.message());
+				return -1;
+			} catch(bad_alloc&) {
+				Py_DECREF(data);
+				PyErr_SetString(PyExc_RuntimeError, "Could not allocate memory.");
+				return -1;
+			}
+
+			Py_DECREF(data);
+
+			return 0;
+		}
+
+		PyErr_Clear();
+
 		const char* kwlist[] = {"input", "output", 0};
 
 		PyObject* input;
@@ -907,6 +1123,11 @@ const char* PCAPreconditioner_doc =
 	"\t>>> pca = PCAPreconditioner(input, output, num_pcs=10)\n"
 	"\n"
 	"If both arguments are specified, C{var_explained} will be ignored."
+	"Instead of inputs and outputs, an iterator over batches of data can be given,\n"
+	"as for L{WhiteningPreconditioner}.\n"
+	"\n"
+	"\t>>> pca = PCAPreconditioner(batches, dim_in=input.shape[0], num_pcs=10)\n"
+	"\n"
 	"Afterwards, apply the preconditioner to the data.\n"
 	"\n"
 	"\t>>> input, output = preconditioner(input, output)\n"
@@ -921,11 +1142,20 @@ const char* PCAPreconditioner_doc =
 	"@type  output: C{ndarray}\n"
 	"@param output: outputs stored in columns\n"
 	"\n"
+	"@type  data: C{iterable}\n"
+	"@param data: batches of inputs stacked on top of outputs\n"
+	"\n"
+	"@type  dim_in: C{int}\n"
+	"@param dim_in: number of rows of each batch corresponding to inputs\n"
+	"\n"
 	"@type  var_explained: C{double}\n"
 	"@param var_explained: the amount of variance retained after dimensionality reduction (in percent)\n"
 	"\n"
 	"@type  num_pcs: C{int}\n"
-	"@param num_pcs: the number of principal components of the input kept";
+	"@param num_pcs: the number of principal components of the input kept\n"
+	"\n"
+	"@type  tolerance: C{double}\n"
+	"@param tolerance: accuracy of principal components if only few are kept, set to zero to always compute all of them";
 
 int PCAPreconditioner_init(PCAPreconditionerObject* self, PyObject* args, PyObject* kwds) {
 	PyObject* eigenvalues;
@@ -998,15 +1228,52 @@ int PCAPreconditioner_init(PCAPreconditionerObject* self, PyObject* args, PyObje
 	} else {
 		PyErr_Clear();
 
-		const char* kwlist[] = {"input", "output", "var_explained", "num_pcs", 0};
+		const char* kwlistStream[] = {"data", "dim_in", "var_explained", "num_pcs", "tolerance", 0};
 
-		PyObject* input;
-		PyObject* output;
+		PyObject* data;
+		int dimIn;
 		double var_explained = 99.;
 		int num_pcs = -1;
+		double tolerance = 1e-8;
 
-		if(!PyArg_ParseTupleAndKeywords(args, kwds, "OO|di", const_cast<char**>(kwlist),
-			&input, &output, &var_explained, &num_pcs))
+		// test if preconditioner is computed from a stream of batches
+		if(PyArg_ParseTupleAndKeywords(args, kwds, "Oi|did", const_cast<char**>(kwlistStream),
+			&data, &dimIn, &var_explained, &num_pcs, &tolerance) && !PyArray_Check(data))
+		{
+			data = PyObject_GetIter(data);
+
+			if(!data) {
+				PyErr_SetString(PyExc_TypeError, "Data should be an iterable over batches of data.");
+				return -1;
+			}
+
+			try {
+				PyIteratorStream stream(data);
+				self->preconditioner = new PCAPreconditioner(stream, dimIn, var_explained, num_pcs, tolerance);
+			} catch(Exception& exception) {
+				Py_DECREF(data);
+				PyErr_SetString(PyExc_RuntimeError, exception.message());
+				return -1;
+			} catch(bad_alloc&) {
+				Py_DECREF(data);
+				PyErr_SetString(PyExc_RuntimeError, "Could not allocate memory.");
+				return -1;
+			}
+
+			Py_DECREF(data);
+
+			return 0;
+		}
+
+		PyErr_Clear();
+
+		const char* kwlist[] = {"input", "output", "var_explained", "num_pcs", "tolerance", 0};
+
+		PyObject* input;
+		PyObject* output;
+
+		if(!PyArg_ParseTupleAndKeywords(args, kwds, "OO|did", const_cast<char**>(kwlist),
+			&input, &output, &var_explained, &num_pcs, &tolerance))
 		{
 			return -1;
 		}
@@ -1026,7 +1293,8 @@ int PCAPreconditioner_init(PCAPreconditionerObject* self, PyObject* args, PyObje
 				PyArray_ToMatrixXd(input),
 				PyArray_ToMatrixXd(output),
 				var_explained,
-				num_pcs);
+				num_pcs,
+				tolerance);
 		} catch(Exception& exception) {
 			Py_DECREF(input);
 			Py_DECREF(output);
@@ -1058,6 +1326,12 @@ const char* PCATransform_doc =
 	"@type  output: C{ndarray}\n"
 	"@param output: outputs stored in columns\n"
 	"\n"
+	"@type  data: C{iterable}\n"
+	"@param data: batches of inputs stacked on top of outputs\n"
+	"\n"
+	"@type  dim_in: C{int}\n"
+	"@param dim_in: number of rows of each batch corresponding to inputs\n"
+	"\n"
 	"@type  dim_out: C{int}\n"
 	"@param dim_out: number of outputs (default: 1)\n"
 	"\n"
@@ -1065,7 +1339,10 @@ const char* PCATransform_doc =
 	"@param var_explained: the amount of variance retained after dimensionality reduction (in percent)\n"
 	"\n"
 	"@type  num_pcs: C{int}\n"
-	"@param num_pcs: the number of principal components of the input kept";
+	"@param num_pcs: the number of principal components of the input kept\n"
+	"\n"
+	"@type  tolerance: C{double}\n"
+	"@param tolerance: accuracy of principal components if only few are kept, set to zero to always compute all of them";
 
 int PCATransform_init(PCATransformObject* self, PyObject* args, PyObject* kwds) {
 	PyObject* eigenvalues;
@@ -1113,15 +1390,52 @@ int PCATransform_init(PCATransformObject* self, PyObject* args, PyObject* kwds)
 	} else {
 		PyErr_Clear();
 
-		const char* kwlist[] = {"input", "output", "var_explained", "num_pcs", "dim_out", 0};
+		const char* kwlistStream[] = {"data", "dim_in", "var_explained", "num_pcs", "tolerance", 0};
 
-		PyObject* input;
-		PyObject* output = 0;
+		PyObject* data;
+		int dimIn;
 		double var_explained = 99.;
 		int num_pcs = -1;
+		double tolerance = 1e-8;
 
-		if(!PyArg_ParseTupleAndKeywords(args, kwds, "O|Odii", const_cast<char**>(kwlist),
-			&input, &output, &var_explained, &num_pcs, &dimOut))
+		// test if transform is computed from a stream of batches
+		if(PyArg_ParseTupleAndKeywords(args, kwds, "Oi|did", const_cast<char**>(kwlistStream),
+			&data, &dimIn, &var_explained, &num_pcs, &tolerance) && !PyArray_Check(data))
+		{
+			data = PyObject_GetIter(data);
+
+			if(!data) {
+				PyErr_SetString(PyExc_TypeError, "Data should be an iterable over batches of data.");
+				return -1;
+			}
+
+			try {
+				PyIteratorStream stream(data);
+				self->preconditioner = new PCATransform(stream, dimIn, var_explained, num_pcs, tolerance);
+			} catch(Exception& exception) {
+				Py_DECREF(data);
+				PyErr_SetString(PyExc_RuntimeError, exception.message());
+				return -1;
+			} catch(bad_alloc&) {
+				Py_DECREF(data);
+				PyErr_SetString(PyExc_RuntimeError, "Could not allocate memory.");
+				return -1;
+			}
+
+			Py_DECREF(data);
+
+			return 0;
+		}
+
+		PyErr_Clear();
+
+		const char* kwlist[] = {"input", "output", "var_explained", "num_pcs", "dim_out", "tolerance", 0};
+
+		PyObject* input;
+		PyObject* output = 0;
+
+		if(!PyArg_ParseTupleAndKeywords(args, kwds, "O|Odiid", const_cast<char**>(kwlist),
+			&input, &output, &var_explained, &num_pcs, &dimOut, &tolerance))
 		{
 			return -1;
 		}
@@ -1148,13 +1462,15 @@ int PCATransform_init(PCATransformObject* self, PyObject* args, PyObject* kwds)
 					PyArray_ToMatrixXd(input),
 					PyArray_ToMatrixXd(output),
 					var_explained,
-					num_pcs);
+					num_pcs,
+					tolerance);
 			else
 				self->preconditioner = new PCATransform(
 					PyArray_ToMatrixXd(input),
 					var_explained,
 					num_pcs,
-					dimOut);
+					dimOut,
+					tolerance);
 		} catch(Exception& exception) {
 			Py_DECREF(input);
 			Py_XDECREF(output);
@@ -1309,3 +1625,133 @@ PyObject* BinningTransform_reduce(BinningTransformObject* self, PyObject*) {
 
 	return result;
 }
+
+
+
+const char* StackedAffineTransform_doc =
+	"Concatenates affine transforms.\n"
+	"\n"
+	"This is useful if the inputs consists of several parts that need to be\n"
+	"processed separately.\n"
+	"\n"
+	"Example:\n"
+	"\n"
+	"\t>>> transform = StackedAffineTransform(\n"
+	"\t>>>\tPCATransform(inputs[:N], num_pcs=10),\n"
+	"\t>>>\tBinningTransform(binning=5, dim_in=inputs.shape[0] - N))\n"
+	"\n"
+	"Using this transform, the first C{N} dimensions are preprocessed using PCA, while\n"
+	"the remaining dimensions are preprocessed by summing neighboring values.\n"
+	"\n"
+	"Each transform is applied to its part of the input separately, so that binning is\n"
+	"computed by summing values rather than by multiplying with a block-diagonal matrix.\n"
+	"\n"
+	"@type  transforms: L{AffineTransform}\n"
+	"@param transforms: any number of affine transforms\n"
+	"\n"
+	"@type  dim_out: C{int}\n"
+	"@param dim_out: dimensionality of the output (default: 1)";
+
+int StackedAffineTransform_init(StackedAffineTransformObject* self, PyObject* args, PyObject* kwds) {
+	PyObject* transforms;
+	int dimOut = 1;
+
+	// test if this call to __init__ is the result of unpickling
+	if(PyArg_ParseTuple(args, "O!i", &PyTuple_Type, &transforms, &dimOut)) {
+		if(kwds && PyDict_Size(kwds)) {
+			PyErr_SetString(PyExc_TypeError, "Unexpected keyword arguments.");
+			return -1;
+		}
+	} else {
+		PyErr_Clear();
+
+		// all positional arguments are transforms
+		transforms = args;
+
+		if(kwds) {
+			PyObject* value = PyDict_GetItemString(kwds, "dim_out");
+
+			if(PyDict_Size(kwds) > (value ? 1 : 0)) {
+				PyErr_SetString(PyExc_TypeError, "The only supported keyword argument is `dim_out`.");
+				return -1;
+			}
+
+			if(value) {
+				dimOut = PyInt_AsLong(value);
+				if(PyErr_Occurred())
+					return -1;
+			}
+		}
+	}
+
+	vector<const AffineTransform*> transformList;
+
+	for(Py_ssize_t i = 0; i < PyTuple_Size(transforms); ++i) {
+		PyObject* transform = PyTuple_GetItem(transforms, i);
+
+		if(!PyType_IsSubtype(Py_TYPE(transform), &AffineTransform_type)) {
+			PyErr_SetString(PyExc_TypeError, "Transforms should be of type `AffineTransform`.");
+			return -1;
+		}
+
+		transformList.push_back(reinterpret_cast<AffineTransformObject*>(transform)->preconditioner);
+	}
+
+	try {
+		self->preconditioner = new StackedAffineTransform(transformList, dimOut);
+	} catch(Exception exception) {
+		PyErr_SetString(PyExc_RuntimeError, exception.message());
+		return -1;
+	}
+
+	return 0;
+}
+
+
+
+PyObject* StackedAffineTransform_transforms(StackedAffineTransformObject* self, void*) {
+	const vector<AffineTransform*>& transforms = self->preconditioner->transforms();
+
+	PyObject* tuple = PyTuple_New(transforms.size());
+
+	for(int i = 0; i < transforms.size(); ++i) {
+		PyObject* transform;
+
+		// wrap copies of the transforms, keeping their type
+		if(BinningTransform* binningTransform = dynamic_cast<BinningTransform*>(transforms[i])) {
+			transform = Preconditioner_new(&BinningTransform_type, 0, 0);
+			reinterpret_cast<BinningTransformObject*>(transform)->preconditioner =
+				new BinningTransform(*binningTransform);
+		} else if(StackedAffineTransform* stackedTransform = dynamic_cast<StackedAffineTransform*>(transforms[i])) {
+			transform = Preconditioner_new(&StackedAffineTransform_type, 0, 0);
+			reinterpret_cast<StackedAffineTransformObject*>(transform)->preconditioner =
+				new StackedAffineTransform(*stackedTransform);
+		} else {
+			transform = Preconditioner_new(&AffineTransform_type, 0, 0);
+			reinterpret_cast<AffineTransformObject*>(transform)->preconditioner =
+				new AffineTransform(*transforms[i]);
+		}
+
+		PyTuple_SetItem(tuple, i, transform);
+	}
+
+	return tuple;
+}
+
+
+
+PyObject* StackedAffineTransform_reduce(StackedAffineTransformObject* self, PyObject*) {
+	PyObject* transforms = StackedAffineTransform_transforms(self, 0);
+
+	PyObject* args = Py_BuildValue("(Oi)",
+		transforms,
+		self->preconditioner->dimOut());
+	PyObject* state = Py_BuildValue("()");
+	PyObject* result = Py_BuildValue("(OOO)", Py_TYPE(self), args, state);
+
+	Py_DECREF(transforms);
+	Py_DECREF(args);
+	Py_DECREF(state);
+
+	return result;
+}
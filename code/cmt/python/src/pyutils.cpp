@@ -9,6 +9,9 @@ using Eigen::Map;
 using Eigen::ColMajor;
 using Eigen::RowMajor;
 
+#include "Eigen/SparseCore"
+using Eigen::MappedSparseMatrix;
+
 #include <utility>
 using std::make_pair;
 
@@ -138,6 +141,35 @@ MatrixXd PyArray_ToMatrixXd(PyObject* array) {
 
 
 
+/**
+ * Maps a two-dimensional Fortran-contiguous array onto a matrix without copying
+ * it, so that results can be written directly into the array and so that arrays
+ * sharing memory also share memory after conversion.
+ *
+ * @param writeable whether results will be written into the array
+ */
+Map<MatrixXd> PyArray_ToMapXd(PyObject* array, bool writeable) {
+	if(!PyArray_Check(array))
+		throw Exception("Data should be stored in NumPy arrays.");
+	if(PyArray_DESCR(array)->type != PyArray_DescrFromType(NPY_DOUBLE)->type)
+		throw Exception("Can only handle arrays of double values.");
+	if(PyArray_NDIM(array) != 2)
+		throw Exception("Arrays should be two-dimensional.");
+	if(!(PyArray_FLAGS(array) & NPY_F_CONTIGUOUS))
+		throw Exception("Arrays should be stored in Fortran order.");
+	if(!PyArray_ISALIGNED(array))
+		throw Exception("Arrays should be aligned in memory.");
+	if(writeable && !PyArray_ISWRITEABLE(array))
+		throw Exception("Arrays should be writeable.");
+
+	return Map<MatrixXd>(
+		reinterpret_cast<double*>(PyArray_DATA(array)),
+		PyArray_DIM(array, 0),
+		PyArray_DIM(array, 1));
+}
+
+
+
 // TODO: fix mess with 64 bit types
 MatrixXi PyArray_ToMatrixXi(PyObject* array) {
 	if(PyArray_DESCR(array)->type != PyArray_DescrFromType(NPY_INT64)->type)
@@ -322,6 +354,75 @@ PyObject* PyArray_FromArraysXXd(const vector<ArrayXXd>& channels) {
 
 
 
+bool PyObject_IsSparseMatrix(PyObject* object) {
+	// SciPy's sparse matrices are recognized by their interface
+	return !PyArray_Check(object) && PyObject_HasAttrString(object, "tocsc");
+}
+
+
+
+/**
+ * Converts a SciPy sparse matrix into an Eigen sparse matrix without storing
+ * zeros. Matrices which are not in CSC format are converted by SciPy first.
+ */
+SparseMatrixXd PyObject_ToSparseMatrixXd(PyObject* object) {
+	PyObject* matrix = PyObject_CallMethod(object, const_cast<char*>("tocsc"), 0);
+
+	if(!matrix) {
+		PyErr_Clear();
+		throw Exception("Sparse matrix could not be converted to CSC format.");
+	}
+
+	PyObject* shape = PyObject_GetAttrString(matrix, "shape");
+	PyObject* data = PyObject_GetAttrString(matrix, "data");
+	PyObject* indices = PyObject_GetAttrString(matrix, "indices");
+	PyObject* indptr = PyObject_GetAttrString(matrix, "indptr");
+
+	Py_DECREF(matrix);
+
+	PyObject* dataArr = data ? PyArray_FROM_OTF(data, NPY_DOUBLE, NPY_IN_ARRAY) : 0;
+	PyObject* indicesArr = indices ? PyArray_FROM_OTF(indices, NPY_INT, NPY_IN_ARRAY) : 0;
+	PyObject* indptrArr = indptr ? PyArray_FROM_OTF(indptr, NPY_INT, NPY_IN_ARRAY) : 0;
+
+	Py_XDECREF(data);
+	Py_XDECREF(indices);
+	Py_XDECREF(indptr);
+
+	bool valid = shape && PyTuple_Check(shape) && PyTuple_Size(shape) == 2
+		&& dataArr && indicesArr && indptrArr;
+
+	SparseMatrixXd result;
+
+	if(valid) {
+		int rows = PyInt_AsLong(PyTuple_GetItem(shape, 0));
+		int cols = PyInt_AsLong(PyTuple_GetItem(shape, 1));
+
+		int* outerIndex = reinterpret_cast<int*>(PyArray_DATA(indptrArr));
+		int* innerIndex = reinterpret_cast<int*>(PyArray_DATA(indicesArr));
+		double* values = reinterpret_cast<double*>(PyArray_DATA(dataArr));
+
+		valid = PyArray_SIZE(indptrArr) == cols + 1;
+
+		if(valid)
+			result = MappedSparseMatrix<double>(
+				rows, cols, outerIndex[cols], outerIndex, innerIndex, values);
+	}
+
+	Py_XDECREF(shape);
+	Py_XDECREF(dataArr);
+	Py_XDECREF(indicesArr);
+	Py_XDECREF(indptrArr);
+
+	if(!valid) {
+		PyErr_Clear();
+		throw Exception("Invalid sparse matrix.");
+	}
+
+	return result;
+}
+
+
+
 Tuples PyList_AsTuples(PyObject* list) {
 	if(!PyList_Check(list))
 		throw Exception("Indices should be given in a list.");
@@ -426,3 +527,38 @@ Regularizer PyObject_ToRegularizer(PyObject* regularizer) {
 
 	throw Exception("Regularizer should be of type `dict`, `float` or `ndarray`.");
 }
+
+
+
+PyIteratorStream::PyIteratorStream(PyObject* iterator) : mIterator(iterator) {
+	Py_INCREF(mIterator);
+}
+
+
+
+PyIteratorStream::~PyIteratorStream() {
+	Py_DECREF(mIterator);
+}
+
+
+
+bool PyIteratorStream::next(MatrixXd& batch) {
+	PyObject* item = PyIter_Next(mIterator);
+
+	if(!item) {
+		if(PyErr_Occurred())
+			throw Exception("Some error occured while reading data from iterator.");
+		return false;
+	}
+
+	PyObject* data = PyArray_FROM_OTF(item, NPY_DOUBLE, NPY_F_CONTIGUOUS | NPY_ALIGNED);
+	Py_DECREF(item);
+
+	if(!data)
+		throw Exception("Data should be stored in Numpy arrays.");
+
+	batch = PyArray_ToMatrixXd(data);
+	Py_DECREF(data);
+
+	return true;
+}
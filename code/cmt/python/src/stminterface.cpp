@@ -2,10 +2,15 @@
 #include "callbackinterface.h"
 #include "trainableinterface.h"
 #include "stminterface.h"
+#include "toolsinterface.h"
 
 #include "Eigen/Core"
 using Eigen::Map;
 
+#include <utility>
+using std::pair;
+using std::make_pair;
+
 #include "cmt/utils"
 using CMT::Exception;
 
@@ -604,6 +609,124 @@ PyObject* STM_nonlinear_responses(STMObject* self, PyObject* args, PyObject* kwd
 
 
 
+/**
+ * Splits sparse inputs into dense nonlinear inputs and sparse linear inputs.
+ */
+static pair<MatrixXd, SparseMatrixXd> STM_split_sparse(STMObject* self, PyObject* input) {
+	SparseMatrixXd inputSparse = PyObject_ToSparseMatrixXd(input);
+
+	if(inputSparse.rows() != self->stm->dimIn())
+		throw Exception("Input has wrong dimensionality.");
+
+	return make_pair(
+		MatrixXd(inputSparse.topRows(self->stm->dimInNonlinear())),
+		SparseMatrixXd(inputSparse.bottomRows(self->stm->dimInLinear())));
+}
+
+
+
+PyObject* STM_sample(STMObject* self, PyObject* args, PyObject* kwds) {
+	const char* kwlist[] = {"input", 0};
+
+	PyObject* input;
+
+	if(!PyArg_ParseTupleAndKeywords(args, kwds, "O", const_cast<char**>(kwlist), &input))
+		return 0;
+
+	if(!PyObject_IsSparseMatrix(input))
+		return CD_sample(reinterpret_cast<CDObject*>(self), args, kwds);
+
+	try {
+		pair<MatrixXd, SparseMatrixXd> inputs = STM_split_sparse(self, input);
+		return PyArray_FromMatrixXd(self->stm->sample(inputs.first, inputs.second));
+	} catch(Exception exception) {
+		PyErr_SetString(PyExc_RuntimeError, exception.message());
+		return 0;
+	}
+
+	return 0;
+}
+
+
+
+PyObject* STM_predict(STMObject* self, PyObject* args, PyObject* kwds) {
+	const char* kwlist[] = {"input", 0};
+
+	PyObject* input;
+
+	if(!PyArg_ParseTupleAndKeywords(args, kwds, "O", const_cast<char**>(kwlist), &input))
+		return 0;
+
+	if(!PyObject_IsSparseMatrix(input))
+		return CD_predict(reinterpret_cast<CDObject*>(self), args, kwds);
+
+	try {
+		pair<MatrixXd, SparseMatrixXd> inputs = STM_split_sparse(self, input);
+		return PyArray_FromMatrixXd(self->stm->predict(inputs.first, inputs.second));
+	} catch(Exception exception) {
+		PyErr_SetString(PyExc_RuntimeError, exception.message());
+		return 0;
+	}
+
+	return 0;
+}
+
+
+
+PyObject* STM_loglikelihood(STMObject* self, PyObject* args, PyObject* kwds) {
+	const char* kwlist[] = {"input", "output", 0};
+
+	PyObject* input;
+	PyObject* output;
+
+	if(!PyArg_ParseTupleAndKeywords(args, kwds, "OO", const_cast<char**>(kwlist), &input, &output))
+		return 0;
+
+	bool windowed = PyObject_TypeCheck(input, &WindowedTimeSeries_type);
+
+	if(!windowed && !PyObject_IsSparseMatrix(input))
+		return CD_loglikelihood(reinterpret_cast<CDObject*>(self), args, kwds);
+
+	output = PyArray_FROM_OTF(output, NPY_DOUBLE, NPY_F_CONTIGUOUS | NPY_ALIGNED);
+
+	if(!output) {
+		PyErr_SetString(PyExc_TypeError, "Outputs have to be stored in a NumPy array.");
+		return 0;
+	}
+
+	if(windowed) {
+		const WindowedTimeSeries& windows = *reinterpret_cast<WindowedTimeSeriesObject*>(input)->windows;
+
+		try {
+			// nonlinear inputs are extracted by the model
+			PyObject* result = PyArray_FromMatrixXd(self->stm->logLikelihood(
+				MatrixXd(0, windows.cols()), windows, PyArray_ToMatrixXd(output)));
+			Py_DECREF(output);
+			return result;
+		} catch(Exception exception) {
+			Py_DECREF(output);
+			PyErr_SetString(PyExc_RuntimeError, exception.message());
+			return 0;
+		}
+	}
+
+	try {
+		pair<MatrixXd, SparseMatrixXd> inputs = STM_split_sparse(self, input);
+		PyObject* result = PyArray_FromMatrixXd(
+			self->stm->logLikelihood(inputs.first, inputs.second, PyArray_ToMatrixXd(output)));
+		Py_DECREF(output);
+		return result;
+	} catch(Exception exception) {
+		Py_DECREF(output);
+		PyErr_SetString(PyExc_RuntimeError, exception.message());
+		return 0;
+	}
+
+	return 0;
+}
+
+
+
 const char* STM_train_doc =
 	"train(self, input, output, input_val=None, output_val=None, parameters=None)\n"
 	"\n"
@@ -621,6 +744,7 @@ const char* STM_train_doc =
 	"\t>>> \t'cb_iter': 25,\n"
 	"\t>>> \t'val_iter': 5,\n"
 	"\t>>> \t'val_look_ahead': 20,\n"
+	"\t>>> \t'val_async': False,\n"
 	"\t>>> \t'train_biases': True,\n"
 	"\t>>> \t'train_weights': True,\n"
 	"\t>>> \t'train_features': True,\n"
@@ -662,6 +786,10 @@ const char* STM_train_doc =
 	"The parameter C{batch_size} has no effect on the solution of the optimization but\n"
 	"can affect speed by reducing the number of cache misses.\n"
 	"\n"
+	"If C{val_async} is set and validation data is given, the validation error is evaluated on a\n"
+	"copy of the model in a separate thread while the optimization continues. Early stopping then\n"
+	"takes effect up to C{val_iter} iterations later.\n"
+	"\n"
 	"If a callback function is given, it will be called every C{cb_iter} iterations. The first\n"
 	"argument to callback will be the current iteration, the second argument will be a I{copy} of\n"
 	"the model.\n"
@@ -669,7 +797,15 @@ const char* STM_train_doc =
 	"\t>>> def callback(i, stm):\n"
 	"\t>>> \tprint i\n"
 	"\n"
-	"@type  input: C{ndarray}\n"
+	"Inputs may also be given as a SciPy sparse matrix. In this case, only the linear inputs\n"
+	"are kept in sparse format and the cost of computing linear responses scales with the number\n"
+	"of non-zero entries. Validation data is not supported for sparse inputs.\n"
+	"\n"
+	"Inputs may also be given as a L{WindowedTimeSeries<tools.WindowedTimeSeries>}, whose\n"
+	"first time series make up the nonlinear inputs. Only these are extracted, while linear\n"
+	"inputs such as spike histories are never stored as windows.\n"
+	"\n"
+	"@type  input: C{ndarray}/C{spmatrix}/C{WindowedTimeSeries}\n"
 	"@param input: inputs stored in columns\n"
 	"\n"
 	"@type  output: C{ndarray}\n"
@@ -727,6 +863,16 @@ PyObject* STM_parameter_gradient(STMObject* self, PyObject* args, PyObject* kwds
 
 
 
+PyObject* STM_per_example_gradients(STMObject* self, PyObject* args, PyObject* kwds) {
+	return Trainable_per_example_gradients(
+		reinterpret_cast<TrainableObject*>(self),
+		args,
+		kwds,
+		&PyObject_ToSTMParameters);
+}
+
+
+
 PyObject* STM_fisher_information(STMObject* self, PyObject* args, PyObject* kwds) {
 	return Trainable_fisher_information(
 		reinterpret_cast<TrainableObject*>(self), 
@@ -747,6 +893,16 @@ PyObject* STM_check_gradient(STMObject* self, PyObject* args, PyObject* kwds) {
 
 
 
+PyObject* STM_check_directional_derivatives(STMObject* self, PyObject* args, PyObject* kwds) {
+	return Trainable_check_directional_derivatives(
+		reinterpret_cast<TrainableObject*>(self),
+		args,
+		kwds,
+		&PyObject_ToSTMParameters);
+}
+
+
+
 PyObject* STM_check_performance(STMObject* self, PyObject* args, PyObject* kwds) {
 	return Trainable_check_performance(
 		reinterpret_cast<TrainableObject*>(self),
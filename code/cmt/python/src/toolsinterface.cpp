@@ -12,6 +12,7 @@ using CMT::ConditionalDistribution;
 
 #include "cmt/tools"
 using CMT::generateDataFromImage;
+using CMT::generateBinaryDataFromImage;
 using CMT::generateDataFromVideo;
 using CMT::sampleImage;
 using CMT::sampleVideo;
@@ -19,6 +20,7 @@ using CMT::fillInImage;
 using CMT::fillInImageMAP;
 using CMT::extractWindows;
 using CMT::sampleSpikeTrain;
+using CMT::sampleSpikeTrains;
 
 #include <utility>
 using std::pair;
@@ -200,6 +202,107 @@ PyObject* generate_data_from_image(PyObject* self, PyObject* args, PyObject* kwd
 
 
 
+const char* generate_binary_data_from_image_doc =
+	"generate_binary_data_from_image(img, input_mask, output_mask)\n"
+	"\n"
+	"Extracts all inputs and outputs from a binary image like L{generate_data_from_image},\n"
+	"but stores the inputs in a L{BinaryMatrix} without ever creating dense inputs.\n"
+	"\n"
+	"@type  img: C{ndarray}\n"
+	"@param img: an array representing a grayscale image containing only zeros and ones\n"
+	"\n"
+	"@type  input_mask: C{ndarray}\n"
+	"@param input_mask: a Boolean array describing the input pixels\n"
+	"\n"
+	"@type  output_mask: C{ndarray}\n"
+	"@param output_mask: a Boolean array describing the output pixels\n"
+	"\n"
+	"@rtype: C{tuple}\n"
+	"@return: the input and output vectors stored in columns";
+
+PyObject* generate_binary_data_from_image(PyObject* self, PyObject* args, PyObject* kwds) {
+	const char* kwlist[] = {"img", "input_mask", "output_mask", 0};
+
+	PyObject* img;
+	PyObject* input_mask;
+	PyObject* output_mask;
+
+	if(!PyArg_ParseTupleAndKeywords(args, kwds, "OOO", const_cast<char**>(kwlist),
+		&img, &input_mask, &output_mask))
+		return 0;
+
+	// make sure data is stored in NumPy array
+	img = PyArray_FROM_OTF(img, NPY_DOUBLE, NPY_F_CONTIGUOUS | NPY_ALIGNED);
+	input_mask = PyArray_FROM_OTF(input_mask, NPY_BOOL, NPY_F_CONTIGUOUS | NPY_ALIGNED);
+	output_mask = PyArray_FROM_OTF(output_mask, NPY_BOOL, NPY_F_CONTIGUOUS | NPY_ALIGNED);
+
+	if(!img) {
+		PyErr_SetString(PyExc_TypeError, "The image has to be given as an array.");
+		return 0;
+	}
+
+	if(!input_mask || !output_mask) {
+		Py_DECREF(img);
+		Py_XDECREF(input_mask);
+		Py_XDECREF(output_mask);
+		PyErr_SetString(PyExc_TypeError, "Masks have to be given as Boolean arrays.");
+		return 0;
+	}
+
+	PyObject* xvalues = 0;
+
+	try {
+		pair<BinaryMatrix, ArrayXXd> dataPair = generateBinaryDataFromImage(
+			PyArray_ToMatrixXd(img),
+			PyArray_ToMatrixXb(input_mask),
+			PyArray_ToMatrixXb(output_mask));
+
+		xvalues = BinaryMatrix_new(&BinaryMatrix_type, 0, 0);
+
+		if(!xvalues) {
+			Py_DECREF(img);
+			Py_DECREF(input_mask);
+			Py_DECREF(output_mask);
+			return 0;
+		}
+
+		reinterpret_cast<BinaryMatrixObject*>(xvalues)->matrix = new BinaryMatrix(dataPair.first);
+
+		PyObject* yvalues = PyArray_FromMatrixXd(dataPair.second);
+
+		PyObject* data = Py_BuildValue("(OO)",
+			xvalues,
+			yvalues);
+
+		Py_DECREF(img);
+		Py_DECREF(xvalues);
+		Py_DECREF(yvalues);
+		Py_DECREF(input_mask);
+		Py_DECREF(output_mask);
+
+		return data;
+
+	} catch(Exception& exception) {
+		Py_DECREF(img);
+		Py_XDECREF(xvalues);
+		Py_DECREF(input_mask);
+		Py_DECREF(output_mask);
+		PyErr_SetString(PyExc_RuntimeError, exception.message());
+		return 0;
+	} catch(bad_alloc&) {
+		Py_DECREF(img);
+		Py_XDECREF(xvalues);
+		Py_DECREF(input_mask);
+		Py_DECREF(output_mask);
+		PyErr_SetString(PyExc_RuntimeError, "Could not allocate memory.");
+		return 0;
+	}
+
+	return 0;
+}
+
+
+
 const char* generate_data_from_video_doc =
 	"generate_data_from_video(video, input_mask, output_mask, num_samples=0)\n"
 	"\n"
@@ -1281,7 +1384,7 @@ PyObject* extract_windows(PyObject* self, PyObject* args, PyObject* kwds) {
 
 
 const char* sample_spike_train_doc =
-	"sample_spike_train(stimuli, model, spike_history=0, preconditioner=None)\n"
+	"sample_spike_train(stimuli, model, spike_history=0, preconditioner=None, num_trials=1)\n"
 	"\n"
 	"Generate a spike train using a given model and a sequence of stimuli.\n"
 	"\n"
@@ -1295,6 +1398,13 @@ const char* sample_spike_train_doc =
 	"If C{preconditioner} is specified, the spike history is first transformed\n"
 	"before appending it to the stimulus.\n"
 	"\n"
+	"If C{num_trials} is larger than one, several spike trains are sampled for\n"
+	"the same stimuli. All trials are simulated together, which is much faster\n"
+	"than sampling them one by one. For affine preconditioners, the cost of a\n"
+	"time step scales with the number of spikes instead of the length of the\n"
+	"spike history. The spike trains are stacked, so that for a model with a\n"
+	"one-dimensional output each row corresponds to one trial.\n"
+	"\n"
 	"@type  stimuli: C{ndarray}\n"
 	"@param stimuli: each column represents a (possibly preprocessed) stimulus window\n"
 	"\n"
@@ -1307,23 +1417,28 @@ const char* sample_spike_train_doc =
 	"@type  preconditioner: L{Preconditioner<transforms.Preconditioner>}\n"
 	"@param preconditioner: transforms the spike history before appending it to the input\n"
 	"\n"
+	"@type  num_trials: C{int}\n"
+	"@param num_trials: number of spike trains sampled for the same stimuli\n"
+	"\n"
 	"@rtype: C{ndarray}\n"
 	"@return: sampled spike train";
 
 PyObject* sample_spike_train(PyObject* self, PyObject* args, PyObject* kwds) {
 	const char* kwlist[] = {
-		"stimulus", "model", "spike_history", "preconditioner", 0};
+		"stimulus", "model", "spike_history", "preconditioner", "num_trials", 0};
 
 	PyObject* stimulus;
 	PyObject* modelObj;
 	int spike_history = 0;
 	PyObject* preconditionerObj = 0;
+	int num_trials = 1;
 
-	if(!PyArg_ParseTupleAndKeywords(args, kwds, "OO!|iO!", const_cast<char**>(kwlist),
+	if(!PyArg_ParseTupleAndKeywords(args, kwds, "OO!|iO!i", const_cast<char**>(kwlist),
 		&stimulus,
 		&CD_type, &modelObj,
 		&spike_history,
-		&Preconditioner_type, &preconditionerObj))
+		&Preconditioner_type, &preconditionerObj,
+		&num_trials))
 		return 0;
 
 	if(preconditionerObj == Py_None)
@@ -1342,9 +1457,10 @@ PyObject* sample_spike_train(PyObject* self, PyObject* args, PyObject* kwds) {
 		reinterpret_cast<PreconditionerObject*>(preconditionerObj)->preconditioner : 0;
 
 	try {
-		ArrayXXd spikeTrain = sampleSpikeTrain(
+		ArrayXXd spikeTrain = sampleSpikeTrains(
 			PyArray_ToMatrixXd(stimulus),
 			model,
+			num_trials,
 			spike_history,
 			preconditioner);
 
@@ -1365,3 +1481,236 @@ PyObject* sample_spike_train(PyObject* self, PyObject* args, PyObject* kwds) {
 
 	return 0;
 }
+
+
+
+PyObject* WindowedTimeSeries_new(PyTypeObject* type, PyObject*, PyObject*) {
+	PyObject* self = type->tp_alloc(type, 0);
+
+	if(self)
+		reinterpret_cast<WindowedTimeSeriesObject*>(self)->windows = 0;
+
+	return self;
+}
+
+
+
+const char* WindowedTimeSeries_doc =
+	"Represents all windows of one or several time series without extracting them.\n"
+	"\n"
+	"Columns correspond to the columns returned by L{extract_windows}. Windows of multiple time\n"
+	"series are stacked and aligned at their end, so that the last column contains the last\n"
+	"window of each time series. Models such as L{GLM<models.GLM>} and L{STM<models.STM>}\n"
+	"accept windowed time series as inputs for training and evaluation. Responses are then\n"
+	"computed by filtering the time series and gradients by correlating them, so that memory\n"
+	"requirements scale with the length of the time series and not with the number of windows\n"
+	"times the window length.\n"
+	"\n"
+	"To predict spikes from the last 20 bins of a stimulus and the preceding 10 spikes, use\n"
+	"\n"
+	"\t>>> inputs = WindowedTimeSeries([stimulus, spike_train[:, :-1]], [20, 10])\n"
+	"\t>>> outputs = spike_train[:, -inputs.shape[1]:]\n"
+	"\t>>> glm.train(inputs, outputs)\n"
+	"\n"
+	"For an L{STM<models.STM>}, nonlinear inputs are extracted explicitly and have to be made up\n"
+	"by the first time series, while linear inputs are kept as windows.\n"
+	"\n"
+	"@type  time_series: C{ndarray}/C{list}\n"
+	"@param time_series: an NxT array or a list of arrays representing time series\n"
+	"\n"
+	"@type  window_length: C{int}/C{list}\n"
+	"@param window_length: number of bins of the windows of each time series";
+
+int WindowedTimeSeries_init(WindowedTimeSeriesObject* self, PyObject* args, PyObject* kwds) {
+	const char* kwlist[] = {"time_series", "window_length", 0};
+
+	PyObject* time_series;
+	PyObject* window_length;
+
+	if(!PyArg_ParseTupleAndKeywords(args, kwds, "OO", const_cast<char**>(kwlist),
+		&time_series, &window_length))
+		return -1;
+
+	bool isList = PyList_Check(time_series) || PyTuple_Check(time_series);
+	int numTimeSeries = isList ? PySequence_Size(time_series) : 1;
+
+	if(PySequence_Check(window_length) && PySequence_Size(window_length) != numTimeSeries) {
+		PyErr_SetString(PyExc_ValueError, "There should be one window length for each time series.");
+		return -1;
+	}
+
+	vector<MatrixXd> timeSeries;
+	vector<int> windowLengths;
+
+	for(int i = 0; i < numTimeSeries; ++i) {
+		PyObject* series = isList ? PySequence_GetItem(time_series, i) : time_series;
+		PyObject* length = PySequence_Check(window_length) ?
+			PySequence_GetItem(window_length, i) : window_length;
+
+		PyObject* array = PyArray_FROM_OTF(series, NPY_DOUBLE, NPY_F_CONTIGUOUS | NPY_ALIGNED);
+
+		if(isList)
+			Py_DECREF(series);
+
+		if(!array || PyArray_NDIM(array) > 2 || !PyInt_Check(length)) {
+			if(length != window_length)
+				Py_DECREF(length);
+			Py_XDECREF(array);
+			PyErr_SetString(PyExc_TypeError,
+				"Time series should be of type `ndarray` and window lengths of type `int`.");
+			return -1;
+		}
+
+		if(PyArray_NDIM(array) == 1)
+			// interpret one-dimensional arrays as one-dimensional time series
+			timeSeries.push_back(PyArray_ToMatrixXd(array).transpose());
+		else
+			timeSeries.push_back(PyArray_ToMatrixXd(array));
+		windowLengths.push_back(PyInt_AsLong(length));
+
+		if(length != window_length)
+			Py_DECREF(length);
+		Py_DECREF(array);
+	}
+
+	try {
+		delete self->windows;
+		self->windows = new WindowedTimeSeries(timeSeries, windowLengths);
+	} catch(Exception& exception) {
+		self->windows = 0;
+		PyErr_SetString(PyExc_RuntimeError, exception.message());
+		return -1;
+	}
+
+	return 0;
+}
+
+
+
+void WindowedTimeSeries_dealloc(WindowedTimeSeriesObject* self) {
+	// delete actual instance
+	delete self->windows;
+
+	// delete Python object
+	Py_TYPE(self)->tp_free(reinterpret_cast<PyObject*>(self));
+}
+
+
+
+PyObject* WindowedTimeSeries_shape(WindowedTimeSeriesObject* self, void*) {
+	return Py_BuildValue("(ii)", self->windows->rows(), self->windows->cols());
+}
+
+
+
+const char* WindowedTimeSeries_to_dense_doc =
+	"to_dense(self)\n"
+	"\n"
+	"Extracts all windows.\n"
+	"\n"
+	"@rtype: C{ndarray}\n"
+	"@return: windows stored in columns";
+
+PyObject* WindowedTimeSeries_to_dense(WindowedTimeSeriesObject* self) {
+	try {
+		return PyArray_FromMatrixXd(self->windows->toDense());
+	} catch(bad_alloc&) {
+		PyErr_SetString(PyExc_RuntimeError, "Could not allocate memory.");
+		return 0;
+	}
+
+	return 0;
+}
+
+
+
+PyObject* BinaryMatrix_new(PyTypeObject* type, PyObject*, PyObject*) {
+	PyObject* self = type->tp_alloc(type, 0);
+
+	if(self)
+		reinterpret_cast<BinaryMatrixObject*>(self)->matrix = 0;
+
+	return self;
+}
+
+
+
+const char* BinaryMatrix_doc =
+	"A matrix of zeros and ones whose columns are stored as bits.\n"
+	"\n"
+	"Binary matrices require 64 times less memory than arrays of doubles. Models such as\n"
+	"L{MCBM<models.MCBM>} accept binary matrices as inputs for training and evaluation and\n"
+	"compute products with them by adding up the columns of their parameters.\n"
+	"\n"
+	"\t>>> inputs, outputs = generate_binary_data_from_image(img, input_mask, output_mask)\n"
+	"\t>>> mcbm.train(inputs, outputs)\n"
+	"\n"
+	"@type  matrix: C{ndarray}\n"
+	"@param matrix: an array containing only zeros and ones";
+
+int BinaryMatrix_init(BinaryMatrixObject* self, PyObject* args, PyObject* kwds) {
+	const char* kwlist[] = {"matrix", 0};
+
+	PyObject* matrix;
+
+	if(!PyArg_ParseTupleAndKeywords(args, kwds, "O", const_cast<char**>(kwlist), &matrix))
+		return -1;
+
+	matrix = PyArray_FROM_OTF(matrix, NPY_DOUBLE, NPY_F_CONTIGUOUS | NPY_ALIGNED);
+
+	if(!matrix) {
+		PyErr_SetString(PyExc_TypeError, "Matrix should be of type `ndarray`.");
+		return -1;
+	}
+
+	try {
+		delete self->matrix;
+		self->matrix = new BinaryMatrix(PyArray_ToMatrixXd(matrix));
+	} catch(Exception& exception) {
+		self->matrix = 0;
+		Py_DECREF(matrix);
+		PyErr_SetString(PyExc_RuntimeError, exception.message());
+		return -1;
+	}
+
+	Py_DECREF(matrix);
+
+	return 0;
+}
+
+
+
+void BinaryMatrix_dealloc(BinaryMatrixObject* self) {
+	// delete actual instance
+	delete self->matrix;
+
+	// delete Python object
+	Py_TYPE(self)->tp_free(reinterpret_cast<PyObject*>(self));
+}
+
+
+
+PyObject* BinaryMatrix_shape(BinaryMatrixObject* self, void*) {
+	return Py_BuildValue("(ii)", self->matrix->rows(), self->matrix->cols());
+}
+
+
+
+const char* BinaryMatrix_to_dense_doc =
+	"to_dense(self)\n"
+	"\n"
+	"Converts the matrix into an array of doubles.\n"
+	"\n"
+	"@rtype: C{ndarray}\n"
+	"@return: zeros and ones stored in columns";
+
+PyObject* BinaryMatrix_to_dense(BinaryMatrixObject* self) {
+	try {
+		return PyArray_FromMatrixXd(self->matrix->toDense());
+	} catch(bad_alloc&) {
+		PyErr_SetString(PyExc_RuntimeError, "Could not allocate memory.");
+		return 0;
+	}
+
+	return 0;
+}
@@ -1,4 +1,5 @@
 #include "trainableinterface.h"
+#include "toolsinterface.h"
 
 #include "cmt/utils"
 using CMT::Exception;
@@ -12,6 +13,15 @@ using Eigen::Map;
 using std::cout;
 using std::endl;
 
+#include <utility>
+using std::pair;
+
+#include <vector>
+using std::vector;
+
+#include <string>
+using std::string;
+
 #if PY_MAJOR_VERSION >= 3
 	#define PyInt_FromLong PyLong_FromLong
 	#define PyInt_AsLong PyLong_AsLong
@@ -105,6 +115,15 @@ Trainable::Parameters* PyObject_ToParameters(
 			else
 				throw Exception("val_look_ahead should be of type `int`.");
 
+		PyObject* val_async = PyDict_GetItemString(parameters, "val_async");
+		if(val_async)
+			if(PyBool_Check(val_async))
+				params->valAsync = (val_async == Py_True);
+			else if(PyInt_Check(val_async))
+				params->valAsync = PyInt_AsLong(val_async);
+			else
+				throw Exception("val_async should be of type `bool`.");
+
 		PyObject* stationary = PyDict_GetItemString(parameters, "stationary");
 		if(stationary)
 			if(PyBool_Check(stationary))
@@ -196,6 +215,18 @@ PyObject* Trainable_train(
 		&parameters))
 		return 0;
 
+	if(input_val == Py_None)
+		input_val = 0;
+	if(output_val == Py_None)
+		output_val = 0;
+
+	if(PyObject_IsSparseMatrix(input))
+		return Trainable_train_sparse(self, input, output, input_val || output_val, parameters, PyObject_ToParameters);
+	if(PyObject_TypeCheck(input, &WindowedTimeSeries_type))
+		return Trainable_train_windows(self, input, output, input_val || output_val, parameters, PyObject_ToParameters);
+	if(PyObject_TypeCheck(input, &BinaryMatrix_type))
+		return Trainable_train_binary(self, input, output, input_val, output_val, parameters, PyObject_ToParameters);
+
 	// make sure data is stored in NumPy array
 	input = PyArray_FROM_OTF(input, NPY_DOUBLE, NPY_F_CONTIGUOUS | NPY_ALIGNED);
 	output = PyArray_FROM_OTF(output, NPY_DOUBLE, NPY_F_CONTIGUOUS | NPY_ALIGNED);
@@ -207,11 +238,6 @@ PyObject* Trainable_train(
 		return 0;
 	}
 
-	if(input_val == Py_None)
-		input_val = 0;
-	if(output_val == Py_None)
-		output_val = 0;
-
 	if((input_val && PyDict_Check(input_val)) || (output_val && PyDict_Check(output_val))) {
 		// for some reason PyArray_FROM_OTF segfaults when input_val is a dictionary
 		Py_DECREF(input);
@@ -281,6 +307,197 @@ PyObject* Trainable_train(
 
 
 
+/**
+ * Trains a model on inputs stored in a SciPy sparse matrix without converting
+ * them into a dense matrix.
+ */
+PyObject* Trainable_train_sparse(
+	TrainableObject* self,
+	PyObject* input,
+	PyObject* output,
+	bool validation,
+	PyObject* parameters,
+	Trainable::Parameters* (*PyObject_ToParameters)(PyObject*))
+{
+	if(validation) {
+		PyErr_SetString(PyExc_NotImplementedError, "Validation data is not supported for sparse inputs.");
+		return 0;
+	}
+
+	output = PyArray_FROM_OTF(output, NPY_DOUBLE, NPY_F_CONTIGUOUS | NPY_ALIGNED);
+
+	if(!output) {
+		PyErr_SetString(PyExc_TypeError, "Outputs have to be stored in a NumPy array.");
+		return 0;
+	}
+
+	try {
+		Trainable::Parameters* params = PyObject_ToParameters(parameters);
+
+		bool converged = self->distribution->train(
+			PyObject_ToSparseMatrixXd(input),
+			PyArray_ToMatrixXd(output),
+			*params);
+
+		delete params;
+
+		Py_DECREF(output);
+
+		if(converged) {
+			Py_INCREF(Py_True);
+			return Py_True;
+		} else {
+			Py_INCREF(Py_False);
+			return Py_False;
+		}
+	} catch(Exception exception) {
+		Py_DECREF(output);
+		PyErr_SetString(PyExc_RuntimeError, exception.message());
+		return 0;
+	}
+
+	return 0;
+}
+
+
+
+/**
+ * Trains a model on windows of time series without extracting them.
+ */
+PyObject* Trainable_train_windows(
+	TrainableObject* self,
+	PyObject* input,
+	PyObject* output,
+	bool validation,
+	PyObject* parameters,
+	Trainable::Parameters* (*PyObject_ToParameters)(PyObject*))
+{
+	if(validation) {
+		PyErr_SetString(PyExc_NotImplementedError, "Validation data is not supported for windowed time series.");
+		return 0;
+	}
+
+	output = PyArray_FROM_OTF(output, NPY_DOUBLE, NPY_F_CONTIGUOUS | NPY_ALIGNED);
+
+	if(!output) {
+		PyErr_SetString(PyExc_TypeError, "Outputs have to be stored in a NumPy array.");
+		return 0;
+	}
+
+	try {
+		Trainable::Parameters* params = PyObject_ToParameters(parameters);
+
+		bool converged = self->distribution->train(
+			*reinterpret_cast<WindowedTimeSeriesObject*>(input)->windows,
+			PyArray_ToMatrixXd(output),
+			*params);
+
+		delete params;
+
+		Py_DECREF(output);
+
+		if(converged) {
+			Py_INCREF(Py_True);
+			return Py_True;
+		} else {
+			Py_INCREF(Py_False);
+			return Py_False;
+		}
+	} catch(Exception exception) {
+		Py_DECREF(output);
+		PyErr_SetString(PyExc_RuntimeError, exception.message());
+		return 0;
+	}
+
+	return 0;
+}
+
+
+
+/**
+ * Trains a model on bit-packed binary inputs without unpacking them. Validation
+ * data is passed on as dense arrays.
+ */
+PyObject* Trainable_train_binary(
+	TrainableObject* self,
+	PyObject* input,
+	PyObject* output,
+	PyObject* input_val,
+	PyObject* output_val,
+	PyObject* parameters,
+	Trainable::Parameters* (*PyObject_ToParameters)(PyObject*))
+{
+	output = PyArray_FROM_OTF(output, NPY_DOUBLE, NPY_F_CONTIGUOUS | NPY_ALIGNED);
+
+	if(!output) {
+		PyErr_SetString(PyExc_TypeError, "Outputs have to be stored in a NumPy array.");
+		return 0;
+	}
+
+	if((input_val && PyDict_Check(input_val)) || (output_val && PyDict_Check(output_val))) {
+		Py_DECREF(output);
+		PyErr_SetString(PyExc_TypeError, "Validation data has to be stored in NumPy arrays.");
+		return 0;
+	}
+
+	if(input_val || output_val) {
+		input_val = PyArray_FROM_OTF(input_val, NPY_DOUBLE, NPY_F_CONTIGUOUS | NPY_ALIGNED);
+		output_val = PyArray_FROM_OTF(output_val, NPY_DOUBLE, NPY_F_CONTIGUOUS | NPY_ALIGNED);
+
+		if(!input_val || !output_val) {
+			Py_DECREF(output);
+			Py_XDECREF(input_val);
+			Py_XDECREF(output_val);
+			PyErr_SetString(PyExc_TypeError, "Validation data has to be stored in NumPy arrays.");
+			return 0;
+		}
+	}
+
+	try {
+		bool converged;
+
+		Trainable::Parameters* params = PyObject_ToParameters(parameters);
+
+		if(input_val && output_val) {
+			converged = self->distribution->train(
+				*reinterpret_cast<BinaryMatrixObject*>(input)->matrix,
+				PyArray_ToMatrixXd(output),
+				PyArray_ToMatrixXd(input_val),
+				PyArray_ToMatrixXd(output_val),
+				*params);
+		} else {
+			converged = self->distribution->train(
+				*reinterpret_cast<BinaryMatrixObject*>(input)->matrix,
+				PyArray_ToMatrixXd(output),
+				*params);
+		}
+
+		delete params;
+
+		Py_DECREF(output);
+		Py_XDECREF(input_val);
+		Py_XDECREF(output_val);
+
+		if(converged) {
+			Py_INCREF(Py_True);
+			return Py_True;
+		} else {
+			Py_INCREF(Py_False);
+			return Py_False;
+		}
+	} catch(Exception exception) {
+		Py_DECREF(output);
+		Py_XDECREF(input_val);
+		Py_XDECREF(output_val);
+		PyErr_SetString(PyExc_RuntimeError, exception.message());
+		return 0;
+	}
+
+	return 0;
+}
+
+
+
 const char* Trainable_parameters_doc =
 	"parameters(self, parameters=None)\n"
 	"\n"
@@ -388,6 +605,43 @@ PyObject* Trainable_set_parameters(
 
 
 
+const char* Trainable_telemetry_doc =
+	"Measurements taken during the last call to C{train()}.\n"
+	"\n"
+	"Contains the number of iterations and of evaluations of the objective, the\n"
+	"evaluations spent in the line search of each iteration, and cumulative\n"
+	"wall-clock times in seconds spent on the gradient, validation, callbacks and\n"
+	"copying parameters into the model. C{peak_memory_increase} is the increase\n"
+	"of the peak resident memory of the process during training. C{throughput}\n"
+	"and C{batch_throughput} are the number of data points and batches for which\n"
+	"the gradient was evaluated per second.";
+
+PyObject* Trainable_telemetry(TrainableObject* self, void*) {
+	const Trainable::Telemetry& telemetry = self->distribution->telemetry();
+
+	PyObject* lineSearch = PyList_New(telemetry.lineSearchEvaluations.size());
+
+	for(int i = 0; i < telemetry.lineSearchEvaluations.size(); ++i)
+		PyList_SetItem(lineSearch, i, PyInt_FromLong(telemetry.lineSearchEvaluations[i]));
+
+	return Py_BuildValue("{s:i,s:i,s:N,s:i,s:i,s:l,s:d,s:d,s:d,s:d,s:d,s:d,s:d}",
+		"iterations", telemetry.numIterations,
+		"evaluations", telemetry.numEvaluations,
+		"line_search_evaluations", lineSearch,
+		"num_data", telemetry.numData,
+		"batch_size", telemetry.batchSize,
+		"peak_memory_increase", telemetry.peakMemoryIncrease,
+		"total_time", telemetry.totalTime,
+		"gradient_time", telemetry.gradientTime,
+		"validation_time", telemetry.validationTime,
+		"callback_time", telemetry.callbackTime,
+		"set_parameters_time", telemetry.setParametersTime,
+		"throughput", telemetry.throughput(),
+		"batch_throughput", telemetry.batchThroughput());
+}
+
+
+
 const char* Trainable_check_gradient_doc =
 	"_check_gradient(self, input, output, epsilon=1e-5, parameters=None)\n"
 	"\n"
@@ -470,6 +724,105 @@ PyObject* Trainable_check_gradient(
 
 
 
+const char* Trainable_check_directional_derivatives_doc =
+	"_check_directional_derivatives(self, input, output, num_directions=5, epsilon=1e-5, parameters=None)\n"
+	"\n"
+	"Compare derivatives along random directions to numerical estimates.\n"
+	"\n"
+	"Each direction only changes one block of parameters, such as the weights or\n"
+	"the features of a model. Only C{2 * num_directions} evaluations of the\n"
+	"objective are needed per block, which makes this much faster than\n"
+	"L{_check_gradient} for models with many parameters. This method is used\n"
+	"for testing purposes.\n"
+	"\n"
+	"@type  input: C{ndarray}\n"
+	"@param input: inputs stored in columns\n"
+	"\n"
+	"@type  output: C{ndarray}\n"
+	"@param output: inputs stored in columns\n"
+	"\n"
+	"@type  num_directions: C{int}\n"
+	"@param num_directions: number of random directions per block of parameters\n"
+	"\n"
+	"@type  epsilon: C{float}\n"
+	"@param epsilon: a small change added to the current parameters\n"
+	"\n"
+	"@type  parameters: C{dict}\n"
+	"@param parameters: a dictionary containing hyperparameters\n"
+	"\n"
+	"@rtype: C{dict}\n"
+	"@return: difference between numerical and analytical derivatives for each block of parameters";
+
+PyObject* Trainable_check_directional_derivatives(
+	TrainableObject* self,
+	PyObject* args,
+	PyObject* kwds,
+	Trainable::Parameters* (*PyObject_ToParameters)(PyObject*))
+{
+	const char* kwlist[] = {"input", "output", "num_directions", "epsilon", "parameters", 0};
+
+	PyObject* input;
+	PyObject* output;
+	int numDirections = 5;
+	double epsilon = 1e-5;
+	PyObject* parameters = 0;
+
+	// read arguments
+	if(!PyArg_ParseTupleAndKeywords(args, kwds, "OO|idO", const_cast<char**>(kwlist),
+		&input,
+		&output,
+		&numDirections,
+		&epsilon,
+		&parameters))
+		return 0;
+
+	// make sure data is stored in NumPy array
+	input = PyArray_FROM_OTF(input, NPY_DOUBLE, NPY_F_CONTIGUOUS | NPY_ALIGNED);
+	output = PyArray_FROM_OTF(output, NPY_DOUBLE, NPY_F_CONTIGUOUS | NPY_ALIGNED);
+
+	if(!input || !output) {
+		Py_XDECREF(input);
+		Py_XDECREF(output);
+		PyErr_SetString(PyExc_TypeError, "Data has to be stored in NumPy arrays.");
+		return 0;
+	}
+
+	try {
+		Trainable::Parameters* params = PyObject_ToParameters(parameters);
+
+		vector<pair<string, double> > errors = self->distribution->checkDirectionalDerivatives(
+			PyArray_ToMatrixXd(input),
+			PyArray_ToMatrixXd(output),
+			numDirections,
+			epsilon,
+			*params);
+
+		delete params;
+
+		Py_DECREF(input);
+		Py_DECREF(output);
+
+		PyObject* errorsObj = PyDict_New();
+
+		for(int i = 0; i < errors.size(); ++i) {
+			PyObject* error = PyFloat_FromDouble(errors[i].second);
+			PyDict_SetItemString(errorsObj, errors[i].first.c_str(), error);
+			Py_DECREF(error);
+		}
+
+		return errorsObj;
+	} catch(Exception exception) {
+		Py_DECREF(input);
+		Py_DECREF(output);
+		PyErr_SetString(PyExc_RuntimeError, exception.message());
+		return 0;
+	}
+
+	return 0;
+}
+
+
+
 const char* Trainable_parameter_gradient_doc =
 	"_parameter_gradient(self, input, output, x=None, parameters=None)\n"
 	"\n"
@@ -479,7 +832,7 @@ const char* Trainable_parameter_gradient_doc =
 	"If C{x} is not specified, the gradient will be evaluated for the current\n"
 	"parameters of the model.\n"
 	"\n"
-	"@type  input: C{ndarray}\n"
+	"@type  input: C{ndarray}/L{BinaryMatrix}/L{WindowedTimeSeries}\n"
 	"@param input: inputs stored in columns\n"
 	"\n"
 	"@type  output: C{ndarray}\n"
@@ -496,6 +849,28 @@ const char* Trainable_parameter_gradient_doc =
 	"\n"
 	"@seealso: L{evaluate()}";
 
+/**
+ * Evaluates the gradient on dense inputs or, if given, on bit-packed inputs or
+ * windows of time series.
+ */
+static double parameterGradient(
+	const Trainable& distribution,
+	PyObject* input,
+	const BinaryMatrix* inputBinary,
+	const WindowedTimeSeries* inputWindows,
+	PyObject* output,
+	const lbfgsfloatval_t* x,
+	lbfgsfloatval_t* g,
+	const Trainable::Parameters& params)
+{
+	if(inputBinary)
+		return distribution.parameterGradient(*inputBinary, PyArray_ToMatrixXd(output), x, g, params);
+	if(inputWindows)
+		return distribution.parameterGradient(
+			MatrixXd(0, inputWindows->cols()), *inputWindows, PyArray_ToMatrixXd(output), x, g, params);
+	return distribution.parameterGradient(PyArray_ToMatrixXd(input), PyArray_ToMatrixXd(output), x, g, params);
+}
+
 PyObject* Trainable_parameter_gradient(
 	TrainableObject* self,
 	PyObject* args,
@@ -517,11 +892,24 @@ PyObject* Trainable_parameter_gradient(
 		&parameters))
 		return 0;
 
-	// make sure data is stored in NumPy array
-	input = PyArray_FROM_OTF(input, NPY_DOUBLE, NPY_F_CONTIGUOUS | NPY_ALIGNED);
+	// bit-packed inputs and windows are passed on without converting them
+	const BinaryMatrix* inputBinary = 0;
+	const WindowedTimeSeries* inputWindows = 0;
+
+	if(PyObject_TypeCheck(input, &BinaryMatrix_type)) {
+		inputBinary = reinterpret_cast<BinaryMatrixObject*>(input)->matrix;
+		input = 0;
+	} else if(PyObject_TypeCheck(input, &WindowedTimeSeries_type)) {
+		inputWindows = reinterpret_cast<WindowedTimeSeriesObject*>(input)->windows;
+		input = 0;
+	} else {
+		// make sure data is stored in NumPy array
+		input = PyArray_FROM_OTF(input, NPY_DOUBLE, NPY_F_CONTIGUOUS | NPY_ALIGNED);
+	}
+
 	output = PyArray_FROM_OTF(output, NPY_DOUBLE, NPY_F_CONTIGUOUS | NPY_ALIGNED);
 
-	if(!input || !output) {
+	if((!input && !inputBinary && !inputWindows) || !output) {
 		Py_XDECREF(input);
 		Py_XDECREF(output);
 		PyErr_SetString(PyExc_TypeError, "Data has to be stored in NumPy arrays.");
@@ -535,7 +923,10 @@ PyObject* Trainable_parameter_gradient(
 		x = PyArray_FROM_OTF(x, NPY_DOUBLE, NPY_F_CONTIGUOUS | NPY_ALIGNED);
 
 	// for performance reasons, only perform these checks in the interface
-	if(PyArray_DIM(input, 0) != self->distribution->dimIn()) {
+	int dimIn = inputBinary ? inputBinary->rows() : inputWindows ? inputWindows->rows() : PyArray_DIM(input, 0);
+	int numData = inputBinary ? inputBinary->cols() : inputWindows ? inputWindows->cols() : PyArray_DIM(input, 1);
+
+	if(dimIn != self->distribution->dimIn()) {
 		PyErr_SetString(PyExc_RuntimeError, "Input has wrong dimensionality.");
 		return 0;
 	}
@@ -545,7 +936,7 @@ PyObject* Trainable_parameter_gradient(
 		return 0;
 	}
 
-	if(PyArray_DIM(output, 1) != PyArray_DIM(input, 1)) {
+	if(PyArray_DIM(output, 1) != numData) {
 		PyErr_SetString(PyExc_RuntimeError, "Number of inputs and outputs should be the same.");
 		return 0;
 	}
@@ -557,9 +948,12 @@ PyObject* Trainable_parameter_gradient(
 
 		if(x) {
 			#if LBFGS_FLOAT == 64
-			self->distribution->parameterGradient(
-				PyArray_ToMatrixXd(input),
-				PyArray_ToMatrixXd(output),
+			parameterGradient(
+				*self->distribution,
+				input,
+				inputBinary,
+				inputWindows,
+				output,
 				reinterpret_cast<lbfgsfloatval_t*>(PyArray_DATA(x)),
 				gradient.data(),
 				*params);
@@ -571,9 +965,12 @@ PyObject* Trainable_parameter_gradient(
 			for(int i = 0; i < PyArray_SIZE(x); ++i)
 				xLBFGS[i] = static_cast<lbfgsfloatval_t>(xData[i]);
 
-			self->distribution->parameterGradient(
-				PyArray_ToMatrixXd(input),
-				PyArray_ToMatrixXd(output),
+			parameterGradient(
+				*self->distribution,
+				input,
+				inputBinary,
+				inputWindows,
+				output,
 				xLBFGS,
 				gLBFGS,
 				*params);
@@ -589,9 +986,12 @@ PyObject* Trainable_parameter_gradient(
 		} else {
 			lbfgsfloatval_t* x = self->distribution->parameters(*params);
 
-			self->distribution->parameterGradient(
-				PyArray_ToMatrixXd(input),
-				PyArray_ToMatrixXd(output),
+			parameterGradient(
+				*self->distribution,
+				input,
+				inputBinary,
+				inputWindows,
+				output,
 				x,
 				gradient.data(),
 				*params);
@@ -601,13 +1001,13 @@ PyObject* Trainable_parameter_gradient(
 
 		delete params;
 
-		Py_DECREF(input);
+		Py_XDECREF(input);
 		Py_DECREF(output);
 		Py_XDECREF(x);
 
 		return PyArray_FromMatrixXd(gradient);
 	} catch(Exception exception) {
-		Py_DECREF(input);
+		Py_XDECREF(input);
 		Py_DECREF(output);
 		Py_XDECREF(x);
 		PyErr_SetString(PyExc_RuntimeError, exception.message());
@@ -617,8 +1017,78 @@ PyObject* Trainable_parameter_gradient(
 
 
 
+const char* Trainable_per_example_gradients_doc =
+	"_per_example_gradients(self, input, output, parameters=None)\n"
+	"\n"
+	"Computes the gradient returned by L{_parameter_gradient()} for each data point\n"
+	"separately, using the current parameters of the model.\n"
+	"\n"
+	"@type  input: C{ndarray}\n"
+	"@param input: inputs stored in columns\n"
+	"\n"
+	"@type  output: C{ndarray}\n"
+	"@param output: outputs stored in columns\n"
+	"\n"
+	"@type  parameters: C{dict}\n"
+	"@param parameters: a dictionary containing hyperparameters\n"
+	"\n"
+	"@rtype: C{ndarray}\n"
+	"@return: one gradient per column";
+
+PyObject* Trainable_per_example_gradients(
+	TrainableObject* self,
+	PyObject* args,
+	PyObject* kwds,
+	Trainable::Parameters* (*PyObject_ToParameters)(PyObject*))
+{
+	const char* kwlist[] = {"input", "output", "parameters", 0};
+
+	PyObject* input;
+	PyObject* output;
+	PyObject* parameters = 0;
+
+	// read arguments
+	if(!PyArg_ParseTupleAndKeywords(args, kwds, "OO|O", const_cast<char**>(kwlist),
+		&input, &output, &parameters))
+		return 0;
+
+	// make sure data is stored in NumPy array
+	input = PyArray_FROM_OTF(input, NPY_DOUBLE, NPY_F_CONTIGUOUS | NPY_ALIGNED);
+	output = PyArray_FROM_OTF(output, NPY_DOUBLE, NPY_F_CONTIGUOUS | NPY_ALIGNED);
+
+	if(!input || !output) {
+		Py_XDECREF(input);
+		Py_XDECREF(output);
+		PyErr_SetString(PyExc_TypeError, "Data has to be stored in NumPy arrays.");
+		return 0;
+	}
+
+	try {
+		Trainable::Parameters* params = PyObject_ToParameters(parameters);
+
+		MatrixXd gradients = self->distribution->perExampleGradients(
+			PyArray_ToMatrixXd(input),
+			PyArray_ToMatrixXd(output),
+			*params);
+
+		delete params;
+
+		Py_DECREF(input);
+		Py_DECREF(output);
+
+		return PyArray_FromMatrixXd(gradients);
+	} catch(Exception exception) {
+		Py_DECREF(input);
+		Py_DECREF(output);
+		PyErr_SetString(PyExc_RuntimeError, exception.message());
+		return 0;
+	}
+}
+
+
+
 const char* Trainable_fisher_information_doc =
-	"_parameter_gradient(self, input, output, x=None, parameters=None)\n"
+	"_fisher_information(self, input, output, parameters=None)\n"
 	"\n"
 	"Estimates the Fisher information matrix of the parameters as returned by L{_parameters()}.\n"
 	"\n"
@@ -0,0 +1,84 @@
+"""
+Measures how much memory is allocated while computing parameter gradients,
+relative to the size of the inputs. Each model is measured in a separate
+process using the increase in peak resident memory.
+
+All data is processed in a single batch, so that every copy of a batch shows up
+as a copy of all inputs. Converting the inputs accounts for one copy and
+matrix-matrix products may pack up to one more copy of the inputs (GLM only
+uses matrix-vector products). Anything beyond that should be small compared to
+the inputs.
+"""
+
+import sys
+import socket
+
+from argparse import ArgumentParser
+from resource import getrusage, RUSAGE_SELF
+from subprocess import check_output
+from datetime import datetime
+from numpy import asarray
+from numpy.random import randn, randint
+from cmt.models import MCGSM, STM, MCBM, GLM, Bernoulli
+from cmt.nonlinear import LogisticFunction
+
+parser = ArgumentParser(sys.argv[0], description=__doc__)
+parser.add_argument('--num_data',    '-d', type=int, default=200000)
+parser.add_argument('--dim_in',      '-i', type=int, default=100)
+parser.add_argument('--tolerance',   '-x', type=float, default=.5)
+parser.add_argument('--model',       '-m', type=str, default='')
+
+args = parser.parse_args(sys.argv[1:])
+
+def models():
+	return {
+		'MCGSM': MCGSM(args.dim_in, 1, 2, 2, 4),
+		'STM': STM(args.dim_in - args.dim_in // 2, args.dim_in // 2, 2, 4),
+		'MCBM': MCBM(args.dim_in, 2, 4),
+		'GLM': GLM(args.dim_in, LogisticFunction, Bernoulli)}
+
+# copies of the inputs which are expected
+copies = {'MCGSM': 2, 'STM': 2, 'MCBM': 2, 'GLM': 1}
+
+if args.model:
+	model = models()[args.model]
+
+	# transposing C-contiguous arrays yields Fortran-contiguous arrays without a copy
+	input = randn(args.num_data, args.dim_in).T
+	output = asarray(randint(2, size=[args.num_data, model.dim_out]), dtype=float).T
+
+	# use a single batch, so that a copy of a batch is a copy of all inputs
+	parameters = {'batch_size': args.num_data}
+
+	# warm up with few data points
+	model._parameter_gradient(input[:, :100], output[:, :100], parameters=parameters)
+
+	before = getrusage(RUSAGE_SELF).ru_maxrss
+	model._parameter_gradient(input, output, parameters=parameters)
+	after = getrusage(RUSAGE_SELF).ru_maxrss
+
+	# ru_maxrss is measured in kilobytes
+	print('{0:.4f}'.format((after - before) * 1024. / input.nbytes))
+	sys.exit(0)
+
+###
+print(socket.gethostname())
+print(datetime.now())
+print(args)
+print('')
+
+failed = False
+
+for name in sorted(models()):
+	cmd = [sys.executable, sys.argv[0], '--model', name,
+		'--num_data', str(args.num_data),
+		'--dim_in', str(args.dim_in)]
+
+	ratio = float(check_output(cmd))
+
+	print('{0:6}{1:8.2f} bytes allocated per byte of input'.format(name, ratio))
+
+	if ratio > copies[name] + args.tolerance:
+		failed = True
+
+sys.exit(1 if failed else 0)
@@ -7,8 +7,10 @@ from numpy import *
 from numpy import max
 from numpy.linalg import inv
 from numpy.random import randn, rand
-from cmt.models import Bernoulli, GLM
-from cmt.nonlinear import LogisticFunction, BlobNonlinearity
+from scipy.sparse import csc_matrix, csr_matrix
+from cmt.models import Bernoulli, Poisson, GLM
+from cmt.nonlinear import LogisticFunction, ExponentialFunction, BlobNonlinearity
+from cmt.tools import WindowedTimeSeries, generate_data_from_spike_train
 
 class Tests(unittest.TestCase):
 	def test_glm_basics(self):
@@ -97,6 +99,231 @@ class Tests(unittest.TestCase):
 
 
 
+	def test_glm_sparse(self):
+		x = (rand(50, 2000) > .95) * 1.
+		y = rand(1, 2000) < .5
+
+		glm = GLM(50, LogisticFunction, Bernoulli)
+		glm_sparse = GLM(50, LogisticFunction, Bernoulli)
+		glm_sparse.weights = glm.weights
+		glm_sparse.bias = glm.bias
+
+		# sparse inputs should give the same results as dense inputs
+		glm.train(x, y, parameters={'max_iter': 20})
+		glm_sparse.train(csc_matrix(x), y, parameters={'max_iter': 20})
+
+		self.assertLess(max(abs(glm.weights - glm_sparse.weights)), 1e-8)
+		self.assertLess(abs(glm.bias - glm_sparse.bias), 1e-8)
+
+		self.assertLess(max(abs(
+			glm.loglikelihood(x, y) - glm.loglikelihood(csc_matrix(x), y))), 1e-10)
+		self.assertLess(max(abs(
+			glm.predict(x) - glm.predict(csr_matrix(x)))), 1e-10)
+		self.assertEqual(glm.sample(csc_matrix(x)).shape, (1, 2000))
+
+		self.assertRaises(RuntimeError, glm.loglikelihood, csc_matrix(x[:-1]), y)
+		self.assertRaises(RuntimeError, glm.loglikelihood, csc_matrix(x), y[:, :-1])
+
+
+
+	def test_glm_newton(self):
+		x = randn(5, 5000)
+
+		for nonlinearity, distribution in [
+			(LogisticFunction, Bernoulli),
+			(ExponentialFunction, Poisson)]:
+
+			glm = GLM(5, nonlinearity, distribution)
+			glm.weights = randn(5, 1) / 2.
+			glm.bias = -.5
+			y = glm.sample(x)
+
+			glm_newton = GLM(5, nonlinearity, distribution)
+			glm_lbfgs = GLM(5, nonlinearity, distribution)
+
+			parameters = {
+				'threshold': 1e-12,
+				'regularize_weights': {'strength': 1e-3, 'norm': b'L2'}}
+
+			glm_lbfgs.train(x, y, parameters=parameters)
+
+			def callback(i, glm):
+				callback.counter += 1
+			callback.counter = 0
+
+			parameters['newton'] = True
+			parameters['callback'] = callback
+			parameters['cb_iter'] = 1
+
+			# Newton's method should converge to the same solution in few iterations
+			glm_newton.train(x, y, parameters=parameters)
+
+			self.assertLess(callback.counter, 20)
+			self.assertLess(max(abs(glm_newton.weights - glm_lbfgs.weights)), 1e-3)
+			self.assertLess(abs(glm_newton.bias - glm_lbfgs.bias), 1e-3)
+
+
+
+	def test_glm_windowed(self):
+		stimulus = randn(2, 3000)
+		spike_train = asarray(rand(1, 3000) < .2, dtype=float)
+
+		x = vstack(generate_data_from_spike_train(stimulus, 10, spike_train, 5)[:2])
+		y = spike_train[:, -x.shape[1]:]
+
+		# windows should not need to be extracted
+		windows = WindowedTimeSeries([stimulus, spike_train[:, :-1]], [10, 5])
+
+		self.assertEqual(windows.shape, x.shape)
+		self.assertLess(max(abs(windows.to_dense() - x)), 1e-16)
+
+		glm = GLM(25, LogisticFunction, Bernoulli)
+		glm_windowed = GLM(25, LogisticFunction, Bernoulli)
+		glm_windowed.weights = glm.weights
+		glm_windowed.bias = glm.bias
+
+		glm.train(x, y, parameters={'max_iter': 20, 'batch_size': 500})
+		glm_windowed.train(windows, y, parameters={'max_iter': 20, 'batch_size': 500})
+
+		self.assertLess(max(abs(glm.weights - glm_windowed.weights)), 1e-8)
+		self.assertLess(abs(glm.bias - glm_windowed.bias), 1e-8)
+
+		self.assertLess(max(abs(
+			glm.loglikelihood(x, y) - glm.loglikelihood(windows, y))), 1e-10)
+
+
+
+	def test_glm_validation(self):
+		# few data points, so that the validation error starts increasing
+		x = randn(50, 100)
+		y = asarray(rand(1, 100) < 1. / (1. + exp(-randn(1, 50).dot(x))), dtype=float)
+		x_val = randn(50, 1000)
+		y_val = asarray(rand(1, 1000) < .5, dtype=float)
+
+		glm = GLM(50, LogisticFunction, Bernoulli)
+		glm_async = GLM(50, LogisticFunction, Bernoulli)
+		glm_async.weights = glm.weights
+		glm_async.bias = glm.bias
+
+		parameters = {'max_iter': 50, 'val_iter': 2, 'val_look_ahead': 0}
+
+		glm.train(x, y, x_val, y_val, parameters=parameters)
+
+		# evaluating the validation error in the background should pick the same parameters
+		parameters['val_async'] = True
+		glm_async.train(x, y, x_val, y_val, parameters=parameters)
+
+		self.assertLess(max(abs(glm.weights - glm_async.weights)), 1e-10)
+		self.assertLess(abs(glm.bias - glm_async.bias), 1e-10)
+
+		iterations = []
+
+		def callback(i, glm):
+			iterations.append(i)
+
+		# early stopping should still take effect
+		glm_async = GLM(50, LogisticFunction, Bernoulli)
+		glm_async.train(x, y, x_val, y_val, parameters={
+			'max_iter': 200,
+			'val_iter': 1,
+			'val_look_ahead': 2,
+			'val_async': True,
+			'callback': callback,
+			'cb_iter': 1})
+
+		self.assertLess(len(iterations), 200)
+
+
+
+	def test_glm_telemetry(self):
+		glm = GLM(4, LogisticFunction, Bernoulli)
+
+		inputs = randn(glm.dim_in, 1000)
+		outputs = glm.sample(inputs)
+
+		callbacks = []
+
+		def callback(i, glm):
+			callbacks.append(i)
+			return True
+
+		glm.train(inputs, outputs, inputs[:, :100], outputs[:, :100], parameters={
+			'max_iter': 10,
+			'threshold': 0.,
+			'batch_size': 300,
+			'val_iter': 2,
+			'val_look_ahead': 0,
+			'callback': callback,
+			'cb_iter': 1})
+
+		telemetry = glm.telemetry
+
+		self.assertEqual(telemetry['num_data'], 1000)
+		self.assertEqual(telemetry['batch_size'], 300)
+		self.assertEqual(telemetry['iterations'], len(callbacks))
+		self.assertEqual(len(telemetry['line_search_evaluations']), telemetry['iterations'])
+
+		# line searches account for all but the initial evaluation
+		self.assertGreaterEqual(telemetry['evaluations'], sum(telemetry['line_search_evaluations']))
+
+		phases = ['gradient_time', 'validation_time', 'callback_time', 'set_parameters_time']
+
+		for phase in phases:
+			self.assertGreaterEqual(telemetry[phase], 0.)
+		self.assertLessEqual(sum(telemetry[phase] for phase in phases), telemetry['total_time'] + 1e-6)
+
+		self.assertGreaterEqual(telemetry['peak_memory_increase'], 0)
+		self.assertGreater(telemetry['throughput'], 0.)
+		self.assertAlmostEqual(
+			telemetry['batch_throughput'] * 250., telemetry['throughput'], delta=telemetry['throughput'] * 1e-8)
+
+		# Newton's method is instrumented as well
+		glm.train(inputs, outputs, parameters={'max_iter': 5, 'newton': True})
+
+		self.assertEqual(len(glm.telemetry['line_search_evaluations']), glm.telemetry['iterations'])
+		self.assertGreaterEqual(glm.telemetry['evaluations'], glm.telemetry['iterations'] + 1)
+
+
+
+	def test_glm_directional_derivatives(self):
+		# trainable nonlinearities cannot be copied, so directions are evaluated serially
+		glm = GLM(4, BlobNonlinearity(3), Bernoulli)
+
+		inputs = randn(glm.dim_in, 100)
+		outputs = glm.sample(inputs)
+
+		errors = glm._check_directional_derivatives(inputs, outputs,
+			parameters={'train_nonlinearity': True, 'train_bias': False})
+
+		self.assertEqual(set(errors.keys()), set(['weights', 'nonlinearity']))
+
+		for block, err in errors.items():
+			self.assertLess(err, 1e-5)
+
+
+
+	def test_glm_per_example_gradients(self):
+		glm = GLM(4, LogisticFunction, Bernoulli)
+		glm.weights = randn(glm.dim_in, 1)
+		glm.bias = -1.
+
+		inputs = randn(glm.dim_in, 25)
+		outputs = glm.sample(inputs)
+
+		parameters = {'regularize_weights': 0.1, 'batch_size': 10}
+
+		gradients = glm._per_example_gradients(inputs, outputs, parameters=parameters)
+
+		self.assertEqual(gradients.shape, (glm.dim_in + 1, inputs.shape[1]))
+
+		# each column should be the gradient on a single data point
+		for n in range(inputs.shape[1]):
+			gradient = glm._parameter_gradient(
+				inputs[:, [n]], outputs[:, [n]], parameters=parameters).ravel()
+			self.assertLess(max(abs(gradients[:, n] - gradient)), 1e-10)
+
+
+
 	def test_glm_fisher_information(self):
 		N = 1000
 		T = 100
@@ -160,6 +387,33 @@ class Tests(unittest.TestCase):
 
 
 
+	def test_glm_canonical(self):
+		x = randn(5, 1000)
+
+		for nonlinearity, distribution in [
+				(LogisticFunction(), Bernoulli()),
+				(LogisticFunction(0.), Bernoulli()),
+				(ExponentialFunction(), Poisson()),
+				(ExponentialFunction(0.), Poisson())]:
+			glm = GLM(x.shape[0], nonlinearity, distribution)
+			glm.weights = randn(*glm.weights.shape) / 2.
+			glm.bias = randn() / 2.
+
+			y = glm.sample(x)
+
+			# gradients of fused log-likelihood should be correct
+			err = glm._check_gradient(x, y, 1e-5, parameters={'train_bias': True})
+			self.assertLess(err, 1e-6)
+
+		# extreme responses should not lead to infinite or undefined gradients
+		glm = GLM(x.shape[0], LogisticFunction(0.), Bernoulli())
+		glm.weights = 1000. * randn(*glm.weights.shape)
+		y = 1. - glm.sample(x)
+
+		self.assertTrue(all(isfinite(glm._parameter_gradient(x, y))))
+
+
+
 	def test_glm_pickle(self):
 		tmp_file = mkstemp()[1]
 
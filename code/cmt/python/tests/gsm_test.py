@@ -22,6 +22,23 @@ class Tests(unittest.TestCase):
 
 
 
+	def test_covariance(self):
+		gsm = GSM(20, 1)
+
+		covariance = cov(randn(gsm.dim, 100))
+		gsm.covariance = covariance
+
+		self.assertLess(max(abs(gsm.covariance - covariance)), 1e-8)
+
+		# badly conditioned covariance matrices should still yield a valid distribution
+		Q, _ = linalg.qr(randn(gsm.dim, gsm.dim))
+		gsm.covariance = dot(Q * logspace(0, -18, gsm.dim), Q.T)
+
+		self.assertTrue(all(isfinite(gsm.covariance)))
+		self.assertTrue(all(isfinite(gsm.loglikelihood(randn(gsm.dim, 10)))))
+
+
+
 	def test_train(self):
 		gsm0 = GSM(3, 2)
 		gsm0.mean = [1, 1, 1]
@@ -7,6 +7,9 @@ from numpy.random import *
 from pickle import dump, load
 from tempfile import mkstemp
 from cmt.models import MCBM, PatchMCBM
+from cmt.tools import BinaryMatrix, generate_masks
+from cmt.tools import generate_data_from_image, generate_binary_data_from_image
+from cmt.utils import seed
 
 class Tests(unittest.TestCase):
 	def test_basics(self):
@@ -143,6 +146,113 @@ class Tests(unittest.TestCase):
 
 
 
+	def test_gradient_batches(self):
+		mcbm = MCBM(10, 4, 8)
+		mcbm._set_parameters(randn(*mcbm._parameters().shape) / 10.)
+
+		input = randn(mcbm.dim_in, 1000)
+		output = randint(2, size=[mcbm.dim_out, 1000])
+
+		# gradients of many small batches should be reduced in a fixed order
+		grad = mcbm._parameter_gradient(input, output, parameters={'batch_size': 10})
+
+		for _ in range(5):
+			self.assertTrue(all(grad == mcbm._parameter_gradient(input, output, parameters={'batch_size': 10})))
+
+		# batch size should only affect rounding errors
+		self.assertLess(max(abs(grad - mcbm._parameter_gradient(input, output))), 1e-10)
+
+
+
+	def test_per_example_gradients(self):
+		mcbm = MCBM(5, 3, 4)
+
+		inputs = randn(mcbm.dim_in, 25)
+		outputs = mcbm.sample(inputs)
+
+		parameters = {
+			'regularize_features': 0.2,
+			'regularize_predictors': 0.3,
+			'regularize_weights': 0.4,
+			'batch_size': 10}
+
+		gradients = mcbm._per_example_gradients(inputs, outputs, parameters=parameters)
+		gradient = mcbm._parameter_gradient(inputs, outputs, parameters=parameters).ravel()
+
+		self.assertEqual(gradients.shape, (gradient.size, inputs.shape[1]))
+
+		# every column includes the regularizers, so the average is the full gradient
+		self.assertLess(max(abs(gradients.mean(1) - gradient)), 1e-10)
+
+		# each column should be the gradient on a single data point
+		for n in range(inputs.shape[1]):
+			gradient = mcbm._parameter_gradient(
+				inputs[:, [n]], outputs[:, [n]], parameters=parameters).ravel()
+			self.assertLess(max(abs(gradients[:, n] - gradient)), 1e-10)
+
+
+
+	def test_binary_inputs(self):
+		mcbm = MCBM(70, 4, 20)
+		mcbm._set_parameters(randn(*mcbm._parameters().shape) / 5.)
+
+		# use columns with mostly zeros and columns with mostly ones
+		input = rand(mcbm.dim_in, 500) < hstack([zeros(250) + .2, zeros(250) + .8])
+		input = asarray(input, dtype='float')
+		output = randint(2, size=[mcbm.dim_out, 500])
+
+		input_packed = BinaryMatrix(input)
+
+		self.assertEqual(input_packed.shape, input.shape)
+		self.assertTrue(all(input_packed.to_dense() == input))
+
+		# bit-packed and dense inputs should give the same results
+		loglik = mcbm.loglikelihood(input, output)
+		loglik_packed = mcbm.loglikelihood(input_packed, output)
+		self.assertLess(max(abs(loglik - loglik_packed)), 1e-10)
+
+		parameters = {'regularize_features': .1, 'regularize_predictors': .2}
+
+		grad = mcbm._parameter_gradient(input, output, parameters=parameters).ravel()
+		grad_packed = mcbm._parameter_gradient(input_packed, output, parameters=parameters).ravel()
+		self.assertLess(max(abs(grad - grad_packed)), 1e-10)
+
+		seed(1)
+		samples = mcbm.sample(input)
+		seed(1)
+		samples_packed = mcbm.sample(input_packed)
+		self.assertTrue(all(samples == samples_packed))
+
+		mcbm_packed = MCBM(mcbm.dim_in, mcbm.num_components, mcbm.num_features)
+		mcbm_packed._set_parameters(mcbm._parameters())
+
+		mcbm.train(input, output, parameters={'max_iter': 10})
+		mcbm_packed.train(input_packed, output, parameters={'max_iter': 10})
+		self.assertLess(max(abs(mcbm._parameters() - mcbm_packed._parameters())), 1e-8)
+
+		# validation data stays dense
+		mcbm_packed._set_parameters(mcbm._parameters())
+
+		mcbm.train(input, output, input[:, :100], output[:, :100],
+			parameters={'max_iter': 10, 'val_iter': 1})
+		mcbm_packed.train(input_packed, output, input[:, :100], output[:, :100],
+			parameters={'max_iter': 10, 'val_iter': 1})
+		self.assertLess(max(abs(mcbm._parameters() - mcbm_packed._parameters())), 1e-8)
+
+		self.assertRaises(RuntimeError, mcbm.loglikelihood, input_packed, output[:, :100])
+
+		# inputs extracted from binary images
+		img = asarray(rand(30, 40) < .5, dtype='float')
+		input_mask, output_mask = generate_masks(5)
+
+		input, output = generate_data_from_image(img, input_mask, output_mask)
+		input_packed, output_packed = generate_binary_data_from_image(img, input_mask, output_mask)
+
+		self.assertTrue(all(input_packed.to_dense() == input))
+		self.assertTrue(all(output_packed == output))
+
+
+
 	def test_pickle(self):
 		mcbm0 = MCBM(11, 4, 21)
 
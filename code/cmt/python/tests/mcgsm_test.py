@@ -314,6 +314,54 @@ class Tests(unittest.TestCase):
 
 
 
+	def test_directional_derivatives(self):
+		mcgsm = MCGSM(5, 2, 2, 4, 10)
+
+		inputs = randn(mcgsm.dim_in, 1000)
+		outputs = randn(mcgsm.dim_out, 1000)
+
+		parameters = {'train_means': True, 'regularize_predictors': 0.5}
+
+		errors = mcgsm._check_directional_derivatives(inputs, outputs, 3, 1e-5, parameters=parameters)
+
+		self.assertEqual(set(errors.keys()),
+			set(['priors', 'scales', 'weights', 'features', 'cholesky_factors', 'predictors', 'means']))
+
+		for block, err in errors.items():
+			self.assertLess(err, 1e-7)
+
+		# checking all parameters should give the same result as before
+		self.assertLess(mcgsm._check_gradient(inputs, outputs, 1e-5, parameters=parameters), 1e-7)
+
+
+
+	def test_per_example_gradients(self):
+		mcgsm = MCGSM(5, 2, 2, 4, 10)
+		mcgsm.linear_features = randn(mcgsm.num_components, mcgsm.dim_in) / 5.
+		mcgsm.means = randn(mcgsm.dim_out, mcgsm.num_components) / 5.
+
+		inputs = randn(mcgsm.dim_in, 25)
+		outputs = randn(mcgsm.dim_out, 25)
+
+		parameters = {
+			'train_linear_features': True,
+			'train_means': True,
+			'regularize_predictors': 0.2,
+			'regularize_linear_features': 0.3,
+			'batch_size': 10}
+
+		gradients = mcgsm._per_example_gradients(inputs, outputs, parameters=parameters)
+
+		self.assertEqual(gradients.shape, (mcgsm._parameters(parameters).size, inputs.shape[1]))
+
+		# each column should be the gradient on a single data point
+		for n in range(inputs.shape[1]):
+			gradient = mcgsm._parameter_gradient(
+				inputs[:, [n]], outputs[:, [n]], parameters=parameters).ravel()
+			self.assertLess(max(abs(gradients[:, n] - gradient)), 1e-10)
+
+
+
 	def test_evaluate(self):
 		mcgsm = MCGSM(5, 3, 4, 2, 10)
 
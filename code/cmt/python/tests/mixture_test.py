@@ -53,6 +53,110 @@ class Test(unittest.TestCase):
 
 
 
+	def test_train_batches(self):
+		data = hstack([randn(4, 2000) + 3., randn(4, 3000) * 2.])
+
+		models = [MoGSM(4, 3, 2), MoGSM(4, 3, 2)]
+		models[0].initialize(data)
+
+		for k in range(models[0].num_components):
+			models[1][k].mean = models[0][k].mean
+			models[1][k].covariance = models[0][k].covariance
+			models[1][k].scales = models[0][k].scales
+			models[1][k].priors = models[0][k].priors
+		models[1].priors = models[0].priors
+
+		parameters = {'verbosity': 0, 'max_iter': 5, 'threshold': 0., 'initialize': False}
+
+		# statistics of many small batches should be the same as those of one large batch
+		models[0].train(data, parameters=dict(parameters, batch_size=100))
+		models[1].train(data, parameters=dict(parameters, batch_size=data.shape[1]))
+
+		self.assertLess(max(abs(models[0].priors - models[1].priors)), 1e-8)
+
+		for k in range(models[0].num_components):
+			self.assertLess(max(abs(models[0][k].mean - models[1][k].mean)), 1e-8)
+			self.assertLess(max(abs(models[0][k].covariance - models[1][k].covariance)), 1e-8)
+			self.assertLess(max(abs(models[0][k].scales - models[1][k].scales)), 1e-8)
+
+		# each EM iteration should not decrease the log-likelihood
+		loglik = models[0].loglikelihood(data).mean()
+		for _ in range(3):
+			models[0].train(data, parameters=dict(parameters, max_iter=1))
+			loglik_new = models[0].loglikelihood(data).mean()
+			self.assertGreater(loglik_new, loglik - 1e-8)
+			loglik = loglik_new
+
+
+
+	def test_train_online(self):
+		data = hstack([randn(4, 2000) + 3., randn(4, 3000) * 2.])
+		data = data[:, permutation(data.shape[1])]
+
+		models = [MoGSM(4, 3, 2), MoGSM(4, 3, 2)]
+		models[0].initialize(data)
+
+		for k in range(models[0].num_components):
+			models[1][k].mean = models[0][k].mean
+			models[1][k].covariance = models[0][k].covariance
+			models[1][k].scales = models[0][k].scales
+			models[1][k].priors = models[0][k].priors
+		models[1].priors = models[0].priors
+
+		parameters = {'verbosity': 0, 'max_iter': 1, 'threshold': 0., 'initialize': False}
+
+		# a single batch should be equivalent to an iteration of batch EM
+		models[0].train(data, parameters=parameters)
+		models[1].train_online([data], parameters=parameters)
+
+		self.assertLess(max(abs(models[0].priors - models[1].priors)), 1e-8)
+
+		for k in range(models[0].num_components):
+			self.assertLess(max(abs(models[0][k].mean - models[1][k].mean)), 1e-8)
+			self.assertLess(max(abs(models[0][k].covariance - models[1][k].covariance)), 1e-8)
+			self.assertLess(max(abs(models[0][k].scales - models[1][k].scales)), 1e-8)
+
+		# with step sizes 1/t, statistics of a Gaussian are averaged over all batches
+		models = [MoGSM(4, 1, 1), MoGSM(4, 1, 1)]
+		models[0].initialize(data)
+		models[1].initialize(data)
+
+		parameters = {'verbosity': 0, 'initialize': False, 'step_size_offset': 1., 'step_size_decay': 1.}
+		component_parameters = {'train_scales': False}
+
+		models[0].train(data, parameters=dict(parameters, max_iter=1),
+			component_parameters=component_parameters)
+		models[1].train_online(hsplit(data, 5), parameters=dict(parameters, max_iter=100),
+			component_parameters=component_parameters)
+
+		self.assertLess(max(abs(models[0][0].mean - models[1][0].mean)), 1e-8)
+		self.assertLess(max(abs(models[0][0].covariance - models[1][0].covariance)), 1e-8)
+
+		# training on a stream of batches should improve the fit
+		def batches():
+			while True:
+				yield hstack([randn(4, 40) + 3., randn(4, 60) * 2.])
+
+		model = MoGSM(4, 3, 2)
+		model.initialize(data)
+
+		loglik = model.loglikelihood(data).mean()
+
+		converged = model.train_online(batches(), data, parameters={
+			'verbosity': 0,
+			'initialize': False,
+			'max_iter': 200,
+			'val_iter': 5,
+			'val_look_ahead': 5})
+
+		self.assertTrue(isinstance(converged, bool))
+		self.assertGreater(model.loglikelihood(data).mean(), loglik)
+
+		self.assertRaises(Exception, model.train_online, 5)
+		self.assertRaises(Exception, model.train_online, [randn(3, 10)])
+
+
+
 	def test_pickle(self):
 		models = [
 			Mixture(dim=5),
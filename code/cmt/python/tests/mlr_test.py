@@ -3,7 +3,8 @@ import unittest
 from tempfile import mkstemp
 from numpy import *
 from numpy import max, abs
-from numpy.random import randn, randint
+from numpy.random import randn, randint, rand
+from scipy.sparse import csc_matrix
 from cmt.models import MLR
 from pickle import load, dump
 
@@ -24,6 +25,56 @@ class Tests(unittest.TestCase):
 
 
 
+	def test_mlr_newton(self):
+		mlr = MLR(10, 4)
+		mlr.weights = randn(4, 10)
+		mlr.biases = randn(4, 1)
+
+		inputs = randn(10, 5000)
+		outputs = mlr.sample(inputs)
+
+		mlr_newton = MLR(10, 4)
+		mlr_lbfgs = MLR(10, 4)
+
+		mlr_lbfgs.train(inputs, outputs, parameters={'threshold': 1e-12})
+		mlr_newton.train(inputs, outputs, parameters={'threshold': 1e-12, 'newton': True})
+
+		self.assertAlmostEqual(
+			mlr_newton.evaluate(inputs, outputs),
+			mlr_lbfgs.evaluate(inputs, outputs), 5)
+
+		# Hessians accumulated over small batches should give the same solution
+		mlr_batches = MLR(10, 4)
+		mlr_newton.weights = mlr_batches.weights = randn(4, 10) / 2.
+		mlr_newton.biases = mlr_batches.biases = randn(4, 1) / 2.
+		mlr_newton.train(inputs, outputs, parameters={'max_iter': 2, 'newton': True})
+		mlr_batches.train(inputs, outputs, parameters={'max_iter': 2, 'newton': True, 'batch_size': 700})
+
+		self.assertLess(max(abs(mlr_newton.weights - mlr_batches.weights)), 1e-8)
+		self.assertLess(max(abs(mlr_newton.biases - mlr_batches.biases)), 1e-8)
+
+
+
+	def test_mlr_sparse(self):
+		mlr = MLR(20, 3)
+		mlr_sparse = MLR(20, 3)
+		mlr_sparse.weights = mlr.weights
+		mlr_sparse.biases = mlr.biases
+
+		N = 1000
+		inputs = (rand(20, N) > .9) * 1.
+		outputs = zeros([3, N])
+		outputs[randint(3, size=N), range(N)] = 1.
+
+		mlr.train(inputs, outputs, parameters={'max_iter': 20})
+		mlr_sparse.train(csc_matrix(inputs), outputs, parameters={'max_iter': 20})
+
+		self.assertLess(max(abs(mlr.weights - mlr_sparse.weights)), 1e-8)
+		self.assertLess(max(abs(
+			mlr.loglikelihood(inputs, outputs) - mlr.loglikelihood(csc_matrix(inputs), outputs))), 1e-10)
+
+
+
 	def test_gradient(self):
 		mlr = MLR(10, 5)
 
@@ -65,6 +116,35 @@ class Tests(unittest.TestCase):
 
 
 
+	def test_per_example_gradients(self):
+		mlr = MLR(5, 4)
+		mlr.weights = randn(*mlr.weights.shape)
+		mlr.biases = randn(*mlr.biases.shape)
+
+		inputs = randn(mlr.dim_in, 25)
+		outputs = mlr.sample(inputs)
+
+		parameters = {
+			'regularize_weights': 0.2,
+			'regularize_biases': 0.3,
+			'batch_size': 10}
+
+		gradients = mlr._per_example_gradients(inputs, outputs, parameters=parameters)
+		gradient = mlr._parameter_gradient(inputs, outputs, parameters=parameters).ravel()
+
+		self.assertEqual(gradients.shape, (gradient.size, inputs.shape[1]))
+
+		# every column includes the regularizers, so the average is the full gradient
+		self.assertLess(max(abs(gradients.mean(1) - gradient)), 1e-10)
+
+		# each column should be the gradient on a single data point
+		for n in range(inputs.shape[1]):
+			gradient = mlr._parameter_gradient(
+				inputs[:, [n]], outputs[:, [n]], parameters=parameters).ravel()
+			self.assertLess(max(abs(gradients[:, n] - gradient)), 1e-10)
+
+
+
 	def test_mlr_pickle(self):
 		tmp_file = mkstemp()[1]
 
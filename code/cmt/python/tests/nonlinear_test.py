@@ -3,7 +3,7 @@ import unittest
 
 from pickle import dump, load
 from tempfile import mkstemp
-from numpy import exp, max, abs
+from numpy import exp, max, abs, linspace, searchsorted, clip, sort, hstack
 from numpy.random import randn, rand
 from cmt.nonlinear import LogisticFunction, ExponentialFunction, HistogramNonlinearity
 from cmt.nonlinear import BlobNonlinearity, TanhBlobNonlinearity
@@ -72,6 +72,33 @@ class Tests(unittest.TestCase):
 
 
 
+	def test_histogram_nonlinearity_bins(self):
+		inputs = randn(1, 1000) * 2.
+		outputs = rand(1, 1000)
+
+		for bin_edges in [linspace(-3., 3., 13), hstack([[-3.], sort(rand(11)) * 6. - 3., [3.]])]:
+			f = HistogramNonlinearity(inputs, outputs, bin_edges=list(bin_edges))
+
+			# inputs lying exactly on edges belong to the bin to their right
+			x = hstack([randn(1, 1000) * 4., bin_edges.reshape(1, -1)])
+			bins = clip(searchsorted(bin_edges[1:-1], x, 'right'), 0, bin_edges.size - 2)
+
+			# centers of bins are far from any edge
+			centers = (bin_edges[1:] + bin_edges[:-1]) / 2.
+
+			self.assertLess(max(abs(f(x) - f(centers[bins]))), 1e-8)
+
+			glm = GLM(1, f)
+			glm.weights = [[1.]]
+			glm.bias = 0.
+
+			err = glm._check_gradient(inputs, (rand(*inputs.shape) < .5) * 1.,
+				parameters={'train_weights': False, 'train_bias': False, 'train_nonlinearity': True})
+
+			self.assertLess(err, 1e-6)
+
+
+
 	def test_histogram_nonlinearity_pickle(self):
 		tmp_file = mkstemp()[1]
 
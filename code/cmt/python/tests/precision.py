@@ -0,0 +1,50 @@
+"""
+Measures how long it takes to compute the Cholesky factor of a GSM's precision
+matrix from its covariance and how long an M-step of a GSM takes, as a function
+of the dimensionality of the data.
+"""
+
+import sys
+import socket
+
+from argparse import ArgumentParser
+from time import time
+from datetime import datetime
+from numpy import dot
+from numpy.random import randn
+from cmt.models import GSM
+
+parser = ArgumentParser(sys.argv[0], description=__doc__)
+parser.add_argument('--dims',        '-d', type=int, nargs='+', default=[25, 50, 100, 200, 400])
+parser.add_argument('--num_data',    '-n', type=int, default=1000)
+parser.add_argument('--repetitions', '-r', type=int, default=10)
+
+args = parser.parse_args(sys.argv[1:])
+
+print(socket.gethostname())
+print(datetime.now())
+print(args)
+print('')
+
+print('{0:>6}{1:>14}{2:>14}'.format('dim', 'covariance', 'train'))
+
+for dim in args.dims:
+	model = GSM(dim, 1)
+
+	A = randn(dim, 2 * dim)
+	covariance = dot(A, A.T) / (2 * dim)
+	data = dot(A, randn(2 * dim, args.num_data))
+
+	# setting the covariance computes the Cholesky factor of the precision matrix
+	t = time()
+	for _ in range(args.repetitions):
+		model.covariance = covariance
+	t_covariance = (time() - t) / args.repetitions
+
+	# a single EM iteration mostly consists of computing the Cholesky factor
+	t = time()
+	for _ in range(args.repetitions):
+		model.train(data, parameters={'max_iter': 1})
+	t_train = (time() - t) / args.repetitions
+
+	print('{0:6}{1:14.6f}{2:14.6f}'.format(dim, t_covariance, t_train))
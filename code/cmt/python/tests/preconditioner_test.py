@@ -5,11 +5,12 @@ from numpy import *
 from numpy import sum, max, round
 from numpy.random import *
 from numpy.linalg import inv, slogdet
-from pickle import dump, load
+from pickle import dump, load, dumps, loads
 from tempfile import mkstemp
 from cmt.transforms import AffinePreconditioner, WhiteningPreconditioner, PCAPreconditioner
 from cmt.transforms import AffineTransform, WhiteningTransform, PCATransform
-from cmt.transforms import BinningTransform
+from cmt.transforms import BinningTransform, StackedAffineTransform
+from cmt.models import GLM, Bernoulli
 
 class Tests(unittest.TestCase):
 	def test_adjust_gradient(self):
@@ -215,6 +216,105 @@ class Tests(unittest.TestCase):
 
 
 
+	def test_affine_preconditioner_buffers(self):
+		N = 200
+
+		X = asfortranarray(dot(randn(5, 5), randn(5, N)) + randn(5, 1))
+		Y = asfortranarray(dot(randn(2, 2), randn(2, N)) + dot(randn(2, 5), X))
+
+		for pre in [
+			WhiteningPreconditioner(X, Y),
+			PCAPreconditioner(X, Y, num_pcs=3),
+			AffineTransform(randn(5, 1), randn(5, 5), 2)]:
+
+			Xp, Yp = pre(X, Y)
+
+			# results written into buffers should be the same as returned results
+			X_pre = empty([pre.dim_in_pre, N], order='F')
+			Y_pre = empty([pre.dim_out_pre, N], order='F')
+			Y_inv = empty([pre.dim_out, N], order='F')
+
+			pre._transform(X, X_pre, Y, Y_pre)
+			self.assertLess(max(abs(X_pre - Xp)), 1e-10)
+			self.assertLess(max(abs(Y_pre - Yp)), 1e-10)
+
+			pre._transform(X, X_pre)
+			self.assertLess(max(abs(X_pre - pre(X))), 1e-10)
+
+			pre._inverse_transform(X_pre, Y_pre, Y_inv)
+			self.assertLess(max(abs(Y_inv - Y)), 1e-10)
+
+			# buffers for preconditioned inputs and outputs may not overlap
+			memory = empty(pre.dim_in_pre * N + pre.dim_out_pre * N)
+			self.assertRaises(RuntimeError, pre._transform, X,
+				memory[:pre.dim_in_pre * N].reshape(pre.dim_in_pre, N, order='F'), Y,
+				memory[N:N + pre.dim_out_pre * N].reshape(pre.dim_out_pre, N, order='F'))
+
+			# results are not written into read-only or misaligned arrays
+			X_read, X_pre_read = X.copy('F'), X_pre.copy('F')
+			X_read.flags.writeable = False
+			X_pre_read.flags.writeable = False
+			pre._transform(X_read, X_pre)
+			self.assertRaises(RuntimeError, pre._transform, X, X_pre_read)
+
+			memory = frombuffer(bytearray(8 * pre.dim_in_pre * N + 1), offset=1)
+			self.assertRaises(RuntimeError, pre._transform, X, memory.reshape(pre.dim_in_pre, N, order='F'))
+
+			if pre.dim_in_pre != pre.dim_in:
+				continue
+
+			# transform data in place
+			X_copy, Y_copy = X.copy('F'), Y.copy('F')
+			pre._transform(X_copy, X_copy, Y_copy, Y_copy)
+			self.assertLess(max(abs(X_copy - Xp)), 1e-10)
+			self.assertLess(max(abs(Y_copy - Yp)), 1e-10)
+
+			pre._inverse_transform(X_copy, Y_copy, Y_copy)
+			self.assertLess(max(abs(Y_copy - Y)), 1e-10)
+
+			# buffer shifted by one data point relative to the inputs
+			B = zeros([pre.dim_in, N + 1], order='F')
+			B[:, 1:] = X
+			pre._transform(B[:, 1:], B[:, :-1])
+			self.assertLess(max(abs(B[:, :-1] - pre(X))), 1e-10)
+
+
+
+	def test_affine_preconditioner_sample(self):
+		X = asfortranarray(randn(5, 500))
+		Y = asfortranarray(rand(1, 500) < .5, dtype=float)
+
+		pre = WhiteningPreconditioner(X, Y)
+
+		glm = GLM(pre.dim_in_pre, distribution=Bernoulli)
+		glm.weights = randn(*glm.weights.shape)
+
+		# preconditioned samples of a Bernoulli GLM are binary
+		samples = empty_like(Y, order='F')
+		pre._sample(glm, X, samples)
+		samples_pre = pre(X, samples)[1]
+		self.assertLess(max(abs(samples_pre - round(samples_pre))), 1e-10)
+		self.assertTrue(all((round(samples_pre) == 0) | (round(samples_pre) == 1)))
+		self.assertTrue(any(round(samples_pre) == 0) and any(round(samples_pre) == 1))
+
+		# samples may be written into the array holding the inputs
+		memory = X.flatten('F')
+		pre._sample(glm, memory.reshape(5, -1, order='F'), memory[:500].reshape(1, -1))
+		samples_pre = pre(X, memory[:500].reshape(1, -1))[1]
+		self.assertTrue(all((round(samples_pre) == 0) | (round(samples_pre) == 1)))
+
+
+
+	def test_affine_preconditioner_log_jacobian_constant(self):
+		X = dot(randn(5, 5), randn(5, 1000)) + randn(5, 1)
+		Y = dot(randn(2, 2), randn(2, 1000)) + dot(randn(2, 5), X)
+
+		for pre in [WhiteningPreconditioner(X, Y), PCAPreconditioner(X, Y, num_pcs=3)]:
+			self.assertAlmostEqual(pre.log_jacobian_constant, slogdet(pre.pre_out)[1])
+			self.assertLess(max(abs(pre.logjacobian(X, Y) - pre.log_jacobian_constant)), 1e-10)
+
+
+
 	def test_whitening_preconditioner(self):
 		X = dot(randn(5, 5), randn(5, 1000)) + randn(5, 1)
 		Y = dot(randn(2, 2), randn(2, 1000)) + dot(randn(2, 5), X)
@@ -235,6 +335,77 @@ class Tests(unittest.TestCase):
 
 
 
+	def test_whitening_preconditioner_chunks(self):
+		# covariances are accumulated over chunks of data of unequal size
+		X = dot(randn(5, 5), randn(5, 12345)) + 1000. * randn(5, 1)
+		Y = dot(randn(2, 2), randn(2, 12345)) + dot(randn(2, 5), X)
+
+		for wt in [WhiteningPreconditioner(X, Y), PCAPreconditioner(X, Y, num_pcs=5)]:
+			Xw, Yw = wt(X, Y)
+
+			self.assertLess(max(abs(mean(vstack([Xw, Yw]), 1))), 1e-8)
+			self.assertLess(max(abs(cov(vstack([Xw, Yw]), bias=True) - eye(7))), 1e-8)
+
+
+
+	def test_whitening_preconditioner_stream(self):
+		X = dot(randn(5, 5), randn(5, 12345)) + 1000. * randn(5, 1)
+		Y = dot(randn(2, 2), randn(2, 12345)) + dot(randn(2, 5), X)
+
+		wt0 = WhiteningPreconditioner(X, Y)
+
+		# batches of inputs stacked on top of outputs
+		batches = (vstack([X[:, i:i + 1000], Y[:, i:i + 1000]]) for i in range(0, X.shape[1], 1000))
+
+		wt1 = WhiteningPreconditioner(batches, dim_in=5)
+
+		self.assertLess(max(abs(wt0.mean_in - wt1.mean_in)), 1e-8)
+		self.assertLess(max(abs(wt0.mean_out - wt1.mean_out)), 1e-8)
+		self.assertLess(max(abs(wt0.pre_in - wt1.pre_in)), 1e-8)
+		self.assertLess(max(abs(wt0.pre_out - wt1.pre_out)), 1e-8)
+		self.assertLess(max(abs(wt0.predictor - wt1.predictor)), 1e-8)
+
+		# outputs only
+		wt0 = WhiteningPreconditioner(empty([0, Y.shape[1]]), Y)
+		wt1 = WhiteningPreconditioner([Y[:, :5000], Y[:, 5000:]], 0)
+
+		self.assertLess(max(abs(wt0.mean_out - wt1.mean_out)), 1e-8)
+		self.assertLess(max(abs(wt0.pre_out - wt1.pre_out)), 1e-8)
+
+		self.assertRaises(RuntimeError, WhiteningPreconditioner, [randn(7, 100)], 8)
+
+
+
+	def test_pca_stream(self):
+		X = dot(randn(5, 5), randn(5, 12345)) + 10. * randn(5, 1)
+		Y = dot(randn(2, 2), randn(2, 12345)) + dot(randn(2, 5), X)
+
+		batches = [vstack([X[:, i:i + 1000], Y[:, i:i + 1000]]) for i in range(0, X.shape[1], 1000)]
+
+		for pca0, pca1 in [
+			(PCAPreconditioner(X, Y, num_pcs=3), PCAPreconditioner(iter(batches), dim_in=5, num_pcs=3)),
+			(PCATransform(X, Y, num_pcs=3), PCATransform(iter(batches), dim_in=5, num_pcs=3))]:
+			self.assertEqual(pca1.dim_in, 5)
+			self.assertEqual(pca1.dim_out, 2)
+			self.assertEqual(pca1.dim_in_pre, 3)
+
+			self.assertLess(max(abs(pca0.eigenvalues - pca1.eigenvalues)), 1e-8)
+			self.assertLess(max(abs(pca0.mean_in - pca1.mean_in)), 1e-8)
+
+			# principal components are only determined up to their sign
+			self.assertLess(max(abs(dot(pca0.pre_in.T, pca0.pre_in) - dot(pca1.pre_in.T, pca1.pre_in))), 1e-8)
+
+			Xp0, Yp0 = pca0(X, Y)
+			Xp1, Yp1 = pca1(X, Y)
+
+			self.assertLess(max(abs(abs(Xp0) - abs(Xp1))), 1e-6)
+			self.assertLess(max(abs(abs(Yp0) - abs(Yp1))), 1e-6)
+
+		self.assertRaises(RuntimeError, PCAPreconditioner, [randn(7, 100)], 8)
+		self.assertRaises(RuntimeError, PCATransform, [randn(7, 100)], 8)
+
+
+
 	def test_whitening_preconditioner_pickle(self):
 		wt0 = WhiteningPreconditioner(randn(5, 1000), randn(2, 1000))
 
@@ -333,6 +504,33 @@ class Tests(unittest.TestCase):
 
 
 
+	def test_pca_preconditioner_truncated(self):
+		# input with quickly decaying spectrum
+		X = .7**arange(200).reshape(-1, 1) * randn(200, 5000)
+		Y = randn(1, 5000) + X[:1]
+
+		for num_pcs, var_explained in [(5, 99.), (-1, 80.)]:
+			# only compute a few principal components
+			pca0 = PCAPreconditioner(X, Y, var_explained=var_explained, num_pcs=num_pcs)
+
+			# compute all principal components
+			pca1 = PCAPreconditioner(X, Y, var_explained=var_explained, num_pcs=num_pcs, tolerance=0.)
+
+			Xp0, Yp0 = pca0(X, Y)
+			Xp1, Yp1 = pca1(X, Y)
+
+			# only the needed eigenvalues should have been computed
+			self.assertLess(pca0.eigenvalues.size, X.shape[0])
+			self.assertEqual(pca1.eigenvalues.size, X.shape[0])
+			self.assertEqual(Xp0.shape, Xp1.shape)
+
+			# principal components are only determined up to sign
+			self.assertLess(max(abs(abs(Xp0) - abs(Xp1))), 1e-5)
+			self.assertLess(max(abs(Yp0 - Yp1)), 1e-5)
+			self.assertLess(max(abs(pca0.eigenvalues[-Xp0.shape[0]:] - pca1.eigenvalues[-Xp1.shape[0]:])), 1e-8)
+
+
+
 	def test_pca_preconditioner_pickle(self):
 		wt0 = PCAPreconditioner(randn(5, 1000), randn(2, 1000), num_pcs=3)
 
@@ -459,6 +657,8 @@ class Tests(unittest.TestCase):
 		self.assertEqual(y[1], 6.)
 		self.assertEqual(y[2], 0.)
 
+		self.assertLess(max(abs(dot(pre.pre_in, x) - y)), 1e-10)
+
 
 
 	def test_binning_transform_pickle(self):
@@ -483,5 +683,67 @@ class Tests(unittest.TestCase):
 
 
 
+	def test_binning_transform_inverse(self):
+		pre0 = BinningTransform(3, 12, 2)
+		pre1 = AffineTransform(pre0.mean_in, pre0.pre_in, dim_out=2)
+
+		X = randn(12, 20)
+		Y = randn(2, 20)
+
+		# binning should behave like the equivalent dense transform
+		self.assertLess(max(abs(pre0(X) - pre1(X))), 1e-10)
+		self.assertLess(max(abs(pre0.inverse(pre0(X)) - pre1.inverse(pre1(X)))), 1e-10)
+
+		dX, dY = randn(4, 20), randn(2, 20)
+
+		self.assertLess(max(abs(pre0.adjust_gradient(dX, dY)[0] - pre1.adjust_gradient(dX, dY)[0])), 1e-10)
+		self.assertLess(max(abs(pre0.adjust_gradient(dX, dY)[1] - dY)), 1e-10)
+
+
+
+	def test_stacked_affine_transform(self):
+		X = randn(10, 100)
+		Y = randn(2, 100)
+
+		pre0 = PCATransform(X[:4], num_pcs=3)
+		pre1 = BinningTransform(3, 6)
+		pre = StackedAffineTransform(pre0, pre1, dim_out=2)
+
+		self.assertEqual(pre.dim_in, 10)
+		self.assertEqual(pre.dim_in_pre, 5)
+		self.assertEqual(pre.dim_out, 2)
+		self.assertEqual(len(pre.transforms), 2)
+		self.assertTrue(isinstance(pre.transforms[1], BinningTransform))
+
+		# equivalent transform using a dense block-diagonal matrix
+		pre_in = zeros([5, 10])
+		pre_in[:3, :4] = pre0.pre_in
+		pre_in[3:, 4:] = pre1.pre_in
+		pre_dense = AffineTransform(vstack([pre0.mean_in, pre1.mean_in]), pre_in, dim_out=2)
+
+		# block-diagonal matrix is built on demand
+		self.assertLess(max(abs(pre.pre_in - pre_in)), 1e-10)
+
+		Xp, Yp = pre(X, Y)
+
+		self.assertLess(max(abs(Xp - pre_dense(X))), 1e-10)
+		self.assertLess(max(abs(Yp - Y)), 1e-10)
+		self.assertLess(max(abs(pre.inverse(Xp) - pre_dense.inverse(Xp))), 1e-10)
+		self.assertLess(max(abs(pre.logjacobian(X, Y))), 1e-10)
+
+		dX, dY = randn(5, 100), randn(2, 100)
+
+		self.assertLess(max(abs(pre.adjust_gradient(dX, dY)[0] - pre_dense.adjust_gradient(dX, dY)[0])), 1e-10)
+
+		# stacked transforms can be nested and pickled
+		pre = loads(dumps(StackedAffineTransform(pre, BinningTransform(2, 4))))
+
+		self.assertEqual(pre.dim_in, 14)
+		self.assertLess(max(abs(pre(vstack([X, randn(4, 100)]))[:5] - Xp)), 1e-10)
+
+		self.assertRaises(TypeError, StackedAffineTransform, pre0, 10)
+
+
+
 if __name__ == '__main__':
 	unittest.main()
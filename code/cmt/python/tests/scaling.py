@@ -0,0 +1,78 @@
+"""
+Measures how the time it takes to compute parameter gradients scales with the
+number of threads. Each thread count is measured in a separate process, since
+OpenMP reads OMP_NUM_THREADS only once.
+"""
+
+import os
+import sys
+import socket
+
+from argparse import ArgumentParser
+from subprocess import check_output
+from time import time
+from datetime import datetime
+from numpy.random import randn, randint
+from cmt.models import STM, MCBM, GLM, Bernoulli
+from cmt.nonlinear import LogisticFunction
+
+parser = ArgumentParser(sys.argv[0], description=__doc__)
+parser.add_argument('--num_data',    '-d', type=int, default=100000)
+parser.add_argument('--dim_in',      '-i', type=int, default=40)
+parser.add_argument('--batch_size',  '-b', type=int, default=100)
+parser.add_argument('--repetitions', '-r', type=int, default=5)
+parser.add_argument('--threads',     '-t', type=int, nargs='+', default=[1, 2, 4, 8, 16, 32, 64])
+parser.add_argument('--model',       '-m', type=str, default='')
+
+args = parser.parse_args(sys.argv[1:])
+
+def models():
+	return {
+		'STM': STM(args.dim_in, 0, 8, 40),
+		'MCBM': MCBM(args.dim_in, 8, 40),
+		'GLM': GLM(args.dim_in, LogisticFunction, Bernoulli)}
+
+if args.model:
+	# measure a single model with the number of threads set by the parent
+	model = models()[args.model]
+
+	input = randn(args.dim_in, args.num_data)
+	output = randint(2, size=[1, args.num_data])
+
+	if args.model == 'MCBM':
+		input = randint(2, size=[args.dim_in, args.num_data])
+
+	t = model._check_performance(input, output,
+		repetitions=args.repetitions,
+		parameters={'batch_size': args.batch_size})
+
+	print('{0:.8f}'.format(t))
+	sys.exit(0)
+
+###
+print(socket.gethostname())
+print(datetime.now())
+print(args)
+print('')
+
+###
+for name in sorted(models()):
+	print('{0}._parameter_gradient'.format(name))
+
+	baseline = None
+
+	for num_threads in args.threads:
+		env = dict(os.environ, OMP_NUM_THREADS=str(num_threads))
+		cmd = [sys.executable, sys.argv[0], '--model', name,
+			'--num_data', str(args.num_data),
+			'--dim_in', str(args.dim_in),
+			'--batch_size', str(args.batch_size),
+			'--repetitions', str(args.repetitions)]
+
+		t = float(check_output(cmd, env=env))
+
+		if baseline is None:
+			baseline = t
+
+		print('{0:12.8f} seconds ({1:2d} threads, {2:5.2f}x)'.format(t, num_threads, baseline / t))
+	print('')
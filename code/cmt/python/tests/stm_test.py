@@ -9,6 +9,8 @@ from tempfile import mkstemp
 from cmt.models import STM, GLM, Bernoulli, Poisson
 from cmt.nonlinear import LogisticFunction, ExponentialFunction
 from scipy.stats import norm
+from scipy.sparse import csc_matrix
+from cmt.tools import WindowedTimeSeries, extract_windows
 
 class Tests(unittest.TestCase):
 	def test_basics(self):
@@ -134,6 +136,124 @@ class Tests(unittest.TestCase):
 
 
 
+	def test_sparse(self):
+		stm = STM(5, 20, 3, 2)
+		stm_sparse = STM(5, 20, 3, 2)
+		stm_sparse._set_parameters(stm._parameters())
+
+		input = vstack([randn(5, 2000), rand(20, 2000) > .9]) * 1.
+		output = rand(1, 2000) < .5
+
+		# only linear inputs are kept in sparse format
+		stm.train(input, output, parameters={'max_iter': 20, 'batch_size': 500})
+		stm_sparse.train(csc_matrix(input), output, parameters={'max_iter': 20, 'batch_size': 500})
+
+		self.assertLess(max(abs(stm._parameters() - stm_sparse._parameters())), 1e-8)
+
+		self.assertLess(max(abs(
+			stm.loglikelihood(input, output) - stm.loglikelihood(csc_matrix(input), output))), 1e-10)
+		self.assertLess(max(abs(
+			stm.predict(input) - stm.predict(csc_matrix(input)))), 1e-10)
+
+		# STM reduces to GLM, which is randomly initialized
+		stm = STM(0, 20, 1)
+		stm_sparse = STM(0, 20, 1)
+
+		stm.train(input[5:], output)
+		stm_sparse.train(csc_matrix(input[5:]), output)
+
+		self.assertAlmostEqual(
+			stm.evaluate(input[5:], output),
+			stm_sparse.evaluate(input[5:], output), 5)
+
+
+
+	def test_windowed(self):
+		stimulus = randn(1, 2000)
+		spike_train = asarray(rand(1, 2000) < .2, dtype=float)
+
+		stm = STM(5, 10, 3, 2)
+		stm_windowed = STM(5, 10, 3, 2)
+		stm_windowed._set_parameters(stm._parameters())
+
+		# stimulus windows are nonlinear inputs, spike histories are linear inputs
+		windows = WindowedTimeSeries([stimulus, spike_train[:, :-1]], [5, 10])
+		input = windows.to_dense()
+		output = spike_train[:, -input.shape[1]:]
+
+		stm.train(input, output, parameters={'max_iter': 20, 'batch_size': 500})
+		stm_windowed.train(windows, output, parameters={'max_iter': 20, 'batch_size': 500})
+
+		self.assertLess(max(abs(stm._parameters() - stm_windowed._parameters())), 1e-8)
+		self.assertLess(max(abs(
+			stm.loglikelihood(input, output) - stm.loglikelihood(windows, output))), 1e-10)
+
+		# gradients of windowed inputs should agree with gradients of extracted windows
+		parameters = {
+			'train_sharpness': True,
+			'batch_size': 300,
+			'regularize_features': .1,
+			'regularize_predictors': .2}
+
+		self.assertLess(max(abs(
+			stm._parameter_gradient(input, output, parameters=parameters) -
+			stm._parameter_gradient(windows, output, parameters=parameters))), 1e-10)
+
+		# model without linear inputs
+		stm = STM(5, 0, 3, 2)
+		stm._set_parameters(randn(*stm._parameters().shape) / 5.)
+
+		windows = WindowedTimeSeries(stimulus[:, 1:], 5)
+		input = extract_windows(stimulus[:, 1:], 5)
+		output = spike_train[:, -input.shape[1]:]
+
+		self.assertLess(max(abs(
+			stm.loglikelihood(input, output) - stm.loglikelihood(windows, output))), 1e-10)
+		self.assertLess(max(abs(
+			stm._parameter_gradient(input, output, parameters=parameters) -
+			stm._parameter_gradient(windows, output, parameters=parameters))), 1e-10)
+
+		# nonlinear and linear inputs have to correspond to different time series
+		stm = STM(4, 11, 3, 2)
+		self.assertRaises(RuntimeError, stm.train, windows, output)
+
+
+
+	def test_telemetry(self):
+		input = vstack([randn(5, 2000), rand(20, 2000) > .9]) * 1.
+		output = rand(1, 2000) < .5
+
+		stm = STM(5, 20, 3, 2)
+		stm.train(input, output, parameters={'max_iter': 10, 'threshold': 0., 'batch_size': 500})
+
+		self.assertEqual(stm.telemetry['num_data'], 2000)
+		self.assertEqual(stm.telemetry['batch_size'], 500)
+		self.assertEqual(len(stm.telemetry['line_search_evaluations']), stm.telemetry['iterations'])
+		self.assertGreaterEqual(stm.telemetry['peak_memory_increase'], 0)
+
+		# telemetry of STMs reducing to GLMs is taken from the GLM
+		stm = STM(0, 20, 1)
+		stm.train(input[5:], output, input[5:, :200], output[:, :200], parameters={'max_iter': 5})
+
+		self.assertEqual(stm.telemetry['num_data'], 2000)
+		self.assertGreater(stm.telemetry['iterations'], 0)
+
+		stm.train(csc_matrix(input[5:]), output, parameters={'max_iter': 5, 'batch_size': 400})
+
+		self.assertEqual(stm.telemetry['num_data'], 2000)
+		self.assertEqual(stm.telemetry['batch_size'], 400)
+
+		spike_train = asarray(rand(1, 2000) < .2, dtype=float)
+		windows = WindowedTimeSeries(spike_train[:, :-1], 10)
+
+		stm = STM(0, 10, 1)
+		stm.train(windows, spike_train[:, -windows.shape[1]:], parameters={'max_iter': 5})
+
+		self.assertEqual(stm.telemetry['num_data'], windows.shape[1])
+		self.assertGreater(stm.telemetry['iterations'], 0)
+
+
+
 	def test_gradient(self):
 		stm = STM(5, 2, 10)
 
@@ -194,6 +314,56 @@ class Tests(unittest.TestCase):
 
 
 
+	def test_gradient_batches(self):
+		stm = STM(5, 2, 10)
+		stm._set_parameters(randn(*stm._parameters().shape) / 10.)
+
+		input = randn(stm.dim_in, 1000)
+		output = randint(2, size=[stm.dim_out, 1000])
+
+		# gradients of many small batches should be reduced in a fixed order
+		grad = stm._parameter_gradient(input, output, parameters={'batch_size': 10})
+
+		for _ in range(5):
+			self.assertTrue(all(grad == stm._parameter_gradient(input, output, parameters={'batch_size': 10})))
+
+		# batch size should only affect rounding errors
+		self.assertLess(max(abs(grad - stm._parameter_gradient(input, output))), 1e-10)
+
+
+
+	def test_per_example_gradients(self):
+		stm = STM(5, 3, 3, 4)
+		stm.biases = randn(*stm.biases.shape) / 2.
+		stm.linear_predictor = randn(*stm.linear_predictor.shape) / 2.
+
+		inputs = randn(stm.dim_in, 25)
+		outputs = stm.sample(inputs)
+
+		parameters = {
+			'regularize_biases': 0.1,
+			'regularize_features': 0.2,
+			'regularize_predictors': 0.3,
+			'regularize_weights': 0.4,
+			'regularize_linear_predictor': 0.5,
+			'batch_size': 10}
+
+		gradients = stm._per_example_gradients(inputs, outputs, parameters=parameters)
+		gradient = stm._parameter_gradient(inputs, outputs, parameters=parameters).ravel()
+
+		self.assertEqual(gradients.shape, (gradient.size, inputs.shape[1]))
+
+		# every column includes the regularizers, so the average is the full gradient
+		self.assertLess(max(abs(gradients.mean(1) - gradient)), 1e-10)
+
+		# each column should be the gradient on a single data point
+		for n in range(inputs.shape[1]):
+			gradient = stm._parameter_gradient(
+				inputs[:, [n]], outputs[:, [n]], parameters=parameters).ravel()
+			self.assertLess(max(abs(gradients[:, n] - gradient)), 1e-10)
+
+
+
 	def test_glm_data_gradient(self):
 		models = []
 		models.append(
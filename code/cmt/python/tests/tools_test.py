@@ -4,9 +4,9 @@ import unittest
 from numpy import *
 from numpy import max, all
 from numpy.random import *
-from cmt.models import MCGSM, GLM, Bernoulli
+from cmt.models import MCGSM, MCBM, GLM, STM, Bernoulli
 from cmt.transforms import WhiteningPreconditioner, AffineTransform
-from cmt.utils import random_select
+from cmt.utils import random_select, seed
 from cmt.nonlinear import LogisticFunction
 from cmt.tools import generate_data_from_image, sample_image
 from cmt.tools import generate_data_from_video, sample_video
@@ -224,6 +224,26 @@ class ToolsTest(unittest.TestCase):
 		# the first frame should be untouched
 		self.assertLess(max(abs(video_init[:, :, 0] - video_sample[:, :, 0])), 1e-10)
 
+		# deterministic model whose output depends on its causal neighborhood,
+		# since responses of binary inputs are always far from zero
+		model = GLM(13, LogisticFunction, Bernoulli)
+		model.weights = randint(-2, 3, size=[13, 1]) * 1000.
+		model.bias = 500.
+
+		video_init = asarray(rand(9, 11, 6) > .5, dtype=float)
+		video_sample = sample_video(video_init, model, xmask, ymask)
+
+		# sample pixels one after another
+		video = video_init.copy()
+		for f in range(video.shape[2] - 1):
+			for i in range(video.shape[0] - 2):
+				for j in range(video.shape[1] - 2):
+					patch = video[i:i + 3, j:j + 3, f:f + 2]
+					input = hstack([patch[:, :, 0][xmask[:, :, 0]], patch[:, :, 1][xmask[:, :, 1]]])
+					video[i + 1, j + 1, f + 1] = model.sample(input.reshape(-1, 1))
+
+		self.assertLess(max(abs(video - video_sample)), 1e-10)
+
 
 
 	def test_fill_in_image(self):
@@ -251,6 +271,10 @@ class ToolsTest(unittest.TestCase):
 		wt = WhiteningPreconditioner(randn(4, 1000), randn(1, 1000))
 		fill_in_image_map(img, model, xmask, ymask, fmask, wt, num_iter=1, patch_size=20)
 
+		# only pixels of the fill-in mask are sampled
+		img_filled = fill_in_image(img, model, xmask, ymask, fmask, wt, num_iter=1, num_steps=2)
+		self.assertLess(max(abs(img_filled[~fmask] - img[~fmask])), 1e-10)
+
 
 
 	def test_preprocess_spike_train(self):
@@ -307,6 +331,113 @@ class ToolsTest(unittest.TestCase):
 		diff = spike_train.ravel()[:10] - [0, 0, 0, 1, 0, 0, 1, 0, 0, 1]
 		self.assertLess(max(abs(diff)), 1e-8)
 
+		# simulate several trials at once
+		spike_trains = sample_spike_train(empty([0, 100]), glm, 3, pre, num_trials=5)
+
+		self.assertEqual(spike_trains.shape, (5, 100))
+
+		diff = spike_trains[:, :10] - [0, 0, 0, 1, 0, 0, 1, 0, 0, 1]
+		self.assertLess(max(abs(diff)), 1e-8)
+
+
+
+	def test_sample_spike_train_filters(self):
+		# GLMs and STMs are simulated by tracking filter outputs, which
+		# should not change the random numbers used for sampling
+		dim_stim = 3
+		spike_history = 4
+
+		def sample(stimuli, model, preconditioner=None):
+			spike_train = zeros([1, stimuli.shape[1]])
+
+			for t in range(spike_history, stimuli.shape[1]):
+				input = vstack([
+					stimuli[:, [t]],
+					spike_train[:, t - spike_history:t].T.reshape(-1, 1)])
+
+				if preconditioner is not None:
+					input = vstack([input[:dim_stim], preconditioner(input[dim_stim:])])
+
+				spike_train[:, t] = model.sample(input)
+
+			return spike_train
+
+		glm = GLM(dim_stim + spike_history, LogisticFunction, Bernoulli)
+		glm.weights = randn(*glm.weights.shape)
+		glm.bias = -1.
+
+		stm = STM(dim_stim, spike_history, 3, 2, LogisticFunction, Bernoulli)
+		stm.predictors = randn(*stm.predictors.shape)
+		stm.features = randn(*stm.features.shape)
+		stm.weights = rand(*stm.weights.shape)
+		stm.linear_predictor = randn(*stm.linear_predictor.shape)
+
+		pre = AffineTransform(randn(spike_history, 1), randn(2, spike_history))
+
+		glm_pre = GLM(dim_stim + 2, LogisticFunction, Bernoulli)
+		glm_pre.weights = randn(*glm_pre.weights.shape)
+
+		stimuli = randn(dim_stim, 200)
+
+		for model, preconditioner in [(glm, None), (stm, None), (glm_pre, pre)]:
+			seed(12)
+			if preconditioner is None:
+				spike_train = sample_spike_train(stimuli, model, spike_history)
+			else:
+				spike_train = sample_spike_train(stimuli, model, spike_history, preconditioner)
+
+			seed(12)
+			self.assertLess(max(abs(spike_train - sample(stimuli, model, preconditioner))), 1e-8)
+			self.assertGreater(spike_train.sum(), 0)
+
+
+
+	def test_sample_spike_train_trials(self):
+		# other models are simulated for all trials at once, with affinely transformed
+		# spike histories kept in a ring buffer
+		dim_stim = 3
+		spike_history = 4
+		num_trials = 3
+
+		def sample(stimuli, model, preconditioner=None):
+			spike_trains = zeros([num_trials, stimuli.shape[1]])
+
+			for t in range(spike_history, stimuli.shape[1]):
+				history = spike_trains[:, t - spike_history:t].T
+
+				if preconditioner is not None:
+					history = preconditioner(history)
+
+				input = vstack([repeat(stimuli[:, [t]], num_trials, 1), history])
+
+				spike_trains[:, t] = model.sample(input)
+
+			return spike_trains
+
+		stimuli = randn(dim_stim, 200)
+
+		pre_affine = AffineTransform(randn(spike_history, 1), randn(2, spike_history))
+		pre_whitening = WhiteningPreconditioner(
+			rand(spike_history, 1000) < .3, rand(1, 1000) < .3)
+
+		for preconditioner in [None, pre_affine, pre_whitening]:
+			dim_in_pre = spike_history if preconditioner is None else preconditioner.dim_in_pre
+
+			mcbm = MCBM(dim_stim + dim_in_pre, 4)
+			mcbm._set_parameters(randn(*mcbm._parameters().shape))
+
+			seed(7)
+			if preconditioner is None:
+				spike_trains = sample_spike_train(stimuli, mcbm, spike_history, num_trials=num_trials)
+			else:
+				spike_trains = sample_spike_train(
+					stimuli, mcbm, spike_history, preconditioner, num_trials=num_trials)
+
+			seed(7)
+			self.assertEqual(spike_trains.shape, (num_trials, stimuli.shape[1]))
+			self.assertLess(max(abs(spike_trains - sample(stimuli, mcbm, preconditioner))), 1e-8)
+			self.assertGreater(spike_trains.sum(), 0)
+
 
 
 	def test_generate_maks(self):
@@ -3,11 +3,30 @@ import unittest
 
 from pickle import dump, load
 from tempfile import mkstemp
-from numpy import log, mean, max, abs, var, histogram, empty, arange
+from threading import Thread
+from numpy import log, mean, max, abs, var, histogram, empty, arange, bincount, hstack, isinf, all
 from numpy.random import randn, rand, randint
 from cmt.models import Bernoulli, Poisson, Binomial
+from cmt.utils import seed
 from scipy import stats
 
+def chisquare(samples, dist, T):
+	"""
+	Pearson's chi-squared test of integer samples, where values in the tails of the
+	distribution are grouped so that every bin has a reasonable number of expected counts.
+	"""
+
+	lo = int(dist.ppf(.001))
+	hi = int(dist.ppf(.999))
+
+	samples = samples.ravel().astype(int)
+	counts = bincount(samples.clip(lo - 1, hi + 1) - lo + 1, minlength=hi - lo + 3)
+
+	f_exp = hstack([dist.cdf(lo - 1), dist.pmf(arange(lo, hi + 1)), dist.sf(hi)]) * T
+
+	# tails might be empty
+	return stats.chisquare(counts[f_exp > 0.], f_exp[f_exp > 0.])[1]
+
 class Tests(unittest.TestCase):
 	def test_bernoulli(self):
 		bernoulli = Bernoulli(.725)
@@ -59,6 +78,17 @@ class Tests(unittest.TestCase):
 
 
 
+	def test_poisson_sample_large(self):
+		T = 10000
+
+		# both sides of the threshold between samplers and very large rates
+		for l in [9.5, 10., 42.3, 1000., 123456.7]:
+			samples = Poisson(l).sample(T)
+
+			self.assertGreater(chisquare(samples, stats.poisson(l), T), 0.00001)
+
+
+
 	def test_poisson_loglikelihood(self):
 		l = 4.2
 
@@ -73,6 +103,21 @@ class Tests(unittest.TestCase):
 
 
 
+	def test_poisson_loglikelihood_large(self):
+		l = 1234.5
+
+		poisson = Poisson(l)
+
+		# counts which are looked up in a table and counts which are not
+		samples = arange(3000).reshape(1, -1)
+
+		loglik0 = stats.poisson.logpmf(samples, l)
+		loglik1 = poisson.loglikelihood(samples)
+
+		self.assertLess(max(abs(loglik0 - loglik1)), 1e-8)
+
+
+
 	def test_poisson_pickle(self):
 		tmp_file = mkstemp()[1]
 
@@ -106,6 +151,43 @@ class Tests(unittest.TestCase):
 
 
 
+	def test_binomial_sample_large(self):
+		T = 10000
+
+		for n, p in [(1000, .005), (1000, .3), (200, .97), (5000, .6), (100000, .5)]:
+			samples = Binomial(n, p).sample(T)
+
+			self.assertGreater(chisquare(samples, stats.binom(n, p), T), 0.00001)
+
+
+
+	def test_seed(self):
+		# generators are reused across calls but are reseeded by seed()
+		for dist in [Poisson(42.3), Binomial(1000, .3)]:
+			seed(7)
+			samples0 = dist.sample(1000)
+			samples1 = dist.sample(1000)
+
+			seed(7)
+			self.assertTrue(all(samples0 == dist.sample(1000)))
+			self.assertTrue(all(samples1 == dist.sample(1000)))
+			self.assertFalse(all(samples0 == samples1))
+
+		# threads outside of OpenMP teams have generators of their own
+		def sample(samples):
+			seed(7)
+			samples.append(Poisson(42.3).sample(1000))
+
+		samples = []
+		for _ in range(2):
+			thread = Thread(target=sample, args=(samples,))
+			thread.start()
+			thread.join()
+
+		self.assertFalse(all(samples[0] == samples[1]))
+
+
+
 	def test_binomial_loglikelihood(self):
 		n = 17
 		p = .9
@@ -121,6 +203,27 @@ class Tests(unittest.TestCase):
 
 
 
+	def test_binomial_loglikelihood_large(self):
+		n = 2000
+		p = .3
+
+		binomial = Binomial(n, p)
+
+		samples = arange(-1, n + 2).reshape(1, -1)
+
+		loglik0 = stats.binom.logpmf(samples, n, p)
+		loglik1 = binomial.loglikelihood(samples)
+
+		# data outside of the support should have zero probability
+		self.assertTrue(all(isinf(loglik1[0, [0, -1]])))
+		self.assertLess(max(abs(loglik0[0, 1:-1] - loglik1[0, 1:-1])), 1e-8)
+
+		# edge cases of the probability
+		self.assertLess(abs(Binomial(n, 0.).loglikelihood([[0]])[0, 0]), 1e-8)
+		self.assertLess(abs(Binomial(n, 1.).loglikelihood([[n]])[0, 0]), 1e-8)
+
+
+
 	def test_binomial_pickle(self):
 		tmp_file = mkstemp()[1]
 
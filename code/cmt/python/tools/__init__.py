@@ -1,5 +1,6 @@
 __all__ = [
 	"generate_data_from_image",
+	"generate_binary_data_from_image",
 	"generate_data_from_video",
 	"density_gradient",
 	"sample_image",
@@ -9,6 +10,8 @@ __all__ = [
 	"fill_in_image",
 	"fill_in_image_map",
 	"extract_windows",
+	"WindowedTimeSeries",
+	"BinaryMatrix",
 	"sample_spike_train",
 	"generate_masks",
 	"rgb2gray",
@@ -21,6 +24,7 @@ __all__ = [
 	"generate_data_from_spike_train"]
 
 from _cmt import generate_data_from_image
+from _cmt import generate_binary_data_from_image
 from _cmt import generate_data_from_video
 from _cmt import density_gradient
 from _cmt import sample_image
@@ -30,6 +34,8 @@ from _cmt import sample_video
 from _cmt import fill_in_image
 from _cmt import fill_in_image_map
 from _cmt import extract_windows
+from _cmt import WindowedTimeSeries
+from _cmt import BinaryMatrix
 from _cmt import sample_spike_train
 from .masks import generate_masks
 from .colors import rgb2gray, rgb2ycc, ycc2rgb, YCbCr
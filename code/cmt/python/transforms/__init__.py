@@ -15,6 +15,6 @@ from _cmt import BinningTransform
 from _cmt import PCAPreconditioner
 from _cmt import PCATransform
 from _cmt import Preconditioner
-from .stackedaffinetransform import StackedAffineTransform
+from _cmt import StackedAffineTransform
 from _cmt import WhiteningPreconditioner
 from _cmt import WhiteningTransform
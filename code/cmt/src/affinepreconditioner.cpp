@@ -7,6 +7,8 @@
 using Eigen::Dynamic;
 using Eigen::Array;
 using Eigen::ArrayXXd;
+using Eigen::MatrixXd;
+using Eigen::Ref;
 
 #include <utility>
 using std::pair;
@@ -109,6 +111,18 @@ int CMT::AffinePreconditioner::dimOutPre() const {
 
 
 
+MatrixXd CMT::AffinePreconditioner::preIn() const {
+	return mPreIn;
+}
+
+
+
+MatrixXd CMT::AffinePreconditioner::preInInv() const {
+	return mPreInInv;
+}
+
+
+
 pair<ArrayXXd, ArrayXXd> CMT::AffinePreconditioner::operator()(
 	const ArrayXXd& input,
 	const ArrayXXd& output) const
@@ -174,6 +188,93 @@ ArrayXXd CMT::AffinePreconditioner::inverse(const ArrayXXd& input) const {
 
 
 
+void CMT::AffinePreconditioner::transform(
+	const Ref<const MatrixXd>& input,
+	Ref<MatrixXd> inputPre) const
+{
+	if(input.rows() != dimIn())
+		throw Exception("Input has wrong dimensionality."); 
+	if(inputPre.rows() != dimInPre() || inputPre.cols() != input.cols())
+		throw Exception("Buffer for preconditioned input has wrong size.");
+	if(input.rows() < 1 || input.cols() < 1)
+		return;
+
+	if(overlap(input, inputPre)) {
+		// writing directly would overwrite inputs which are still needed
+		MatrixXd inputPreTmp(inputPre.rows(), inputPre.cols());
+		AffinePreconditioner::transform(input, inputPreTmp);
+		inputPre = inputPreTmp;
+		return;
+	}
+
+	// the offset is the same for every column, so compute it only once
+	inputPre.col(0).noalias() = -mPreIn * mMeanIn;
+	for(int i = 1; i < inputPre.cols(); ++i)
+		inputPre.col(i) = inputPre.col(0);
+	inputPre.noalias() += mPreIn * input;
+}
+
+
+
+void CMT::AffinePreconditioner::transform(
+	const Ref<const MatrixXd>& input,
+	const Ref<const MatrixXd>& output,
+	Ref<MatrixXd> inputPre,
+	Ref<MatrixXd> outputPre) const
+{
+	if(input.cols() != output.cols())
+		throw Exception("Number of inputs and outputs must be the same."); 
+	if(output.rows() != dimOut())
+		throw Exception("Output has wrong dimensionality."); 
+	if(outputPre.rows() != dimOutPre() || outputPre.cols() != output.cols())
+		throw Exception("Buffer for preconditioned output has wrong size.");
+	if(overlap(inputPre, outputPre))
+		throw Exception("Buffers for preconditioned inputs and outputs must not overlap.");
+
+	// residual of the linear prediction of the outputs, computed before any
+	// buffer is written since the buffers may share memory with the outputs
+	MatrixXd residual = output.colwise() - mMeanOut;
+
+	transform(input, inputPre);
+
+	if(input.rows() > 0)
+		residual.noalias() -= mPredictor * inputPre;
+
+	outputPre.noalias() = mPreOut * residual;
+}
+
+
+
+void CMT::AffinePreconditioner::inverseTransform(
+	const Ref<const MatrixXd>& inputPre,
+	const Ref<const MatrixXd>& outputPre,
+	Ref<MatrixXd> output) const
+{
+	if(inputPre.cols() != outputPre.cols())
+		throw Exception("Number of inputs and outputs must be the same."); 
+	if(inputPre.rows() != dimInPre())
+		throw Exception("Input has wrong dimensionality."); 
+	if(outputPre.rows() != dimOutPre())
+		throw Exception("Output has wrong dimensionality."); 
+	if(output.rows() != dimOut() || output.cols() != outputPre.cols())
+		throw Exception("Buffer for output has wrong size.");
+
+	if(overlap(output, inputPre) || overlap(output, outputPre)) {
+		// writing directly would overwrite data which is still needed
+		MatrixXd outputTmp(output.rows(), output.cols());
+		AffinePreconditioner::inverseTransform(inputPre, outputPre, outputTmp);
+		output = outputTmp;
+		return;
+	}
+
+	output.noalias() = mPreOutInv * outputPre;
+	if(inputPre.rows() > 0)
+		output.noalias() += mPredictor * inputPre;
+	output.colwise() += mMeanOut;
+}
+
+
+
 Array<double, 1, Dynamic> CMT::AffinePreconditioner::logJacobian(const ArrayXXd& input, const ArrayXXd& output) const {
 	return Array<double, 1, Dynamic>::Zero(output.cols()) + mLogJacobian;
 }
@@ -5,6 +5,8 @@
 
 #include "Eigen/Core"
 using Eigen::ArrayXXd;
+using Eigen::MatrixXd;
+using Eigen::Ref;
 
 #include <utility>
 using std::pair;
@@ -62,7 +64,7 @@ pair<ArrayXXd, ArrayXXd> CMT::AffineTransform::operator()(
 	const ArrayXXd& input,
 	const ArrayXXd& output) const
 {
-	return make_pair(AffinePreconditioner::operator()(input), output);
+	return make_pair(operator()(input), output);
 }
 
 
@@ -71,7 +73,51 @@ pair<ArrayXXd, ArrayXXd> CMT::AffineTransform::inverse(
 	const ArrayXXd& input,
 	const ArrayXXd& output) const
 {
-	return make_pair(AffinePreconditioner::inverse(input), output);
+	return make_pair(inverse(input), output);
+}
+
+
+
+void CMT::AffineTransform::transform(
+	const Ref<const MatrixXd>& input,
+	const Ref<const MatrixXd>& output,
+	Ref<MatrixXd> inputPre,
+	Ref<MatrixXd> outputPre) const
+{
+	if(outputPre.rows() != output.rows() || outputPre.cols() != output.cols())
+		throw Exception("Buffer for preconditioned output has wrong size.");
+	if(overlap(inputPre, outputPre))
+		throw Exception("Buffers for preconditioned inputs and outputs must not overlap.");
+
+	if(overlap(inputPre, output)) {
+		// copy outputs before they are overwritten by preconditioned inputs
+		MatrixXd outputTmp = output;
+		transform(input, inputPre);
+		outputPre = outputTmp;
+	} else {
+		transform(input, inputPre);
+
+		// outputs are passed through unchanged
+		if(overlap(output, outputPre))
+			outputPre = output.eval();
+		else
+			outputPre = output;
+	}
+}
+
+
+
+void CMT::AffineTransform::inverseTransform(
+	const Ref<const MatrixXd>& inputPre,
+	const Ref<const MatrixXd>& outputPre,
+	Ref<MatrixXd> output) const
+{
+	if(output.rows() != outputPre.rows() || output.cols() != outputPre.cols())
+		throw Exception("Buffer for output has wrong size.");
+	if(overlap(output, outputPre))
+		output = outputPre.eval();
+	else
+		output = outputPre;
 }
 
 
@@ -0,0 +1,208 @@
+#include "binarymatrix.h"
+
+#include <algorithm>
+using std::min;
+
+#include "Eigen/Core"
+using Eigen::Array;
+using Eigen::Dynamic;
+using Eigen::MatrixXd;
+using Eigen::VectorXd;
+
+CMT::BinaryMatrix::BinaryMatrix(int rows, int cols) :
+	mRows(rows),
+	mCols(cols),
+	mNumWords((rows + 63) / 64),
+	mWords(mNumWords * cols, 0)
+{
+}
+
+
+
+CMT::BinaryMatrix::BinaryMatrix(const MatrixXd& matrix) :
+	mRows(matrix.rows()),
+	mCols(matrix.cols()),
+	mNumWords((matrix.rows() + 63) / 64),
+	mWords(mNumWords * matrix.cols(), 0)
+{
+	if(!isBinary(matrix))
+		throw Exception("Matrix should only contain zeros and ones.");
+
+	#pragma omp parallel for
+	for(int j = 0; j < mCols; ++j) {
+		const double* data = matrix.data() + j * mRows;
+
+		// assemble words in registers to avoid repeated memory access
+		for(int k = 0; k < mNumWords; ++k) {
+			int numBits = min(64, mRows - 64 * k);
+			Word word = 0;
+			for(int i = 0; i < numBits; ++i)
+				word |= static_cast<Word>(data[64 * k + i] > 0.) << i;
+			mWords[j * mNumWords + k] = word;
+		}
+	}
+}
+
+
+
+CMT::BinaryMatrix CMT::BinaryMatrix::middleCols(int j, int n) const {
+	if(j < 0 || n < 0 || j + n > mCols)
+		throw Exception("Invalid column range.");
+
+	BinaryMatrix matrix(mRows, n);
+
+	for(int k = 0; k < n * mNumWords; ++k)
+		matrix.mWords[k] = mWords[j * mNumWords + k];
+
+	return matrix;
+}
+
+
+
+MatrixXd CMT::BinaryMatrix::toDense() const {
+	MatrixXd matrix(mRows, mCols);
+
+	for(int j = 0; j < mCols; ++j)
+		for(int i = 0; i < mRows; ++i)
+			matrix(i, j) = (*this)(i, j);
+
+	return matrix;
+}
+
+
+
+Array<int, 1, Dynamic> CMT::BinaryMatrix::colSum() const {
+	Array<int, 1, Dynamic> sum = Array<int, 1, Dynamic>::Zero(mCols);
+
+	for(int j = 0; j < mCols; ++j)
+		for(int k = 0; k < mNumWords; ++k)
+			sum[j] += __builtin_popcountll(mWords[j * mNumWords + k]);
+
+	return sum;
+}
+
+
+
+/**
+ * Computes the product of a dense matrix with this binary matrix.
+ *
+ * Each column of the result is a sum over columns of the dense matrix. If a
+ * column contains more ones than zeros, the columns corresponding to zeros are
+ * subtracted from the sum over all columns instead.
+ */
+MatrixXd CMT::BinaryMatrix::leftProduct(const MatrixXd& lhs) const {
+	if(lhs.cols() != mRows)
+		throw Exception("Matrix dimensions do not match.");
+
+	int m = lhs.rows();
+
+	MatrixXd result(m, mCols);
+	VectorXd lhsSum = lhs.rowwise().sum();
+
+	// mask for the bits of the last word which are in use
+	Word lastMask = mRows % 64 ? (static_cast<Word>(1) << (mRows % 64)) - 1 : ~static_cast<Word>(0);
+
+	#pragma omp parallel for
+	for(int j = 0; j < mCols; ++j) {
+		const Word* words = col(j);
+		double* r = result.data() + j * m;
+
+		int numOnes = 0;
+		for(int k = 0; k < mNumWords; ++k)
+			numOnes += __builtin_popcountll(words[k]);
+
+		if(2 * numOnes <= mRows) {
+			for(int i = 0; i < m; ++i)
+				r[i] = 0.;
+
+			for(int k = 0; k < mNumWords; ++k)
+				for(Word word = words[k]; word; word &= word - 1) {
+					const double* c = lhs.data() + (k * 64 + __builtin_ctzll(word)) * m;
+					for(int i = 0; i < m; ++i)
+						r[i] += c[i];
+				}
+		} else {
+			for(int i = 0; i < m; ++i)
+				r[i] = lhsSum[i];
+
+			for(int k = 0; k < mNumWords; ++k) {
+				Word word = ~words[k];
+				if(k == mNumWords - 1)
+					word &= lastMask;
+
+				for(; word; word &= word - 1) {
+					const double* c = lhs.data() + (k * 64 + __builtin_ctzll(word)) * m;
+					for(int i = 0; i < m; ++i)
+						r[i] -= c[i];
+				}
+			}
+		}
+	}
+
+	return result;
+}
+
+
+
+/**
+ * Computes the product of a dense matrix with the transpose of this binary matrix.
+ */
+MatrixXd CMT::BinaryMatrix::leftProductTranspose(const MatrixXd& lhs) const {
+	if(lhs.cols() != mCols)
+		throw Exception("Matrix dimensions do not match.");
+
+	int m = lhs.rows();
+
+	MatrixXd result = MatrixXd::Zero(m, mRows);
+	VectorXd lhsSum = VectorXd::Zero(m);
+
+	Word lastMask = mRows % 64 ? (static_cast<Word>(1) << (mRows % 64)) - 1 : ~static_cast<Word>(0);
+
+	for(int j = 0; j < mCols; ++j) {
+		const Word* words = col(j);
+		const double* c = lhs.data() + j * m;
+
+		int numOnes = 0;
+		for(int k = 0; k < mNumWords; ++k)
+			numOnes += __builtin_popcountll(words[k]);
+
+		if(2 * numOnes <= mRows) {
+			for(int k = 0; k < mNumWords; ++k)
+				for(Word word = words[k]; word; word &= word - 1) {
+					double* r = result.data() + (k * 64 + __builtin_ctzll(word)) * m;
+					for(int i = 0; i < m; ++i)
+						r[i] += c[i];
+				}
+		} else {
+			for(int i = 0; i < m; ++i)
+				lhsSum[i] += c[i];
+
+			for(int k = 0; k < mNumWords; ++k) {
+				Word word = ~words[k];
+				if(k == mNumWords - 1)
+					word &= lastMask;
+
+				for(; word; word &= word - 1) {
+					double* r = result.data() + (k * 64 + __builtin_ctzll(word)) * m;
+					for(int i = 0; i < m; ++i)
+						r[i] -= c[i];
+				}
+			}
+		}
+	}
+
+	result.colwise() += lhsSum;
+
+	return result;
+}
+
+
+
+bool CMT::BinaryMatrix::isBinary(const MatrixXd& matrix) {
+	const double* data = matrix.data();
+
+	for(int i = 0; i < matrix.size(); ++i)
+		if(data[i] != 0. && data[i] != 1.)
+			return false;
+	return true;
+}
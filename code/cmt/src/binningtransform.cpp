@@ -2,19 +2,126 @@
 #include "exception.h"
 #include "utils.h"
 
-CMT::BinningTransform::BinningTransform(int binning, int dimIn, int dimOut) :
-	AffineTransform(
-		VectorXd::Zero(dimIn),
-		MatrixXd::Zero(dimIn / binning, dimIn),
-		dimOut),
-	mBinning(binning)
-{
-	if(dimIn % binning)
+#include "Eigen/Core"
+using Eigen::ArrayXXd;
+using Eigen::MatrixXd;
+using Eigen::VectorXd;
+using Eigen::RowVectorXd;
+using Eigen::Map;
+using Eigen::Ref;
+
+#include <utility>
+using std::pair;
+using std::make_pair;
+
+/**
+ * The binning matrix is never stored, since it is mostly zero.
+ */
+CMT::BinningTransform::BinningTransform(int binning, int dimIn, int dimOut) : mBinning(binning) {
+	if(binning < 1 || dimIn % binning)
 		throw Exception("Input dimensionality has to be a multiple of binning width.");
 
-	for(int i = 0, j = 0; i < mPreIn.rows(); ++i)
-		for(int k = 0; k < binning; ++k, ++j)
-			mPreIn(i, j) = 1.;
+	mMeanIn = VectorXd::Zero(dimIn);
+	mMeanOut = VectorXd::Zero(dimOut);
+	mPreOut = MatrixXd::Identity(dimOut, dimOut);
+	mPreOutInv = MatrixXd::Identity(dimOut, dimOut);
+	mPredictor = MatrixXd::Zero(dimOut, dimIn / binning);
+	mGradTransform = MatrixXd::Zero(dimOut, dimIn);
+	mLogJacobian = 0.;
+}
+
+
+
+int CMT::BinningTransform::dimInPre() const {
+	return dimIn() / mBinning;
+}
+
+
+
+/**
+ * Builds the binning matrix, which sums neighboring dimensions.
+ */
+MatrixXd CMT::BinningTransform::preIn() const {
+	MatrixXd preIn = MatrixXd::Zero(dimInPre(), dimIn());
+
+	for(int i = 0; i < preIn.rows(); ++i)
+		preIn.row(i).segment(i * mBinning, mBinning).setOnes();
+
+	return preIn;
+}
+
+
+
+/**
+ * Since the rows of the binning matrix are orthogonal, its pseudoinverse is
+ * given by its scaled transpose.
+ */
+MatrixXd CMT::BinningTransform::preInInv() const {
+	return preIn().transpose() / mBinning;
+}
+
+
+
+ArrayXXd CMT::BinningTransform::operator()(const ArrayXXd& input) const {
+	ArrayXXd inputTr(dimInPre(), input.cols());
+	transform(input.matrix(), inputTr.matrix());
+	return inputTr;
+}
+
+
+
+/**
+ * Distributes each bin evenly across the dimensions it was summed over, which
+ * corresponds to applying the pseudoinverse of the binning matrix.
+ */
+ArrayXXd CMT::BinningTransform::inverse(const ArrayXXd& input) const {
+	if(input.rows() != dimInPre())
+		throw Exception("Input has wrong dimensionality.");
+
+	ArrayXXd inputTr(dimIn(), input.cols());
+
+	// each column of the mapped matrix corresponds to one bin
+	Map<MatrixXd>(inputTr.data(), mBinning, input.size()) =
+		(Map<const RowVectorXd>(input.data(), input.size()) / mBinning).replicate(mBinning, 1);
+
+	return inputTr;
+}
+
+
+
+/**
+ * Sums neighboring dimensions instead of multiplying with the (mostly zero)
+ * binning matrix. Each column of the input is viewed as a matrix whose columns
+ * are bins, so that the input is only read once.
+ */
+void CMT::BinningTransform::transform(
+	const Ref<const MatrixXd>& input,
+	Ref<MatrixXd> inputPre) const
+{
+	if(input.rows() != dimIn())
+		throw Exception("Input has wrong dimensionality.");
+	if(inputPre.rows() != dimInPre() || inputPre.cols() != input.cols())
+		throw Exception("Buffer for preconditioned input has wrong size.");
+
+	for(int j = 0; j < input.cols(); ++j)
+		inputPre.col(j) = Map<const MatrixXd>(
+			input.col(j).data(), mBinning, inputPre.rows()).colwise().sum().transpose();
+}
+
+
+
+pair<ArrayXXd, ArrayXXd> CMT::BinningTransform::adjustGradient(
+	const ArrayXXd& inputGradient,
+	const ArrayXXd& outputGradient) const
+{
+	if(inputGradient.rows() != dimInPre())
+		throw Exception("Gradient has wrong dimensionality.");
+
+	// each input dimension receives the gradient of its bin
+	ArrayXXd inputGradientTr(dimIn(), inputGradient.cols());
+
+	Map<MatrixXd>(inputGradientTr.data(), mBinning, inputGradient.size()) =
+		Map<const RowVectorXd>(inputGradient.data(), inputGradient.size()).replicate(mBinning, 1);
 
-	mPreInInv = pInverse(mPreIn);
+	return make_pair(inputGradientTr, outputGradient);
 }
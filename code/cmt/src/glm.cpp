@@ -7,24 +7,42 @@ using CMT::GLM;
 #include "nonlinearities.h"
 using CMT::Nonlinearity;
 using CMT::LogisticFunction;
+using CMT::ExponentialFunction;
+using CMT::HistogramNonlinearity;
 
 #include "univariatedistributions.h"
 using CMT::UnivariateDistribution;
 using CMT::Bernoulli;
+using CMT::Poisson;
 
 #include <cmath>
 using std::log;
 using std::min;
+using std::max;
 
 #include <map>
 using std::pair;
 using std::make_pair;
 
+#include <vector>
+using std::vector;
+
+#include <string>
+using std::string;
+
+#include "Eigen/Cholesky"
+using Eigen::LLT;
+using Eigen::Lower;
+using Eigen::Success;
+
 #include "Eigen/Core"
 using Eigen::Dynamic;
 using Eigen::Array;
 using Eigen::ArrayXXd;
+using Eigen::ArrayXXi;
 using Eigen::MatrixXd;
+using Eigen::RowVectorXd;
+using Eigen::Ref;
 
 Nonlinearity* const GLM::defaultNonlinearity = new LogisticFunction;
 UnivariateDistribution* const GLM::defaultDistribution = new Bernoulli;
@@ -33,7 +51,8 @@ CMT::GLM::Parameters::Parameters() :
 	Trainable::Parameters(),
 	trainWeights(true),
 	trainBias(true),
-	trainNonlinearity(false)
+	trainNonlinearity(false),
+	newton(false)
 {
 }
 
@@ -44,6 +63,7 @@ CMT::GLM::Parameters::Parameters(const Parameters& params) :
 	trainWeights(params.trainWeights),
 	trainBias(params.trainBias),
 	trainNonlinearity(params.trainNonlinearity),
+	newton(params.newton),
 	regularizeWeights(params.regularizeWeights),
 	regularizeBias(params.regularizeBias)
 {
@@ -57,6 +77,7 @@ CMT::GLM::Parameters& CMT::GLM::Parameters::operator=(const Parameters& params)
 	trainWeights = params.trainWeights;
 	trainBias = params.trainBias;
 	trainNonlinearity = params.trainNonlinearity;
+	newton = params.newton;
 	regularizeWeights = params.regularizeWeights;
 	regularizeBias = params.regularizeBias;
 
@@ -101,6 +122,19 @@ CMT::GLM::~GLM() {
 
 
 
+/**
+ * Nonlinearity and distribution are shared with the copy. Since the parameters
+ * of a trainable nonlinearity may change during training, no copy is created
+ * in that case.
+ */
+CMT::Trainable* CMT::GLM::copy() const {
+	if(dynamic_cast<TrainableNonlinearity*>(mNonlinearity))
+		return 0;
+	return new GLM(*this);
+}
+
+
+
 Array<double, 1, Dynamic> CMT::GLM::logLikelihood(
 	const MatrixXd& input,
 	const MatrixXd& output) const
@@ -120,6 +154,38 @@ Array<double, 1, Dynamic> CMT::GLM::logLikelihood(
 
 
 
+Array<double, 1, Dynamic> CMT::GLM::logLikelihood(
+	const SparseMatrixXd& input,
+	const MatrixXd& output) const
+{
+	if(input.rows() != mDimIn)
+		throw Exception("Input has wrong dimensionality.");
+	if(input.cols() != output.cols())
+		throw Exception("The number of inputs and outputs must be the same.");
+
+	RowVectorXd responses = mWeights.transpose() * input;
+
+	return mDistribution->logLikelihood(output, (*mNonlinearity)(responses.array() + mBias));
+}
+
+
+
+Array<double, 1, Dynamic> CMT::GLM::logLikelihood(
+	const WindowedTimeSeries& input,
+	const MatrixXd& output) const
+{
+	if(input.rows() != mDimIn)
+		throw Exception("Input has wrong dimensionality.");
+	if(input.cols() != output.cols())
+		throw Exception("The number of inputs and outputs must be the same.");
+
+	RowVectorXd responses = input.leftProduct(mWeights.transpose());
+
+	return mDistribution->logLikelihood(output, (*mNonlinearity)(responses.array() + mBias));
+}
+
+
+
 MatrixXd CMT::GLM::sample(const MatrixXd& input) const {
 	if(input.rows() != mDimIn)
 		throw Exception("Input has wrong dimensionality.");
@@ -144,6 +210,28 @@ MatrixXd CMT::GLM::predict(const MatrixXd& input) const {
 
 
 
+MatrixXd CMT::GLM::sample(const SparseMatrixXd& input) const {
+	if(input.rows() != mDimIn)
+		throw Exception("Input has wrong dimensionality.");
+
+	RowVectorXd responses = mWeights.transpose() * input;
+
+	return mDistribution->sample((*mNonlinearity)(responses.array() + mBias));
+}
+
+
+
+MatrixXd CMT::GLM::predict(const SparseMatrixXd& input) const {
+	if(input.rows() != mDimIn)
+		throw Exception("Input has wrong dimensionality.");
+
+	RowVectorXd responses = mWeights.transpose() * input;
+
+	return (*mNonlinearity)(responses.array() + mBias);
+}
+
+
+
 int CMT::GLM::numParameters(const Trainable::Parameters& params_) const {
 	const Parameters& params = dynamic_cast<const Parameters&>(params_);
 	
@@ -227,8 +315,169 @@ void CMT::GLM::setParameters(
 
 
 
+vector<pair<string, int> > CMT::GLM::parameterBlocks(const Trainable::Parameters& params_) const {
+	const Parameters& params = dynamic_cast<const Parameters&>(params_);
+
+	vector<pair<string, int> > blocks;
+
+	if(params.trainWeights)
+		blocks.push_back(make_pair(string("weights"), mDimIn));
+	if(params.trainBias)
+		blocks.push_back(make_pair(string("bias"), 1));
+	if(params.trainNonlinearity) {
+		TrainableNonlinearity* nonlinearity =
+			dynamic_cast<TrainableNonlinearity*>(mNonlinearity);
+		if(!nonlinearity)
+			throw Exception("Nonlinearity has to be trainable.");
+		blocks.push_back(make_pair(string("nonlinearity"), nonlinearity->numParameters()));
+	}
+
+	return blocks;
+}
+
+
+
+double CMT::GLM::parameterGradient(
+	const MatrixXd& input,
+	const MatrixXd& output,
+	const lbfgsfloatval_t* x,
+	lbfgsfloatval_t* g,
+	const Trainable::Parameters& params) const
+{
+	return computeParameterGradient(input, 0, 0, output, x, g, params);
+}
+
+
+
+double CMT::GLM::parameterGradient(
+	const MatrixXd& inputDense,
+	const SparseMatrixXd& inputSparse,
+	const MatrixXd& output,
+	const lbfgsfloatval_t* x,
+	lbfgsfloatval_t* g,
+	const Trainable::Parameters& params) const
+{
+	if(inputDense.rows() + inputSparse.rows() != mDimIn)
+		throw Exception("Input has wrong dimensionality.");
+	if(inputDense.cols() != inputSparse.cols())
+		throw Exception("Number of dense and sparse inputs must be the same.");
+
+	return computeParameterGradient(inputDense, &inputSparse, 0, output, x, g, params);
+}
+
+
+
 double CMT::GLM::parameterGradient(
+	const MatrixXd& inputDense,
+	const WindowedTimeSeries& inputWindows,
+	const MatrixXd& output,
+	const lbfgsfloatval_t* x,
+	lbfgsfloatval_t* g,
+	const Trainable::Parameters& params) const
+{
+	if(inputDense.rows() + inputWindows.rows() != mDimIn)
+		throw Exception("Input has wrong dimensionality.");
+	if(inputDense.cols() != inputWindows.cols())
+		throw Exception("Number of dense inputs and windows must be the same.");
+
+	return computeParameterGradient(inputDense, 0, &inputWindows, output, x, g, params);
+}
+
+
+
+MatrixXd CMT::GLM::perExampleGradients(
+	const MatrixXd& input,
+	const MatrixXd& output,
+	const Trainable::Parameters& params_) const
+{
+	const Parameters& params = dynamic_cast<const Parameters&>(params_);
+
+	// check if nonlinearity is trainable and/or differentiable
+	TrainableNonlinearity* trainableNonlinearity =
+		dynamic_cast<TrainableNonlinearity*>(mNonlinearity);
+	DifferentiableNonlinearity* differentiableNonlinearity =
+		dynamic_cast<DifferentiableNonlinearity*>(mNonlinearity);
+
+	if((params.trainWeights || params.trainBias) && !differentiableNonlinearity)
+		throw Exception("Nonlinearity has to be differentiable.");
+	if(params.trainNonlinearity && !trainableNonlinearity)
+		throw Exception("Nonlinearity is not trainable.");
+
+	if(input.rows() != mDimIn || output.rows() != 1)
+		throw Exception("Data has wrong dimensionality.");
+	if(input.cols() != output.cols())
+		throw Exception("The number of inputs and outputs should be the same.");
+
+	int numData = static_cast<int>(output.cols());
+	int batchSize = max(min(params.batchSize, numData), 1);
+
+	MatrixXd gradients(numParameters(params), numData);
+
+	#pragma omp parallel for
+	for(int b = 0; b < numData; b += batchSize) {
+		int width = min(batchSize, numData - b);
+		const Ref<const MatrixXd> inputBatch = input.middleCols(b, width);
+		const Ref<const MatrixXd> outputBatch = output.middleCols(b, width);
+
+		Array<double, 1, Dynamic> responses = (mWeights.transpose() * inputBatch).array() + mBias;
+
+		// derivatives of negative log-likelihood with respect to means and responses
+		Array<double, 1, Dynamic> tmp1;
+		Array<double, 1, Dynamic> tmp3;
+
+		if(params.trainNonlinearity) {
+			tmp1 = mDistribution->gradient(outputBatch, (*mNonlinearity)(responses));
+			if(params.trainWeights || params.trainBias)
+				tmp3 = tmp1 * differentiableNonlinearity->derivative(responses);
+		} else if(params.trainWeights || params.trainBias) {
+			mDistribution->logKernel(outputBatch, responses, *mNonlinearity, &tmp3);
+		}
+
+		int offset = 0;
+
+		if(params.trainWeights) {
+			gradients.block(offset, b, mDimIn, width) = inputBatch.array().rowwise() * tmp3;
+			offset += mDimIn;
+		}
+
+		if(params.trainBias) {
+			gradients.block(offset, b, 1, width) = tmp3.matrix();
+			offset += 1;
+		}
+
+		if(params.trainNonlinearity)
+			gradients.block(offset, b, trainableNonlinearity->numParameters(), width) =
+				(trainableNonlinearity->gradient(responses).rowwise() * tmp1).matrix();
+	}
+
+	gradients /= log(2.);
+
+	// gradients of regularizers are the same for all data points
+	VectorXd regularization = VectorXd::Zero(gradients.rows());
+
+	if(params.trainWeights)
+		regularization.head(mDimIn) = params.regularizeWeights.gradient(mWeights);
+	if(params.trainBias)
+		regularization[params.trainWeights ? mDimIn : 0] =
+			params.regularizeBias.gradient(MatrixXd::Constant(1, 1, mBias))(0, 0);
+
+	gradients.colwise() += regularization;
+
+	return gradients;
+}
+
+
+
+/**
+ * Computes the gradient for inputs which are given by a dense part stacked on
+ * top of an optional sparse part or optional windows of time series. Only the
+ * non-zero entries of the sparse part contribute to the cost of computing
+ * responses and weight gradients, and windows are never stored explicitly.
+ */
+double CMT::GLM::computeParameterGradient(
 	const MatrixXd& inputCompl,
+	const SparseMatrixXd* inputSparse,
+	const WindowedTimeSeries* inputWindows,
 	const MatrixXd& outputCompl,
 	const lbfgsfloatval_t* x,
 	lbfgsfloatval_t* g,
@@ -241,15 +490,21 @@ double CMT::GLM::parameterGradient(
 		dynamic_cast<TrainableNonlinearity*>(mNonlinearity);
 	DifferentiableNonlinearity* differentiableNonlinearity =
 		dynamic_cast<DifferentiableNonlinearity*>(mNonlinearity);
+	HistogramNonlinearity* histogramNonlinearity =
+		dynamic_cast<HistogramNonlinearity*>(mNonlinearity);
 
 	if((params.trainWeights || params.trainBias) && !differentiableNonlinearity)
 		throw Exception("Nonlinearity has to be differentiable.");
 	if(params.trainNonlinearity && !trainableNonlinearity)
 		throw Exception("Nonlinearity is not trainable.");
 
-	int numData = static_cast<int>(inputCompl.cols());
+	int numData = static_cast<int>(outputCompl.cols());
 	int batchSize = min(params.batchSize, numData);
 
+	// dimensionality of dense and sparse (or windowed) parts of the input
+	int dimDense = static_cast<int>(inputCompl.rows());
+	int dimSparse = mDimIn - dimDense;
+
 	lbfgsfloatval_t* y = const_cast<lbfgsfloatval_t*>(x);
 	int offset = 0;
 
@@ -272,66 +527,108 @@ double CMT::GLM::parameterGradient(
 		offset += trainableNonlinearity->numParameters();
 	}
 
-	// initialize gradient and log-likelihood
-	if(g) {
-		if(params.trainWeights)
-			weightsGrad.setZero();
-		if(params.trainBias)
-			*biasGrad = 0.;
-		if(params.trainNonlinearity)
-			nonlinearityGrad.setZero();
-	}
+	// thread-private gradients with the log-likelihood stored in the last entry
+	vector<VectorXd> partials(numThreads(), VectorXd::Zero(offset + 1));
+
+	#pragma omp parallel
+	{
+		VectorXd& partial = partials[threadID()];
+
+		// interpret thread-private memory in the same way as the gradient
+		VectorLBFGS weightsGrad(partial.data(), params.trainWeights ? mDimIn : 0);
+		double* biasGrad = partial.data() + weightsGrad.size();
+		VectorLBFGS nonlinearityGrad(biasGrad + params.trainBias,
+			params.trainNonlinearity ? trainableNonlinearity->numParameters() : 0);
+		double& logLik = partial[offset];
+
+		#pragma omp for schedule(static)
+		for(int b = 0; b < numData; b += batchSize) {
+			int width = min(batchSize, numData - b);
+			const Ref<const MatrixXd> input = inputCompl.middleCols(b, width);
+			const Ref<const MatrixXd> output = outputCompl.middleCols(b, width);
+
+			// linear responses
+			Array<double, 1, Dynamic> responses;
+
+			if(dimDense)
+				responses = (weights.head(dimDense).transpose() * input).array() + bias;
+			else
+				responses = Array<double, 1, Dynamic>::Constant(output.cols(), bias);
+
+			if(inputSparse && dimSparse) {
+				RowVectorXd responsesSparse = weights.tail(dimSparse).transpose() * inputSparse->middleCols(b, width);
+				responses += responsesSparse.array();
+			}
 
-	double logLik = 0.;
+			WindowedTimeSeries windows;
 
-	#pragma omp parallel for
-	for(int b = 0; b < inputCompl.cols(); b += batchSize) {
-		const MatrixXd& input = inputCompl.middleCols(b, min(batchSize, numData - b));
-		const MatrixXd& output = outputCompl.middleCols(b, min(batchSize, numData - b));
+			if(inputWindows && dimSparse) {
+				windows = inputWindows->middleCols(b, width);
+				RowVectorXd responsesWindows = windows.leftProduct(weights.tail(dimSparse).transpose());
+				responses += responsesWindows.array();
+			}
 
-		// linear responses
-		Array<double, 1, Dynamic> responses;
+			// derivative of negative log-likelihood with respect to responses
+			Array<double, 1, Dynamic> tmp3;
 
-		if(mDimIn)
-			responses = (weights.transpose() * input).array() + bias;
-		else
-			responses = Array<double, 1, Dynamic>::Constant(output.cols(), bias);
+			if(params.trainNonlinearity) {
+				ArrayXXi bins;
+
+				// nonlinear responses
+				Array<double, 1, Dynamic> means;
+
+				if(histogramNonlinearity) {
+					// bins are reused for the gradient
+					bins = histogramNonlinearity->bins(responses);
+					means = histogramNonlinearity->evaluate(bins);
+				} else {
+					means = mNonlinearity->operator()(responses);
+				}
+
+				if(g) {
+					// derivative of negative log-likelihood with respect to means
+					Array<double, 1, Dynamic> tmp1 = mDistribution->gradient(output, means);
 
-		// nonlinear responses
-		Array<double, 1, Dynamic> means = mNonlinearity->operator()(responses);
+					if(params.trainWeights || params.trainBias)
+						tmp3 = tmp1 * differentiableNonlinearity->derivative(responses);
 
-		if(g) {
-			Array<double, 1, Dynamic> tmp1 = mDistribution->gradient(output, means);
-			
-			if(params.trainWeights || params.trainBias) {
-				Array<double, 1, Dynamic> tmp2 = differentiableNonlinearity->derivative(responses);
-				Array<double, 1, Dynamic> tmp3 = tmp1 * tmp2;
+					if(histogramNonlinearity)
+						nonlinearityGrad += histogramNonlinearity->gradient(bins, tmp1).matrix();
+					else
+						nonlinearityGrad += (trainableNonlinearity->gradient(responses).rowwise() * tmp1).rowwise().sum().matrix();
+				}
 
+				logLik += mDistribution->logKernel(output, means).sum();
+			} else {
+				// lets the distribution skip the means for canonical nonlinearities
+				logLik += mDistribution->logKernel(output, responses, *mNonlinearity,
+					g && (params.trainWeights || params.trainBias) ? &tmp3 : 0).sum();
+			}
+
+			if(g && (params.trainWeights || params.trainBias)) {
 				// weights gradient
 				if(params.trainWeights && mDimIn) {
-					VectorXd weightsGrad_ = (input.array().rowwise() * tmp3).rowwise().sum();
-
-					#pragma omp critical
-					weightsGrad += weightsGrad_;
+					if(dimDense)
+						weightsGrad.head(dimDense) += (input.array().rowwise() * tmp3).rowwise().sum().matrix();
+					if(inputSparse && dimSparse)
+						weightsGrad.tail(dimSparse) += inputSparse->middleCols(b, width) * tmp3.transpose().matrix();
+					if(inputWindows && dimSparse)
+						weightsGrad.tail(dimSparse) += windows.leftProductTranspose(tmp3.matrix()).transpose();
 				}
 
 				// bias gradient
 				if(params.trainBias)
-					#pragma omp critical
 					*biasGrad += tmp3.sum();
 			}
+		}
+	}
 
-			if(params.trainNonlinearity) {
-				VectorXd nonlinearityGrad_ = (trainableNonlinearity->gradient(responses).rowwise() * tmp1).rowwise().sum();
+	reduceSum(partials);
 
-				#pragma omp critical
-				nonlinearityGrad += nonlinearityGrad_;
-			}
-		}
+	double logLik = partials[0][offset] + cachedLogBaseMeasure(outputCompl);
 
-		#pragma omp critical
-		logLik += mDistribution->logLikelihood(output, means).sum();
-	}
+	if(g)
+		VectorLBFGS(g, offset) = partials[0].head(offset);
 
 	double normConst = outputCompl.cols() * log(2.);
 
@@ -355,9 +652,126 @@ double CMT::GLM::parameterGradient(
 
 
 
-pair<pair<ArrayXXd, ArrayXXd>, Array<double, 1, Dynamic> > CMT::GLM::computeDataGradient(
+double CMT::GLM::logBaseMeasure(const MatrixXd& output) const {
+	return mDistribution->logBaseMeasure(output).sum();
+}
+
+
+
+bool CMT::GLM::train(
 	const MatrixXd& input,
-	const MatrixXd& output) const
+	const MatrixXd& output,
+	const MatrixXd* inputVal,
+	const MatrixXd* outputVal,
+	const Trainable::Parameters& params_)
+{
+	const Parameters& params = dynamic_cast<const Parameters&>(params_);
+
+	// Newton's method is only used for canonical link functions
+	bool canonical =
+		(dynamic_cast<LogisticFunction*>(mNonlinearity) && dynamic_cast<Bernoulli*>(mDistribution)) ||
+		(dynamic_cast<ExponentialFunction*>(mNonlinearity) && dynamic_cast<Poisson*>(mDistribution));
+
+	// L1 penalties are not twice differentiable
+	bool smooth =
+		!(params.trainWeights && params.regularizeWeights.norm() == Regularizer::L1
+			&& params.regularizeWeights.strength() > 0.) &&
+		!(params.trainBias && params.regularizeBias.norm() == Regularizer::L1
+			&& params.regularizeBias.strength() > 0.);
+
+	if(params.newton && canonical && smooth && !params.trainNonlinearity && !inputVal && !outputVal)
+		return trainNewton(input, output, params);
+
+	return Trainable::train(input, output, inputVal, outputVal, params);
+}
+
+
+
+/**
+ * Computes the Newton direction for canonical link functions, for which the
+ * Hessian of the negative log-likelihood is given by X W X^T with weights
+ * W = g'(w^T x + b). The Hessian is accumulated over batches of data.
+ */
+bool CMT::GLM::newtonDirection(
+	const MatrixXd& inputCompl,
+	const MatrixXd& outputCompl,
+	const lbfgsfloatval_t* x,
+	const lbfgsfloatval_t* g,
+	lbfgsfloatval_t* d,
+	const Trainable::Parameters& params_) const
+{
+	const Parameters& params = dynamic_cast<const Parameters&>(params_);
+
+	DifferentiableNonlinearity* nonlinearity =
+		dynamic_cast<DifferentiableNonlinearity*>(mNonlinearity);
+
+	if(!nonlinearity)
+		return false;
+
+	int numData = static_cast<int>(inputCompl.cols());
+	int batchSize = min(params.batchSize, numData);
+	int numParams = numParameters(params);
+
+	// interpret parameters
+	VectorXd weights = params.trainWeights ? VectorLBFGS(const_cast<double*>(x), mDimIn) : mWeights;
+	double bias = params.trainBias ? x[params.trainWeights ? mDimIn : 0] : mBias;
+
+	// offset of weights and bias in Hessian
+	int dimWeights = params.trainWeights ? mDimIn : 0;
+
+	MatrixXd hessian = MatrixXd::Zero(numParams, numParams);
+
+	#pragma omp parallel for
+	for(int b = 0; b < numData; b += batchSize) {
+		const Ref<const MatrixXd> input = inputCompl.middleCols(b, min(batchSize, numData - b));
+
+		Array<double, 1, Dynamic> responses;
+		if(mDimIn)
+			responses = (weights.transpose() * input).array() + bias;
+		else
+			responses = Array<double, 1, Dynamic>::Constant(input.cols(), bias);
+
+		Array<double, 1, Dynamic> curvature = nonlinearity->derivative(responses);
+
+		MatrixXd hessian_ = MatrixXd::Zero(numParams, numParams);
+
+		if(dimWeights) {
+			MatrixXd inputScaled = input.array().rowwise() * curvature.sqrt();
+			hessian_.topLeftCorner(dimWeights, dimWeights).selfadjointView<Lower>().rankUpdate(inputScaled);
+
+			if(params.trainBias)
+				hessian_.block(dimWeights, 0, 1, dimWeights) = (input * curvature.matrix().transpose()).transpose();
+		}
+
+		if(params.trainBias)
+			hessian_(dimWeights, dimWeights) = curvature.sum();
+
+		#pragma omp critical
+		hessian += hessian_;
+	}
+
+	hessian /= numData * log(2.);
+
+	if(dimWeights)
+		hessian.topLeftCorner(dimWeights, dimWeights) += params.regularizeWeights.hessian(dimWeights);
+	if(params.trainBias)
+		hessian(dimWeights, dimWeights) += params.regularizeBias.hessian(1)(0, 0);
+
+	LLT<MatrixXd, Lower> llt(hessian);
+
+	if(llt.info() != Success)
+		return false;
+
+	VectorLBFGS(d, numParams) = -llt.solve(VectorLBFGS(const_cast<double*>(g), numParams));
+
+	return true;
+}
+
+
+
+pair<pair<ArrayXXd, ArrayXXd>, Array<double, 1, Dynamic> > CMT::GLM::computeDataGradient(
+	const Ref<const MatrixXd>& input,
+	const Ref<const MatrixXd>& output) const
 {
 	// make sure nonlinearity is differentiable
 	DifferentiableNonlinearity* nonlinearity =
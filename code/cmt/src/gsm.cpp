@@ -1,17 +1,21 @@
 #include "gsm.h"
 #include "utils.h"
-#include "Eigen/LU"
 
 #include "Eigen/Core"
+using Eigen::Lower;
 using Eigen::Array;
 using Eigen::ArrayXd;
 using Eigen::Matrix;
 using Eigen::MatrixXd;
 using Eigen::Dynamic;
+using Eigen::Ref;
 
 #include <cmath>
 using std::sqrt;
 
+#include <algorithm>
+using std::min;
+
 #include <cstdlib>
 using std::rand;
 
@@ -82,6 +86,12 @@ MatrixXd CMT::GSM::sample(int numSamples) const {
 
 
 Array<double, 1, Dynamic> CMT::GSM::logLikelihood(const MatrixXd& data) const {
+	return logLikelihood(Ref<const MatrixXd>(data));
+}
+
+
+
+Array<double, 1, Dynamic> CMT::GSM::logLikelihood(const Ref<const MatrixXd>& data) const {
 	MatrixXd dataWhitened = mCholesky.transpose() * (data.colwise() - mMean);
 	Matrix<double, 1, Dynamic> sqNorm = dataWhitened.colwise().squaredNorm();
 
@@ -103,10 +113,17 @@ void CMT::GSM::initialize(const MatrixXd& data, const Parameters& parameters) {
 	if(data.rows() != dim())
 		throw Exception("Data has wrong dimensionality.");
 
-	// data statistics
+	// data statistics, computed in batches to avoid copying the data
 	VectorXd mean = data.rowwise().mean();
-	MatrixXd cov = CMT::covariance(data)
-		+ parameters.regularizeCovariance * MatrixXd::Identity(dim(), dim());
+	MatrixXd cov = MatrixXd::Zero(dim(), dim());
+
+	for(int b = 0; b < data.cols(); b += 2000) {
+		MatrixXd dataCentered = data.middleCols(b, min<int>(2000, data.cols() - b)).colwise() - mean;
+		cov.selfadjointView<Lower>().rankUpdate(dataCentered, 1. / data.cols());
+	}
+
+	cov = cov.selfadjointView<Lower>();
+	cov += parameters.regularizeCovariance * MatrixXd::Identity(dim(), dim());
 
 	MatrixXd cholesky = cov.llt().matrixL();
 
@@ -142,7 +159,7 @@ bool CMT::GSM::train(const MatrixXd& data, const Parameters& parameters) {
 		MatrixXd cov = dataCentered * dataCentered.transpose() / data.cols();
 
 		// compute Cholesky factor of precision matrix
-		mCholesky = cov.inverse().llt().matrixL();
+		mCholesky = choleskyPrecision(cov);
 	}
 
 	// squared norm of whitened data
@@ -205,7 +222,7 @@ bool CMT::GSM::train(
 		MatrixXd cov = dataWeighted * dataWeighted.transpose();
 
 		// compute Cholesky factor of precision matrix
-		mCholesky = cov.inverse().llt().matrixL();
+		mCholesky = choleskyPrecision(cov);
 	}
 
 	// squared norm of whitened data
@@ -235,3 +252,205 @@ bool CMT::GSM::train(
 
 	return true;
 }
+
+
+
+CMT::GSM::Statistics& CMT::GSM::Statistics::operator+=(
+	const Mixture::Component::Statistics& statistics)
+{
+	const Statistics* gsmStatistics = dynamic_cast<const Statistics*>(&statistics);
+
+	if(!gsmStatistics)
+		throw Exception("Statistics were not created by a GSM.");
+
+	if(center.size() && gsmStatistics->center.size() && center != gsmStatistics->center) {
+		// moments need to be relative to the same point before they can be added
+		Statistics statisticsRecentered = *gsmStatistics;
+		statisticsRecentered.recenter(center);
+		return *this += statisticsRecentered;
+	}
+
+	if(!center.size())
+		center = gsmStatistics->center;
+
+	Mixture::Component::Statistics::operator+=(statistics);
+
+	// statistics which have not been accumulated yet are empty
+	if(!firstMoment.size())
+		firstMoment = gsmStatistics->firstMoment;
+	else if(gsmStatistics->firstMoment.size())
+		firstMoment += gsmStatistics->firstMoment;
+
+	if(!secondMoment.size())
+		secondMoment = gsmStatistics->secondMoment;
+	else if(gsmStatistics->secondMoment.size())
+		secondMoment += gsmStatistics->secondMoment;
+
+	if(!scaleWeights.size())
+		scaleWeights = gsmStatistics->scaleWeights;
+	else if(gsmStatistics->scaleWeights.size())
+		scaleWeights += gsmStatistics->scaleWeights;
+
+	if(!scaleNorms.size())
+		scaleNorms = gsmStatistics->scaleNorms;
+	else if(gsmStatistics->scaleNorms.size())
+		scaleNorms += gsmStatistics->scaleNorms;
+
+	return *this;
+}
+
+
+
+CMT::GSM::Statistics& CMT::GSM::Statistics::operator*=(double factor) {
+	Mixture::Component::Statistics::operator*=(factor);
+
+	firstMoment *= factor;
+	secondMoment *= factor;
+	scaleWeights *= factor;
+	scaleNorms *= factor;
+
+	return *this;
+}
+
+
+
+/**
+ * Changes the point relative to which the first and second moments are computed.
+ * Only the lower triangular part of the second moment is updated.
+ */
+void CMT::GSM::Statistics::recenter(const VectorXd& center) {
+	if(firstMoment.size() && this->center.size()) {
+		VectorXd shift = center - this->center;
+
+		secondMoment.selfadjointView<Lower>().rankUpdate(shift, firstMoment, -1.);
+		secondMoment.selfadjointView<Lower>().rankUpdate(shift, weightSum);
+		firstMoment -= weightSum * shift;
+	}
+
+	this->center = center;
+}
+
+
+
+/**
+ * Fits parameters to weighted sufficient statistics (M). Unlike the other
+ * training methods, this performs a single EM step for the scales, using squared
+ * norms which were computed with the parameters at the time of accumulation.
+ *
+ * @param statistics statistics computed by accumulate() with the current parameters
+ * @param parameters hyperparameters which control which parameters are optimized
+ */
+bool CMT::GSM::train(
+	const Mixture::Component::Statistics& componentStatistics,
+	const Parameters& parameters)
+{
+	const Statistics* gsmStatistics = dynamic_cast<const Statistics*>(&componentStatistics);
+
+	if(!gsmStatistics)
+		throw Exception("Statistics were not created by a GSM.");
+
+	const Statistics& statistics = *gsmStatistics;
+
+	if(statistics.weightSum <= 0.)
+		return true;
+	if(statistics.firstMoment.size() != dim() || statistics.center.size() != dim())
+		throw Exception("Statistics have wrong dimensionality.");
+	if(statistics.scaleWeights.size() != numScales())
+		throw Exception("Statistics have wrong number of scales.");
+
+	// moments and mean are relative to the center
+	VectorXd mean = statistics.firstMoment / statistics.weightSum;
+	VectorXd meanShift = parameters.trainMean ? mean : VectorXd(mMean - statistics.center);
+
+	if(parameters.trainCovariance) {
+		MatrixXd cov = statistics.secondMoment.selfadjointView<Lower>();
+		cov /= statistics.weightSum;
+		cov -= meanShift * mean.transpose() + mean * meanShift.transpose()
+			- meanShift * meanShift.transpose();
+
+		// compute Cholesky factor of precision matrix
+		mCholesky = choleskyPrecision(cov);
+	}
+
+	if(parameters.trainMean)
+		// update mean
+		mMean = statistics.center + meanShift;
+
+	// update prior weights and precision scale variables
+	if(parameters.trainPriors)
+		mPriors = statistics.scaleWeights / statistics.weightSum;
+
+	if(parameters.trainScales)
+		mScales = mDim * statistics.scaleWeights.array() / statistics.scaleNorms.array();
+
+	return true;
+}
+
+
+
+CMT::GSM::Statistics* CMT::GSM::createStatistics() const {
+	return new Statistics;
+}
+
+
+
+/**
+ * Adds weighted sufficient statistics of the data to the given statistics. Moments
+ * are computed relative to the current mean to avoid cancellation errors, and
+ * squared norms of whitened data are used to compute posteriors over scales.
+ *
+ * @param data data stored column-wise
+ * @param weights weights corresponding to data points
+ * @param statistics statistics which will be updated
+ */
+void CMT::GSM::accumulate(
+	const Ref<const MatrixXd>& data,
+	const Array<double, 1, Dynamic>& weights,
+	Mixture::Component::Statistics& componentStatistics) const
+{
+	if(data.rows() != dim())
+		throw Exception("Data has wrong dimensionality.");
+	if(data.cols() != weights.cols())
+		throw Exception("Wrong number of weights.");
+
+	Statistics* gsmStatistics = dynamic_cast<Statistics*>(&componentStatistics);
+
+	if(!gsmStatistics)
+		throw Exception("Statistics were not created by a GSM.");
+
+	Statistics& statistics = *gsmStatistics;
+
+	if(statistics.center.size() && statistics.center != mMean)
+		statistics.recenter(mMean);
+
+	if(!statistics.firstMoment.size()) {
+		statistics.center = mMean;
+		statistics.firstMoment = VectorXd::Zero(dim());
+		statistics.secondMoment = MatrixXd::Zero(dim(), dim());
+		statistics.scaleWeights = VectorXd::Zero(numScales());
+		statistics.scaleNorms = VectorXd::Zero(numScales());
+	}
+
+	MatrixXd dataCentered = data.colwise() - mMean;
+
+	statistics.weightSum += weights.sum();
+	statistics.firstMoment += dataCentered * weights.matrix().transpose();
+
+	// only the lower triangular part of the second moment is updated
+	MatrixXd dataWeighted = dataCentered.array().rowwise() * weights.sqrt();
+	statistics.secondMoment.selfadjointView<Lower>().rankUpdate(dataWeighted);
+
+	// squared norm of whitened data
+	Matrix<double, 1, Dynamic> sqNorm = (mCholesky.transpose() * dataCentered).colwise().squaredNorm();
+
+	// unnormalized joint distribution over data and scales
+	ArrayXXd logJoint = (-0.5 * mScales * sqNorm).array().colwise()
+		+ (mPriors.array().log() + mDim / 2. * mScales.array().log());
+
+	// posterior over scales weighted by data weights
+	ArrayXXd postWeighted = (logJoint.rowwise() - logSumExp(logJoint)).exp();
+	postWeighted.rowwise() *= weights;
+
+	statistics.scaleWeights += postWeighted.rowwise().sum().matrix();
+	statistics.scaleNorms += (postWeighted.rowwise() * sqNorm.array()).rowwise().sum().matrix();
+}
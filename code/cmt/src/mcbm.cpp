@@ -5,6 +5,12 @@
 using std::pair;
 using std::make_pair;
 
+#include <vector>
+using std::vector;
+
+#include <string>
+using std::string;
+
 #include <cmath>
 using std::min;
 using std::max;
@@ -15,8 +21,63 @@ using std::log;
 using Eigen::Dynamic;
 using Eigen::Array;
 using Eigen::ArrayXXd;
+using Eigen::MatrixBase;
 using Eigen::MatrixXd;
 using Eigen::VectorXd;
+using Eigen::Ref;
+
+#include "binarymatrix.h"
+using CMT::BinaryMatrix;
+
+/**
+ * Computes lhs * input, where the input may be dense or binary.
+ */
+template <class Derived>
+static inline MatrixXd product(const MatrixBase<Derived>& lhs, const Ref<const MatrixXd>& input) {
+	return lhs * input;
+}
+
+
+
+template <class Derived>
+static inline MatrixXd product(const MatrixBase<Derived>& lhs, const BinaryMatrix& input) {
+	return input.leftProduct(lhs);
+}
+
+
+
+/**
+ * Computes lhs * input^T, where the input may be dense or binary.
+ */
+template <class Derived>
+static inline MatrixXd productTranspose(const MatrixBase<Derived>& lhs, const Ref<const MatrixXd>& input) {
+	return lhs * input.transpose();
+}
+
+
+
+template <class Derived>
+static inline MatrixXd productTranspose(const MatrixBase<Derived>& lhs, const BinaryMatrix& input) {
+	return input.leftProductTranspose(lhs);
+}
+
+
+
+/**
+ * Type of a batch of inputs. Batches of dense inputs refer to the data instead
+ * of copying it.
+ */
+template <class InputType>
+struct Batch {
+	typedef InputType Type;
+};
+
+
+
+template <>
+struct Batch<MatrixXd> {
+	typedef Ref<const MatrixXd> Type;
+};
 
 CMT::MCBM::Parameters::Parameters() :
 	Trainable::Parameters(),
@@ -109,30 +170,19 @@ CMT::MCBM::~MCBM() {
 
 
 
-MatrixXd CMT::MCBM::sample(const MatrixXd& input) const {
-	if(mDimIn) {
-		// some intermediate computations
-		ArrayXXd featureEnergy = mWeights * (mFeatures.transpose() * input).array().square().matrix();
-		ArrayXXd biasEnergy = mInputBias.transpose() * input;
-		ArrayXXd predictorEnergy = mPredictors * input;
-
-		// unnormalized probabilities of generating a 0 or 1 for each component
-		ArrayXXd logProb0 = (featureEnergy + biasEnergy).colwise() + mPriors.array();
-		ArrayXXd logProb1 = (logProb0 + predictorEnergy).colwise() + mOutputBias.array();
+CMT::Trainable* CMT::MCBM::copy() const {
+	return new MCBM(*this);
+}
 
-		// sum over components
-		logProb0 = logSumExp(logProb0);
-		logProb1 = logSumExp(logProb1);
 
-		// stack row vectors
-		ArrayXXd logProb01(2, input.cols());
-		logProb01 << logProb0, logProb1; 
 
-		// normalize log-probability
-		logProb1 -= logSumExp(logProb01);
+MatrixXd CMT::MCBM::sample(const MatrixXd& input) const {
+	if(mDimIn) {
+		// normalized log-probabilities of generating a 0 or 1
+		ArrayXXd logProb01 = logProbabilities(input);
 
 		ArrayXXd uniRand = Array<double, 1, Dynamic>::Random(input.cols()).abs();
-		return (uniRand < logProb1.exp()).cast<double>();
+		return (uniRand < logProb01.row(1).exp()).cast<double>();
 	} else {
 		// input is zero-dimensional
 		double logProb0 = logSumExp(mPriors)[0];
@@ -151,6 +201,20 @@ MatrixXd CMT::MCBM::sample(const MatrixXd& input) const {
 
 
 
+MatrixXd CMT::MCBM::sample(const BinaryMatrix& input) const {
+	if(input.rows() != dimIn())
+		throw Exception("Inputs have wrong dimensionality.");
+
+	if(!mDimIn)
+		return sample(MatrixXd(0, input.cols()));
+
+	ArrayXXd logProb01 = logProbabilities(input);
+	ArrayXXd uniRand = Array<double, 1, Dynamic>::Random(input.cols()).abs();
+	return (uniRand < logProb01.row(1).exp()).cast<double>();
+}
+
+
+
 Array<int, 1, Dynamic> CMT::MCBM::samplePrior(const MatrixXd& input) const {
 	if(input.rows() != dimIn())
 		throw Exception("Inputs have wrong dimensionality.");
@@ -234,6 +298,38 @@ Array<int, 1, Dynamic> CMT::MCBM::samplePosterior(
 
 
 
+/**
+ * Computes normalized log-probabilities of generating a 0 (first row) or a 1
+ * (second row) for each input.
+ */
+template <class InputType>
+ArrayXXd CMT::MCBM::logProbabilities(const InputType& input) const {
+	// compute all linear functions of the input in a single pass
+	MatrixXd linearWeights(mNumFeatures + 2 * mNumComponents, mDimIn);
+	linearWeights << mFeatures.transpose(), mInputBias.transpose(), mPredictors;
+	MatrixXd linearOutput = product(linearWeights, input);
+
+	// some intermediate computations
+	ArrayXXd featureEnergy = mWeights * linearOutput.topRows(mNumFeatures).array().square().matrix();
+	ArrayXXd biasEnergy = linearOutput.middleRows(mNumFeatures, mNumComponents);
+	ArrayXXd predictorEnergy = linearOutput.bottomRows(mNumComponents);
+
+	// unnormalized probabilities of generating a 0 or 1 for each component
+	ArrayXXd logProb0 = (featureEnergy + biasEnergy).colwise() + mPriors.array();
+	ArrayXXd logProb1 = (logProb0 + predictorEnergy).colwise() + mOutputBias.array();
+
+	// stack row vectors of probabilities summed over components
+	ArrayXXd logProb01(2, input.cols());
+	logProb01 << logSumExp(logProb0), logSumExp(logProb1);
+
+	// normalize log-probabilities
+	logProb01.rowwise() -= logSumExp(logProb01);
+
+	return logProb01;
+}
+
+
+
 Array<double, 1, Dynamic> CMT::MCBM::logLikelihood(
 	const MatrixXd& input,
 	const MatrixXd& output) const 
@@ -241,34 +337,14 @@ Array<double, 1, Dynamic> CMT::MCBM::logLikelihood(
 	if(input.rows() != dimIn())
 		throw Exception("Input has wrong dimensionality.");
 	if(output.rows() != dimOut())
-		throw Exception("Input has wrong dimensionality.");
+		throw Exception("Output has wrong dimensionality.");
 	if(input.cols() != output.cols())
 		throw Exception("The number of inputs and outputs must be the same.");
 
 	if(mDimIn) {
-		// some intermediate computations
-		ArrayXXd featureEnergy = mWeights * (mFeatures.transpose() * input).array().square().matrix();
-		ArrayXXd biasEnergy = mInputBias.transpose() * input;
-		ArrayXXd predictorEnergy = mPredictors * input;
-
-		// unnormalized probabilities of generating a 0 or 1 for each component
-		ArrayXXd logProb0 = (featureEnergy + biasEnergy).colwise() + mPriors.array();
-		ArrayXXd logProb1 = (logProb0 + predictorEnergy).colwise() + mOutputBias.array();
-
-		// sum over components
-		logProb0 = logSumExp(logProb0);
-		logProb1 = logSumExp(logProb1);
+		ArrayXXd logProb01 = logProbabilities(input);
 
-		// stack row vectors
-		ArrayXXd logProb01(2, input.cols());
-		logProb01 << logProb0, logProb1; 
-
-		// normalized log-probabilities
-		Array<double, 1, Dynamic> logNorm = logSumExp(logProb01);
-		logProb1 -= logNorm;
-		logProb0 -= logNorm;
-
-		return output.array() * logProb1 + (1. - output.array()) * logProb0;
+		return output.array() * logProb01.row(1) + (1. - output.array()) * logProb01.row(0);
 	} else {
 		// input is zero-dimensional
 		double logProb0 = logSumExp(mPriors)[0];
@@ -287,6 +363,27 @@ Array<double, 1, Dynamic> CMT::MCBM::logLikelihood(
 
 
 
+Array<double, 1, Dynamic> CMT::MCBM::logLikelihood(
+	const BinaryMatrix& input,
+	const MatrixXd& output) const 
+{
+	if(input.rows() != dimIn())
+		throw Exception("Input has wrong dimensionality.");
+	if(output.rows() != dimOut())
+		throw Exception("Input has wrong dimensionality.");
+	if(input.cols() != output.cols())
+		throw Exception("The number of inputs and outputs must be the same.");
+
+	if(!mDimIn)
+		return logLikelihood(MatrixXd(0, input.cols()), output);
+
+	ArrayXXd logProb01 = logProbabilities(input);
+
+	return output.array() * logProb01.row(1) + (1. - output.array()) * logProb01.row(0);
+}
+
+
+
 int CMT::MCBM::numParameters(const Trainable::Parameters& params_) const {
 	const Parameters& params = dynamic_cast<const Parameters&>(params_);
 
@@ -376,18 +473,65 @@ void CMT::MCBM::setParameters(const lbfgsfloatval_t* x, const Trainable::Paramet
 
 
 
+vector<pair<string, int> > CMT::MCBM::parameterBlocks(const Trainable::Parameters& params_) const {
+	const Parameters& params = dynamic_cast<const Parameters&>(params_);
+
+	vector<pair<string, int> > blocks;
+
+	if(params.trainPriors)
+		blocks.push_back(make_pair(string("priors"), static_cast<int>(mPriors.size())));
+	if(params.trainWeights)
+		blocks.push_back(make_pair(string("weights"), static_cast<int>(mWeights.size())));
+	if(params.trainFeatures)
+		blocks.push_back(make_pair(string("features"), static_cast<int>(mFeatures.size())));
+	if(params.trainPredictors)
+		blocks.push_back(make_pair(string("predictors"), static_cast<int>(mPredictors.size())));
+	if(params.trainInputBias)
+		blocks.push_back(make_pair(string("input_bias"), static_cast<int>(mInputBias.size())));
+	if(params.trainOutputBias)
+		blocks.push_back(make_pair(string("output_bias"), static_cast<int>(mOutputBias.size())));
+
+	return blocks;
+}
+
+
+
 double CMT::MCBM::parameterGradient(
-	const MatrixXd& inputCompl,
-	const MatrixXd& outputCompl,
+	const MatrixXd& input,
+	const MatrixXd& output,
 	const lbfgsfloatval_t* x,
 	lbfgsfloatval_t* g,
 	const Trainable::Parameters& params_) const
 {
 	const Parameters& params = dynamic_cast<const Parameters&>(params_);
 
-	// average log-likelihood
-	double logLik = 0.;
+	return computeParameterGradient(input, output, x, g, params);
+}
+
 
+
+double CMT::MCBM::parameterGradient(
+	const BinaryMatrix& input,
+	const MatrixXd& output,
+	const lbfgsfloatval_t* x,
+	lbfgsfloatval_t* g,
+	const Trainable::Parameters& params_) const
+{
+	const Parameters& params = dynamic_cast<const Parameters&>(params_);
+
+	return computeParameterGradient(input, output, x, g, params);
+}
+
+
+
+template <class InputType>
+double CMT::MCBM::computeParameterGradient(
+	const InputType& inputCompl,
+	const MatrixXd& outputCompl,
+	const lbfgsfloatval_t* x,
+	lbfgsfloatval_t* g,
+	const Parameters& params) const
+{
 	// interpret memory for parameters and gradients
 	lbfgsfloatval_t* y = const_cast<lbfgsfloatval_t*>(x);
 
@@ -423,101 +567,127 @@ double CMT::MCBM::parameterGradient(
 	if(params.trainOutputBias)
 		offset += outputBias.size();
 
-	if(g) {
-		// initialize gradients
+	// split data into batches for better performance
+	int numData = static_cast<int>(inputCompl.cols());
+	int batchSize = min(max(params.batchSize, 10), numData);
+
+	// all linear functions of the input are computed in a single pass
+	MatrixXd linearWeights(mNumFeatures + 2 * mNumComponents, mDimIn);
+	linearWeights << features.transpose(), inputBias.transpose(), predictors;
+
+	// thread-private gradients with the log-likelihood stored in the last entry
+	vector<VectorXd> partials(numThreads(), VectorXd::Zero(offset + 1));
+
+	#pragma omp parallel
+	{
+		VectorXd& partial = partials[threadID()];
+		double& logLik = partial[offset];
+
+		// interpret thread-private memory in the same way as the gradient
+		double* h = partial.data();
+
+		VectorLBFGS priorsGrad(h, mNumComponents);
 		if(params.trainPriors)
-			priorsGrad.setZero();
+			h += priorsGrad.size();
+
+		MatrixLBFGS weightsGrad(h, mNumComponents, mNumFeatures);
 		if(params.trainWeights)
-			weightsGrad.setZero();
+			h += weightsGrad.size();
+
+		MatrixLBFGS featuresGrad(h, mDimIn, mNumFeatures);
 		if(params.trainFeatures)
-			featuresGrad.setZero();
+			h += featuresGrad.size();
+
+		MatrixLBFGS predictorsGrad(h, mNumComponents, mDimIn);
 		if(params.trainPredictors)
-			predictorsGrad.setZero();
+			h += predictorsGrad.size();
+
+		MatrixLBFGS inputBiasGrad(h, mDimIn, mNumComponents);
 		if(params.trainInputBias)
-			inputBiasGrad.setZero();
-		if(params.trainOutputBias)
-			outputBiasGrad.setZero();
-	}
+			h += inputBiasGrad.size();
 
-	// split data into batches for better performance
-	int numData = static_cast<int>(inputCompl.cols());
-	int batchSize = min(max(params.batchSize, 10), numData);
+		VectorLBFGS outputBiasGrad(h, mNumComponents);
 
-	#pragma omp parallel for
-	for(int b = 0; b < inputCompl.cols(); b += batchSize) {
-		const MatrixXd& input = inputCompl.middleCols(b, min(batchSize, numData - b));
-		const MatrixXd& output = outputCompl.middleCols(b, min(batchSize, numData - b));
+		#pragma omp for schedule(static)
+		for(int b = 0; b < numData; b += batchSize) {
+			const typename Batch<InputType>::Type input = inputCompl.middleCols(b, min(batchSize, numData - b));
+			const Ref<const MatrixXd> output = outputCompl.middleCols(b, min(batchSize, numData - b));
 
-		ArrayXXd featureOutput = features.transpose() * input;
-		MatrixXd featureOutputSq = featureOutput.square();
-		MatrixXd weightsOutput = weights * featureOutputSq;
-		ArrayXXd predictorOutput = predictors * input;
+			MatrixXd linearOutput = product(linearWeights, input);
 
-		// unnormalized posteriors over components for both possible outputs
-		ArrayXXd logPost0 = (weightsOutput + inputBias.transpose() * input).colwise() + priors;
-		ArrayXXd logPost1 = (logPost0 + predictorOutput).colwise() + outputBias.array();
+			ArrayXXd featureOutput = linearOutput.topRows(mNumFeatures);
+			MatrixXd featureOutputSq = featureOutput.square();
+			MatrixXd weightsOutput = weights * featureOutputSq;
+			ArrayXXd predictorOutput = linearOutput.bottomRows(mNumComponents);
 
-		// sum over components to get unnormalized probabilities of outputs
-		Array<double, 1, Dynamic> logProb0 = logSumExp(logPost0);
-		Array<double, 1, Dynamic> logProb1 = logSumExp(logPost1);
-	
-		// normalize posteriors over components
-		logPost0.rowwise() -= logProb0;
-		logPost1.rowwise() -= logProb1;
+			// unnormalized posteriors over components for both possible outputs
+			ArrayXXd logPost0 = (weightsOutput + linearOutput.middleRows(mNumFeatures, mNumComponents)).colwise() + priors;
+			ArrayXXd logPost1 = (logPost0 + predictorOutput).colwise() + outputBias.array();
 
-		// stack row vectors
-		ArrayXXd logProb01(2, input.cols());
-		logProb01 << logProb0, logProb1; 
+			// sum over components to get unnormalized probabilities of outputs
+			Array<double, 1, Dynamic> logProb0 = logSumExp(logPost0);
+			Array<double, 1, Dynamic> logProb1 = logSumExp(logPost1);
 
-		// normalize log-probabilities
-		Array<double, 1, Dynamic> logNorm = logSumExp(logProb01);
-		logProb1 -= logNorm;
-		logProb0 -= logNorm;
+			// normalize posteriors over components
+			logPost0.rowwise() -= logProb0;
+			logPost1.rowwise() -= logProb1;
 
-		double logLikBatch = (output.array() * logProb1 + (1. - output.array()) * logProb0).sum();
+			// stack row vectors
+			ArrayXXd logProb01(2, input.cols());
+			logProb01 << logProb0, logProb1; 
 
-		#pragma omp critical
-		logLik += logLikBatch;
+			// normalize log-probabilities
+			Array<double, 1, Dynamic> logNorm = logSumExp(logProb01);
+			logProb1 -= logNorm;
+			logProb0 -= logNorm;
 
-		if(!g)
-			// don't compute gradients
-			continue;
+			logLik += (output.array() * logProb1 + (1. - output.array()) * logProb0).sum();
 
-		Array<double, 1, Dynamic> tmp = output.array() * logProb0.exp() - (1. - output.array()) * logProb1.exp();
+			if(!g)
+				// don't compute gradients
+				continue;
 
-		ArrayXXd post0Tmp = logPost0.exp().rowwise() * tmp;
-		ArrayXXd post1Tmp = logPost1.exp().rowwise() * tmp;
-		ArrayXXd postDiffTmp = post1Tmp - post0Tmp;
+			Array<double, 1, Dynamic> tmp = output.array() * logProb0.exp() - (1. - output.array()) * logProb1.exp();
 
-		// update gradients
-		if(params.trainPriors)
-			#pragma omp critical
-			priorsGrad -= postDiffTmp.rowwise().sum().matrix();
+			ArrayXXd post0Tmp = logPost0.exp().rowwise() * tmp;
+			ArrayXXd post1Tmp = logPost1.exp().rowwise() * tmp;
+			ArrayXXd postDiffTmp = post1Tmp - post0Tmp;
 
-		if(params.trainWeights)
-			#pragma omp critical
-			weightsGrad -= postDiffTmp.matrix() * featureOutputSq.transpose();
-
-		if(params.trainFeatures) {
-			ArrayXXd tmp2 = weights.transpose() * postDiffTmp.matrix() * 2.;
-			MatrixXd tmp3 = featureOutput * tmp2;
-			#pragma omp critical
-			featuresGrad -= input * tmp3.transpose();
-		}
+			// update gradients
+			if(params.trainPriors)
+				priorsGrad -= postDiffTmp.rowwise().sum().matrix();
 
-		if(params.trainPredictors)
-			#pragma omp critical
-			predictorsGrad -= post1Tmp.matrix() * input.transpose();
+			if(params.trainWeights)
+				weightsGrad -= postDiffTmp.matrix() * featureOutputSq.transpose();
 
-		if(params.trainInputBias)
-			#pragma omp critical
-			inputBiasGrad -= input * postDiffTmp.matrix().transpose();
+			if(params.trainFeatures || params.trainInputBias || params.trainPredictors) {
+				ArrayXXd tmp2 = weights.transpose() * postDiffTmp.matrix() * 2.;
+
+				// gradients of all linear functions are also computed in a single pass
+				MatrixXd linearGrad(mNumFeatures + 2 * mNumComponents, input.cols());
+				linearGrad << (featureOutput * tmp2).matrix(), postDiffTmp.matrix(), post1Tmp.matrix();
+				MatrixXd tmp3 = productTranspose(linearGrad, input);
+
+				if(params.trainFeatures)
+					featuresGrad -= tmp3.topRows(mNumFeatures).transpose();
+				if(params.trainInputBias)
+					inputBiasGrad -= tmp3.middleRows(mNumFeatures, mNumComponents).transpose();
+				if(params.trainPredictors)
+					predictorsGrad -= tmp3.bottomRows(mNumComponents);
+			}
 
-		if(params.trainOutputBias)
-			#pragma omp critical
-			outputBiasGrad -= post1Tmp.rowwise().sum().matrix();
+			if(params.trainOutputBias)
+				outputBiasGrad -= post1Tmp.rowwise().sum().matrix();
+		}
 	}
 
+	reduceSum(partials);
+
+	double logLik = partials[0][offset];
+
+	if(g)
+		VectorLBFGS(g, offset) = partials[0].head(offset);
+
 	double normConst = inputCompl.cols() * log(2.) * dimOut();
 
 	if(g) {
@@ -550,9 +720,137 @@ double CMT::MCBM::parameterGradient(
 
 
 
-pair<pair<ArrayXXd, ArrayXXd>, Array<double, 1, Dynamic> > CMT::MCBM::computeDataGradient(
+MatrixXd CMT::MCBM::perExampleGradients(
 	const MatrixXd& input,
-	const MatrixXd& output) const
+	const MatrixXd& output,
+	const Trainable::Parameters& params_) const
+{
+	const Parameters& params = dynamic_cast<const Parameters&>(params_);
+
+	if(input.rows() != mDimIn || output.rows() != 1)
+		throw Exception("Data has wrong dimensionality.");
+	if(input.cols() != output.cols())
+		throw Exception("The number of inputs and outputs should be the same.");
+
+	int numData = static_cast<int>(input.cols());
+	int batchSize = min(max(params.batchSize, 10), max(numData, 1));
+
+	// all linear functions of the input are computed in a single pass
+	MatrixXd linearWeights(mNumFeatures + 2 * mNumComponents, mDimIn);
+	linearWeights << mFeatures.transpose(), mInputBias.transpose(), mPredictors;
+
+	MatrixXd gradients(numParameters(params), numData);
+
+	#pragma omp parallel for
+	for(int b = 0; b < numData; b += batchSize) {
+		int width = min(batchSize, numData - b);
+		const Ref<const MatrixXd> inputBatch = input.middleCols(b, width);
+		const Ref<const MatrixXd> outputBatch = output.middleCols(b, width);
+
+		MatrixXd linearOutput = linearWeights * inputBatch;
+
+		ArrayXXd featureOutput = linearOutput.topRows(mNumFeatures);
+		MatrixXd featureOutputSq = featureOutput.square();
+		MatrixXd weightsOutput = mWeights * featureOutputSq;
+		ArrayXXd predictorOutput = linearOutput.bottomRows(mNumComponents);
+
+		// unnormalized posteriors over components for both possible outputs
+		ArrayXXd logPost0 = (weightsOutput + linearOutput.middleRows(mNumFeatures, mNumComponents)).colwise() + mPriors;
+		ArrayXXd logPost1 = (logPost0 + predictorOutput).colwise() + mOutputBias.array();
+
+		// sum over components to get unnormalized probabilities of outputs
+		Array<double, 1, Dynamic> logProb0 = logSumExp(logPost0);
+		Array<double, 1, Dynamic> logProb1 = logSumExp(logPost1);
+
+		// normalize posteriors over components
+		logPost0.rowwise() -= logProb0;
+		logPost1.rowwise() -= logProb1;
+
+		ArrayXXd logProb01(2, width);
+		logProb01 << logProb0, logProb1;
+
+		// normalize log-probabilities
+		Array<double, 1, Dynamic> logNorm = logSumExp(logProb01);
+		logProb1 -= logNorm;
+		logProb0 -= logNorm;
+
+		Array<double, 1, Dynamic> tmp =
+			outputBatch.array() * logProb0.exp() - (1. - outputBatch.array()) * logProb1.exp();
+
+		ArrayXXd post1Tmp = logPost1.exp().rowwise() * tmp;
+		ArrayXXd postDiffTmp = post1Tmp - logPost0.exp().rowwise() * tmp;
+		ArrayXXd featuresTmp = featureOutput * (mWeights.transpose() * postDiffTmp.matrix() * 2.).array();
+
+		for(int n = 0; n < width; ++n) {
+			double* g = gradients.col(b + n).data();
+
+			if(params.trainPriors) {
+				VectorLBFGS(g, mNumComponents) = -postDiffTmp.col(n);
+				g += mNumComponents;
+			}
+
+			if(params.trainWeights) {
+				MatrixLBFGS(g, mNumComponents, mNumFeatures) =
+					-postDiffTmp.col(n).matrix() * featureOutputSq.col(n).transpose();
+				g += mNumComponents * mNumFeatures;
+			}
+
+			if(params.trainFeatures) {
+				MatrixLBFGS(g, mDimIn, mNumFeatures) =
+					-inputBatch.col(n) * featuresTmp.col(n).matrix().transpose();
+				g += mDimIn * mNumFeatures;
+			}
+
+			if(params.trainPredictors) {
+				MatrixLBFGS(g, mNumComponents, mDimIn) =
+					-post1Tmp.col(n).matrix() * inputBatch.col(n).transpose();
+				g += mNumComponents * mDimIn;
+			}
+
+			if(params.trainInputBias) {
+				MatrixLBFGS(g, mDimIn, mNumComponents) =
+					-inputBatch.col(n) * postDiffTmp.col(n).matrix().transpose();
+				g += mDimIn * mNumComponents;
+			}
+
+			if(params.trainOutputBias)
+				VectorLBFGS(g, mNumComponents) = -post1Tmp.col(n);
+		}
+	}
+
+	gradients /= log(2.) * dimOut();
+
+	// gradients of regularizers are the same for all data points
+	VectorXd regularization = VectorXd::Zero(gradients.rows());
+	double* g = regularization.data();
+
+	if(params.trainPriors)
+		g += mNumComponents;
+
+	if(params.trainWeights) {
+		MatrixLBFGS(g, mNumComponents, mNumFeatures) = params.regularizeWeights.gradient(mWeights);
+		g += mWeights.size();
+	}
+
+	if(params.trainFeatures) {
+		MatrixLBFGS(g, mDimIn, mNumFeatures) = params.regularizeFeatures.gradient(mFeatures);
+		g += mFeatures.size();
+	}
+
+	if(params.trainPredictors)
+		MatrixLBFGS(g, mNumComponents, mDimIn) =
+			params.regularizePredictors.gradient(mPredictors.transpose()).transpose();
+
+	gradients.colwise() += regularization;
+
+	return gradients;
+}
+
+
+
+pair<pair<ArrayXXd, ArrayXXd>, Array<double, 1, Dynamic> > CMT::MCBM::computeDataGradient(
+	const Ref<const MatrixXd>& input,
+	const Ref<const MatrixXd>& output) const
 {
 	throw Exception("Not implemented.");
 
@@ -565,6 +863,10 @@ pair<pair<ArrayXXd, ArrayXXd>, Array<double, 1, Dynamic> > CMT::MCBM::computeDat
 
 
 
+/**
+ * Binary inputs are packed into a BinaryMatrix for the duration of training so
+ * that gradients are computed by the bit-packed kernels.
+ */
 bool CMT::MCBM::train(
 	const MatrixXd& input,
 	const MatrixXd& output,
@@ -578,7 +880,29 @@ bool CMT::MCBM::train(
 		mPriors.setZero();
 		mOutputBias.setConstant(prob > 0. ? log(prob) : -50.);
 		return true;
-	} else {
-		return Trainable::train(input, output, inputVal, outputVal, params);
 	}
+
+	if(input.rows() == dimIn() && BinaryMatrix::isBinary(input))
+		return train(BinaryMatrix(input), output, inputVal, outputVal, params);
+
+	return Trainable::train(input, output, inputVal, outputVal, params);
+}
+
+
+
+/**
+ * Trains the model on bit-packed binary inputs, which are never converted into
+ * a dense matrix.
+ */
+bool CMT::MCBM::train(
+	const BinaryMatrix& input,
+	const MatrixXd& output,
+	const MatrixXd* inputVal,
+	const MatrixXd* outputVal,
+	const Trainable::Parameters& params)
+{
+	if(!mDimIn && !input.rows())
+		// zero-dimensional inputs carry no bits
+		return train(MatrixXd(0, input.cols()), output, inputVal, outputVal, params);
+	return Trainable::train(input, output, inputVal, outputVal, params);
 }
@@ -6,6 +6,12 @@
 using std::pair;
 using std::make_pair;
 
+#include <vector>
+using std::vector;
+
+#include <string>
+using std::string;
+
 #include "Eigen/Core"
 using Eigen::Dynamic;
 using Eigen::Matrix;
@@ -14,6 +20,7 @@ using Eigen::Array;
 using Eigen::ArrayXXd;
 using Eigen::ArrayXd;
 using Eigen::Map;
+using Eigen::Ref;
 
 #include <cmath>
 using std::max;
@@ -189,6 +196,12 @@ CMT::MCGSM::~MCGSM() {
 
 
 
+CMT::Trainable* CMT::MCGSM::copy() const {
+	return new MCGSM(*this);
+}
+
+
+
 void CMT::MCGSM::initialize(const MatrixXd& input, const MatrixXd& output) {
 	if(input.rows() != mDimIn || output.rows() != mDimOut)
 		throw Exception("Data has wrong dimensionality.");
@@ -249,8 +262,8 @@ void CMT::MCGSM::initialize(const MatrixXd& input, const MatrixXd& output) {
 		mMeans.setZero();
 
 		// optimal linear predictor and precision
-		MatrixXd predictor = covXY.transpose() * covXX.inverse();
-		MatrixXd choleskyFactor = covariance(output - predictor * input).inverse().llt().matrixL();
+		MatrixXd predictor = covXX.llt().solve(covXY).transpose();
+		MatrixXd choleskyFactor = choleskyPrecision(covariance(output - predictor * input));
 		vector<MatrixXd> choleskyFactors;
 
 		for(int i = 0; i < mNumComponents; ++i) {
@@ -764,6 +777,34 @@ void CMT::MCGSM::setParameters(const lbfgsfloatval_t* x, const Trainable::Parame
 
 
 
+vector<pair<string, int> > CMT::MCGSM::parameterBlocks(const Trainable::Parameters& params_) const {
+	const Parameters& params = dynamic_cast<const Parameters&>(params_);
+
+	vector<pair<string, int> > blocks;
+
+	if(params.trainPriors)
+		blocks.push_back(make_pair(string("priors"), static_cast<int>(mPriors.size())));
+	if(params.trainScales)
+		blocks.push_back(make_pair(string("scales"), static_cast<int>(mScales.size())));
+	if(params.trainWeights)
+		blocks.push_back(make_pair(string("weights"), static_cast<int>(mWeights.size())));
+	if(params.trainFeatures)
+		blocks.push_back(make_pair(string("features"), static_cast<int>(mFeatures.size())));
+	if(params.trainCholeskyFactors)
+		blocks.push_back(make_pair(string("cholesky_factors"),
+			mNumComponents * mDimOut * (mDimOut + 1) / 2 - mNumComponents));
+	if(params.trainPredictors)
+		blocks.push_back(make_pair(string("predictors"), mNumComponents * mDimOut * mDimIn));
+	if(params.trainLinearFeatures)
+		blocks.push_back(make_pair(string("linear_features"), static_cast<int>(mLinearFeatures.size())));
+	if(params.trainMeans)
+		blocks.push_back(make_pair(string("means"), static_cast<int>(mMeans.size())));
+
+	return blocks;
+}
+
+
+
 double CMT::MCGSM::parameterGradient(
 	const MatrixXd& inputCompl,
 	const MatrixXd& outputCompl,
@@ -867,8 +908,8 @@ double CMT::MCGSM::parameterGradient(
 	int batchSize = min(max(params.batchSize, 10), numData);
 
 	for(int b = 0; b < inputCompl.cols(); b += batchSize) {
-		const MatrixXd& input = inputCompl.middleCols(b, min(batchSize, numData - b));
-		const MatrixXd& output = outputCompl.middleCols(b, min(batchSize, numData - b));
+		const Ref<const MatrixXd> input = inputCompl.middleCols(b, min(batchSize, numData - b));
+		const Ref<const MatrixXd> output = outputCompl.middleCols(b, min(batchSize, numData - b));
 
 		// compute unnormalized posterior
 		MatrixXd featureOutput = features.transpose() * input;
@@ -973,8 +1014,8 @@ double CMT::MCGSM::parameterGradient(
 
 			// partial gradient of features
 			if(params.trainFeatures) {
-				MatrixXd tmp5 = input.array().rowwise() * tmp0;
-				ArrayXXd tmp6 = tmp5 * featureOutput.transpose();
+				MatrixXd tmp5 = featureOutput.array().rowwise() * tmp0;
+				ArrayXXd tmp6 = input * tmp5.transpose();
 
 				#pragma omp critical
 				featuresGrad += (tmp6.rowwise() * weightsSqr.row(i).array()).matrix();
@@ -1062,9 +1103,209 @@ double CMT::MCGSM::parameterGradient(
 
 
 
+MatrixXd CMT::MCGSM::perExampleGradients(
+	const MatrixXd& inputCompl,
+	const MatrixXd& outputCompl,
+	const Trainable::Parameters& params_) const
+{
+	const Parameters& params = dynamic_cast<const Parameters&>(params_);
+
+	if(inputCompl.rows() != mDimIn || outputCompl.rows() != mDimOut)
+		throw Exception("Data has wrong dimensionality.");
+	if(inputCompl.cols() != outputCompl.cols())
+		throw Exception("The number of inputs and outputs should be the same.");
+
+	// number of free parameters of each Cholesky factor
+	int numCholFac = mDimOut * (mDimOut + 1) / 2 - 1;
+
+	// offsets of parameter blocks in the same order as used by parameters()
+	int offset = 0;
+	int priorsOffset = offset;
+	if(params.trainPriors)
+		offset += mPriors.size();
+	int scalesOffset = offset;
+	if(params.trainScales)
+		offset += mScales.size();
+	int weightsOffset = offset;
+	if(params.trainWeights)
+		offset += mWeights.size();
+	int featuresOffset = offset;
+	if(params.trainFeatures)
+		offset += mFeatures.size();
+	int cholFacOffset = offset;
+	if(params.trainCholeskyFactors)
+		offset += mNumComponents * numCholFac;
+	int predictorsOffset = offset;
+	if(params.trainPredictors)
+		offset += mNumComponents * mDimOut * mDimIn;
+	int linearFeaturesOffset = offset;
+	if(params.trainLinearFeatures)
+		offset += mLinearFeatures.size();
+	int meansOffset = offset;
+	if(params.trainMeans)
+		offset += mMeans.size();
+
+	int numData = static_cast<int>(inputCompl.cols());
+	int batchSize = min(max(params.batchSize, 10), max(numData, 1));
+
+	MatrixXd weightsSqr = mWeights.array().square();
+
+	MatrixXd gradients(offset, numData);
+
+	#pragma omp parallel for
+	for(int b = 0; b < numData; b += batchSize) {
+		int width = min(batchSize, numData - b);
+		const Ref<const MatrixXd> input = inputCompl.middleCols(b, width);
+		const Ref<const MatrixXd> output = outputCompl.middleCols(b, width);
+		Ref<MatrixXd> grad = gradients.middleCols(b, width);
+
+		// compute unnormalized posterior
+		MatrixXd featureOutput = mFeatures.transpose() * input;
+		MatrixXd featureOutputSqr = featureOutput.array().square();
+		MatrixXd weightsOutput = weightsSqr * featureOutputSqr - 2. * mLinearFeatures * input;
+
+		vector<ArrayXXd> logPosteriorIn(mNumComponents);
+		vector<ArrayXXd> logPosteriorOut(mNumComponents);
+		vector<MatrixXd> predError(mNumComponents);
+		vector<Array<double, 1, Dynamic> > predErrorSqNorm(mNumComponents);
+
+		ArrayXXd logNormInScales(mNumComponents, width);
+		ArrayXXd logNormOutScales(mNumComponents, width);
+
+		for(int i = 0; i < mNumComponents; ++i) {
+			VectorXd scalesExp = mScales.row(i).transpose().exp();
+
+			MatrixXd negEnergyGate = -scalesExp / 2. * weightsOutput.row(i);
+			negEnergyGate.colwise() += mPriors.row(i).transpose().matrix();
+
+			predError[i] = (output - mPredictors[i] * input).colwise() - mMeans.col(i);
+			predErrorSqNorm[i] = (mCholeskyFactors[i].transpose() * predError[i]).colwise().squaredNorm();
+
+			MatrixXd negEnergyExpert = -scalesExp / 2. * predErrorSqNorm[i].matrix();
+
+			// normalize expert energy
+			double logDet = mCholeskyFactors[i].diagonal().array().abs().log().sum();
+			VectorXd logPartf = mDimOut / 2. * mScales.row(i).transpose()
+				+ logDet - mDimOut / 2. * log(2. * PI);
+
+			negEnergyExpert.colwise() += logPartf;
+
+			logPosteriorIn[i] = negEnergyGate;
+			logPosteriorOut[i] = negEnergyGate + negEnergyExpert;
+
+			logNormInScales.row(i) = logSumExp(logPosteriorIn[i]);
+			logNormOutScales.row(i) = logSumExp(logPosteriorOut[i]);
+		}
+
+		Array<double, 1, Dynamic> logNormIn = logSumExp(logNormInScales);
+		Array<double, 1, Dynamic> logNormOut = logSumExp(logNormOutScales);
+
+		// derivatives with respect to each component's gate energy
+		MatrixXd tmp0(mNumComponents, width);
+
+		for(int i = 0; i < mNumComponents; ++i) {
+			ArrayXd scalesExp = mScales.row(i).transpose().exp();
+
+			ArrayXXd posteriorIn = (logPosteriorIn[i].rowwise() - logNormIn).exp();
+			ArrayXXd posteriorOut = (logPosteriorOut[i].rowwise() - logNormOut).exp();
+			ArrayXXd posteriorDiff = posteriorIn - posteriorOut;
+
+			tmp0.row(i) = -scalesExp.matrix().transpose() * posteriorDiff.matrix();
+
+			Array<double, 1, Dynamic> tmp3 = posteriorOut.colwise().sum();
+			Array<double, 1, Dynamic> tmp7 = scalesExp.matrix().transpose() * posteriorOut.matrix();
+			MatrixXd precision = mCholeskyFactors[i] * mCholeskyFactors[i].transpose();
+			MatrixXd tmp8 = predError[i].array().rowwise() * tmp7;
+			MatrixXd tmp9 = precision * tmp8;
+			VectorXd tmp10 = mCholeskyFactors[i].diagonal().cwiseInverse();
+
+			for(int n = 0; n < width; ++n) {
+				double* g = grad.col(n).data();
+
+				if(params.trainPriors)
+					MatrixLBFGS(g + priorsOffset, mNumComponents, mNumScales).row(i) =
+						posteriorDiff.col(n).transpose();
+
+				if(params.trainScales)
+					MatrixLBFGS(g + scalesOffset, mNumComponents, mNumScales).row(i) = (
+						posteriorOut.col(n) * predErrorSqNorm[i][n] * scalesExp / 2. -
+						posteriorOut.col(n) * mDimOut / 2. -
+						posteriorDiff.col(n) * weightsOutput(i, n) * scalesExp / 2.).matrix().transpose();
+
+				if(params.trainWeights)
+					MatrixLBFGS(g + weightsOffset, mNumComponents, mNumFeatures).row(i) =
+						featureOutputSqr.col(n).transpose().cwiseProduct(mWeights.row(i).matrix()) * tmp0(i, n);
+
+				if(params.trainCholeskyFactors) {
+					MatrixXd choleskyFactorGrad = tmp8.col(n) * (predError[i].col(n).transpose() * mCholeskyFactors[i]);
+					choleskyFactorGrad.diagonal() -= tmp3[n] * tmp10;
+
+					double* h = g + cholFacOffset + i * numCholFac;
+					for(int m = 1; m < mDimOut; ++m)
+						for(int k = 0; k <= m; ++k, ++h)
+							*h = choleskyFactorGrad(m, k);
+				}
+
+				if(params.trainPredictors)
+					MatrixLBFGS(g + predictorsOffset + i * mDimOut * mDimIn, mDimOut, mDimIn) =
+						-tmp9.col(n) * input.col(n).transpose();
+
+				if(params.trainLinearFeatures)
+					MatrixLBFGS(g + linearFeaturesOffset, mNumComponents, mDimIn).row(i) =
+						-tmp0(i, n) * input.col(n).transpose();
+
+				if(params.trainMeans)
+					MatrixLBFGS(g + meansOffset, mDimOut, mNumComponents).col(i) = -tmp9.col(n);
+			}
+		}
+
+		// features are shared by all components
+		if(params.trainFeatures) {
+			MatrixXd tmp5 = featureOutput.cwiseProduct(weightsSqr.transpose() * tmp0);
+
+			for(int n = 0; n < width; ++n)
+				MatrixLBFGS(grad.col(n).data() + featuresOffset, mDimIn, mNumFeatures) =
+					input.col(n) * tmp5.col(n).transpose();
+		}
+	}
+
+	gradients /= log(2.) * dimOut();
+
+	// gradients of regularizers are the same for all data points
+	VectorXd regularization = VectorXd::Zero(offset);
+	double* g = regularization.data();
+
+	if(params.trainWeights)
+		MatrixLBFGS(g + weightsOffset, mNumComponents, mNumFeatures) =
+			params.regularizeWeights.gradient(mWeights);
+
+	if(params.trainFeatures)
+		MatrixLBFGS(g + featuresOffset, mDimIn, mNumFeatures) =
+			params.regularizeFeatures.gradient(mFeatures);
+
+	if(params.trainPredictors)
+		for(int i = 0; i < mNumComponents; ++i)
+			MatrixLBFGS(g + predictorsOffset + i * mDimOut * mDimIn, mDimOut, mDimIn) =
+				params.regularizePredictors.gradient(mPredictors[i].transpose()).transpose();
+
+	if(params.trainLinearFeatures)
+		MatrixLBFGS(g + linearFeaturesOffset, mNumComponents, mDimIn) =
+			params.regularizeLinearFeatures.gradient(mLinearFeatures.transpose()).transpose();
+
+	if(params.trainMeans)
+		MatrixLBFGS(g + meansOffset, mDimOut, mNumComponents) =
+			params.regularizeMeans.gradient(mMeans);
+
+	gradients.colwise() += regularization;
+
+	return gradients;
+}
+
+
+
 pair<pair<ArrayXXd, ArrayXXd>, Array<double, 1, Dynamic> > CMT::MCGSM::computeDataGradient(
-	const MatrixXd& input,
-	const MatrixXd& output) const
+	const Ref<const MatrixXd>& input,
+	const Ref<const MatrixXd>& output) const
 {
 	if(input.rows() > 0) {
 		// compute unnormalized posterior
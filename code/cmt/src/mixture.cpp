@@ -3,6 +3,7 @@
 
 #include <cmath>
 using std::log;
+using std::pow;
 
 #include <limits>
 using std::numeric_limits;
@@ -17,6 +18,8 @@ using std::setprecision;
 
 #include <algorithm>
 using std::random_shuffle;
+using std::min;
+using std::max;
 
 #include "Eigen/Core"
 using Eigen::Dynamic;
@@ -25,6 +28,8 @@ using Eigen::ArrayXd;
 using Eigen::ArrayXXd;
 using Eigen::MatrixXd;
 using Eigen::PermutationMatrix;
+using Eigen::Ref;
+using Eigen::Lower;
 
 CMT::Mixture::Parameters::Parameters() :
 	verbosity(1),
@@ -35,7 +40,10 @@ CMT::Mixture::Parameters::Parameters() :
 	initialize(true),
 	trainPriors(true),
 	trainComponents(true),
-	regularizePriors(0.)
+	regularizePriors(0.),
+	batchSize(2000),
+	stepSizeOffset(2.),
+	stepSizeDecay(0.7)
 {
 }
 
@@ -58,6 +66,51 @@ CMT::Mixture::Component::Parameters::Parameters() :
 
 
 
+CMT::Mixture::Component::Statistics::Statistics() : weightSum(0.) {
+}
+
+
+
+CMT::Mixture::Component::Statistics::~Statistics() {
+}
+
+
+
+CMT::Mixture::Component::Statistics& CMT::Mixture::Component::Statistics::operator+=(
+	const Statistics& statistics)
+{
+	weightSum += statistics.weightSum;
+	return *this;
+}
+
+
+
+CMT::Mixture::Component::Statistics& CMT::Mixture::Component::Statistics::operator*=(
+	double factor)
+{
+	weightSum *= factor;
+	return *this;
+}
+
+
+
+/**
+ * Evaluates the log-likelihood of a view of the data. Components which cannot
+ * process views directly work on a copy.
+ */
+Array<double, 1, Dynamic> CMT::Mixture::Component::logLikelihood(
+	const Ref<const MatrixXd>& data) const
+{
+	return logLikelihood(MatrixXd(data));
+}
+
+
+
+CMT::Mixture::Stream::~Stream() {
+}
+
+
+
 void CMT::Mixture::Component::initialize(
 	const MatrixXd& data,
 	const Parameters& parameters)
@@ -142,26 +195,140 @@ MatrixXd CMT::Mixture::sample(int numSamples) const {
 
 
 ArrayXXd CMT::Mixture::posterior(const MatrixXd& data) {
-	ArrayXXd logJoint(numComponents(), data.cols());
+	ArrayXXd posterior(numComponents(), data.cols());
+
+	int numData = static_cast<int>(data.cols());
+	int batchSize = Parameters().batchSize;
 
 	#pragma omp parallel for
-	for(int k = 0; k < numComponents(); ++k)
-		logJoint.row(k) = mComponents[k]->logLikelihood(data) + log(mPriors[k]);
+	for(int b = 0; b < numData; b += batchSize) {
+		ArrayXXd logJoint = this->logJoint(data.middleCols(b, min(batchSize, numData - b)));
+
+		// normalize posterior
+		posterior.middleCols(b, logJoint.cols()) = (logJoint.rowwise() - logSumExp(logJoint)).exp();
+	}
 
-	// return normalized posterior
-	return (logJoint.rowwise() - logSumExp(logJoint)).exp();
+	return posterior;
 }
 
 
 
 Array<double, 1, Dynamic> CMT::Mixture::logLikelihood(const MatrixXd& data) const {
-	ArrayXXd logJoint(numComponents(), data.cols());
+	Array<double, 1, Dynamic> logLik(data.cols());
+
+	int numData = static_cast<int>(data.cols());
+	int batchSize = Parameters().batchSize;
 
 	#pragma omp parallel for
+	for(int b = 0; b < numData; b += batchSize) {
+		ArrayXXd logJoint = this->logJoint(data.middleCols(b, min(batchSize, numData - b)));
+		logLik.segment(b, logJoint.cols()) = logSumExp(logJoint);
+	}
+
+	return logLik;
+}
+
+
+
+/**
+ * Computes the joint log-probability of each data point and each component.
+ */
+ArrayXXd CMT::Mixture::logJoint(const Ref<const MatrixXd>& data) const {
+	ArrayXXd logJoint(numComponents(), data.cols());
+
 	for(int k = 0; k < numComponents(); ++k)
 		logJoint.row(k) = mComponents[k]->logLikelihood(data) + log(mPriors[k]);
 
-	return logSumExp(logJoint);
+	return logJoint;
+}
+
+
+
+/**
+ * Computes the average log-likelihood of the data and accumulates the sufficient
+ * statistics of all components in a single pass over the data (E). Each batch is
+ * only read once from memory and processed by all components while it is cached.
+ *
+ * @param data data points stored column-wise
+ * @param statistics will be replaced by statistics weighted by posterior probabilities
+ * @param parameters controls the size of batches
+ */
+double CMT::Mixture::expectation(
+	const MatrixXd& data,
+	vector<Component::Statistics*>& statistics,
+	const Parameters& parameters) const
+{
+	int numData = static_cast<int>(data.cols());
+	int batchSize = min(max(parameters.batchSize, 1), numData);
+
+	// thread-private statistics and log-likelihoods
+	vector<vector<Component::Statistics*> > partials(numThreads());
+	vector<double> logLiks(partials.size(), 0.);
+
+	for(int i = 0; i < partials.size(); ++i)
+		for(int k = 0; k < numComponents(); ++k)
+			partials[i].push_back(mComponents[k]->createStatistics());
+
+	#pragma omp parallel
+	{
+		int thread = threadID();
+
+		#pragma omp for schedule(static)
+		for(int b = 0; b < numData; b += batchSize) {
+			Ref<const MatrixXd> batch = data.middleCols(b, min(batchSize, numData - b));
+
+			ArrayXXd logJoint = this->logJoint(batch);
+			Array<double, 1, Dynamic> logLik = logSumExp(logJoint);
+
+			// posterior over components
+			ArrayXXd post = (logJoint.rowwise() - logLik).exp();
+
+			for(int k = 0; k < numComponents(); ++k)
+				mComponents[k]->accumulate(batch, post.row(k), *partials[thread][k]);
+
+			logLiks[thread] += logLik.sum();
+		}
+	}
+
+	// sum statistics in a fixed order
+	double logLik = logLiks[0];
+
+	for(int i = 1; i < partials.size(); ++i) {
+		for(int k = 0; k < numComponents(); ++k) {
+			*partials[0][k] += *partials[i][k];
+			delete partials[i][k];
+		}
+		logLik += logLiks[i];
+	}
+
+	for(int k = 0; k < statistics.size(); ++k)
+		delete statistics[k];
+	statistics = partials[0];
+
+	return logLik / numData;
+}
+
+
+
+/**
+ * Optimizes prior weights and components given their sufficient statistics (M).
+ */
+void CMT::Mixture::maximization(
+	const vector<Component::Statistics*>& statistics,
+	int numData,
+	const Parameters& parameters,
+	const Component::Parameters& componentParameters)
+{
+	if(parameters.trainPriors) {
+		for(int k = 0; k < numComponents(); ++k)
+			mPriors[k] = statistics[k]->weightSum / numData + parameters.regularizePriors;
+		mPriors /= mPriors.sum();
+	}
+
+	if(parameters.trainComponents)
+		#pragma omp parallel for
+		for(int k = 0; k < numComponents(); ++k)
+			mComponents[k]->train(*statistics[k], componentParameters);
 }
 
 
@@ -197,59 +364,45 @@ bool CMT::Mixture::train(
 	if(parameters.initialize && !initialized())
 		initialize(data, parameters, componentParameters);
 
-	ArrayXXd logJoint(numComponents(), data.cols());
-	Array<double, Dynamic, 1> postSum;
-	Array<double, 1, Dynamic> logLik;
-	ArrayXXd post;
-	ArrayXXd weights;
+	vector<Component::Statistics*> statistics;
 	double avgLogLoss = numeric_limits<double>::infinity();
 	double avgLogLossNew;
 
-	for(int i = 0; i < parameters.maxIter; ++i) {
-		// compute joint probability of data and assignments (E)
-		#pragma omp parallel for
-		for(int k = 0; k < numComponents(); ++k)
-			logJoint.row(k) = mComponents[k]->logLikelihood(data) + log(mPriors[k]);
+	bool converged = false;
 
-		// compute normalized posterior (E)
-		logLik = logSumExp(logJoint);
+	for(int i = 0; i < parameters.maxIter; ++i) {
+		// compute posterior and sufficient statistics (E)
+		double logLik = expectation(data, statistics, parameters);
 
 		// average negative log-likelihood in bits per component
-		avgLogLossNew = -logLik.mean() / log(2.) / dim();
+		avgLogLossNew = -logLik / log(2.) / dim();
 
 		if(parameters.verbosity > 0)
 			cout << setw(6) << i << setw(14) << setprecision(7) << avgLogLossNew << endl;
 
 		// test for convergence
-		if(avgLogLoss - avgLogLossNew < parameters.threshold)
-			return true;
+		if(avgLogLoss - avgLogLossNew < parameters.threshold) {
+			converged = true;
+			break;
+		}
 		avgLogLoss = avgLogLossNew;
 
-		// compute normalized posterior (E)
-		post = (logJoint.rowwise() - logLik).exp();
-		postSum = post.rowwise().sum();
-		weights = post.colwise() / postSum;
+		// optimize prior weights and components (M)
+		maximization(statistics, data.cols(), parameters, componentParameters);
 
-		// optimize prior weights (M)
-		if(parameters.trainPriors) {
-			mPriors = postSum / data.cols() + parameters.regularizePriors;
-			mPriors /= mPriors.sum();
-		}
-
-		// optimize components (M)
-		if(parameters.trainComponents) {
-			#pragma omp parallel for
-			for(int k = 0; k < numComponents(); ++k)
-				mComponents[k]->train(data, weights.row(k), componentParameters);
-		} else {
-			return true;
+		if(!parameters.trainComponents) {
+			converged = true;
+			break;
 		}
 	}
 
-	if(parameters.verbosity > 0)
+	for(int k = 0; k < statistics.size(); ++k)
+		delete statistics[k];
+
+	if(!converged && parameters.verbosity > 0)
 		cout << setw(6) << parameters.maxIter << setw(14) << setprecision(7) << evaluate(data) << endl;
 
-	return false;
+	return converged;
 }
 
 
@@ -263,11 +416,7 @@ bool CMT::Mixture::train(
 	if(parameters.initialize && !initialized())
 		initialize(data, parameters, componentParameters);
 
-	ArrayXXd logJoint(numComponents(), data.cols());
-	Array<double, Dynamic, 1> postSum;
-	Array<double, 1, Dynamic> logLik;
-	ArrayXXd post;
-	ArrayXXd weights;
+	vector<Component::Statistics*> statistics;
 
 	// training and validation log-loss for checking convergence
 	double avgLogLoss = numeric_limits<double>::infinity();
@@ -283,17 +432,14 @@ bool CMT::Mixture::train(
 	for(int k = 0; k < numComponents(); ++k)
 		components.push_back(mComponents[k]->copy());
 
-	for(int i = 0; i < parameters.maxIter; ++i) {
-		// compute joint probability of data and assignments (E)
-		#pragma omp parallel for
-		for(int k = 0; k < numComponents(); ++k)
-			logJoint.row(k) = mComponents[k]->logLikelihood(data) + log(mPriors[k]);
+	bool converged = false;
 
-		// compute normalized posterior (E)
-		logLik = logSumExp(logJoint);
+	for(int i = 0; i < parameters.maxIter; ++i) {
+		// compute posterior and sufficient statistics (E)
+		double logLik = expectation(data, statistics, parameters);
 
 		// average negative log-likelihood in bits per component
-		avgLogLossNew = -logLik.mean() / log(2.) / dim();
+		avgLogLossNew = -logLik / log(2.) / dim();
 
 		if(parameters.verbosity > 0) {
 			if(i % parameters.valIter == 0) {
@@ -308,28 +454,18 @@ bool CMT::Mixture::train(
 		}
 
 		// test for convergence
-		if(avgLogLoss - avgLogLossNew < parameters.threshold)
-			return true;
+		if(avgLogLoss - avgLogLossNew < parameters.threshold) {
+			converged = true;
+			break;
+		}
 		avgLogLoss = avgLogLossNew;
 
-		// compute normalized posterior (E)
-		post = (logJoint.rowwise() - logLik).exp();
-		postSum = post.rowwise().sum();
-		weights = post.colwise() / postSum;
+		// optimize prior weights and components (M)
+		maximization(statistics, data.cols(), parameters, componentParameters);
 
-		// optimize prior weights (M)
-		if(parameters.trainPriors) {
-			mPriors = postSum / data.cols() + parameters.regularizePriors;
-			mPriors /= mPriors.sum();
-		}
-
-		// optimize components (M)
-		if(parameters.trainComponents) {
-			#pragma omp parallel for
-			for(int k = 0; k < numComponents(); ++k)
-				mComponents[k]->train(data, weights.row(k), componentParameters);
-		} else {
-			return true;
+		if(!parameters.trainComponents) {
+			converged = true;
+			break;
 		}
 
 		if((i + 1) % parameters.valIter == 0) {
@@ -349,20 +485,177 @@ bool CMT::Mixture::train(
 				if(parameters.valLookAhead > 0 && counter >= parameters.valLookAhead) {
 					// set parameters to best parameters found during training
 					mPriors = priors;
-
-					for(int k = 0; k < numComponents(); ++k) {
+					for(int k = 0; k < numComponents(); ++k)
 						*mComponents[k] = *components[k];
-						delete components[k];
-					}
 
-					return true;
+					converged = true;
+					break;
 				}
 			}
 		}
 	}
 
-	if(parameters.verbosity > 0)
+	for(int k = 0; k < components.size(); ++k)
+		delete components[k];
+	for(int k = 0; k < statistics.size(); ++k)
+		delete statistics[k];
+
+	if(!converged && parameters.verbosity > 0)
 		cout << setw(6) << parameters.maxIter << setw(11) << setprecision(5) << evaluate(data) << endl;
 
-	return false;
+	return converged;
+}
+
+
+
+bool CMT::Mixture::trainOnline(
+	Stream& stream,
+	const Parameters& parameters,
+	const Component::Parameters& componentParameters)
+{
+	return trainOnline(stream, 0, parameters, componentParameters);
+}
+
+
+
+bool CMT::Mixture::trainOnline(
+	Stream& stream,
+	const MatrixXd& dataValid,
+	const Parameters& parameters,
+	const Component::Parameters& componentParameters)
+{
+	return trainOnline(stream, &dataValid, parameters, componentParameters);
+}
+
+
+
+/**
+ * Fits the mixture to batches of data read from a stream using stepwise EM. After
+ * each batch, the statistics of all components are replaced by an average of the
+ * previous statistics and the statistics of the batch, where the batch gets weight
+ * \f$(t + t_0)^{-\kappa}\f$. Only the statistics are kept, so that memory does not
+ * grow with the length of the stream.
+ *
+ * @param stream provides batches of data until it is exhausted
+ * @param dataValid validation data used for early stopping, may be null
+ * @param parameters maxIter limits the number of batches
+ * @param componentParameters passed down to components during M-step
+ */
+bool CMT::Mixture::trainOnline(
+	Stream& stream,
+	const MatrixXd* dataValid,
+	const Parameters& parameters,
+	const Component::Parameters& componentParameters)
+{
+	vector<Component::Statistics*> statistics;
+	vector<Component::Statistics*> batchStatistics;
+	MatrixXd batch;
+
+	for(int k = 0; k < numComponents(); ++k)
+		statistics.push_back(mComponents[k]->createStatistics());
+
+	// validation log-loss for checking convergence
+	double avgLogLossValid = numeric_limits<double>::infinity();
+	double avgLogLossValidNew = avgLogLossValid;
+	int counter = 0;
+
+	// backup of model parameters
+	VectorXd priors;
+	vector<Component*> components;
+
+	bool converged = false;
+
+	for(int i = 0; i < parameters.maxIter; ++i) {
+		if(!stream.next(batch))
+			break;
+
+		if(batch.rows() != dim()) {
+			for(int k = 0; k < components.size(); ++k)
+				delete components[k];
+			for(int k = 0; k < statistics.size(); ++k)
+				delete statistics[k];
+			for(int k = 0; k < batchStatistics.size(); ++k)
+				delete batchStatistics[k];
+			throw Exception("Data has wrong dimensionality.");
+		}
+
+		if(!batch.cols())
+			continue;
+
+		if(parameters.initialize && !initialized())
+			initialize(batch, parameters, componentParameters);
+
+		if(dataValid && components.empty()) {
+			avgLogLossValid = evaluate(*dataValid);
+			avgLogLossValidNew = avgLogLossValid;
+
+			priors = mPriors;
+			for(int k = 0; k < numComponents(); ++k)
+				components.push_back(mComponents[k]->copy());
+		}
+
+		// compute posterior and sufficient statistics of batch (E)
+		double logLik = expectation(batch, batchStatistics, parameters);
+
+		if(parameters.verbosity > 0) {
+			cout << setw(6) << i << setw(14) << setprecision(7) << -logLik / log(2.) / dim();
+			if(dataValid && i % parameters.valIter == 0)
+				cout << setw(14) << setprecision(7) << avgLogLossValidNew;
+			cout << endl;
+		}
+
+		// average statistics, the first batch replaces the (empty) statistics
+		double stepSize = i > 0 ? pow(i + parameters.stepSizeOffset, -parameters.stepSizeDecay) : 1.;
+
+		for(int k = 0; k < numComponents(); ++k) {
+			*batchStatistics[k] *= stepSize / batch.cols();
+			*statistics[k] *= 1. - stepSize;
+			*batchStatistics[k] += *statistics[k];
+		}
+
+		statistics.swap(batchStatistics);
+
+		// optimize prior weights and components (M)
+		maximization(statistics, 1, parameters, componentParameters);
+
+		if(!parameters.trainComponents) {
+			converged = true;
+			break;
+		}
+
+		if(dataValid && (i + 1) % parameters.valIter == 0) {
+			// check validation error
+			avgLogLossValidNew = evaluate(*dataValid);
+
+			if(avgLogLossValidNew < avgLogLossValid) {
+				// backup new found model parameters
+				priors = mPriors;
+				for(int k = 0; k < numComponents(); ++k)
+					*components[k] = *mComponents[k];
+
+				avgLogLossValid = avgLogLossValidNew;
+			} else {
+				counter++;
+
+				if(parameters.valLookAhead > 0 && counter >= parameters.valLookAhead) {
+					// set parameters to best parameters found during training
+					mPriors = priors;
+					for(int k = 0; k < numComponents(); ++k)
+						*mComponents[k] = *components[k];
+
+					converged = true;
+					break;
+				}
+			}
+		}
+	}
+
+	for(int k = 0; k < components.size(); ++k)
+		delete components[k];
+	for(int k = 0; k < statistics.size(); ++k)
+		delete statistics[k];
+	for(int k = 0; k < batchStatistics.size(); ++k)
+		delete batchStatistics[k];
+
+	return converged;
 }
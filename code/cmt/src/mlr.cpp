@@ -1,16 +1,25 @@
 #include "mlr.h"
 #include "utils.h"
 
+#include "Eigen/Cholesky"
+using Eigen::LLT;
+using Eigen::Lower;
+using Eigen::Success;
+
 #include "Eigen/Core"
 using Eigen::Array;
 using Eigen::ArrayXXd;
 using Eigen::MatrixXd;
 using Eigen::Dynamic;
 using Eigen::RowMajor;
+using Eigen::Ref;
 
 #include <cstdlib>
 using std::rand;
 
+#include <algorithm>
+using std::min;
+
 #include <cmath>
 using std::log;
 
@@ -18,12 +27,19 @@ using std::log;
 using std::pair;
 using std::make_pair;
 
+#include <vector>
+using std::vector;
+
+#include <string>
+using std::string;
+
 #include <iostream>
 
 CMT::MLR::Parameters::Parameters() :
 	Trainable::Parameters(),
 	trainWeights(true),
 	trainBiases(true),
+	newton(false),
 	regularizeWeights(0.),
 	regularizeBiases(0.)
 {
@@ -35,6 +51,7 @@ CMT::MLR::Parameters::Parameters(const Parameters& params) :
 	Trainable::Parameters(params),
 	trainWeights(params.trainWeights),
 	trainBiases(params.trainBiases),
+	newton(params.newton),
 	regularizeWeights(params.regularizeWeights),
 	regularizeBiases(params.regularizeBiases)
 {
@@ -47,6 +64,7 @@ CMT::MLR::Parameters& CMT::MLR::Parameters::operator=(const Parameters& params)
 
 	trainWeights = params.trainWeights;
 	trainBiases = params.trainBiases;
+	newton = params.newton;
 	regularizeWeights = params.regularizeWeights;
 	regularizeBiases = params.regularizeBiases;
 
@@ -74,6 +92,12 @@ CMT::MLR::~MLR() {
 
 
 
+CMT::Trainable* CMT::MLR::copy() const {
+	return new MLR(*this);
+}
+
+
+
 Array<double, 1, Dynamic> CMT::MLR::logLikelihood(
 	const MatrixXd& input,
 	const MatrixXd& output) const
@@ -94,17 +118,52 @@ Array<double, 1, Dynamic> CMT::MLR::logLikelihood(
 
 
 
+Array<double, 1, Dynamic> CMT::MLR::logLikelihood(
+	const SparseMatrixXd& input,
+	const MatrixXd& output) const
+{
+	if(input.cols() != output.cols())
+		throw Exception("Number of inputs and outputs have to be the same.");
+	if(input.rows() != mDimIn)
+		throw Exception("Inputs have wrong dimensionality.");
+	if(output.rows() != mDimOut)
+		throw Exception("Output has wrong dimensionality.");
+
+	// distribution over outputs
+	MatrixXd responses = mWeights * input;
+	ArrayXXd logProb = responses.colwise() + mBiases;
+	logProb.rowwise() -= logSumExp(logProb);
+
+	return (logProb * output.array()).colwise().sum();
+}
+
+
+
 MatrixXd CMT::MLR::sample(const MatrixXd& input) const {
 	if(input.rows() != mDimIn)
 		throw Exception("Inputs have wrong dimensionality.");
 
 	// distribution over outputs
-	ArrayXXd prob = predict(input);
+	return sampleOutputs(predict(input));
+}
+
+
+
+MatrixXd CMT::MLR::sample(const SparseMatrixXd& input) const {
+	if(input.rows() != mDimIn)
+		throw Exception("Inputs have wrong dimensionality.");
+
+	// distribution over outputs
+	return sampleOutputs(predict(input));
+}
 
-	MatrixXd output = MatrixXd::Zero(mDimOut, input.cols());
+
+
+MatrixXd CMT::MLR::sampleOutputs(const ArrayXXd& prob) const {
+	MatrixXd output = MatrixXd::Zero(mDimOut, prob.cols());
 
 	#pragma omp parallel for
-	for(int j = 0; j < input.cols(); ++j) {
+	for(int j = 0; j < prob.cols(); ++j) {
 		double urand = static_cast<double>(rand()) / RAND_MAX;
 		double cdf = 0.;
 
@@ -139,9 +198,24 @@ MatrixXd CMT::MLR::predict(const MatrixXd& input) const {
 
 
 
+MatrixXd CMT::MLR::predict(const SparseMatrixXd& input) const {
+	if(input.rows() != mDimIn)
+		throw Exception("Inputs have wrong dimensionality.");
+
+	// distribution over outputs
+	MatrixXd responses = mWeights * input;
+	ArrayXXd prob = responses.colwise() + mBiases;
+	prob.rowwise() -= logSumExp(prob);
+	prob = prob.exp();
+
+	return prob;
+}
+
+
+
 pair<pair<ArrayXXd, ArrayXXd>, Array<double, 1, Dynamic> > CMT::MLR::computeDataGradient(
-	const MatrixXd& input,
-	const MatrixXd& output) const
+	const Ref<const MatrixXd>& input,
+	const Ref<const MatrixXd>& output) const
 {
 	return make_pair(
 		make_pair(
@@ -208,11 +282,116 @@ void CMT::MLR::setParameters(
 
 
 
+vector<pair<string, int> > CMT::MLR::parameterBlocks(const Trainable::Parameters& params_) const {
+	const Parameters& params = dynamic_cast<const Parameters&>(params_);
+
+	vector<pair<string, int> > blocks;
+
+	if(params.trainWeights)
+		blocks.push_back(make_pair(string("weights"), mDimIn * (mDimOut - 1)));
+	if(params.trainBiases)
+		blocks.push_back(make_pair(string("biases"), mDimOut - 1));
+
+	return blocks;
+}
+
+
+
 double CMT::MLR::parameterGradient(
 	const MatrixXd& input,
 	const MatrixXd& output,
 	const lbfgsfloatval_t* x,
 	lbfgsfloatval_t* g,
+	const Trainable::Parameters& params) const
+{
+	return computeParameterGradient(input, 0, output, x, g, params);
+}
+
+
+
+double CMT::MLR::parameterGradient(
+	const MatrixXd& inputDense,
+	const SparseMatrixXd& inputSparse,
+	const MatrixXd& output,
+	const lbfgsfloatval_t* x,
+	lbfgsfloatval_t* g,
+	const Trainable::Parameters& params) const
+{
+	if(inputDense.rows() + inputSparse.rows() != mDimIn)
+		throw Exception("Inputs have wrong dimensionality.");
+	if(inputDense.cols() != inputSparse.cols())
+		throw Exception("Number of dense and sparse inputs must be the same.");
+
+	return computeParameterGradient(inputDense, &inputSparse, output, x, g, params);
+}
+
+
+
+MatrixXd CMT::MLR::perExampleGradients(
+	const MatrixXd& input,
+	const MatrixXd& output,
+	const Trainable::Parameters& params_) const
+{
+	const Parameters& params = dynamic_cast<const Parameters&>(params_);
+
+	if(input.rows() != mDimIn || output.rows() != mDimOut)
+		throw Exception("Data has wrong dimensionality.");
+	if(input.cols() != output.cols())
+		throw Exception("The number of inputs and outputs should be the same.");
+
+	// compute distribution over outputs
+	ArrayXXd logProb = (mWeights * input).colwise() + mBiases;
+	logProb.rowwise() -= logSumExp(logProb);
+
+	// difference between prediction and actual output
+	MatrixXd diff = (logProb.exp().matrix() - output).bottomRows(mDimOut - 1) / log(2.);
+
+	MatrixXd gradients(numParameters(params), output.cols());
+
+	#pragma omp parallel for
+	for(int n = 0; n < output.cols(); ++n) {
+		double* g = gradients.col(n).data();
+
+		if(params.trainWeights) {
+			Map<Matrix<double, Dynamic, Dynamic, RowMajor> >(g, mDimOut - 1, mDimIn) =
+				diff.col(n) * input.col(n).transpose();
+			g += (mDimOut - 1) * mDimIn;
+		}
+
+		if(params.trainBiases)
+			VectorLBFGS(g, mDimOut - 1) = diff.col(n);
+	}
+
+	// gradients of regularizers are the same for all data points
+	VectorXd regularization(gradients.rows());
+	double* g = regularization.data();
+
+	if(params.trainWeights) {
+		Map<Matrix<double, Dynamic, Dynamic, RowMajor> >(g, mDimOut - 1, mDimIn) =
+			params.regularizeWeights.gradient(mWeights.bottomRows(mDimOut - 1).transpose()).transpose();
+		g += (mDimOut - 1) * mDimIn;
+	}
+
+	if(params.trainBiases)
+		VectorLBFGS(g, mDimOut - 1) = params.regularizeBiases.gradient(mBiases).bottomRows(mDimOut - 1);
+
+	gradients.colwise() += regularization;
+
+	return gradients;
+}
+
+
+
+/**
+ * Computes the gradient for inputs which are given by a dense part stacked on
+ * top of an optional sparse part.
+ */
+double CMT::MLR::computeParameterGradient(
+	const MatrixXd& input,
+	const SparseMatrixXd* inputSparse,
+	const MatrixXd& output,
+	const lbfgsfloatval_t* x,
+	lbfgsfloatval_t* g,
 	const Trainable::Parameters& params_) const
 {
 	const Parameters& params = dynamic_cast<const Parameters&>(params_);
@@ -230,8 +409,16 @@ double CMT::MLR::parameterGradient(
 		for(int i = 1; i < mBiases.rows(); ++i, ++k)
 			biases[i] = x[k];
 
+	// dimensionality of dense and sparse parts of the input
+	int dimDense = static_cast<int>(input.rows());
+	int dimSparse = mDimIn - dimDense;
+
 	// compute distribution over outputs
-	ArrayXXd logProb = (weights * input).colwise() + biases;
+	MatrixXd responses = weights.leftCols(dimDense) * input;
+	if(inputSparse && dimSparse)
+		responses += weights.rightCols(dimSparse) * *inputSparse;
+
+	ArrayXXd logProb = responses.colwise() + biases;
 	logProb.rowwise() -= logSumExp(logProb);
 
 	// difference between prediction and actual output
@@ -245,7 +432,9 @@ double CMT::MLR::parameterGradient(
 
 		if(params.trainWeights) {
 			Map<Matrix<double, Dynamic, Dynamic, RowMajor> > weightsGrad(g, mDimOut - 1, mDimIn);
-			weightsGrad = (diff * input.transpose() / normConst).bottomRows(mDimOut - 1);
+			weightsGrad.leftCols(dimDense) = (diff * input.transpose() / normConst).bottomRows(mDimOut - 1);
+			if(inputSparse && dimSparse)
+				weightsGrad.rightCols(dimSparse) = (diff.bottomRows(mDimOut - 1) * inputSparse->transpose()) / normConst;
 			offset += weightsGrad.size();
 
 			weightsGrad += params.regularizeWeights.gradient(
@@ -255,7 +444,7 @@ double CMT::MLR::parameterGradient(
 		if(params.trainBiases) {
 			VectorLBFGS biasesGrad(g + offset, mDimOut - 1);
 			biasesGrad = diff.rowwise().sum().bottomRows(mDimOut - 1) / normConst;
-			biasesGrad += params.regularizeBiases.gradient(biases);
+			biasesGrad += params.regularizeBiases.gradient(biases).bottomRows(mDimOut - 1);
 		}
 	}
 
@@ -273,6 +462,149 @@ double CMT::MLR::parameterGradient(
 
 
 
+bool CMT::MLR::train(
+	const MatrixXd& input,
+	const MatrixXd& output,
+	const MatrixXd* inputVal,
+	const MatrixXd* outputVal,
+	const Trainable::Parameters& params_)
+{
+	const Parameters& params = dynamic_cast<const Parameters&>(params_);
+
+	// L1 penalties are not twice differentiable
+	bool smooth =
+		!(params.trainWeights && params.regularizeWeights.norm() == Regularizer::L1
+			&& params.regularizeWeights.strength() > 0.) &&
+		!(params.trainBiases && params.regularizeBiases.norm() == Regularizer::L1
+			&& params.regularizeBiases.strength() > 0.);
+
+	if(params.newton && smooth && !inputVal && !outputVal)
+		return trainNewton(input, output, params);
+
+	return Trainable::train(input, output, inputVal, outputVal, params);
+}
+
+
+
+/**
+ * Computes a search direction using a block-diagonal approximation of the
+ * Hessian, ignoring interactions between the parameters of different outputs.
+ * Each block is of the form X W X^T, where W = p(1 - p), and is solved
+ * independently.
+ */
+bool CMT::MLR::newtonDirection(
+	const MatrixXd& input,
+	const MatrixXd& output,
+	const lbfgsfloatval_t* x,
+	const lbfgsfloatval_t* g,
+	lbfgsfloatval_t* d,
+	const Trainable::Parameters& params_) const
+{
+	const Parameters& params = dynamic_cast<const Parameters&>(params_);
+
+	MatrixXd weights = mWeights;
+	VectorXd biases = mBiases;
+
+	// copy parameters
+	int k = 0;
+	if(params.trainWeights)
+		for(int i = 1; i < weights.rows(); ++i)
+			for(int j = 0; j < weights.cols(); ++j, ++k)
+				weights(i, j) = x[k];
+	if(params.trainBiases)
+		for(int i = 1; i < mBiases.rows(); ++i, ++k)
+			biases[i] = x[k];
+
+	int numData = static_cast<int>(input.cols());
+	int batchSize = min(params.batchSize, numData);
+
+	double normConst = numData * log(2.);
+
+	int dimWeights = params.trainWeights ? mDimIn : 0;
+	int dimBlock = dimWeights + (params.trainBiases ? 1 : 0);
+	int offset = params.trainWeights ? (mDimOut - 1) * mDimIn : 0;
+
+	// blocks of the Hessian belonging to different classes are ignored
+	vector<MatrixXd> hessians(mDimOut - 1, MatrixXd::Zero(dimBlock, dimBlock));
+
+	// accumulate Hessians over batches, so that scaled inputs are never larger than a batch
+	#pragma omp parallel for
+	for(int b = 0; b < numData; b += batchSize) {
+		const Ref<const MatrixXd> inputBatch = input.middleCols(b, min(batchSize, numData - b));
+
+		// compute distribution over outputs
+		ArrayXXd prob = (weights * inputBatch).colwise() + biases;
+		prob.rowwise() -= logSumExp(prob);
+		prob = prob.exp();
+
+		vector<MatrixXd> hessians_(mDimOut - 1, MatrixXd::Zero(dimBlock, dimBlock));
+
+		for(int i = 1; i < mDimOut; ++i) {
+			Array<double, 1, Dynamic> curvature = prob.row(i) * (1. - prob.row(i));
+
+			MatrixXd& hessian = hessians_[i - 1];
+
+			if(dimWeights) {
+				MatrixXd inputScaled = inputBatch.array().rowwise() * curvature.sqrt();
+				hessian.topLeftCorner(dimWeights, dimWeights).selfadjointView<Lower>().rankUpdate(inputScaled);
+
+				if(params.trainBiases)
+					hessian.block(dimWeights, 0, 1, dimWeights) =
+						(inputBatch * curvature.matrix().transpose()).transpose();
+			}
+
+			if(params.trainBiases)
+				hessian(dimWeights, dimWeights) = curvature.sum();
+		}
+
+		#pragma omp critical
+		for(int i = 0; i < hessians.size(); ++i)
+			hessians[i] += hessians_[i];
+	}
+
+	MatrixXd hessianWeights = params.regularizeWeights.hessian(mDimIn);
+	double hessianBias = params.regularizeBiases.hessian(1)(0, 0);
+
+	bool success = true;
+
+	#pragma omp parallel for
+	for(int i = 1; i < mDimOut; ++i) {
+		MatrixXd hessian = hessians[i - 1] / normConst;
+		VectorXd gradient(dimBlock);
+
+		if(dimWeights) {
+			hessian.topLeftCorner(dimWeights, dimWeights) += hessianWeights;
+
+			for(int j = 0; j < dimWeights; ++j)
+				gradient[j] = g[(i - 1) * mDimIn + j];
+		}
+
+		if(params.trainBiases) {
+			hessian(dimWeights, dimWeights) += hessianBias;
+			gradient[dimWeights] = g[offset + i - 1];
+		}
+
+		LLT<MatrixXd, Lower> llt(hessian);
+
+		if(llt.info() != Success) {
+			#pragma omp critical
+			success = false;
+			continue;
+		}
+
+		VectorXd direction = -llt.solve(gradient);
+
+		for(int j = 0; j < dimWeights; ++j)
+			d[(i - 1) * mDimIn + j] = direction[j];
+		if(params.trainBiases)
+			d[offset + i - 1] = direction[dimWeights];
+	}
+
+	return success;
+}
+
+
+
 double CMT::MLR::evaluate(
 	const MatrixXd& input,
 	const MatrixXd& output) const
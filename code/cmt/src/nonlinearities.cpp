@@ -6,10 +6,15 @@
 using std::exp;
 using std::log;
 using std::tanh;
+using std::fabs;
+
+#include <algorithm>
+using std::upper_bound;
 
 #include "Eigen/Core"
 using Eigen::ArrayXd;
 using Eigen::ArrayXXd;
+using Eigen::ArrayXXi;
 
 CMT::Nonlinearity::~Nonlinearity() {
 }
@@ -170,10 +175,11 @@ void CMT::HistogramNonlinearity::initialize(
 		counter[k] = 0;
 	}
 
+	ArrayXXi bins = this->bins(inputs);
+
 	for(int i = 0; i < inputs.rows(); ++i)
 		for(int j = 0; j < inputs.cols(); ++j) {
-			// find bin
-			int k = bin(inputs(i, j));
+			int k = bins(i, j);
 
 			// update histogram
 			counter[k] += 1;
@@ -189,13 +195,7 @@ void CMT::HistogramNonlinearity::initialize(
 
 
 ArrayXXd CMT::HistogramNonlinearity::operator()(const ArrayXXd& inputs) const {
-	ArrayXXd outputs(inputs.rows(), inputs.cols());
-
-	for(int i = 0; i < inputs.rows(); ++i)
-		for(int j = 0; j < inputs.cols(); ++j)
-			outputs(i, j) = mHistogram[bin(inputs(i, j))] + mEpsilon;
-
-	return outputs;
+	return evaluate(bins(inputs));
 }
 
 
@@ -210,11 +210,70 @@ double CMT::HistogramNonlinearity::operator()(double input) const {
  * Finds index into histogram.
  */
 int CMT::HistogramNonlinearity::bin(double input) const {
-	// find bin
-	for(int k = 0; k < mBinEdges.size() - 1; ++k)
-		if(input < mBinEdges[k + 1])
-			return k;
-	return mHistogram.size() - 1;
+	// find first bin whose upper edge is larger than the input
+	return upper_bound(mBinEdges.begin() + 1, mBinEdges.end() - 1, input) - mBinEdges.begin() - 1;
+}
+
+
+
+/**
+ * Finds indices into histogram for many inputs at once. If the bin edges are
+ * evenly spaced, bins are computed directly instead of searched for.
+ *
+ * @param inputs points at which the nonlinearity will be evaluated
+ * @return index into histogram for each input
+ */
+ArrayXXi CMT::HistogramNonlinearity::bins(const ArrayXXd& inputs) const {
+	ArrayXXi bins(inputs.rows(), inputs.cols());
+
+	int numBins = mHistogram.size();
+	double binWidth = (mBinEdges.back() - mBinEdges.front()) / numBins;
+
+	// test whether bin edges are evenly spaced
+	bool uniform = binWidth > 0.;
+	for(int k = 1; uniform && k < numBins; ++k)
+		if(fabs(mBinEdges[k] - mBinEdges[0] - k * binWidth) > 1e-6 * binWidth)
+			uniform = false;
+
+	if(!uniform) {
+		for(int i = 0; i < inputs.size(); ++i)
+			bins.data()[i] = bin(inputs.data()[i]);
+		return bins;
+	}
+
+	for(int i = 0; i < inputs.size(); ++i) {
+		double input = inputs.data()[i];
+		double position = (input - mBinEdges[0]) / binWidth;
+
+		// also maps NaNs to the last bin, like bin()
+		int k = position < 0. ? 0 : (position < numBins - 1 ? static_cast<int>(position) : numBins - 1);
+
+		// correct for rounding errors
+		if(k > 0 && input < mBinEdges[k])
+			k -= 1;
+		else if(k < numBins - 1 && input >= mBinEdges[k + 1])
+			k += 1;
+
+		bins.data()[i] = k;
+	}
+
+	return bins;
+}
+
+
+
+/**
+ * Evaluates the nonlinearity for precomputed bins.
+ *
+ * @param bins indices into histogram as returned by L{bins()}
+ */
+ArrayXXd CMT::HistogramNonlinearity::evaluate(const ArrayXXi& bins) const {
+	ArrayXXd outputs(bins.rows(), bins.cols());
+
+	for(int i = 0; i < bins.size(); ++i)
+		outputs.data()[i] = mHistogram[bins.data()[i]] + mEpsilon;
+
+	return outputs;
 }
 
 
@@ -252,10 +311,31 @@ ArrayXXd CMT::HistogramNonlinearity::gradient(const ArrayXXd& inputs) const {
 		throw Exception("Data has to be stored in one row.");
 
 	ArrayXXd gradient = ArrayXXd::Zero(mHistogram.size(), inputs.cols());
+	ArrayXXi bins = this->bins(inputs);
 
-	for(int i = 0; i < inputs.rows(); ++i)
-		for(int j = 0; j < inputs.rows(); ++j)
-			gradient(bin(inputs(i, j)), j) = 1;
+	for(int j = 0; j < inputs.cols(); ++j)
+		gradient(bins(0, j), j) = 1;
+
+	return gradient;
+}
+
+
+
+/**
+ * Computes the gradient of a weighted sum of outputs with respect to the
+ * histogram, without creating the gradient for each input.
+ *
+ * @param bins indices into histogram as returned by L{bins()}
+ * @param weights weight of each output
+ */
+ArrayXd CMT::HistogramNonlinearity::gradient(const ArrayXXi& bins, const ArrayXXd& weights) const {
+	if(bins.rows() != weights.rows() || bins.cols() != weights.cols())
+		throw Exception("Bins and weights have to have same size.");
+
+	ArrayXd gradient = ArrayXd::Zero(mHistogram.size());
+
+	for(int i = 0; i < bins.size(); ++i)
+		gradient[bins.data()[i]] += weights.data()[i];
 
 	return gradient;
 }
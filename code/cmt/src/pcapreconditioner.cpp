@@ -9,15 +9,68 @@ CMT::PCAPreconditioner::PCAPreconditioner(
 	const ArrayXXd& input,
 	const ArrayXXd& output,
 	double varExplained,
-	int numPCs)
+	int numPCs,
+	double tolerance)
 {
 	if(input.cols() != output.cols())
 		throw Exception("Number of inputs and outputs must be the same."); 
 
 	if(input.rows() < 1) {
-		mMeanOut = output.rowwise().mean();
+		Moments moments(output.rows());
+		moments.add(output.matrix());
 
-		MatrixXd covYY = covariance(output);
+		initialize(moments, 0, varExplained, numPCs, tolerance);
+	} else {
+		// compute means and covariances of stacked input and output
+		Moments moments(input.rows() + output.rows());
+		moments.add(input.matrix(), output.matrix());
+
+		initialize(moments, input.rows(), varExplained, numPCs, tolerance);
+	}
+}
+
+
+
+CMT::PCAPreconditioner::PCAPreconditioner(
+	const VectorXd& eigenvalues,
+	const VectorXd& meanIn,
+	const VectorXd& meanOut,
+	const MatrixXd& preIn,
+	const MatrixXd& preInInv,
+	const MatrixXd& preOut,
+	const MatrixXd& preOutInv,
+	const MatrixXd& predictor) :
+	AffinePreconditioner(
+		meanIn, meanOut, preIn, preInInv, preOut, preOutInv, predictor),
+	mEigenvalues(eigenvalues)
+{
+}
+
+
+
+/**
+ * Computes the principal components of the inputs and whitening transforms
+ * from the means and covariances of inputs stacked on top of outputs.
+ *
+ * @param moments moments of stacked inputs and outputs
+ * @param dimIn dimensionality of the inputs
+ */
+void CMT::PCAPreconditioner::initialize(
+	const Moments& moments,
+	int dimIn,
+	double varExplained,
+	int numPCs,
+	double tolerance)
+{
+	if(dimIn < 0 || dimIn > moments.dim())
+		throw Exception("Number of inputs is inconsistent with the dimensionality of the data.");
+
+	int dimOut = moments.dim() - dimIn;
+
+	if(dimIn == 0) {
+		mMeanOut = moments.mean();
+
+		MatrixXd covYY = moments.covariance();
 
 		SelfAdjointEigenSolver<MatrixXd> eigenSolver;
 		eigenSolver.compute(covYY);
@@ -26,25 +79,20 @@ CMT::PCAPreconditioner::PCAPreconditioner(
 
 		mLogJacobian = mPreOut.partialPivLu().matrixLU().diagonal().array().abs().log().sum();
 	} else {
-		mMeanIn = input.rowwise().mean();
-		mMeanOut = output.rowwise().mean();
-
-		// concatenate input and output
-		ArrayXXd data(input.rows() + output.rows(), input.cols());
-		data << input.matrix().colwise() - mMeanIn, output.matrix().colwise() - mMeanOut;
+		mMeanIn = moments.mean().head(dimIn);
+		mMeanOut = moments.mean().tail(dimOut);
 
-		// compute covariances
-		MatrixXd cov = covariance(data);
-		MatrixXd covXX = cov.topLeftCorner(input.rows(), input.rows());
-		MatrixXd covYX = cov.bottomLeftCorner(output.rows(), input.rows());
-		MatrixXd covYY = cov.bottomRightCorner(output.rows(), output.rows());
+		MatrixXd cov = moments.covariance();
+		MatrixXd covXX = cov.topLeftCorner(dimIn, dimIn);
+		MatrixXd covYX = cov.bottomLeftCorner(dimOut, dimIn);
+		MatrixXd covYY = cov.bottomRightCorner(dimOut, dimOut);
 
-		SelfAdjointEigenSolver<MatrixXd> eigenSolver;
-		eigenSolver.compute(covXX);
-		mEigenvalues = eigenSolver.eigenvalues();
+		// largest eigenvalues and eigenvectors, possibly not all of them
+		MatrixXd eigenvectors;
+		largestEigenvectors(covXX, mEigenvalues, eigenvectors, numPCs, varExplained, tolerance);
 
 		if(numPCs < 0) {
-			double totalVariance = mEigenvalues.sum();
+			double totalVariance = covXX.trace();
 			double varExplainedSoFar = 0.;
 			numPCs = 0;
 
@@ -58,14 +106,15 @@ CMT::PCAPreconditioner::PCAPreconditioner(
 
 		// input whitening
 		mPreIn = mEigenvalues.tail(numPCs).cwiseSqrt().cwiseInverse().asDiagonal() *
-			eigenSolver.eigenvectors().rightCols(numPCs).transpose();
-		mPreInInv = eigenSolver.eigenvectors().rightCols(numPCs) *
+			eigenvectors.rightCols(numPCs).transpose();
+		mPreInInv = eigenvectors.rightCols(numPCs) *
 			mEigenvalues.tail(numPCs).cwiseSqrt().asDiagonal();
 
 		// optimal linear predictor
 		mPredictor = covYX * mPreIn.transpose();
 
 		// output whitening
+		SelfAdjointEigenSolver<MatrixXd> eigenSolver;
 		eigenSolver.compute(covYY - mPredictor * mPredictor.transpose());
 		mPreOut = eigenSolver.operatorInverseSqrt();
 		mPreOutInv = eigenSolver.operatorSqrt();
@@ -74,20 +123,3 @@ CMT::PCAPreconditioner::PCAPreconditioner(
 		mLogJacobian = mPreOut.partialPivLu().matrixLU().diagonal().array().abs().log().sum();
 	}
 }
-
-
-
-CMT::PCAPreconditioner::PCAPreconditioner(
-	const VectorXd& eigenvalues,
-	const VectorXd& meanIn,
-	const VectorXd& meanOut,
-	const MatrixXd& preIn,
-	const MatrixXd& preInInv,
-	const MatrixXd& preOut,
-	const MatrixXd& preOutInv,
-	const MatrixXd& predictor) :
-	AffinePreconditioner(
-		meanIn, meanOut, preIn, preInInv, preOut, preOutInv, predictor),
-	mEigenvalues(eigenvalues)
-{
-}
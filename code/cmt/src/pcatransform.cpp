@@ -2,9 +2,6 @@
 #include "exception.h"
 #include "pcatransform.h"
 
-#include "Eigen/Eigenvalues"
-using Eigen::SelfAdjointEigenSolver;
-
 #include <iostream>
 using std::cout;
 using std::endl;
@@ -13,9 +10,13 @@ CMT::PCATransform::PCATransform(
 	const ArrayXXd& input,
 	const ArrayXXd& output,
 	double varExplained,
-	int numPCs)
+	int numPCs,
+	double tolerance)
 {
-	initialize(input, varExplained, numPCs, output.rows());
+	Moments moments(input.rows());
+	moments.add(input.matrix());
+
+	initialize(moments, input.rows(), varExplained, numPCs, output.rows(), tolerance);
 }
 
 
@@ -24,9 +25,13 @@ CMT::PCATransform::PCATransform(
 	const ArrayXXd& input,
 	double varExplained,
 	int numPCs,
-	int dimOut)
+	int dimOut,
+	double tolerance)
 {
-	initialize(input, varExplained, numPCs, dimOut);
+	Moments moments(input.rows());
+	moments.add(input.matrix());
+
+	initialize(moments, input.rows(), varExplained, numPCs, dimOut, tolerance);
 }
 
 
@@ -52,32 +57,45 @@ CMT::PCATransform::PCATransform(const PCATransform& transform) :
 
 
 
+/**
+ * Computes the principal components of the inputs from their mean and
+ * covariance. Other rows of the moments, such as outputs stacked below the
+ * inputs, are ignored.
+ *
+ * @param moments moments of the inputs, possibly stacked on top of outputs
+ * @param dimIn dimensionality of the inputs
+ */
 void CMT::PCATransform::initialize(
-	const ArrayXXd& input,
+	const Moments& moments,
+	int dimIn,
 	double varExplained,
 	int numPCs,
-	int dimOut)
+	int dimOut,
+	double tolerance)
 {
+	if(dimIn < 0 || dimIn > moments.dim())
+		throw Exception("Number of inputs is inconsistent with the dimensionality of the data.");
+
 	mMeanOut = VectorXd::Zero(dimOut);
 	mPreOut = MatrixXd::Identity(dimOut, dimOut);
 	mPreOutInv = MatrixXd::Identity(dimOut, dimOut);
-	mGradTransform = MatrixXd::Zero(dimOut, input.rows());
+	mGradTransform = MatrixXd::Zero(dimOut, dimIn);
 	mLogJacobian = 0.;
 
-	if(input.rows() < 1)
+	if(dimIn < 1)
 		return;
 
-	mMeanIn = input.rowwise().mean();
+	mMeanIn = moments.mean().head(dimIn);
 
 	// compute covariances
-	MatrixXd covXX = covariance(input);
+	MatrixXd covXX = moments.covariance().topLeftCorner(dimIn, dimIn);
 
-	SelfAdjointEigenSolver<MatrixXd> eigenSolver;
-	eigenSolver.compute(covXX);
-	mEigenvalues = eigenSolver.eigenvalues();
+	// largest eigenvalues and eigenvectors, possibly not all of them
+	MatrixXd eigenvectors;
+	largestEigenvectors(covXX, mEigenvalues, eigenvectors, numPCs, varExplained, tolerance);
 
 	if(numPCs < 0) {
-		double totalVariance = mEigenvalues.sum();
+		double totalVariance = covXX.trace();
 		double varExplainedSoFar = 0.;
 		numPCs = 0;
 
@@ -102,7 +120,7 @@ void CMT::PCATransform::initialize(
 
 	// input whitening
 	mPreIn = tmp.tail(numPCs).cwiseSqrt().cwiseInverse().asDiagonal() *
-		eigenSolver.eigenvectors().rightCols(numPCs).transpose();
-	mPreInInv = eigenSolver.eigenvectors().rightCols(numPCs) *
+		eigenvectors.rightCols(numPCs).transpose();
+	mPreInInv = eigenvectors.rightCols(numPCs) *
 		tmp.tail(numPCs).cwiseSqrt().asDiagonal();
 }
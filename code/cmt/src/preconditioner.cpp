@@ -1,9 +1,14 @@
+#include "exception.h"
+#include "utils.h"
 #include "preconditioner.h"
+#include "conditionaldistribution.h"
 
 #include "Eigen/Core"
 using Eigen::Array;
 using Eigen::ArrayXXd;
+using Eigen::MatrixXd;
 using Eigen::Dynamic;
+using Eigen::Ref;
 
 #include <utility>
 using std::pair;
@@ -42,3 +47,75 @@ pair<ArrayXXd, ArrayXXd> CMT::Preconditioner::adjustGradient(
 {
 	return adjustGradient(dataGradient.first, dataGradient.second);
 }
+
+
+
+/**
+ * Preconditions inputs and writes the result into a preallocated buffer. Buffers
+ * may share memory with the data they are computed from, so that data can be
+ * transformed in place. Buffers for preconditioned inputs and outputs must not
+ * overlap each other.
+ */
+void CMT::Preconditioner::transform(
+	const Ref<const MatrixXd>& input,
+	Ref<MatrixXd> inputPre) const
+{
+	if(inputPre.rows() != dimInPre() || inputPre.cols() != input.cols())
+		throw Exception("Buffer for preconditioned input has wrong size.");
+	inputPre = operator()(input.array()).matrix();
+}
+
+
+
+void CMT::Preconditioner::transform(
+	const Ref<const MatrixXd>& input,
+	const Ref<const MatrixXd>& output,
+	Ref<MatrixXd> inputPre,
+	Ref<MatrixXd> outputPre) const
+{
+	if(inputPre.rows() != dimInPre() || inputPre.cols() != input.cols())
+		throw Exception("Buffer for preconditioned input has wrong size.");
+	if(outputPre.rows() != dimOutPre() || outputPre.cols() != output.cols())
+		throw Exception("Buffer for preconditioned output has wrong size.");
+	if(overlap(inputPre, outputPre))
+		throw Exception("Buffers for preconditioned inputs and outputs must not overlap.");
+
+	pair<ArrayXXd, ArrayXXd> data = operator()(input.array(), output.array());
+
+	inputPre = data.first.matrix();
+	outputPre = data.second.matrix();
+}
+
+
+
+void CMT::Preconditioner::inverseTransform(
+	const Ref<const MatrixXd>& inputPre,
+	const Ref<const MatrixXd>& outputPre,
+	Ref<MatrixXd> output) const
+{
+	if(output.rows() != dimOut() || output.cols() != outputPre.cols())
+		throw Exception("Buffer for output has wrong size.");
+	output = inverse(inputPre.array(), outputPre.array()).second.matrix();
+}
+
+
+
+/**
+ * Preconditions the input, samples from the model and transforms the sampled
+ * output back. The preconditioned input is stored in the given buffer, which is
+ * only reallocated if its size changes, so that it can be reused across calls.
+ * The output may share memory with the input, but the buffer may not.
+ */
+void CMT::Preconditioner::sample(
+	const ConditionalDistribution& model,
+	const Ref<const MatrixXd>& input,
+	MatrixXd& inputPre,
+	Ref<MatrixXd> output) const
+{
+	if(overlap(inputPre, input) || overlap(inputPre, output))
+		throw Exception("Buffer for preconditioned input must not overlap inputs or outputs.");
+
+	inputPre.resize(dimInPre(), input.cols());
+	transform(input, inputPre);
+	inverseTransform(inputPre, model.sample(inputPre), output);
+}
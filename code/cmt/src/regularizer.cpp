@@ -77,3 +77,22 @@ MatrixXd CMT::Regularizer::gradient(const MatrixXd& parameters) const {
 
 	return MatrixXd::Zero(parameters.rows(), parameters.cols());
 }
+
+
+
+/**
+ * Returns the Hessian of the penalty with respect to a parameter vector of the
+ * given dimensionality. The L1 penalty is treated as having zero curvature.
+ */
+MatrixXd CMT::Regularizer::hessian(int dim) const {
+	if(mNorm == L1)
+		return MatrixXd::Zero(dim, dim);
+
+	if(mUseMatrix) {
+		if(mTransform.cols() != dim)
+			throw Exception("Regularizer transform and parameters are incompatible.");
+		return mStrength * 2. * mTT;
+	}
+
+	return mStrength * 2. * MatrixXd::Identity(dim, dim);
+}
@@ -0,0 +1,243 @@
+#include "exception.h"
+#include "stackedaffinetransform.h"
+#include "binningtransform.h"
+
+#include "Eigen/Core"
+using Eigen::ArrayXXd;
+using Eigen::MatrixXd;
+using Eigen::VectorXd;
+using Eigen::Ref;
+
+#include <utility>
+using std::pair;
+using std::make_pair;
+
+#include <vector>
+using std::vector;
+
+using CMT::AffineTransform;
+using CMT::BinningTransform;
+using CMT::StackedAffineTransform;
+
+/**
+ * Creates a copy which keeps the structure of the given transform.
+ */
+static AffineTransform* copyTransform(const AffineTransform& transform) {
+	const BinningTransform* binningTransform =
+		dynamic_cast<const BinningTransform*>(&transform);
+	if(binningTransform)
+		return new BinningTransform(*binningTransform);
+
+	const StackedAffineTransform* stackedTransform =
+		dynamic_cast<const StackedAffineTransform*>(&transform);
+	if(stackedTransform)
+		return new StackedAffineTransform(*stackedTransform);
+
+	// other transforms are fully described by their mean and matrices
+	return new AffineTransform(transform);
+}
+
+
+
+CMT::StackedAffineTransform::StackedAffineTransform(
+	const vector<const AffineTransform*>& transforms,
+	int dimOut)
+{
+	initialize(transforms, dimOut);
+}
+
+
+
+CMT::StackedAffineTransform::StackedAffineTransform(const StackedAffineTransform& transform) :
+	AffineTransform(transform),
+	mDimInPre(transform.mDimInPre)
+{
+	for(int i = 0; i < transform.mTransforms.size(); ++i)
+		mTransforms.push_back(copyTransform(*transform.mTransforms[i]));
+}
+
+
+
+CMT::StackedAffineTransform::~StackedAffineTransform() {
+	for(int i = 0; i < mTransforms.size(); ++i)
+		delete mTransforms[i];
+}
+
+
+
+StackedAffineTransform& CMT::StackedAffineTransform::operator=(const StackedAffineTransform& transform) {
+	if(this == &transform)
+		return *this;
+
+	// copy components before releasing the old ones
+	vector<AffineTransform*> transforms;
+	for(int i = 0; i < transform.mTransforms.size(); ++i)
+		transforms.push_back(copyTransform(*transform.mTransforms[i]));
+
+	for(int i = 0; i < mTransforms.size(); ++i)
+		delete mTransforms[i];
+
+	AffineTransform::operator=(transform);
+
+	mDimInPre = transform.mDimInPre;
+	mTransforms = transforms;
+
+	return *this;
+}
+
+
+
+int CMT::StackedAffineTransform::dimInPre() const {
+	return mDimInPre;
+}
+
+
+
+/**
+ * Builds the block-diagonal matrix of the components.
+ */
+MatrixXd CMT::StackedAffineTransform::preIn() const {
+	MatrixXd preIn = MatrixXd::Zero(dimInPre(), dimIn());
+
+	for(int i = 0, offset = 0, offsetPre = 0; i < mTransforms.size(); ++i) {
+		const AffineTransform& component = *mTransforms[i];
+
+		preIn.block(offsetPre, offset, component.dimInPre(), component.dimIn()) = component.preIn();
+
+		offset += component.dimIn();
+		offsetPre += component.dimInPre();
+	}
+
+	return preIn;
+}
+
+
+
+MatrixXd CMT::StackedAffineTransform::preInInv() const {
+	MatrixXd preInInv = MatrixXd::Zero(dimIn(), dimInPre());
+
+	for(int i = 0, offset = 0, offsetPre = 0; i < mTransforms.size(); ++i) {
+		const AffineTransform& component = *mTransforms[i];
+
+		preInInv.block(offset, offsetPre, component.dimIn(), component.dimInPre()) = component.preInInv();
+
+		offset += component.dimIn();
+		offsetPre += component.dimInPre();
+	}
+
+	return preInInv;
+}
+
+
+
+void CMT::StackedAffineTransform::initialize(
+	const vector<const AffineTransform*>& transforms,
+	int dimOut)
+{
+	if(transforms.empty())
+		throw Exception("At least one transform is required.");
+
+	int dimIn = 0;
+	int dimInPre = 0;
+
+	for(int i = 0; i < transforms.size(); ++i) {
+		dimIn += transforms[i]->dimIn();
+		dimInPre += transforms[i]->dimInPre();
+	}
+
+	mDimInPre = dimInPre;
+	mMeanIn = VectorXd(dimIn);
+
+	for(int i = 0, offset = 0; i < transforms.size(); ++i) {
+		const AffineTransform& component = *transforms[i];
+
+		mMeanIn.segment(offset, component.dimIn()) = component.meanIn();
+		mTransforms.push_back(copyTransform(component));
+
+		offset += component.dimIn();
+	}
+
+	mMeanOut = VectorXd::Zero(dimOut);
+	mPreOut = MatrixXd::Identity(dimOut, dimOut);
+	mPreOutInv = MatrixXd::Identity(dimOut, dimOut);
+	mPredictor = MatrixXd::Zero(dimOut, dimInPre);
+	mGradTransform = MatrixXd::Zero(dimOut, dimIn);
+	mLogJacobian = 0.;
+}
+
+
+
+ArrayXXd CMT::StackedAffineTransform::operator()(const ArrayXXd& input) const {
+	ArrayXXd inputTr(dimInPre(), input.cols());
+	transform(input.matrix(), inputTr.matrix());
+	return inputTr;
+}
+
+
+
+ArrayXXd CMT::StackedAffineTransform::inverse(const ArrayXXd& input) const {
+	if(input.rows() != dimInPre())
+		throw Exception("Input has wrong dimensionality.");
+
+	ArrayXXd inputTr(dimIn(), input.cols());
+
+	for(int i = 0, offset = 0, offsetPre = 0; i < mTransforms.size(); ++i) {
+		const AffineTransform& component = *mTransforms[i];
+
+		inputTr.middleRows(offset, component.dimIn()) =
+			component.inverse(input.middleRows(offsetPre, component.dimInPre()));
+
+		offset += component.dimIn();
+		offsetPre += component.dimInPre();
+	}
+
+	return inputTr;
+}
+
+
+
+void CMT::StackedAffineTransform::transform(
+	const Ref<const MatrixXd>& input,
+	Ref<MatrixXd> inputPre) const
+{
+	if(input.rows() != dimIn())
+		throw Exception("Input has wrong dimensionality.");
+	if(inputPre.rows() != dimInPre() || inputPre.cols() != input.cols())
+		throw Exception("Buffer for preconditioned input has wrong size.");
+
+	for(int i = 0, offset = 0, offsetPre = 0; i < mTransforms.size(); ++i) {
+		const AffineTransform& component = *mTransforms[i];
+
+		component.transform(
+			input.middleRows(offset, component.dimIn()),
+			inputPre.middleRows(offsetPre, component.dimInPre()));
+
+		offset += component.dimIn();
+		offsetPre += component.dimInPre();
+	}
+}
+
+
+
+pair<ArrayXXd, ArrayXXd> CMT::StackedAffineTransform::adjustGradient(
+	const ArrayXXd& inputGradient,
+	const ArrayXXd& outputGradient) const
+{
+	if(inputGradient.rows() != dimInPre())
+		throw Exception("Gradient has wrong dimensionality.");
+
+	ArrayXXd inputGradientTr(dimIn(), inputGradient.cols());
+
+	for(int i = 0, offset = 0, offsetPre = 0; i < mTransforms.size(); ++i) {
+		const AffineTransform& component = *mTransforms[i];
+
+		inputGradientTr.middleRows(offset, component.dimIn()) = component.adjustGradient(
+			inputGradient.middleRows(offsetPre, component.dimInPre()),
+			outputGradient).first;
+
+		offset += component.dimIn();
+		offsetPre += component.dimInPre();
+	}
+
+	return make_pair(inputGradientTr, outputGradient);
+}
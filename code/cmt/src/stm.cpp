@@ -17,19 +17,34 @@ using Eigen::Array;
 using Eigen::Dynamic;
 using Eigen::VectorXi;
 using Eigen::VectorXd;
+using Eigen::RowVectorXd;
+using Eigen::Ref;
 
 #include "nonlinearities.h"
 using CMT::Nonlinearity;
+using CMT::TrainableNonlinearity;
 using CMT::LogisticFunction;
 
 #include "univariatedistributions.h"
 using CMT::UnivariateDistribution;
 using CMT::Bernoulli;
 
+#include "windowedtimeseries.h"
+using CMT::WindowedTimeSeries;
+
+#include "exception.h"
+using CMT::Exception;
+
 #include <utility>
 using std::pair;
 using std::make_pair;
 
+#include <vector>
+using std::vector;
+
+#include <string>
+using std::string;
+
 #include <cmath>
 using std::max;
 using std::min;
@@ -40,6 +55,26 @@ using std::numeric_limits;
 Nonlinearity* const STM::defaultNonlinearity = new LogisticFunction;
 UnivariateDistribution* const STM::defaultDistribution = new Bernoulli;
 
+/**
+ * Splits windows of time series into nonlinear and linear inputs. The first
+ * time series have to make up the nonlinear inputs.
+ */
+static pair<WindowedTimeSeries, WindowedTimeSeries> splitWindows(
+	const WindowedTimeSeries& input,
+	int dimInNonlinear)
+{
+	for(int i = 0, dim = 0; i <= input.numTimeSeries(); ++i) {
+		if(dim == dimInNonlinear)
+			return make_pair(
+				input.middleTimeSeries(0, i),
+				input.middleTimeSeries(i, input.numTimeSeries() - i));
+		if(i < input.numTimeSeries())
+			dim += input.timeSeries(i).rows() * input.windowLength(i);
+	}
+
+	throw Exception("Nonlinear and linear inputs should correspond to different time series.");
+}
+
 CMT::STM::Parameters::Parameters() :
 	Trainable::Parameters(),
 	trainSharpness(false),
@@ -127,6 +162,19 @@ CMT::STM::STM(
 
 
 
+/**
+ * Nonlinearity and distribution are shared with the copy. Since the parameters
+ * of a trainable nonlinearity may change during training, no copy is created
+ * in that case.
+ */
+CMT::Trainable* CMT::STM::copy() const {
+	if(dynamic_cast<TrainableNonlinearity*>(mNonlinearity))
+		return 0;
+	return new STM(*this);
+}
+
+
+
 MatrixXd CMT::STM::sample(const MatrixXd& input) const {
 	return mDistribution->sample(mNonlinearity->operator()(response(input)));
 }
@@ -140,6 +188,13 @@ MatrixXd CMT::STM::sample(const MatrixXd& inputNonlinear, const MatrixXd& inputL
 
 
 
+MatrixXd CMT::STM::sample(const MatrixXd& inputNonlinear, const SparseMatrixXd& inputLinear) const {
+	return mDistribution->sample(
+		mNonlinearity->operator()(response(inputNonlinear, inputLinear)));
+}
+
+
+
 MatrixXd CMT::STM::predict(const MatrixXd& input) const {
 	return mNonlinearity->operator()(response(input));
 }
@@ -152,6 +207,12 @@ MatrixXd CMT::STM::predict(const MatrixXd& inputNonlinear, const MatrixXd& input
 
 
 
+MatrixXd CMT::STM::predict(const MatrixXd& inputNonlinear, const SparseMatrixXd& inputLinear) const {
+	return mNonlinearity->operator()(response(inputNonlinear, inputLinear));
+}
+
+
+
 Array<double, 1, Dynamic> CMT::STM::logLikelihood(
 	const MatrixXd& input,
 	const MatrixXd& output) const
@@ -198,6 +259,48 @@ Array<double, 1, Dynamic> CMT::STM::logLikelihood(
 
 
 
+Array<double, 1, Dynamic> CMT::STM::logLikelihood(
+	const MatrixXd& inputNonlinear,
+	const SparseMatrixXd& inputLinear,
+	const MatrixXd& output) const
+{
+	if(output.rows() != dimOut())
+		throw Exception("Output has wrong dimensionality.");
+	if(inputLinear.cols() != output.cols())
+		throw Exception("The number of inputs and outputs must be the same.");
+
+	return mDistribution->logLikelihood(
+		output,
+		mNonlinearity->operator()(response(inputNonlinear, inputLinear)));
+}
+
+
+
+Array<double, 1, Dynamic> CMT::STM::logLikelihood(
+	const MatrixXd& inputNonlinear,
+	const WindowedTimeSeries& inputLinear,
+	const MatrixXd& output) const
+{
+	if(output.rows() != dimOut())
+		throw Exception("Output has wrong dimensionality.");
+	if(inputLinear.cols() != output.cols())
+		throw Exception("The number of inputs and outputs must be the same.");
+
+	if(!inputNonlinear.rows() && inputLinear.rows() == dimIn() && dimInNonlinear()) {
+		// nonlinear inputs are windows as well
+		pair<WindowedTimeSeries, WindowedTimeSeries> inputs = splitWindows(inputLinear, dimInNonlinear());
+		return mDistribution->logLikelihood(
+			output,
+			mNonlinearity->operator()(response(inputs.first, inputs.second)));
+	}
+
+	return mDistribution->logLikelihood(
+		output,
+		mNonlinearity->operator()(response(inputNonlinear, inputLinear)));
+}
+
+
+
 Array<double, 1, Dynamic> CMT::STM::response(const MatrixXd& input) const {
 	if(input.rows() != dimIn())
 		throw Exception("Input has wrong dimensionality.");
@@ -264,6 +367,101 @@ Array<double, 1, Dynamic> CMT::STM::response(
 
 
 
+Array<double, 1, Dynamic> CMT::STM::response(
+	const MatrixXd& inputNonlinear,
+	const SparseMatrixXd& inputLinear) const
+{
+	if(inputNonlinear.rows() != dimInNonlinear() || inputLinear.rows() != dimInLinear())
+		throw Exception("Input has wrong dimensionality.");
+	if(inputNonlinear.cols() != inputLinear.cols())
+		throw Exception("Number of nonlinear and linear inputs must be the same.");
+
+	// only non-zero linear inputs contribute to the cost
+	RowVectorXd linearResponse = mLinearPredictor.transpose() * inputLinear;
+
+	if(!dimInNonlinear()) {
+		// model has only linear inputs
+		double bias = numComponents() > 1 ?
+			log((mSharpness * mBiases).array().exp().sum()) / mSharpness :
+			mBiases[0];
+		return linearResponse.array() + bias;
+	}
+
+	MatrixXd jointEnergy;
+	if(numFeatures() > 0)
+		jointEnergy = mWeights * (mFeatures.transpose() * inputNonlinear).array().square().matrix()
+			+ mPredictors * inputNonlinear;
+	else
+		jointEnergy = mPredictors * inputNonlinear;
+	jointEnergy.colwise() += mBiases;
+
+	return logSumExp(mSharpness * jointEnergy) / mSharpness + linearResponse.array();
+}
+
+
+
+Array<double, 1, Dynamic> CMT::STM::response(
+	const MatrixXd& inputNonlinear,
+	const WindowedTimeSeries& inputLinear) const
+{
+	if(inputNonlinear.rows() != dimInNonlinear() || inputLinear.rows() != dimInLinear())
+		throw Exception("Input has wrong dimensionality.");
+	if(inputNonlinear.cols() != inputLinear.cols())
+		throw Exception("Number of nonlinear and linear inputs must be the same.");
+
+	// filter time series without extracting windows
+	RowVectorXd linearResponse = inputLinear.leftProduct(mLinearPredictor.transpose());
+
+	if(!dimInNonlinear()) {
+		// model has only linear inputs
+		double bias = numComponents() > 1 ?
+			log((mSharpness * mBiases).array().exp().sum()) / mSharpness :
+			mBiases[0];
+		return linearResponse.array() + bias;
+	}
+
+	MatrixXd jointEnergy;
+	if(numFeatures() > 0)
+		jointEnergy = mWeights * (mFeatures.transpose() * inputNonlinear).array().square().matrix()
+			+ mPredictors * inputNonlinear;
+	else
+		jointEnergy = mPredictors * inputNonlinear;
+	jointEnergy.colwise() += mBiases;
+
+	return logSumExp(mSharpness * jointEnergy) / mSharpness + linearResponse.array();
+}
+
+
+
+/**
+ * Computes the response for windows of time series without extracting them.
+ * Features and predictors are applied to the nonlinear inputs by filtering the
+ * time series.
+ */
+Array<double, 1, Dynamic> CMT::STM::response(
+	const WindowedTimeSeries& inputNonlinear,
+	const WindowedTimeSeries& inputLinear) const
+{
+	if(inputNonlinear.rows() != dimInNonlinear() || inputLinear.rows() != dimInLinear())
+		throw Exception("Input has wrong dimensionality.");
+	if(inputNonlinear.cols() != inputLinear.cols())
+		throw Exception("Number of nonlinear and linear inputs must be the same.");
+
+	RowVectorXd linearResponse = inputLinear.leftProduct(mLinearPredictor.transpose());
+
+	MatrixXd jointEnergy;
+	if(numFeatures() > 0)
+		jointEnergy = mWeights * inputNonlinear.leftProduct(mFeatures.transpose()).array().square().matrix()
+			+ inputNonlinear.leftProduct(mPredictors);
+	else
+		jointEnergy = inputNonlinear.leftProduct(mPredictors);
+	jointEnergy.colwise() += mBiases;
+
+	return logSumExp(mSharpness * jointEnergy) / mSharpness + linearResponse.array();
+}
+
+
+
 ArrayXXd CMT::STM::nonlinearResponses(const MatrixXd& input) const {
 	if(input.rows() != dimInNonlinear() && input.rows() != dimIn())
 		throw Exception("Input has wrong dimensionality.");
@@ -411,6 +609,110 @@ bool CMT::STM::train(
 
 
 
+/**
+ * Trains the parameters of an STM which is equivalent to a GLM, that is, of an
+ * STM without nonlinear inputs or with a single component and no features.
+ *
+ * @param inputNonlinear nonlinear inputs, or all inputs if no linear inputs are given
+ * @param inputLinear linear inputs in sparse format or as windows of time series
+ */
+template <class LinearInputType>
+bool CMT::STM::trainGLM(
+	const MatrixXd& inputNonlinear,
+	const LinearInputType* inputLinear,
+	const MatrixXd& output,
+	const MatrixXd* inputVal,
+	const MatrixXd* outputVal,
+	const Trainable::Parameters& params)
+{
+	GLM glm(dimIn(), mNonlinearity, mDistribution);
+
+	GLM::Parameters glmParams;
+	glmParams.Trainable::Parameters::operator=(params);
+
+	const Parameters& stmParams = dynamic_cast<const Parameters&>(params);
+
+	if(stmParams.trainLinearPredictor)
+		glmParams.trainWeights = true;
+	if(stmParams.trainBiases)
+		glmParams.trainBias = true;
+	glmParams.regularizeWeights = stmParams.regularizeLinearPredictor;
+	glmParams.regularizeBias = stmParams.regularizeBiases;
+
+	bool converged;
+	if(inputLinear)
+		converged = glm.train(inputNonlinear, *inputLinear, output, glmParams);
+	else if(inputVal && outputVal)
+		converged = glm.train(inputNonlinear, output, *inputVal, *outputVal, glmParams);
+	else
+		converged = glm.train(inputNonlinear, output, glmParams);
+
+	// copy parameters
+	mPredictors = glm.weights().topRows(dimInNonlinear()).transpose();
+	mLinearPredictor = glm.weights().bottomRows(dimInLinear());
+	mBiases.setConstant(glm.bias() - log(numComponents()));
+	mTelemetry = glm.telemetry();
+
+	return converged;
+}
+
+
+
+bool CMT::STM::train(
+	const MatrixXd& inputNonlinear,
+	const SparseMatrixXd& inputLinear,
+	const MatrixXd& output,
+	const Trainable::Parameters& params)
+{
+	if(!inputNonlinear.rows() && inputLinear.rows() == dimIn() && dimInNonlinear())
+		// only keep linear inputs in sparse format
+		return train(
+			MatrixXd(inputLinear.topRows(dimInNonlinear())),
+			SparseMatrixXd(inputLinear.bottomRows(dimInLinear())),
+			output,
+			params);
+
+	if(inputNonlinear.rows() != dimInNonlinear() || inputLinear.rows() != dimInLinear())
+		throw Exception("Only linear inputs can be sparse.");
+
+	if(!dimIn())
+		// STM reduces to univariate distribution
+		return train(inputNonlinear, output, 0, 0, params);
+
+	if(!dimInNonlinear() || (numComponents() == 1 && numFeatures() == 0))
+		// STM reduces to GLM
+		return trainGLM(inputNonlinear, &inputLinear, output, 0, 0, params);
+
+	return Trainable::train(inputNonlinear, inputLinear, output, params);
+}
+
+
+
+bool CMT::STM::train(
+	const MatrixXd& inputNonlinear,
+	const WindowedTimeSeries& inputLinear,
+	const MatrixXd& output,
+	const Trainable::Parameters& params)
+{
+	if(!inputNonlinear.rows() && inputLinear.rows() == dimIn() && dimInNonlinear())
+		// nonlinear inputs are windows as well, which have to belong to separate time series
+		splitWindows(inputLinear, dimInNonlinear());
+	else if(inputNonlinear.rows() != dimInNonlinear() || inputLinear.rows() != dimInLinear())
+		throw Exception("Only linear inputs can be windows of time series.");
+
+	if(!dimIn())
+		// STM reduces to univariate distribution
+		return train(inputNonlinear, output, 0, 0, params);
+
+	if(!dimInNonlinear() || (numComponents() == 1 && numFeatures() == 0))
+		// STM reduces to GLM
+		return trainGLM(inputNonlinear, &inputLinear, output, 0, 0, params);
+
+	return Trainable::train(inputNonlinear, inputLinear, output, params);
+}
+
+
+
 int CMT::STM::numParameters(const Trainable::Parameters& params_) const {
 	const Parameters& params = dynamic_cast<const Parameters&>(params_);
 
@@ -498,8 +800,243 @@ void CMT::STM::setParameters(const lbfgsfloatval_t* x, const Trainable::Paramete
 
 
 
+vector<pair<string, int> > CMT::STM::parameterBlocks(const Trainable::Parameters& params_) const {
+	const Parameters& params = dynamic_cast<const Parameters&>(params_);
+
+	vector<pair<string, int> > blocks;
+
+	if(params.trainBiases)
+		blocks.push_back(make_pair(string("biases"), static_cast<int>(mBiases.size())));
+	if(params.trainWeights)
+		blocks.push_back(make_pair(string("weights"), static_cast<int>(mWeights.size())));
+	if(params.trainFeatures)
+		blocks.push_back(make_pair(string("features"), static_cast<int>(mFeatures.size())));
+	if(params.trainPredictors)
+		blocks.push_back(make_pair(string("predictors"), static_cast<int>(mPredictors.size())));
+	if(params.trainLinearPredictor)
+		blocks.push_back(make_pair(string("linear_predictor"), static_cast<int>(mLinearPredictor.size())));
+	if(params.trainSharpness)
+		blocks.push_back(make_pair(string("sharpness"), 1));
+
+	return blocks;
+}
+
+
+
+double CMT::STM::parameterGradient(
+	const MatrixXd& input,
+	const MatrixXd& output,
+	const lbfgsfloatval_t* x,
+	lbfgsfloatval_t* g,
+	const Trainable::Parameters& params) const
+{
+	return computeParameterGradient(input, 0, 0, 0, output, x, g, params);
+}
+
+
+
 double CMT::STM::parameterGradient(
+	const MatrixXd& inputNonlinear,
+	const SparseMatrixXd& inputLinear,
+	const MatrixXd& output,
+	const lbfgsfloatval_t* x,
+	lbfgsfloatval_t* g,
+	const Trainable::Parameters& params) const
+{
+	if(inputNonlinear.rows() != dimInNonlinear() || inputLinear.rows() != dimInLinear())
+		throw Exception("Only linear inputs can be sparse.");
+	if(inputNonlinear.cols() != inputLinear.cols())
+		throw Exception("Number of nonlinear and linear inputs must be the same.");
+
+	return computeParameterGradient(inputNonlinear, &inputLinear, 0, 0, output, x, g, params);
+}
+
+
+
+double CMT::STM::parameterGradient(
+	const MatrixXd& inputNonlinear,
+	const WindowedTimeSeries& inputLinear,
+	const MatrixXd& output,
+	const lbfgsfloatval_t* x,
+	lbfgsfloatval_t* g,
+	const Trainable::Parameters& params) const
+{
+	if(inputNonlinear.cols() != inputLinear.cols())
+		throw Exception("Number of nonlinear and linear inputs must be the same.");
+
+	if(!inputNonlinear.rows() && inputLinear.rows() == dimIn() && dimInNonlinear()) {
+		// nonlinear inputs are windows as well
+		pair<WindowedTimeSeries, WindowedTimeSeries> inputs = splitWindows(inputLinear, dimInNonlinear());
+		return computeParameterGradient(inputNonlinear, 0, &inputs.second, &inputs.first, output, x, g, params);
+	}
+
+	if(inputNonlinear.rows() != dimInNonlinear() || inputLinear.rows() != dimInLinear())
+		throw Exception("Only linear inputs can be windows of time series.");
+
+	return computeParameterGradient(inputNonlinear, 0, &inputLinear, 0, output, x, g, params);
+}
+
+
+
+MatrixXd CMT::STM::perExampleGradients(
+	const MatrixXd& input,
+	const MatrixXd& output,
+	const Trainable::Parameters& params_) const
+{
+	// check if nonlinearity is differentiable
+	DifferentiableNonlinearity* nonlinearity = dynamic_cast<DifferentiableNonlinearity*>(mNonlinearity);
+
+	if(!nonlinearity)
+		throw Exception("Nonlinearity has to be differentiable for training.");
+
+	const Parameters& params = dynamic_cast<const Parameters&>(params_);
+
+	if(input.rows() != dimIn() || output.rows() != 1)
+		throw Exception("Data has wrong dimensionality.");
+	if(input.cols() != output.cols())
+		throw Exception("The number of inputs and outputs should be the same.");
+
+	int numData = static_cast<int>(output.cols());
+	int batchSize = min(max(params.batchSize, 10), max(numData, 1));
+
+	MatrixXd gradients(numParameters(params), numData);
+
+	#pragma omp parallel for
+	for(int b = 0; b < numData; b += batchSize) {
+		int width = min(batchSize, numData - b);
+		const Ref<const MatrixXd> inputNonlinear = input.block(0, b, dimInNonlinear(), width);
+		const Ref<const MatrixXd> inputLinear = input.block(dimInNonlinear(), b, dimInLinear(), width);
+
+		ArrayXXd featureOutput;
+		MatrixXd featureOutputSq;
+		MatrixXd jointEnergy;
+
+		if(numFeatures() > 0) {
+			featureOutput = mFeatures.transpose() * inputNonlinear;
+			featureOutputSq = featureOutput.square();
+			jointEnergy = mWeights * featureOutputSq + mPredictors * inputNonlinear;
+		} else {
+			jointEnergy = mPredictors * inputNonlinear;
+		}
+
+		jointEnergy.colwise() += mBiases;
+		MatrixXd jointEnergyScaled = jointEnergy * mSharpness;
+
+		Array<double, 1, Dynamic> nonlinearResponse = logSumExp(jointEnergyScaled);
+
+		// posterior over components for each data point
+		MatrixXd posterior = (jointEnergyScaled.rowwise() - nonlinearResponse.matrix()).array().exp();
+
+		nonlinearResponse /= mSharpness;
+
+		Array<double, 1, Dynamic> response = nonlinearResponse;
+		if(dimInLinear())
+			response += (mLinearPredictor.transpose() * inputLinear).array();
+
+		// derivative of log-likelihood with respect to response
+		Array<double, 1, Dynamic> tmp;
+		mDistribution->logKernel(output.middleCols(b, width), response, *nonlinearity, &tmp);
+		tmp = -tmp;
+
+		MatrixXd postTmp = posterior.array().rowwise() * tmp;
+
+		// gradients with respect to linear functions of the nonlinear inputs
+		MatrixXd featuresTmp;
+		if(params.trainFeatures && numFeatures() > 0)
+			featuresTmp = featureOutput * (2. * mWeights.transpose() * postTmp).array();
+
+		Array<double, 1, Dynamic> sharpnessTmp;
+		if(params.trainSharpness)
+			sharpnessTmp = ((jointEnergy.array() * posterior.array()).colwise().sum() - nonlinearResponse)
+				* tmp / mSharpness;
+
+		for(int n = 0; n < width; ++n) {
+			double* g = gradients.col(b + n).data();
+
+			if(params.trainBiases) {
+				VectorLBFGS(g, mNumComponents) = -postTmp.col(n);
+				g += mNumComponents;
+			}
+
+			if(params.trainWeights) {
+				if(numFeatures() > 0)
+					MatrixLBFGS(g, mNumComponents, mNumFeatures) =
+						-postTmp.col(n) * featureOutputSq.col(n).transpose();
+				g += mNumComponents * mNumFeatures;
+			}
+
+			if(params.trainFeatures) {
+				if(numFeatures() > 0)
+					MatrixLBFGS(g, dimInNonlinear(), mNumFeatures) =
+						-inputNonlinear.col(n) * featuresTmp.col(n).transpose();
+				g += dimInNonlinear() * mNumFeatures;
+			}
+
+			if(params.trainPredictors) {
+				MatrixLBFGS(g, mNumComponents, dimInNonlinear()) =
+					-postTmp.col(n) * inputNonlinear.col(n).transpose();
+				g += mNumComponents * dimInNonlinear();
+			}
+
+			if(params.trainLinearPredictor) {
+				VectorLBFGS(g, dimInLinear()) = -inputLinear.col(n) * tmp[n];
+				g += dimInLinear();
+			}
+
+			if(params.trainSharpness)
+				*g = -sharpnessTmp[n];
+		}
+	}
+
+	gradients /= log(2.) * dimOut();
+
+	// gradients of regularizers are the same for all data points
+	VectorXd regularization = VectorXd::Zero(gradients.rows());
+	double* g = regularization.data();
+
+	if(params.trainBiases) {
+		VectorLBFGS(g, mNumComponents) = params.regularizeBiases.gradient(mBiases);
+		g += mNumComponents;
+	}
+
+	if(params.trainWeights) {
+		MatrixLBFGS(g, mNumComponents, mNumFeatures) =
+			params.regularizeWeights.gradient(mWeights.transpose()).transpose();
+		g += mWeights.size();
+	}
+
+	if(params.trainFeatures) {
+		MatrixLBFGS(g, dimInNonlinear(), mNumFeatures) = params.regularizeFeatures.gradient(mFeatures);
+		g += mFeatures.size();
+	}
+
+	if(params.trainPredictors) {
+		MatrixLBFGS(g, mNumComponents, dimInNonlinear()) =
+			params.regularizePredictors.gradient(mPredictors.transpose()).transpose();
+		g += mPredictors.size();
+	}
+
+	if(params.trainLinearPredictor)
+		VectorLBFGS(g, dimInLinear()) = params.regularizeLinearPredictor.gradient(mLinearPredictor);
+
+	gradients.colwise() += regularization;
+
+	return gradients;
+}
+
+
+
+/**
+ * Computes the gradient for stacked nonlinear and linear inputs or, if a sparse
+ * matrix or windows of time series are given, for dense nonlinear inputs and
+ * sparse or windowed linear inputs. If windows are also given for the nonlinear
+ * inputs, the windows are never extracted.
+ */
+double CMT::STM::computeParameterGradient(
 	const MatrixXd& inputCompl,
+	const SparseMatrixXd* inputLinearSparse,
+	const WindowedTimeSeries* inputLinearWindows,
+	const WindowedTimeSeries* inputNonlinearWindows,
 	const MatrixXd& outputCompl,
 	const lbfgsfloatval_t* x,
 	lbfgsfloatval_t* g,
@@ -513,9 +1050,6 @@ double CMT::STM::parameterGradient(
 
 	const Parameters& params = dynamic_cast<const Parameters&>(params_);
 
-	// average log-likelihood
-	double logLik = 0.;
-
 	lbfgsfloatval_t* y = const_cast<lbfgsfloatval_t*>(x);
 	int offset = 0;
 
@@ -549,119 +1083,178 @@ double CMT::STM::parameterGradient(
 		offset += linearPredictor.size();
 
 	double sharpness = params.trainSharpness ? y[offset++] : mSharpness;
-	double sharpnessGrad = 0.;
 
-	if(g) {
-		// initialize gradients
+	// split data into batches for better performance
+	int numData = static_cast<int>(outputCompl.cols());
+	int batchSize = min(max(params.batchSize, 10), numData);
+
+	// number of nonlinear and linear inputs stored in the dense matrix
+	int dimInNonlinearDense = inputNonlinearWindows ? 0 : dimInNonlinear();
+	int dimInLinearDense = inputLinearSparse || inputLinearWindows ? 0 : dimInLinear();
+
+	// thread-private gradients with the log-likelihood stored in the last entry
+	vector<VectorXd> partials(numThreads(), VectorXd::Zero(offset + 1));
+
+	#pragma omp parallel
+	{
+		VectorXd& partial = partials[threadID()];
+		double& logLik = partial[offset];
+
+		// interpret thread-private memory in the same way as the gradient
+		double* h = partial.data();
+
+		VectorLBFGS biasesGrad(h, mNumComponents);
 		if(params.trainBiases)
-			biasesGrad.setZero();
+			h += biasesGrad.size();
+
+		MatrixLBFGS weightsGrad(h, mNumComponents, mNumFeatures);
 		if(params.trainWeights)
-			weightsGrad.setZero();
+			h += weightsGrad.size();
+
+		MatrixLBFGS featuresGrad(h, dimInNonlinear(), mNumFeatures);
 		if(params.trainFeatures)
-			featuresGrad.setZero();
+			h += featuresGrad.size();
+
+		MatrixLBFGS predictorsGrad(h, mNumComponents, dimInNonlinear());
 		if(params.trainPredictors)
-			predictorsGrad.setZero();
-		if(params.trainLinearPredictor)
-			linearPredictorGrad.setZero();
-	}
+			h += predictorsGrad.size();
 
-	// split data into batches for better performance
-	int numData = static_cast<int>(inputCompl.cols());
-	int batchSize = min(max(params.batchSize, 10), numData);
+		VectorLBFGS linearPredictorGrad(h, dimInLinear());
+		if(params.trainLinearPredictor)
+			h += linearPredictorGrad.size();
+
+		double& sharpnessGrad = *h;
+
+		#pragma omp for schedule(static)
+		for(int b = 0; b < numData; b += batchSize) {
+			int width = min(batchSize, numData - b);
+			const Ref<const MatrixXd> inputNonlinear = inputCompl.block(0, b, dimInNonlinearDense, width);
+			const Ref<const MatrixXd> inputLinear = inputCompl.block(dimInNonlinearDense, b, dimInLinearDense, width);
+			const Ref<const MatrixXd> output = outputCompl.middleCols(b, width);
+
+			ArrayXXd featureOutput;
+			MatrixXd featureOutputSq;
+			MatrixXd jointEnergy;
+
+			WindowedTimeSeries windowsNonlinear;
+
+			if(inputNonlinearWindows) {
+				// filter time series with features and predictors
+				windowsNonlinear = inputNonlinearWindows->middleCols(b, width);
+
+				if(numFeatures() > 0) {
+					featureOutput = windowsNonlinear.leftProduct(features.transpose());
+					featureOutputSq = featureOutput.square();
+					jointEnergy = weights * featureOutputSq + windowsNonlinear.leftProduct(predictors);
+				} else {
+					jointEnergy = windowsNonlinear.leftProduct(predictors);
+				}
+			} else if(numFeatures() > 0) {
+				featureOutput = features.transpose() * inputNonlinear;
+				featureOutputSq = featureOutput.square();
+				jointEnergy = weights * featureOutputSq + predictors * inputNonlinear;
+			} else {
+				jointEnergy = predictors * inputNonlinear;
+			}
 
-	#pragma omp parallel for
-	for(int b = 0; b < inputCompl.cols(); b += batchSize) {
-		int width = min(batchSize, numData - b);
-		const MatrixXd& inputNonlinear = inputCompl.block(0, b, dimInNonlinear(), width);
-		const MatrixXd& inputLinear = inputCompl.block(dimInNonlinear(), b, dimInLinear(), width);
-		const MatrixXd& output = outputCompl.middleCols(b, width);
+			jointEnergy.colwise() += biases;
+			MatrixXd jointEnergyScaled = jointEnergy * sharpness;
 
-		ArrayXXd featureOutput;
-		MatrixXd featureOutputSq;
-		MatrixXd jointEnergy;
+			Matrix<double, 1, Dynamic> response = logSumExp(jointEnergyScaled);
 
-		if(numFeatures() > 0) {
-			featureOutput = features.transpose() * inputNonlinear;
-			featureOutputSq = featureOutput.square();
-			jointEnergy = weights * featureOutputSq + predictors * inputNonlinear;
-		} else {
-			jointEnergy = predictors * inputNonlinear;
-		}
+			// posterior over components for each data point
+			MatrixXd posterior = (jointEnergyScaled.rowwise() - response).array().exp();
 
-		jointEnergy.colwise() += biases;
-		MatrixXd jointEnergyScaled = jointEnergy * sharpness;
+			response /= sharpness;
 
-		Matrix<double, 1, Dynamic> response = logSumExp(jointEnergyScaled);
+			MatrixXd nonlinearResponse;
+			if(params.trainSharpness)
+				// make copy of nonlinear response
+				nonlinearResponse = response;
 
-		// posterior over components for each data point
-		MatrixXd posterior = (jointEnergyScaled.rowwise() - response).array().exp();
+			WindowedTimeSeries windows;
 
-		response /= sharpness;
+			if(dimInLinear()) {
+				if(inputLinearSparse) {
+					response += linearPredictor.transpose() * inputLinearSparse->middleCols(b, width);
+				} else if(inputLinearWindows) {
+					windows = inputLinearWindows->middleCols(b, width);
+					response += windows.leftProduct(linearPredictor.transpose());
+				} else {
+					response += linearPredictor.transpose() * inputLinear;
+				}
+			}
 
-		MatrixXd nonlinearResponse;
-		if(params.trainSharpness)
-			// make copy of nonlinear response
-			nonlinearResponse = response;
+			// derivative of negative log-likelihood with respect to response
+			Array<double, 1, Dynamic> tmp;
 
-		if(dimInLinear())
-			response += linearPredictor.transpose() * inputLinear;
+			// update log-likelihood
+			logLik += mDistribution->logKernel(
+				output,
+				response,
+				*nonlinearity,
+				g ? &tmp : 0).sum();
 
-		// update log-likelihood
-		double logLikBatch = mDistribution->logLikelihood(
-			output,
-			nonlinearity->operator()(response)).sum();
+			if(!g)
+				// don't compute gradients
+				continue;
 
-		#pragma omp critical
-		logLik += logLikBatch;
+			// derivative of log-likelihood with respect to response
+			tmp = -tmp;
 
-		if(!g)
-			// don't compute gradients
-			continue;
+			MatrixXd postTmp = posterior.array().rowwise() * tmp;
 
-		Array<double, 1, Dynamic> tmp = -mDistribution->gradient(output, nonlinearity->operator()(response))
-			* nonlinearity->derivative(response);
+			if(params.trainBiases)
+				biasesGrad -= postTmp.rowwise().sum();
 
-		MatrixXd postTmp = posterior.array().rowwise() * tmp;
+			if(numFeatures() > 0) {
+				if(params.trainWeights)
+					weightsGrad -= postTmp * featureOutputSq.transpose();
 
-		if(params.trainBiases)
-			#pragma omp critical
-			biasesGrad -= postTmp.rowwise().sum();
+				if(params.trainFeatures) {
+					ArrayXXd tmp2 = 2. * weights.transpose() * postTmp;
+					MatrixXd tmp3 = featureOutput * tmp2;
+					if(inputNonlinearWindows)
+						featuresGrad -= windowsNonlinear.leftProductTranspose(tmp3).transpose();
+					else
+						featuresGrad -= inputNonlinear * tmp3.transpose();
+				}
+			}
 
-		if(numFeatures() > 0) {
-			if(params.trainWeights)
-				#pragma omp critical
-				weightsGrad -= postTmp * featureOutputSq.transpose();
+			if(params.trainPredictors) {
+				if(inputNonlinearWindows)
+					predictorsGrad -= windowsNonlinear.leftProductTranspose(postTmp);
+				else
+					predictorsGrad -= postTmp * inputNonlinear.transpose();
+			}
 
-			if(params.trainFeatures) {
-				ArrayXXd tmp2 = 2. * weights.transpose() * postTmp;
-				MatrixXd tmp3 = featureOutput * tmp2;
-				#pragma omp critical
-				featuresGrad -= inputNonlinear * tmp3.transpose();
+			if(params.trainLinearPredictor && dimInLinear() > 0) {
+				if(inputLinearSparse)
+					linearPredictorGrad -= inputLinearSparse->middleCols(b, width) * tmp.transpose().matrix();
+				else if(inputLinearWindows)
+					linearPredictorGrad -= windows.leftProductTranspose(tmp.matrix()).transpose();
+				else
+					linearPredictorGrad -= inputLinear * tmp.transpose().matrix();
 			}
-		}
 
-		if(params.trainPredictors)
-			#pragma omp critical
-			predictorsGrad -= postTmp * inputNonlinear.transpose();
-
-		if(params.trainLinearPredictor && dimInLinear() > 0)
-			#pragma omp critical
-			linearPredictorGrad -= inputLinear * tmp.transpose().matrix();
-
-		if(params.trainSharpness) {
-			double tmp2 = ((jointEnergy.array() * posterior.array()).colwise().sum() * tmp).sum() / sharpness;
-			double tmp3 = (nonlinearResponse.array() * tmp).sum() / sharpness;
-			#pragma omp critical
-			sharpnessGrad -= tmp2 - tmp3;
+			if(params.trainSharpness) {
+				double tmp2 = ((jointEnergy.array() * posterior.array()).colwise().sum() * tmp).sum() / sharpness;
+				double tmp3 = (nonlinearResponse.array() * tmp).sum() / sharpness;
+				sharpnessGrad -= tmp2 - tmp3;
+			}
 		}
 	}
 
-	double normConst = inputCompl.cols() * log(2.) * dimOut();
+	reduceSum(partials);
 
-	if(g) {
-		if(params.trainSharpness)
-			g[offset - 1] = sharpnessGrad;
+	double logLik = partials[0][offset] + cachedLogBaseMeasure(outputCompl);
+
+	if(g)
+		VectorLBFGS(g, offset) = partials[0].head(offset);
+
+	double normConst = outputCompl.cols() * log(2.) * dimOut();
 
+	if(g) {
 		for(int i = 0; i < offset; ++i)
 			g[i] /= normConst;
 
@@ -695,8 +1288,8 @@ double CMT::STM::parameterGradient(
 
 
 pair<pair<ArrayXXd, ArrayXXd>, Array<double, 1, Dynamic> > CMT::STM::computeDataGradient(
-	const MatrixXd& input,
-	const MatrixXd& output) const
+	const Ref<const MatrixXd>& input,
+	const Ref<const MatrixXd>& output) const
 {
 	// make sure nonlinearity is differentiable
 	DifferentiableNonlinearity* nonlinearity =
@@ -753,8 +1346,8 @@ pair<pair<ArrayXXd, ArrayXXd>, Array<double, 1, Dynamic> > CMT::STM::computeData
 
 	} else if(dimInNonlinear() && dimInLinear()) {
 		// split inputs into linear and nonlinear components
-		MatrixXd inputNonlinear = input.topRows(dimInNonlinear());
-		MatrixXd inputLinear = input.bottomRows(dimInLinear());
+		const Ref<const MatrixXd> inputNonlinear = input.topRows(dimInNonlinear());
+		const Ref<const MatrixXd> inputLinear = input.bottomRows(dimInLinear());
 
 		Array<double, 1, Dynamic> responses;
 
@@ -762,7 +1355,7 @@ pair<pair<ArrayXXd, ArrayXXd>, Array<double, 1, Dynamic> > CMT::STM::computeData
 
 		if(numFeatures() > 0)
 			jointEnergy = mWeights * (mFeatures.transpose() * inputNonlinear).array().square().matrix()
-				+ mPredictors * input;
+				+ mPredictors * inputNonlinear;
 		else
 			jointEnergy = mPredictors * inputNonlinear;
 		jointEnergy.colwise() += mBiases.array();
@@ -826,6 +1419,12 @@ pair<pair<ArrayXXd, ArrayXXd>, Array<double, 1, Dynamic> > CMT::STM::computeData
 
 
 
+double CMT::STM::logBaseMeasure(const MatrixXd& output) const {
+	return mDistribution->logBaseMeasure(output).sum();
+}
+
+
+
 bool CMT::STM::train(
 	const MatrixXd& input,
 	const MatrixXd& output,
@@ -846,6 +1445,9 @@ bool CMT::STM::train(
 
 		mBiases.setConstant(nonlinearity->inverse(mean) - log(numComponents()));
 
+		// no optimization took place
+		mTelemetry = Telemetry();
+
 		return true;
 
 	} else if(!dimInNonlinear() || (numComponents() == 1 && numFeatures() == 0)) {
@@ -853,32 +1455,7 @@ bool CMT::STM::train(
 			throw Exception("Input has wrong dimensionality.");
 
 		// STM reduces to GLM
-		GLM glm(dimIn(), mNonlinearity, mDistribution);
-
-		GLM::Parameters glmParams;
-		glmParams.Trainable::Parameters::operator=(params);
-
-		const Parameters& stmParams = dynamic_cast<const Parameters&>(params);
-
-		if(stmParams.trainLinearPredictor)
-			glmParams.trainWeights = true;
-		if(stmParams.trainBiases)
-			glmParams.trainBias = true;
-		glmParams.regularizeWeights = stmParams.regularizeLinearPredictor;
-		glmParams.regularizeBias = stmParams.regularizeBiases;
-
-		bool converged;
-		if(inputVal && outputVal)
-			converged = glm.train(input, output, *inputVal, *outputVal, glmParams);
-		else
-			converged = glm.train(input, output, glmParams);
-
-		// copy parameters
-		mPredictors = glm.weights().topRows(dimInNonlinear()).transpose();
-		mLinearPredictor = glm.weights().bottomRows(dimInLinear());
-		mBiases.setConstant(glm.bias() - log(numComponents()));
-
-		return converged;
+		return trainGLM(input, static_cast<const SparseMatrixXd*>(0), output, inputVal, outputVal, params);
 
 	} else {
 		return Trainable::train(input, output, inputVal, outputVal, params);
@@ -1,6 +1,8 @@
 #include "lbfgs.h"
 #include "utils.h"
 #include "exception.h"
+using CMT::Exception;
+using CMT::logSumExp;
 
 #include <algorithm>
 using std::max;
@@ -35,8 +37,18 @@ using CMT::Tuples;
 using CMT::ConditionalDistribution;
 using CMT::ArrayXXb;
 using CMT::Preconditioner;
+using CMT::BinaryMatrix;
 using CMT::extractFromImage;
 
+#include "affinepreconditioner.h"
+using CMT::AffinePreconditioner;
+
+#include "glm.h"
+using CMT::GLM;
+
+#include "stm.h"
+using CMT::STM;
+
 #include "Eigen/Core"
 using Eigen::Block;
 using Eigen::Dynamic;
@@ -45,6 +57,7 @@ using Eigen::ArrayXd;
 using Eigen::ArrayXXd;
 using Eigen::ArrayXXi;
 using Eigen::VectorXd;
+using Eigen::MatrixXd;
 using Eigen::Map;
 
 #include <iostream>
@@ -441,6 +454,43 @@ pair<ArrayXXd, ArrayXXd> CMT::generateDataFromImage(
 
 
 
+pair<BinaryMatrix, ArrayXXd> CMT::generateBinaryDataFromImage(
+	const ArrayXXd& img,
+	const ArrayXXb& inputMask,
+	const ArrayXXb& outputMask)
+{
+	int w = img.cols() - inputMask.cols() + 1;
+	int h = img.rows() - inputMask.rows() + 1;
+
+	if(w < 1 || h < 1)
+		throw Exception("Image not large enough for these masks.");
+	if(!BinaryMatrix::isBinary(img.matrix()))
+		throw Exception("Image should only contain zeros and ones.");
+
+	// precompute indices of active pixels in masks
+	pair<Tuples, Tuples> inOutIndices = masksToIndices(inputMask, outputMask);
+	Tuples& inputIndices = inOutIndices.first;
+	Tuples& outputIndices = inOutIndices.second;
+
+	pair<BinaryMatrix, ArrayXXd> data = make_pair(
+		BinaryMatrix(inputIndices.size(), w * h),
+		ArrayXXd(outputIndices.size(), w * h));
+
+	for(int k = 0, i = 0; i < h; ++i)
+		for(int j = 0; j < w; ++j, ++k) {
+			// extract input and output without creating a dense input patch
+			for(int m = 0; m < inputIndices.size(); ++m)
+				if(img(i + inputIndices[m].first, j + inputIndices[m].second) > 0.)
+					data.first.set(m, k);
+			for(int m = 0; m < outputIndices.size(); ++m)
+				data.second(m, k) = img(i + outputIndices[m].first, j + outputIndices[m].second);
+		}
+
+	return data;
+}
+
+
+
 pair<ArrayXXd, ArrayXXd> CMT::generateDataFromVideo(
 	const vector<ArrayXXd>& video,
 	const vector<ArrayXXb>& inputMask,
@@ -670,13 +720,13 @@ ArrayXXd CMT::densityGradient(
 
 	if(preconditioner) {
 		pair<ArrayXXd, ArrayXXd> data = preconditioner->operator()(inputs, outputs);
-		results = model.computeDataGradient(data.first, data.second);
+		results = model.computeDataGradient(data.first.matrix(), data.second.matrix());
 
 		// adjust gradient and likelihood to take transformation into account
 		results.first = preconditioner->adjustGradient(results.first.first, results.first.second);
 		results.second += preconditioner->logJacobian(inputs, outputs);
 	} else {
-		results = model.computeDataGradient(inputs, outputs);
+		results = model.computeDataGradient(inputs.matrix(), outputs.matrix());
 	}
 
 	ArrayXXd& inputGradients = results.first.first;
@@ -819,13 +869,13 @@ vector<ArrayXXd> CMT::densityGradient(
 
 	if(preconditioner) {
 		pair<ArrayXXd, ArrayXXd> data = preconditioner->operator()(inputs, outputs);
-		results = model.computeDataGradient(data.first, data.second);
+		results = model.computeDataGradient(data.first.matrix(), data.second.matrix());
 
 		// adjust gradient and likelihood to take transformation into account
 		results.first = preconditioner->adjustGradient(results.first.first, results.first.second);
 		results.second += preconditioner->logJacobian(inputs, outputs);
 	} else {
-		results = model.computeDataGradient(inputs, outputs);
+		results = model.computeDataGradient(inputs.matrix(), outputs.matrix());
 	}
 
 	ArrayXXd& inputGradients = results.first.first;
@@ -921,21 +971,21 @@ ArrayXXd CMT::sampleImage(
 			throw Exception("Model and masks are incompatible.");
 	}
 
+	// buffers reused across pixels
+	MatrixXd inputPre;
+	VectorXd output(outputIndices.size());
+
 	for(int i = 0; i + inputMask.rows() <= img.rows(); i += h)
 		for(int j = 0; j + inputMask.cols() <= img.cols(); j += w) {
 			// extract causal neighborhood
 			VectorXd input = extractFromImage(
 				img.block(i, j, inputMask.rows(), inputMask.cols()), inputIndices);
 
-			VectorXd output;
-
 			// sample output
-			if(preconditioner) {
-				input = preconditioner->operator()(input);
-				output = preconditioner->inverse(input, model.sample(input)).second;
-			} else {
+			if(preconditioner)
+				preconditioner->sample(model, input, inputPre, output);
+			else
 				output = model.sample(input);
-			}
 
 			output = output.cwiseMin(maxValue);
 			output = output.cwiseMax(minValue);
@@ -1027,9 +1077,13 @@ vector<ArrayXXd> CMT::sampleImage(
 			throw Exception("Model and masks are incompatible.");
 	}
 
+	// buffers reused across pixels
+	VectorXd input(numInputs * numChannels);
+	MatrixXd inputPre;
+	VectorXd output(numOutputs * numChannels);
+
 	for(int i = 0; i + inputMask.rows() <= img[0].rows(); i += h)
 		for(int j = 0; j + inputMask.cols() <= img[0].cols(); j += w) {
-			VectorXd input(numInputs * numChannels);
 
 			// extract causal neighborhood
 			#pragma omp parallel for
@@ -1038,15 +1092,10 @@ vector<ArrayXXd> CMT::sampleImage(
 					img[m].block(i, j, inputMask.rows(), inputMask.cols()), inputIndices);
 
 			// sample output
-			VectorXd output;
-			
-			if(preconditioner) {
-				input = preconditioner->operator()(input);
+			if(preconditioner)
+				preconditioner->sample(model, input, inputPre, output);
+			else
 				output = model.sample(input);
-				output = preconditioner->inverse(input, output).second;
-			} else {
-				output = model.sample(input);
-			}
 
 			// bound outputs
 			for(int k = 0; k < numOutputs; ++k) {
@@ -1159,9 +1208,13 @@ vector<ArrayXXd> CMT::sampleImage(
 			throw Exception("Model and masks are incompatible.");
 	}
 
+	// buffers reused across pixels
+	VectorXd input(numInputs);
+	MatrixXd inputPre;
+	VectorXd output(numOutputs);
+
 	for(int i = 0; i + inputMask[0].rows() <= img[0].rows(); i += h)
 		for(int j = 0; j + inputMask[0].cols() <= img[0].cols(); j += w) {
-			VectorXd input(numInputs);
 
 			// extract causal neighborhood
 			for(int m = 0, offset = 0; m < numChannels; ++m) {
@@ -1171,14 +1224,10 @@ vector<ArrayXXd> CMT::sampleImage(
 			}
 
 			// sample output
-			VectorXd output;
-
-			if(preconditioner) {
-				input = preconditioner->operator()(input);
-				output = preconditioner->inverse(input, model.sample(input)).second;
-			} else {
+			if(preconditioner)
+				preconditioner->sample(model, input, inputPre, output);
+			else
 				output = model.sample(input);
-			}
 
 			// bound outputs
 			for(int k = 0; k < numOutputs; ++k) {
@@ -1260,6 +1309,10 @@ ArrayXXd CMT::sampleImageConditionally(
 			throw Exception("Model and masks are incompatible.");
 	}
 
+	// buffers for preconditioned inputs and outputs
+	MatrixXd inputPre(preconditioner ? preconditioner->dimInPre() : 0, 1);
+	MatrixXd outputPre(preconditioner ? preconditioner->dimOutPre() : 0, 1);
+
 	// extract causal neighborhoods and corresponding output regions
 	vector<vector<VectorXd> > inputs;
 	vector<vector<VectorXd> > outputs;
@@ -1293,9 +1346,9 @@ ArrayXXd CMT::sampleImageConditionally(
 			label[0] = labels(i / h, j / w);
 
 			if(preconditioner) {
-				pair<ArrayXXd, ArrayXXd> data = preconditioner->operator()(inputs[i][j], outputs[i][j]);
-				logLik[i].push_back(model.logLikelihood(data.first, data.second, label)[0]);
-				logPrb[i].push_back(log(model.prior(data.first)(label[0], 0)));
+				preconditioner->transform(inputs[i][j], outputs[i][j], inputPre, outputPre);
+				logLik[i].push_back(model.logLikelihood(inputPre, outputPre, label)[0]);
+				logPrb[i].push_back(log(model.prior(inputPre)(label[0], 0)));
 			} else {
 				logLik[i].push_back(model.logLikelihood(inputs[i][j], outputs[i][j], label)[0]);
 				logPrb[i].push_back(log(model.prior(inputs[i][j])(label[0], 0)));
@@ -1344,11 +1397,11 @@ ArrayXXd CMT::sampleImageConditionally(
 				label[0] = labels(i / h, j / w);
 
 				// propose output
-				VectorXd output;
+				VectorXd output(outputIndices.size());
 
 				if(preconditioner) {
-					VectorXd input = preconditioner->operator()(inputs[i][j]);
-					output = preconditioner->inverse(input, model.sample(input, label)).second;
+					preconditioner->transform(inputs[i][j], inputPre);
+					preconditioner->inverseTransform(inputPre, model.sample(inputPre, label), output);
 				} else {
 					output = model.sample(inputs[i][j], label);
 				}
@@ -1381,12 +1434,12 @@ ArrayXXd CMT::sampleImageConditionally(
 					label[0] = labels(m / h, n / w);
 
 					if(preconditioner) {
-						pair<ArrayXXd, ArrayXXd> data = preconditioner->operator()(inputsUpdated[k], outputs[m][n]);
+						preconditioner->transform(inputsUpdated[k], outputs[m][n], inputPre, outputPre);
 
-						logLikUpdated.push_back(model.logLikelihood(data.first, data.second, label)[0]);
+						logLikUpdated.push_back(model.logLikelihood(inputPre, outputPre, label)[0]);
 						logAlpha += logLikUpdated[k] - logLik[m][n];
 
-						logPrbUpdated.push_back(log(model.prior(data.first)(label[0], 0)));
+						logPrbUpdated.push_back(log(model.prior(inputPre)(label[0], 0)));
 						logAlpha += logPrbUpdated[k] - logPrb[m][n];
 					} else {
 						logLikUpdated.push_back(model.logLikelihood(inputsUpdated[k], outputs[m][n], label)[0]);
@@ -1511,6 +1564,57 @@ ArrayXXi CMT::sampleLabelsConditionally(
 
 
 
+/**
+ * Computes offsets (in units of the output block) to earlier positions on
+ * which sampling at a position depends. A position depends on an earlier
+ * position if it reads one of its outputs or writes one of its inputs.
+ */
+static vector<vector<int> > videoDependencies(
+	const vector<Tuples>& inputIndices,
+	const vector<Tuples>& outputIndices,
+	int l,
+	int h,
+	int w)
+{
+	set<vector<int> > dependencies;
+
+	for(int m = 0; m < inputIndices.size(); ++m)
+		for(int p = 0; p < inputIndices[m].size(); ++p)
+			for(int n = 0; n < outputIndices.size(); ++n)
+				for(int q = 0; q < outputIndices[n].size(); ++q) {
+					int df = m - n;
+					int di = inputIndices[m][p].first - outputIndices[n][q].first;
+					int dj = inputIndices[m][p].second - outputIndices[n][q].second;
+
+					// only pixels shared by positions on the grid cause dependencies
+					if(df % l || di % h || dj % w)
+						continue;
+
+					vector<int> offset(3);
+					offset[0] = df / l;
+					offset[1] = di / h;
+					offset[2] = dj / w;
+
+					// whichever of the two positions comes first in raster order
+					if(offset[0] < 0 || (offset[0] == 0 && (offset[1] < 0 || (offset[1] == 0 && offset[2] < 0))))
+						for(int k = 0; k < 3; ++k)
+							offset[k] = -offset[k];
+
+					dependencies.insert(offset);
+				}
+
+	return vector<vector<int> >(dependencies.begin(), dependencies.end());
+}
+
+
+
+/**
+ * Positions are not visited in raster order. Each position is assigned the
+ * earliest step after all positions it depends on, which allows wavefronts
+ * within frames and overlaps the sampling of subsequent frames. All positions
+ * of a step are sampled with a single call to the model. The result has the
+ * same distribution as sampling positions one after another in raster order.
+ */
 vector<ArrayXXd> CMT::sampleVideo(
 	vector<ArrayXXd> video,
 	const ConditionalDistribution& model,
@@ -1543,7 +1647,7 @@ vector<ArrayXXd> CMT::sampleVideo(
 			throw Exception("Input and output masks should be of the same size.");
 		if(inputMask[m].cols() != inputMask[0].cols() || inputMask[m].rows() != outputMask[0].rows())
 			throw Exception("Input and output masks should be of the same size.");
-		if(video[m].cols() != video[0].cols() || video[m].rows() != video[0].cols())
+		if(video[m].cols() != video[0].cols() || video[m].rows() != video[0].rows())
 			throw Exception("All video frames should be of the same size.");
 
 		inputIndices.push_back(Tuples());
@@ -1595,35 +1699,83 @@ vector<ArrayXXd> CMT::sampleVideo(
 			throw Exception("Model and masks are incompatible.");
 	}
 
-	for(int f = 0; f + inputMask.size() <= video.size(); f += l)
-		for(int i = 0; i + inputMask[0].rows() <= video[0].rows(); i += h)
-			for(int j = 0; j + inputMask[0].cols() <= video[0].cols(); j += w) {
-				VectorXd input(numInputs);
-
-				// extract causal neighborhood
-				for(int m = 0, offset = 0; m < inputMask.size(); ++m) {
-					input.segment(offset, inputIndices[m].size()) = extractFromImage(
-						video[f + m].block(i, j, inputMask[m].rows(), inputMask[m].cols()), inputIndices[m]);
-					offset += inputIndices[m].size();
+	// number of positions at which outputs are sampled
+	int numFrames = (video.size() - inputMask.size()) / l + 1;
+	int numRows = video[0].rows() < inputMask[0].rows() ? 0 :
+		(video[0].rows() - inputMask[0].rows()) / h + 1;
+	int numCols = video[0].cols() < inputMask[0].cols() ? 0 :
+		(video[0].cols() - inputMask[0].cols()) / w + 1;
+
+	// offsets to earlier positions which read outputs of a position or write its inputs
+	vector<vector<int> > dependencies = videoDependencies(inputIndices, outputIndices, l, h, w);
+
+	// earliest step at which each position can be sampled without changing the result
+	vector<int> steps(numFrames * numRows * numCols, 0);
+	int numSteps = 0;
+
+	for(int a = 0, n = 0; a < numFrames; ++a)
+		for(int b = 0; b < numRows; ++b)
+			for(int c = 0; c < numCols; ++c, ++n) {
+				for(int k = 0; k < dependencies.size(); ++k) {
+					int a2 = a - dependencies[k][0];
+					int b2 = b - dependencies[k][1];
+					int c2 = c - dependencies[k][2];
+
+					if(a2 >= 0 && b2 >= 0 && b2 < numRows && c2 >= 0 && c2 < numCols)
+						steps[n] = max(steps[n], steps[(a2 * numRows + b2) * numCols + c2] + 1);
 				}
 
-				// sample output
-				VectorXd output;
+				numSteps = max(numSteps, steps[n] + 1);
+			}
 
-				if(preconditioner) {
-					input = preconditioner->operator()(input);
-					output = preconditioner->inverse(input, model.sample(input)).second;
-				} else {
-					output = model.sample(input);
-				}
+	// group positions by step
+	vector<vector<int> > batches(numSteps);
+	for(int n = 0; n < steps.size(); ++n)
+		batches[steps[n]].push_back(n);
 
-				// replace pixels in video by model's output
-				for(int m = 0, offset = 0; m < inputMask.size(); ++m) {
-					for(int k = 0; k < outputIndices[m].size(); ++k)
-						video[f + m](i + outputIndices[m][k].first, j + outputIndices[m][k].second) = output[offset + k];
-					offset += outputIndices[m].size();
-				}
+	// buffers reused across steps
+	MatrixXd inputPre;
+
+	for(int s = 0; s < batches.size(); ++s) {
+		const vector<int>& batch = batches[s];
+
+		MatrixXd input(numInputs, batch.size());
+		MatrixXd output(numOutputs, batch.size());
+
+		// extract causal neighborhoods
+		#pragma omp parallel for
+		for(int k = 0; k < batch.size(); ++k) {
+			int f = batch[k] / (numRows * numCols) * l;
+			int i = batch[k] / numCols % numRows * h;
+			int j = batch[k] % numCols * w;
+
+			for(int m = 0, offset = 0; m < inputMask.size(); ++m) {
+				for(int q = 0; q < inputIndices[m].size(); ++q)
+					input(offset + q, k) = video[f + m](i + inputIndices[m][q].first, j + inputIndices[m][q].second);
+				offset += inputIndices[m].size();
+			}
+		}
+
+		// sample outputs of all positions in a single call
+		if(preconditioner)
+			preconditioner->sample(model, input, inputPre, output);
+		else
+			output = model.sample(input);
+
+		// replace pixels in video by model's outputs
+		#pragma omp parallel for
+		for(int k = 0; k < batch.size(); ++k) {
+			int f = batch[k] / (numRows * numCols) * l;
+			int i = batch[k] / numCols % numRows * h;
+			int j = batch[k] % numCols * w;
+
+			for(int m = 0, offset = 0; m < inputMask.size(); ++m) {
+				for(int q = 0; q < outputIndices[m].size(); ++q)
+					video[f + m](i + outputIndices[m][q].first, j + outputIndices[m][q].second) = output(offset + q, k);
+				offset += outputIndices[m].size();
 			}
+		}
+	}
 
 	return video;
 }
@@ -1638,6 +1790,9 @@ inline double computeEnergy(
 	const Tuples& inputIndices,
 	const Tuples& outputIndices,
 	const Preconditioner* preconditioner,
+	const AffinePreconditioner* affinePreconditioner,
+	MatrixXd& inputPre,
+	MatrixXd& outputPre,
 	int i,
 	int j,
 	const Tuples& offsets)
@@ -1660,8 +1815,13 @@ inline double computeEnergy(
 
 		// update energy
 		if(preconditioner) {
-			pair<ArrayXXd, ArrayXXd> data = preconditioner->operator()(input, output);
-			energy -= model.logLikelihood(data.first, data.second)[0] + preconditioner->logJacobian(input, output)[0];
+			preconditioner->transform(input, output, inputPre, outputPre);
+			energy -= model.logLikelihood(inputPre, outputPre)[0];
+
+			if(affinePreconditioner)
+				energy -= affinePreconditioner->logJacobianConstant();
+			else
+				energy -= preconditioner->logJacobian(input, output)[0];
 		} else {
 			energy -= model.logLikelihood(input, output)[0];
 		}
@@ -1701,6 +1861,19 @@ ArrayXXd CMT::fillInImage(
 	for(int i = 0; i < inputIndices.size(); ++i)
 		offsets.push_back(make_pair(-inputIndices[i].first, -inputIndices[i].second));
 
+	// buffers for preconditioned inputs and outputs, shared by all energy evaluations
+	MatrixXd inputPre;
+	MatrixXd outputPre;
+
+	// affine preconditioners have a constant Jacobian determinant
+	const AffinePreconditioner* affinePreconditioner = 0;
+
+	if(preconditioner) {
+		inputPre.resize(preconditioner->dimInPre(), 1);
+		outputPre.resize(preconditioner->dimOutPre(), 1);
+		affinePreconditioner = dynamic_cast<const AffinePreconditioner*>(preconditioner);
+	}
+
 	for(int i = 0; i < numIterations; ++i)
 		for(Tuples::iterator iter = fillInIndices.begin(); iter != fillInIndices.end(); ++iter) {
 			// sample from cauchy distribution
@@ -1713,7 +1886,8 @@ ArrayXXd CMT::fillInImage(
 				model, 
 				inputMask, outputMask,
 				inputIndices, outputIndices,
-				preconditioner,
+				preconditioner, affinePreconditioner,
+				inputPre, outputPre,
 				iter->first, iter->second,
 				offsets);
 
@@ -1728,7 +1902,8 @@ ArrayXXd CMT::fillInImage(
 					model, 
 					inputMask, outputMask,
 					inputIndices, outputIndices,
-					preconditioner,
+					preconditioner, affinePreconditioner,
+					inputPre, outputPre,
 					iter->first, iter->second,
 					offsets);
 
@@ -1803,13 +1978,13 @@ lbfgsfloatval_t fillInImageMAPGradient(
 	
 	if(preconditioner) {
 		pair<ArrayXXd, ArrayXXd> data = preconditioner->operator()(inputs, outputs);
-		results = model.computeDataGradient(data.first, data.second);
+		results = model.computeDataGradient(data.first.matrix(), data.second.matrix());
 
 		// adjust gradient and likelihood to take transformation into account
 		results.first = preconditioner->adjustGradient(results.first.first, results.first.second);
 		results.second += preconditioner->logJacobian(inputs, outputs);
 	} else {
-		results = model.computeDataGradient(inputs, outputs);
+		results = model.computeDataGradient(inputs.matrix(), outputs.matrix());
 	}
 
 	ArrayXXd& inputGradient = results.first.first;
@@ -1973,54 +2148,256 @@ ArrayXXd CMT::extractWindows(const ArrayXXd& timeSeries, int windowLength) {
 
 
 
-ArrayXXd CMT::sampleSpikeTrain(
+/**
+ * Stacks the linear filters of GLMs and STMs, whose outputs fully determine the
+ * distribution of the model's output. Returns an empty matrix for other models.
+ */
+static MatrixXd linearFilters(const ConditionalDistribution& model) {
+	if(const GLM* glm = dynamic_cast<const GLM*>(&model))
+		return glm->weights().transpose();
+
+	if(const STM* stm = dynamic_cast<const STM*>(&model)) {
+		int numFeatures = stm->numFeatures();
+		int numComponents = stm->numComponents();
+
+		// features, predictors and linear predictor
+		MatrixXd filters = MatrixXd::Zero(numFeatures + numComponents + 1, stm->dimIn());
+		filters.topLeftCorner(numFeatures, stm->dimInNonlinear()) = stm->features().transpose();
+		filters.block(numFeatures, 0, numComponents, stm->dimInNonlinear()) = stm->predictors();
+		filters.bottomRightCorner(1, stm->dimInLinear()) = stm->linearPredictor().transpose();
+
+		return filters;
+	}
+
+	return MatrixXd();
+}
+
+
+
+/**
+ * Samples outputs of a GLM or STM given the outputs of its linear filters.
+ * Uses the same random numbers as sampling the model with the corresponding
+ * inputs.
+ */
+static MatrixXd sampleFromFilterOutputs(
+	const ConditionalDistribution& model,
+	const MatrixXd& filterOutputs)
+{
+	if(const GLM* glm = dynamic_cast<const GLM*>(&model))
+		return glm->distribution()->sample(
+			(*glm->nonlinearity())(filterOutputs.row(0).array() + glm->bias()));
+
+	const STM& stm = dynamic_cast<const STM&>(model);
+
+	int numFeatures = stm.numFeatures();
+	int numComponents = stm.numComponents();
+
+	MatrixXd jointEnergy = filterOutputs.middleRows(numFeatures, numComponents);
+	if(numFeatures > 0)
+		jointEnergy += stm.weights() * filterOutputs.topRows(numFeatures).array().square().matrix();
+	jointEnergy.colwise() += stm.biases();
+
+	Array<double, 1, Dynamic> response =
+		logSumExp(stm.sharpness() * jointEnergy) / stm.sharpness()
+		+ filterOutputs.bottomRows(1).array();
+
+	return stm.distribution()->sample((*stm.nonlinearity())(response));
+}
+
+
+
+/**
+ * Samples spike trains from a GLM or STM without assembling inputs. Only the
+ * outputs of the model's linear filters are tracked. The filtered stimulus is
+ * computed for all time steps at once. Each spike adds its filtered version to
+ * the filter outputs of the following time steps, which are kept in a ring
+ * buffer. Time steps without spikes therefore cost time proportional to the
+ * number of filters, independent of the length of the spike history.
+ *
+ * An affine preconditioner of the spike history is folded into the filters.
+ */
+static bool sampleSpikeTrainsFromFilters(
 	const ArrayXXd& stimuli,
 	const ConditionalDistribution& model,
+	int numTrials,
 	int spikeHistory,
-	const Preconditioner* preconditioner)
+	const AffinePreconditioner* preconditioner,
+	ArrayXXd& spikeTrains)
 {
-	if(spikeHistory <= 0)
-		return model.sample(stimuli);
+	MatrixXd filters = linearFilters(model);
+
+	if(!filters.size())
+		return false;
+
+	int dimOut = model.dimOut();
+	int dimStim = stimuli.rows();
+	int dimHist = spikeHistory * dimOut;
+	int numFilters = filters.rows();
 
-	// container for sampled spike train
-	ArrayXXd spikeTrain = ArrayXXd::Zero(model.dimOut(), stimuli.cols());
+	if(filters.cols() != dimStim + (preconditioner ? preconditioner->dimInPre() : dimHist))
+		throw Exception("Input has wrong dimensionality.");
+
+	// filtered stimuli of all time steps
+	MatrixXd filterOutputs = filters.leftCols(dimStim) * stimuli.matrix();
+
+	// filters applied to spike history
+	MatrixXd filtersHist;
 
 	if(preconditioner) {
-		// container for input to the model and spike history
-		ArrayXd input(stimuli.rows() + preconditioner->dimInPre());
-		ArrayXd spikes(spikeHistory * model.dimOut());
-
-		for(int t = spikeHistory; t < stimuli.cols(); ++t) {
-			// extract spike history
-			for(int k = 0, i = t - spikeHistory; i < t; ++i)
-				for(int j = 0; j < model.dimOut(); ++j, ++k)
-					spikes[k] = spikeTrain(j, i);
-
-			// transform spike history
-			ArrayXd spikesPrec = preconditioner->operator()(spikes);
-
-			// copy stimulus and transformed spike history into input
-			for(int i = 0; i < stimuli.rows(); ++i)
-				input[i] = stimuli(i, t);
-			for(int i = 0; i < spikesPrec.rows(); ++i)
-				input[stimuli.rows() + i] = spikesPrec[i];
-
-			spikeTrain.col(t) = model.sample(input);
-		}
+		filtersHist = filters.rightCols(preconditioner->dimInPre()) * preconditioner->preIn();
+		filterOutputs.colwise() -= filtersHist * preconditioner->meanIn();
 	} else {
-		ArrayXd input(stimuli.rows() + spikeHistory * model.dimOut());
+		filtersHist = filters.rightCols(dimHist);
+	}
+
+	// filter outputs of the next time steps, stored in blocks of numTrials columns
+	MatrixXd filterOutputsHist = MatrixXd::Zero(numFilters, spikeHistory * numTrials);
+	MatrixXd outputs(numFilters, numTrials);
+
+	for(int t = spikeHistory; t < stimuli.cols(); ++t) {
+		int slot = t % spikeHistory;
+
+		outputs = filterOutputsHist.middleCols(slot * numTrials, numTrials);
+		outputs.colwise() += filterOutputs.col(t);
+
+		// reuse slot for time step t + spikeHistory
+		filterOutputsHist.middleCols(slot * numTrials, numTrials).setZero();
+
+		MatrixXd spikes = sampleFromFilterOutputs(model, outputs);
+
+		Map<MatrixXd>(&spikeTrains(0, t), dimOut, numTrials) = spikes;
+
+		// add contributions of new spikes to filter outputs of future time steps
+		for(int n = 0; n < numTrials; ++n)
+			for(int j = 0; j < dimOut; ++j) {
+				if(spikes(j, n) == 0.)
+					continue;
+
+				for(int d = 1; d <= spikeHistory; ++d)
+					filterOutputsHist.col((t + d) % spikeHistory * numTrials + n) +=
+						spikes(j, n) * filtersHist.col((spikeHistory - d) * dimOut + j);
+			}
+	}
+
+	return true;
+}
+
+
+
+ArrayXXd CMT::sampleSpikeTrain(
+	const ArrayXXd& stimuli,
+	const ConditionalDistribution& model,
+	int spikeHistory,
+	const Preconditioner* preconditioner)
+{
+	return sampleSpikeTrains(stimuli, model, 1, spikeHistory, preconditioner);
+}
 
-		for(int t = spikeHistory; t < stimuli.cols(); ++t) {
-			// copy stimulus and spike history into input
-			for(int i = 0; i < stimuli.rows(); ++i)
-				input[i] = stimuli(i, t);
-			for(int i = t - spikeHistory, k = stimuli.rows(); i < t; ++i)
-				for(int j = 0; j < model.dimOut(); ++j, ++k)
-					input[k] = spikeTrain(j, i);
 
-			spikeTrain.col(t) = model.sample(input);
+
+/**
+ * Samples several spike trains for the same stimuli. All trials are advanced
+ * together, so that the model is applied to one column per trial at each time
+ * step. The spike trains of trial n are stored in rows n * dimOut to
+ * (n + 1) * dimOut - 1 of the returned array.
+ *
+ * GLMs and STMs are simulated by tracking the outputs of their linear filters
+ * (see sampleSpikeTrainsFromFilters). For other models, if the spike history
+ * is transformed by an affine preconditioner, the transformed history is not
+ * recomputed at every time step. Instead, each
+ * spike adds its contribution to the transformed inputs of the following time
+ * steps, which are kept in a ring buffer. The cost of a time step then scales
+ * with the number of spikes instead of the length of the spike history.
+ */
+ArrayXXd CMT::sampleSpikeTrains(
+	const ArrayXXd& stimuli,
+	const ConditionalDistribution& model,
+	int numTrials,
+	int spikeHistory,
+	const Preconditioner* preconditioner)
+{
+	if(numTrials < 1)
+		throw Exception("Number of trials should be positive.");
+
+	int dimOut = model.dimOut();
+	int dimStim = stimuli.rows();
+
+	// container for sampled spike trains
+	ArrayXXd spikeTrains = ArrayXXd::Zero(dimOut * numTrials, stimuli.cols());
+
+	if(spikeHistory <= 0) {
+		for(int n = 0; n < numTrials; ++n)
+			spikeTrains.middleRows(n * dimOut, dimOut) = model.sample(stimuli);
+		return spikeTrains;
+	}
+
+	int dimHist = spikeHistory * dimOut;
+
+	if(preconditioner && preconditioner->dimIn() != dimHist)
+		throw Exception("Preconditioner has wrong input dimensionality.");
+
+	const AffinePreconditioner* affine = dynamic_cast<const AffinePreconditioner*>(preconditioner);
+
+	if((affine || !preconditioner) &&
+		sampleSpikeTrainsFromFilters(stimuli, model, numTrials, spikeHistory, affine, spikeTrains))
+		return spikeTrains;
+
+	// inputs to the model, one column per trial
+	MatrixXd input(dimStim + (preconditioner ? preconditioner->dimInPre() : dimHist), numTrials);
+	MatrixXd history(dimHist, numTrials);
+
+	// transformed inputs of the next time steps, stored in blocks of numTrials columns
+	MatrixXd projections;
+	MatrixXd preIn;
+	VectorXd offset;
+
+	if(affine) {
+		preIn = affine->preIn();
+		offset = -preIn * affine->meanIn();
+		projections = MatrixXd::Zero(preIn.rows(), spikeHistory * numTrials);
+	}
+
+	for(int t = spikeHistory; t < stimuli.cols(); ++t) {
+		input.topRows(dimStim).colwise() = stimuli.col(t).matrix();
+
+		if(affine) {
+			int slot = t % spikeHistory;
+
+			input.bottomRows(preIn.rows()) = projections.middleCols(slot * numTrials, numTrials);
+			input.bottomRows(preIn.rows()).colwise() += offset;
+
+			// reuse slot for time step t + spikeHistory
+			projections.middleCols(slot * numTrials, numTrials).setZero();
+		} else {
+			// spikes of time step i are stored in one column of the spike trains
+			for(int k = 0, i = t - spikeHistory; i < t; ++i, ++k)
+				history.middleRows(k * dimOut, dimOut) =
+					Map<const MatrixXd>(&spikeTrains(0, i), dimOut, numTrials);
+
+			if(preconditioner)
+				preconditioner->transform(history, input.bottomRows(preconditioner->dimInPre()));
+			else
+				input.bottomRows(dimHist) = history;
 		}
+
+		MatrixXd spikes = model.sample(input);
+
+		Map<MatrixXd>(&spikeTrains(0, t), dimOut, numTrials) = spikes;
+
+		if(affine)
+			// add contributions of new spikes to transformed inputs of future time steps
+			for(int n = 0; n < numTrials; ++n)
+				for(int j = 0; j < dimOut; ++j) {
+					if(spikes(j, n) == 0.)
+						continue;
+
+					for(int d = 1; d <= spikeHistory; ++d) {
+						int slot = (t + d) % spikeHistory;
+						projections.col(slot * numTrials + n) +=
+							spikes(j, n) * preIn.col((spikeHistory - d) * dimOut + j);
+					}
+				}
 	}
 
-	return spikeTrain;
+	return spikeTrains;
 }
@@ -2,15 +2,33 @@
 	#include <gettimeofday.h>
 #else
 	#include <sys/time.h>
+	#include <sys/resource.h>
 #endif
 
 #include <cstdlib>
 #include "trainable.h"
 #include "exception.h"
+#include "utils.h"
 
 #include "Eigen/Core"
 using Eigen::ColMajor;
 using Eigen::MatrixXd;
+using Eigen::VectorXd;
+using Eigen::Lower;
+using Eigen::StrictlyUpper;
+
+#include "Eigen/SparseCore"
+using Eigen::Triplet;
+
+#include <utility>
+using std::pair;
+using std::make_pair;
+
+#include <vector>
+using std::vector;
+
+#include <string>
+using std::string;
 
 #include <limits>
 using std::numeric_limits;
@@ -31,6 +49,84 @@ using std::endl;
 using std::setw;
 using std::setprecision;
 
+#include <algorithm>
+using std::swap;
+using std::min;
+using std::max;
+
+#include <exception>
+using std::exception_ptr;
+using std::current_exception;
+using std::rethrow_exception;
+
+#include <thread>
+using std::thread;
+
+/**
+ * Returns the wall-clock time in seconds.
+ */
+static double wallTime() {
+	timeval time;
+	gettimeofday(&time, 0);
+	return time.tv_sec + time.tv_usec / 1E6;
+}
+
+
+
+/**
+ * Returns the peak resident memory of the process in bytes, or zero if it is
+ * not available.
+ */
+static long peakMemory() {
+#ifdef _WIN32
+	return 0;
+#else
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	#ifdef __APPLE__
+		return usage.ru_maxrss;
+	#else
+		// measured in kilobytes
+		return usage.ru_maxrss * 1024L;
+	#endif
+#endif
+}
+
+
+
+/**
+ * Evaluates the validation error of a snapshot of parameters in a separate
+ * thread, using a copy of the model which is being trained.
+ */
+struct CMT::Trainable::AsyncValidation {
+	public:
+		Trainable* model;
+		const MatrixXd* input;
+		const MatrixXd* output;
+
+		// snapshot of parameters and the state of L-BFGS when it was taken
+		lbfgsfloatval_t* parameters;
+		int iteration;
+		double fx;
+
+		double logLoss;
+		bool running;
+
+		AsyncValidation(Trainable* model, const MatrixXd* input, const MatrixXd* output, int numParameters);
+		~AsyncValidation();
+
+		void start(const lbfgsfloatval_t* x, int iteration, double fx, const Parameters& params);
+		void wait();
+
+	private:
+		int mNumParameters;
+		thread mThread;
+		exception_ptr mException;
+
+		void run();
+};
+
+
 CMT::Trainable::Callback::~Callback() {
 }
 
@@ -46,6 +142,7 @@ CMT::Trainable::Parameters::Parameters() {
 	cbIter = 25;
 	valIter = 5;
 	valLookAhead = 20;
+	valAsync = false;
 	stationary = false;
 }
 
@@ -68,6 +165,7 @@ CMT::Trainable::Parameters::Parameters(const Parameters& params) :
 	cbIter(params.cbIter),
 	valIter(params.valIter),
 	valLookAhead(params.valLookAhead),
+	valAsync(params.valAsync),
 	stationary(params.stationary)
 {
 	if(params.callback)
@@ -88,6 +186,7 @@ CMT::Trainable::Parameters& CMT::Trainable::Parameters::operator=(
 	cbIter = params.cbIter;
 	valIter = params.valIter;
 	valLookAhead = params.valLookAhead;
+	valAsync = params.valAsync;
 	stationary = params.stationary;
 
 	return *this;
@@ -95,6 +194,68 @@ CMT::Trainable::Parameters& CMT::Trainable::Parameters::operator=(
 
 
 
+CMT::Trainable::Telemetry::Telemetry() :
+	numIterations(0),
+	numEvaluations(0),
+	numData(0),
+	batchSize(0),
+	peakMemoryIncrease(0),
+	totalTime(0.),
+	gradientTime(0.),
+	validationTime(0.),
+	callbackTime(0.),
+	setParametersTime(0.)
+{
+}
+
+
+
+/**
+ * Adds the measurements of an optimization which continued where the other one
+ * stopped.
+ */
+CMT::Trainable::Telemetry& CMT::Trainable::Telemetry::operator+=(
+	const Telemetry& telemetry)
+{
+	numIterations += telemetry.numIterations;
+	numEvaluations += telemetry.numEvaluations;
+	lineSearchEvaluations.insert(lineSearchEvaluations.end(),
+		telemetry.lineSearchEvaluations.begin(),
+		telemetry.lineSearchEvaluations.end());
+	peakMemoryIncrease = max(peakMemoryIncrease, telemetry.peakMemoryIncrease);
+	totalTime += telemetry.totalTime;
+	gradientTime += telemetry.gradientTime;
+	validationTime += telemetry.validationTime;
+	callbackTime += telemetry.callbackTime;
+	setParametersTime += telemetry.setParametersTime;
+
+	return *this;
+}
+
+
+
+/**
+ * Data points processed per second of evaluating the objective and gradient.
+ */
+double CMT::Trainable::Telemetry::throughput() const {
+	if(gradientTime <= 0.)
+		return 0.;
+	return static_cast<double>(numEvaluations) * numData / gradientTime;
+}
+
+
+
+/**
+ * Batches processed per second of evaluating the objective and gradient.
+ */
+double CMT::Trainable::Telemetry::batchThroughput() const {
+	if(gradientTime <= 0. || batchSize < 1)
+		return 0.;
+	return static_cast<double>(numEvaluations) * ((numData + batchSize - 1) / batchSize) / gradientTime;
+}
+
+
+
 CMT::Trainable::InstanceLBFGS::InstanceLBFGS(
 	CMT::Trainable* cd,
 	const CMT::Trainable::Parameters* params,
@@ -104,12 +265,17 @@ CMT::Trainable::InstanceLBFGS::InstanceLBFGS(
 	params(params),
 	input(input),
 	output(output),
+	inputSparse(0),
+	inputWindows(0),
+	inputBinary(0),
 	inputVal(0),
 	outputVal(0),
 	logLoss(numeric_limits<double>::max()),
 	counter(0),
 	parameters(0),
-	fx(numeric_limits<double>::max())
+	fx(numeric_limits<double>::max()),
+	validation(0),
+	telemetry(0)
 {
 }
 
@@ -126,29 +292,208 @@ CMT::Trainable::InstanceLBFGS::InstanceLBFGS(
 	params(params),
 	input(input),
 	output(output),
+	inputSparse(0),
+	inputWindows(0),
+	inputBinary(0),
 	inputVal(inputVal),
 	outputVal(outputVal),
 	logLoss(numeric_limits<double>::max()),
 	counter(0),
 	parameters(cd->parameters(*params)),
-	fx(numeric_limits<double>::max())
+	fx(numeric_limits<double>::max()),
+	validation(0),
+	telemetry(0)
+{
+}
+
+
+
+CMT::Trainable::InstanceLBFGS::InstanceLBFGS(
+	CMT::Trainable* cd,
+	const CMT::Trainable::Parameters* params,
+	const MatrixXd* inputDense,
+	const SparseMatrixXd* inputSparse,
+	const MatrixXd* output) :
+	cd(cd),
+	params(params),
+	input(inputDense),
+	output(output),
+	inputSparse(inputSparse),
+	inputWindows(0),
+	inputBinary(0),
+	inputVal(0),
+	outputVal(0),
+	logLoss(numeric_limits<double>::max()),
+	counter(0),
+	parameters(0),
+	fx(numeric_limits<double>::max()),
+	validation(0),
+	telemetry(0)
+{
+}
+
+
+
+CMT::Trainable::InstanceLBFGS::InstanceLBFGS(
+	CMT::Trainable* cd,
+	const CMT::Trainable::Parameters* params,
+	const MatrixXd* inputDense,
+	const WindowedTimeSeries* inputWindows,
+	const MatrixXd* output) :
+	cd(cd),
+	params(params),
+	input(inputDense),
+	output(output),
+	inputSparse(0),
+	inputWindows(inputWindows),
+	inputBinary(0),
+	inputVal(0),
+	outputVal(0),
+	logLoss(numeric_limits<double>::max()),
+	counter(0),
+	parameters(0),
+	fx(numeric_limits<double>::max()),
+	validation(0),
+	telemetry(0)
+{
+}
+
+
+
+CMT::Trainable::InstanceLBFGS::InstanceLBFGS(
+	CMT::Trainable* cd,
+	const CMT::Trainable::Parameters* params,
+	const BinaryMatrix* inputBinary,
+	const MatrixXd* output,
+	const MatrixXd* inputVal,
+	const MatrixXd* outputVal) :
+	cd(cd),
+	params(params),
+	input(0),
+	output(output),
+	inputSparse(0),
+	inputWindows(0),
+	inputBinary(inputBinary),
+	inputVal(inputVal),
+	outputVal(outputVal),
+	logLoss(numeric_limits<double>::max()),
+	counter(0),
+	parameters(inputVal && outputVal ? cd->parameters(*params) : 0),
+	fx(numeric_limits<double>::max()),
+	validation(0),
+	telemetry(0)
 {
 }
 
 
 
 CMT::Trainable::InstanceLBFGS::~InstanceLBFGS() {
+	if(validation)
+		delete validation;
 	if(parameters)
 		lbfgs_free(parameters);
 }
 
 
 
+CMT::Trainable::AsyncValidation::AsyncValidation(
+	Trainable* model,
+	const MatrixXd* input,
+	const MatrixXd* output,
+	int numParameters) :
+	model(model),
+	input(input),
+	output(output),
+	parameters(lbfgs_malloc(numParameters)),
+	iteration(0),
+	fx(0.),
+	logLoss(0.),
+	running(false),
+	mNumParameters(numParameters)
+{
+}
+
+
+
+CMT::Trainable::AsyncValidation::~AsyncValidation() {
+	if(running)
+		mThread.join();
+	lbfgs_free(parameters);
+	delete model;
+}
+
+
+
+/**
+ * Takes a snapshot of the parameters and starts evaluating it. The copy of
+ * the model is only touched by the calling thread while no evaluation is
+ * running.
+ */
+void CMT::Trainable::AsyncValidation::start(
+	const lbfgsfloatval_t* x,
+	int iteration,
+	double fx,
+	const Parameters& params)
+{
+	wait();
+
+	for(int i = 0; i < mNumParameters; ++i)
+		parameters[i] = x[i];
+
+	this->iteration = iteration;
+	this->fx = fx;
+
+	model->setParameters(parameters, params);
+
+	mThread = thread(&AsyncValidation::run, this);
+	running = true;
+}
+
+
+
+void CMT::Trainable::AsyncValidation::wait() {
+	if(!running)
+		return;
+
+	mThread.join();
+	running = false;
+
+	if(mException) {
+		exception_ptr exception = mException;
+		mException = exception_ptr();
+		rethrow_exception(exception);
+	}
+}
+
+
+
+void CMT::Trainable::AsyncValidation::run() {
+	try {
+		logLoss = model->evaluate(*input, *output);
+	} catch(...) {
+		// exceptions are passed on to the thread calling wait()
+		mException = current_exception();
+	}
+}
+
+
+
+CMT::Trainable::Trainable() : mCachedOutput(0), mCachedLogBaseMeasure(0.) {
+}
+
+
+
 CMT::Trainable::~Trainable() {
 }
 
 
 
+const CMT::Trainable::Telemetry& CMT::Trainable::telemetry() const {
+	return mTelemetry;
+}
+
+
+
 int CMT::Trainable::callbackLBFGS(
 	void* instance,
 	const lbfgsfloatval_t* x,
@@ -158,48 +503,85 @@ int CMT::Trainable::callbackLBFGS(
 	const lbfgsfloatval_t gnorm,
 	const lbfgsfloatval_t, int,
 	int iteration,
-	int)
+	int numLineSearch)
 {
 	// unpack user data
 	InstanceLBFGS* inst = static_cast<InstanceLBFGS*>(instance);
 
 	const CMT::Trainable::Parameters& params = *inst->params;
 
+	Telemetry* telemetry = inst->telemetry;
+
+	if(telemetry) {
+		telemetry->numIterations = iteration;
+		telemetry->lineSearchEvaluations.push_back(numLineSearch);
+	}
+
+	double start;
+
 	// check whether to evaluate validation set
-	if(inst->inputVal && inst->outputVal && iteration % params.valIter == 0) {
-		inst->cd->setParameters(x, params);
+	if(inst->validation && iteration % params.valIter == 0) {
+		AsyncValidation& validation = *inst->validation;
 
-		double logLoss = inst->cd->evaluate(*inst->inputVal, *inst->outputVal);
+		start = wallTime();
 
-		if(params.verbosity > 0) {
-			cout << setw(6) << iteration;
-			cout << setw(11) << setprecision(5) << fx;
-			cout << setw(11) << setprecision(5) << logLoss << endl;
+		// use result of previous evaluation, which was running during the last iterations
+		if(validation.running) {
+			validation.wait();
+
+			if(validate(inst, validation.parameters, validation.logLoss, validation.iteration, validation.fx)) {
+				if(telemetry)
+					telemetry->validationTime += wallTime() - start;
+				return 1;
+			}
 		}
 
-		if(logLoss < inst->logLoss) {
-			// store current parameters for later
-			for(int i = 0, N = inst->cd->numParameters(params); i < N; ++i)
-				inst->parameters[i] = x[i];
+		// evaluate current parameters while optimization continues
+		validation.start(x, iteration, fx, params);
 
-			inst->counter = 0;
-			inst->logLoss = logLoss;
-		} else {
-			inst->counter += 1;
+		if(telemetry)
+			telemetry->validationTime += wallTime() - start;
 
-			if(params.valLookAhead > 0 && inst->counter >= params.valLookAhead)
-				// performance did not improve for valLookAhead times
-				return 1;
+		if(params.verbosity > 0)
+			cout << setw(6) << iteration << setw(11) << setprecision(5) << fx << endl;
+
+	} else if(inst->inputVal && inst->outputVal && iteration % params.valIter == 0) {
+		start = wallTime();
+		inst->cd->setParameters(x, params);
+
+		if(telemetry) {
+			telemetry->setParametersTime += wallTime() - start;
+			start = wallTime();
 		}
+
+		bool stop = validate(inst, x, inst->cd->evaluate(*inst->inputVal, *inst->outputVal), iteration, fx);
+
+		if(telemetry)
+			telemetry->validationTime += wallTime() - start;
+
+		if(stop)
+			return 1;
+
 	} else {
 		if(params.verbosity > 0)
 			cout << setw(6) << iteration << setw(11) << setprecision(5) << fx << endl;
 	}
 
 	if(params.callback && iteration % params.cbIter == 0) {
+		start = wallTime();
 		inst->cd->setParameters(x, params);
 
-		if(!(*params.callback)(iteration, *inst->cd))
+		if(telemetry) {
+			telemetry->setParametersTime += wallTime() - start;
+			start = wallTime();
+		}
+
+		bool proceed = (*params.callback)(iteration, *inst->cd);
+
+		if(telemetry)
+			telemetry->callbackTime += wallTime() - start;
+
+		if(!proceed)
 			return 1;
 	}
 
@@ -214,6 +596,45 @@ int CMT::Trainable::callbackLBFGS(
 
 
 
+/**
+ * Keeps track of the parameters with the smallest validation error. Returns
+ * true if the validation error did not improve for too long.
+ */
+bool CMT::Trainable::validate(
+	InstanceLBFGS* inst,
+	const lbfgsfloatval_t* x,
+	double logLoss,
+	int iteration,
+	double fx)
+{
+	const CMT::Trainable::Parameters& params = *inst->params;
+
+	if(params.verbosity > 0) {
+		cout << setw(6) << iteration;
+		cout << setw(11) << setprecision(5) << fx;
+		cout << setw(11) << setprecision(5) << logLoss << endl;
+	}
+
+	if(logLoss < inst->logLoss) {
+		// store parameters for later
+		for(int i = 0, N = inst->cd->numParameters(params); i < N; ++i)
+			inst->parameters[i] = x[i];
+
+		inst->counter = 0;
+		inst->logLoss = logLoss;
+	} else {
+		inst->counter += 1;
+
+		if(params.valLookAhead > 0 && inst->counter >= params.valLookAhead)
+			// performance did not improve for valLookAhead times
+			return true;
+	}
+
+	return false;
+}
+
+
+
 lbfgsfloatval_t CMT::Trainable::evaluateLBFGS(
 	void* instance,
 	const lbfgsfloatval_t* x,
@@ -224,28 +645,101 @@ lbfgsfloatval_t CMT::Trainable::evaluateLBFGS(
 	const InstanceLBFGS& inst = *static_cast<InstanceLBFGS*>(instance);
 	const CMT::Trainable& cd = *inst.cd;
 	const CMT::Trainable::Parameters& params = *inst.params;
-	const MatrixXd& input = *inst.input;
 	const MatrixXd& output = *inst.output;
 
-	return cd.parameterGradient(input, output, x, g, params);
+	double start = inst.telemetry ? wallTime() : 0.;
+	double value;
+
+	if(inst.inputBinary)
+		value = cd.parameterGradient(*inst.inputBinary, output, x, g, params);
+	else if(inst.inputSparse)
+		value = cd.parameterGradient(*inst.input, *inst.inputSparse, output, x, g, params);
+	else if(inst.inputWindows)
+		value = cd.parameterGradient(*inst.input, *inst.inputWindows, output, x, g, params);
+	else
+		value = cd.parameterGradient(*inst.input, output, x, g, params);
+
+	if(inst.telemetry) {
+		inst.telemetry->numEvaluations += 1;
+		inst.telemetry->gradientTime += wallTime() - start;
+	}
+
+	return value;
 }
 
 
 
-MatrixXd CMT::Trainable::fisherInformation( 
+/**
+ * Names and sizes of the groups of parameters in the order used by
+ * parameters(). By default, all parameters form a single group.
+ */
+vector<pair<string, int> > CMT::Trainable::parameterBlocks(const Parameters& params) const {
+	return vector<pair<string, int> >(1, make_pair(string("parameters"), numParameters(params)));
+}
+
+
+
+double CMT::Trainable::parameterGradient(
+	const MatrixXd& inputDense,
+	const SparseMatrixXd& inputSparse,
+	const MatrixXd& output,
+	const lbfgsfloatval_t* x,
+	lbfgsfloatval_t* g,
+	const Parameters& params) const
+{
+	throw Exception("Sparse inputs are not supported by this model.");
+}
+
+
+
+double CMT::Trainable::parameterGradient(
+	const MatrixXd& inputDense,
+	const WindowedTimeSeries& inputWindows,
+	const MatrixXd& output,
+	const lbfgsfloatval_t* x,
+	lbfgsfloatval_t* g,
+	const Parameters& params) const
+{
+	throw Exception("Windowed time series are not supported by this model.");
+}
+
+
+
+double CMT::Trainable::parameterGradient(
+	const BinaryMatrix& input,
+	const MatrixXd& output,
+	const lbfgsfloatval_t* x,
+	lbfgsfloatval_t* g,
+	const Parameters& params) const
+{
+	throw Exception("Binary inputs are not supported by this model.");
+}
+
+
+
+/**
+ * Computes the gradient of parameterGradient() for each data point separately,
+ * i.e., the gradient of the negative log-likelihood (in bits) of a single data
+ * point plus the gradient of the regularizers. Returns one column per data
+ * point.
+ *
+ * This default implementation evaluates parameterGradient() once per data
+ * point. Models should override it to compute all gradients in one pass.
+ */
+MatrixXd CMT::Trainable::perExampleGradients(
 	const MatrixXd& input,
 	const MatrixXd& output,
-	const Parameters& params)
+	const Parameters& params) const
 {
 	if(input.rows() != dimIn() || output.rows() != dimOut())
 		throw Exception("Data has wrong dimensionality.");
 	if(input.cols() != output.cols())
 		throw Exception("The number of inputs and outputs should be the same.");
 
-	Matrix<double, Dynamic, Dynamic, ColMajor> gradients(numParameters(params), input.cols());
-
 	int n = numParameters(params);
 
+	Matrix<double, Dynamic, Dynamic, ColMajor> gradients(n, input.cols());
+
 	// get parameters and allocate memory for gradient
 	lbfgsfloatval_t* x = parameters(params);
 
@@ -255,8 +749,56 @@ MatrixXd CMT::Trainable::fisherInformation(
 
 	lbfgs_free(x);
 
-	// estimate Fisher information matrix (correcting that gradients are for base two log-likelihood)
-	return gradients * gradients.transpose() * pow(log(2.), 2);
+	return gradients;
+}
+
+
+
+/**
+ * Estimates the Fisher information matrix from per-example gradients, which
+ * are computed for batches of data points. Each batch is added to the lower
+ * triangle of the matrix in panels of columns, which are updated in parallel.
+ */
+MatrixXd CMT::Trainable::fisherInformation( 
+	const MatrixXd& input,
+	const MatrixXd& output,
+	const Parameters& params)
+{
+	if(input.rows() != dimIn() || output.rows() != dimOut())
+		throw Exception("Data has wrong dimensionality.");
+	if(input.cols() != output.cols())
+		throw Exception("The number of inputs and outputs should be the same.");
+
+	int n = numParameters(params);
+	int numData = input.cols();
+	int batchSize = min(max(params.batchSize, 1), max(numData, 1));
+	int panelSize = 64;
+
+	MatrixXd fisherInformation = MatrixXd::Zero(n, n);
+
+	for(int b = 0; b < numData; b += batchSize) {
+		int width = min(batchSize, numData - b);
+
+		MatrixXd gradients = perExampleGradients(
+			input.middleCols(b, width),
+			output.middleCols(b, width),
+			params);
+
+		#pragma omp parallel for schedule(dynamic)
+		for(int j = 0; j < n; j += panelSize) {
+			int w = min(panelSize, n - j);
+
+			// diagonal block and the rest of the panel below it
+			fisherInformation.block(j, j, w, w).selfadjointView<Lower>().rankUpdate(gradients.middleRows(j, w));
+			fisherInformation.block(j + w, j, n - j - w, w).noalias() +=
+				gradients.bottomRows(n - j - w) * gradients.middleRows(j, w).transpose();
+		}
+	}
+
+	fisherInformation.triangularView<StrictlyUpper>() = fisherInformation.transpose();
+
+	// correct that gradients are for base two log-likelihood
+	return fisherInformation * pow(log(2.), 2);
 }
 
 
@@ -319,21 +861,161 @@ bool CMT::Trainable::train(
 
 
 bool CMT::Trainable::train(
-	const MatrixXd& input,
+	const SparseMatrixXd& input,
 	const MatrixXd& output,
-	const MatrixXd* inputVal,
-	const MatrixXd* outputVal,
 	const Parameters& params)
 {
-	if(input.rows() != dimIn() || output.rows() != dimOut())
+	return train(MatrixXd(0, input.cols()), input, output, params);
+}
+
+
+
+bool CMT::Trainable::train(
+	const MatrixXd& inputDense,
+	const SparseMatrixXd& inputSparse,
+	const MatrixXd& output,
+	const Parameters& params)
+{
+	if(inputDense.rows() + inputSparse.rows() != dimIn() || output.rows() != dimOut())
 		throw Exception("Data has wrong dimensionality.");
 
-	if(input.cols() != output.cols())
+	if(inputDense.cols() != output.cols() || inputSparse.cols() != output.cols())
 		throw Exception("The number of inputs and outputs should be the same.");
 
-	if(inputVal && outputVal) {
-		if(inputVal->rows() != dimIn() || outputVal->rows() != dimOut())
-			throw Exception("Data has wrong dimensionality.");
+	if(output.cols() < 1)
+		return true;
+
+	if(numParameters(params) < 1)
+		return true;
+
+	// wrap all additional arguments to optimization routine
+	InstanceLBFGS instance(this, &params, &inputDense, &inputSparse, &output);
+
+	return optimize(instance, params);
+}
+
+
+
+bool CMT::Trainable::train(
+	const WindowedTimeSeries& input,
+	const MatrixXd& output,
+	const Parameters& params)
+{
+	return train(MatrixXd(0, input.cols()), input, output, params);
+}
+
+
+
+/**
+ * Trains the model on dense inputs stacked on top of windows extracted from
+ * time series, without storing the windows.
+ */
+bool CMT::Trainable::train(
+	const MatrixXd& inputDense,
+	const WindowedTimeSeries& inputWindows,
+	const MatrixXd& output,
+	const Parameters& params)
+{
+	if(inputDense.rows() + inputWindows.rows() != dimIn() || output.rows() != dimOut())
+		throw Exception("Data has wrong dimensionality.");
+
+	if(inputDense.cols() != output.cols() || inputWindows.cols() != output.cols())
+		throw Exception("The number of inputs and outputs should be the same.");
+
+	if(output.cols() < 1)
+		return true;
+
+	if(numParameters(params) < 1)
+		return true;
+
+	// wrap all additional arguments to optimization routine
+	InstanceLBFGS instance(this, &params, &inputDense, &inputWindows, &output);
+
+	return optimize(instance, params);
+}
+
+
+
+bool CMT::Trainable::train(
+	const BinaryMatrix& input,
+	const MatrixXd& output,
+	const Parameters& params)
+{
+	return train(input, output, 0, 0, params);
+}
+
+
+
+bool CMT::Trainable::train(
+	const BinaryMatrix& input,
+	const MatrixXd& output,
+	const MatrixXd& inputVal,
+	const MatrixXd& outputVal,
+	const Parameters& params)
+{
+	return train(input, output, &inputVal, &outputVal, params);
+}
+
+
+
+/**
+ * Trains the model on bit-packed binary inputs without converting them into a
+ * dense matrix. Validation data is only evaluated and stays dense.
+ */
+bool CMT::Trainable::train(
+	const BinaryMatrix& input,
+	const MatrixXd& output,
+	const MatrixXd* inputVal,
+	const MatrixXd* outputVal,
+	const Parameters& params)
+{
+	if(input.rows() != dimIn() || output.rows() != dimOut())
+		throw Exception("Data has wrong dimensionality.");
+
+	if(input.cols() != output.cols())
+		throw Exception("The number of inputs and outputs should be the same.");
+
+	if(inputVal && outputVal) {
+		if(inputVal->rows() != dimIn() || outputVal->rows() != dimOut())
+			throw Exception("Data has wrong dimensionality.");
+
+		if(inputVal->cols() != outputVal->cols())
+			throw Exception("The number of validation inputs and outputs should be the same.");
+
+	} else if(inputVal || outputVal) {
+		throw Exception("Inputs or outputs of the validation set are missing.");
+	}
+
+	if(output.cols() < 1)
+		return true;
+
+	if(numParameters(params) < 1)
+		return true;
+
+	// wrap all additional arguments to optimization routine
+	InstanceLBFGS instance(this, &params, &input, &output, inputVal, outputVal);
+
+	return optimize(instance, params);
+}
+
+
+
+bool CMT::Trainable::train(
+	const MatrixXd& input,
+	const MatrixXd& output,
+	const MatrixXd* inputVal,
+	const MatrixXd* outputVal,
+	const Parameters& params)
+{
+	if(input.rows() != dimIn() || output.rows() != dimOut())
+		throw Exception("Data has wrong dimensionality.");
+
+	if(input.cols() != output.cols())
+		throw Exception("The number of inputs and outputs should be the same.");
+
+	if(inputVal && outputVal) {
+		if(inputVal->rows() != dimIn() || outputVal->rows() != dimOut())
+			throw Exception("Data has wrong dimensionality.");
 
 		if(inputVal->cols() != outputVal->cols())
 			throw Exception("The number of validation inputs and outputs should be the same.");
@@ -348,6 +1030,26 @@ bool CMT::Trainable::train(
 	if(numParameters(params) < 1)
 		return true;
 
+	// wrap all additional arguments to optimization routine
+	InstanceLBFGS instance(this, &params, &input, &output, inputVal, outputVal);
+
+	return optimize(instance, params);
+}
+
+
+
+bool CMT::Trainable::optimize(InstanceLBFGS& instance, const Parameters& params) {
+	const MatrixXd* inputVal = instance.inputVal;
+	const MatrixXd* outputVal = instance.outputVal;
+
+	double start = wallTime();
+	long memory = peakMemory();
+
+	mTelemetry = Telemetry();
+	mTelemetry.numData = static_cast<int>(instance.output->cols());
+	mTelemetry.batchSize = params.batchSize;
+	instance.telemetry = &mTelemetry;
+
 	// create copy of model parameters for L-BFGS
 	lbfgsfloatval_t* x = parameters(params);
 
@@ -361,9 +1063,6 @@ bool CMT::Trainable::train(
 	hyperparams.max_linesearch = 100;
 	hyperparams.ftol = 1e-4;
 
-	// wrap all additional arguments to optimization routine
-	InstanceLBFGS instance(this, &params, &input, &output, inputVal, outputVal);
-
 	if(params.verbosity > 0) {
 		if(inputVal && outputVal) {
 			cout << setw(6) << 0;
@@ -375,14 +1074,35 @@ bool CMT::Trainable::train(
 		}
 	}
 
+	if(params.valAsync && inputVal && outputVal && instance.parameters) {
+		// validation error is evaluated in the background on a copy of the model
+		Trainable* model = copy();
+
+		if(model)
+			instance.validation = new AsyncValidation(model, inputVal, outputVal, numParameters(params));
+	}
+
 	// start LBFGS optimization
 	int status = LBFGSERR_MAXIMUMITERATION;
-	if(params.maxIter > 0)
+	if(params.maxIter > 0) {
+		CacheGuard cache(this, instance.output);
 		status = lbfgs(numParameters(params), x, 0,
 			&evaluateLBFGS,
 			&callbackLBFGS,
 			&instance,
 			&hyperparams);
+	}
+
+	double time = wallTime();
+
+	if(instance.validation && instance.validation->running) {
+		// use result of last evaluation of the validation error
+		AsyncValidation& validation = *instance.validation;
+
+		validation.wait();
+		validate(&instance,
+			validation.parameters, validation.logLoss, validation.iteration, validation.fx);
+	}
 
 	// copy parameters back
 	setParameters(x, params);
@@ -398,11 +1118,20 @@ bool CMT::Trainable::train(
 		if(logLoss < evaluate(*inputVal, *outputVal))
 			// otherwise, use other set of parameters after all
 			setParameters(x, params);
+
+		mTelemetry.validationTime += wallTime() - time;
+	} else {
+		mTelemetry.setParametersTime += wallTime() - time;
 	}
 
 	// free memory used by LBFGS
 	lbfgs_free(x);
 
+	instance.telemetry = 0;
+
+	mTelemetry.totalTime = wallTime() - start;
+	mTelemetry.peakMemoryIncrease = peakMemory() - memory;
+
 	if(status >= 0) {
 		return true;
 	} else {
@@ -414,6 +1143,186 @@ bool CMT::Trainable::train(
 
 
 
+/**
+ * Creates a copy of the model which can be used independently of it, or returns
+ * 0 if this is not supported. Used to evaluate the validation error while the
+ * model is being trained.
+ */
+CMT::Trainable* CMT::Trainable::copy() const {
+	return 0;
+}
+
+
+
+/**
+ * Computes a (quasi-)Newton search direction from the current parameters and
+ * gradient. Returns false if no such direction is available, in which case
+ * trainNewton() falls back to L-BFGS.
+ */
+bool CMT::Trainable::newtonDirection(
+	const MatrixXd& input,
+	const MatrixXd& output,
+	const lbfgsfloatval_t* x,
+	const lbfgsfloatval_t* g,
+	lbfgsfloatval_t* d,
+	const Parameters& params) const
+{
+	return false;
+}
+
+
+
+/**
+ * Minimizes the objective using Newton steps computed by newtonDirection()
+ * combined with a backtracking line search.
+ */
+bool CMT::Trainable::trainNewton(
+	const MatrixXd& input,
+	const MatrixXd& output,
+	const Parameters& params)
+{
+	if(input.rows() != dimIn() || output.rows() != dimOut())
+		throw Exception("Data has wrong dimensionality.");
+
+	if(input.cols() != output.cols())
+		throw Exception("The number of inputs and outputs should be the same.");
+
+	int numParams = numParameters(params);
+
+	if(input.cols() < 1 || numParams < 1)
+		return true;
+
+	lbfgsfloatval_t* x = parameters(params);
+	lbfgsfloatval_t* y = lbfgs_malloc(numParams);
+	lbfgsfloatval_t* g = lbfgs_malloc(numParams);
+	lbfgsfloatval_t* h = lbfgs_malloc(numParams);
+	lbfgsfloatval_t* d = lbfgs_malloc(numParams);
+
+	double start = wallTime();
+	long memory = peakMemory();
+
+	mTelemetry = Telemetry();
+	mTelemetry.numData = static_cast<int>(output.cols());
+	mTelemetry.batchSize = params.batchSize;
+
+	CacheGuard cache(this, &output);
+
+	double time = wallTime();
+	double fx = parameterGradient(input, output, x, g, params);
+
+	mTelemetry.numEvaluations += 1;
+	mTelemetry.gradientTime += wallTime() - time;
+
+	if(params.verbosity > 0)
+		cout << setw(6) << 0 << setw(11) << setprecision(5) << fx << endl;
+
+	bool converged = false;
+	bool fallback = false;
+
+	for(int iter = 1; iter <= params.maxIter; ++iter) {
+		if(!newtonDirection(input, output, x, g, d, params)) {
+			fallback = true;
+			break;
+		}
+
+		// directional derivative
+		double slope = 0.;
+		for(int i = 0; i < numParams; ++i)
+			slope += g[i] * d[i];
+
+		if(slope >= 0.) {
+			// not a descent direction
+			fallback = true;
+			break;
+		}
+
+		// backtracking line search
+		double fy = fx;
+		double step = 1.;
+		bool accepted = false;
+
+		int k = 0;
+
+		for(; k < 50; ++k, step /= 2.) {
+			for(int i = 0; i < numParams; ++i)
+				y[i] = x[i] + step * d[i];
+
+			time = wallTime();
+			fy = parameterGradient(input, output, y, h, params);
+
+			mTelemetry.numEvaluations += 1;
+			mTelemetry.gradientTime += wallTime() - time;
+
+			if(fy <= fx + 1e-4 * step * slope) {
+				accepted = true;
+				break;
+			}
+		}
+
+		mTelemetry.numIterations = iter;
+		mTelemetry.lineSearchEvaluations.push_back(accepted ? k + 1 : k);
+
+		if(!accepted) {
+			// no further progress possible
+			converged = true;
+			break;
+		}
+
+		swap(x, y);
+		swap(g, h);
+
+		double fPrev = fx;
+		fx = fy;
+
+		if(params.verbosity > 0)
+			cout << setw(6) << iter << setw(11) << setprecision(5) << fx << endl;
+
+		if(params.callback && iter % params.cbIter == 0) {
+			time = wallTime();
+			setParameters(x, params);
+			mTelemetry.setParametersTime += wallTime() - time;
+
+			time = wallTime();
+			bool proceed = (*params.callback)(iter, *this);
+			mTelemetry.callbackTime += wallTime() - time;
+
+			if(!proceed)
+				break;
+		}
+
+		if(fPrev - fx < params.threshold) {
+			converged = true;
+			break;
+		}
+	}
+
+	time = wallTime();
+	setParameters(x, params);
+	mTelemetry.setParametersTime += wallTime() - time;
+
+	lbfgs_free(x);
+	lbfgs_free(y);
+	lbfgs_free(g);
+	lbfgs_free(h);
+	lbfgs_free(d);
+
+	mTelemetry.totalTime = wallTime() - start;
+	mTelemetry.peakMemoryIncrease = peakMemory() - memory;
+
+	if(fallback) {
+		// continue optimization with L-BFGS
+		Telemetry telemetry = mTelemetry;
+
+		converged = Trainable::train(input, output, 0, 0, params);
+
+		mTelemetry = telemetry += mTelemetry;
+	}
+
+	return converged;
+}
+
+
+
 double CMT::Trainable::checkGradient(
 	const MatrixXd& input,
 	const MatrixXd& output,
@@ -425,49 +1334,108 @@ double CMT::Trainable::checkGradient(
 	if(input.cols() != output.cols())
 		throw Exception("The number of inputs and outputs should be the same.");
 
-	// request memory for LBFGS and copy parameters
+	int numParams = numParameters(params);
+
+	// perturb one parameter at a time
+	vector<Triplet<double> > triplets;
+	for(int i = 0; i < numParams; ++i)
+		triplets.push_back(Triplet<double>(i, i, 1.));
+
+	SparseMatrixXd directions(numParams, numParams);
+	directions.setFromTriplets(triplets.begin(), triplets.end());
+
+	// compute numerical gradient using central differences
+	VectorXd numGrad = numericalDerivatives(input, output, directions, epsilon, params);
+
+	// compute analytical gradient
 	lbfgsfloatval_t* x = parameters(params);
+	lbfgsfloatval_t* g = lbfgs_malloc(numParams);
+
+	InstanceLBFGS instance(this, &params, &input, &output);
+	evaluateLBFGS(&instance, x, g, 0, 0.);
+
+	double err = (VectorLBFGS(g, numParams) - numGrad).norm();
+
+	lbfgs_free(x);
+	lbfgs_free(g);
+
+	return err;
+}
+
+
+
+/**
+ * Compares derivatives along a few random directions to their numerical
+ * estimates. Each direction only changes the parameters of one block, so that
+ * errors can be attributed to a group of parameters. This is much cheaper than
+ * checkGradient() for models with many parameters.
+ *
+ * Returns the name of each block of parameters and the norm of the difference
+ * between numerical and analytical directional derivatives.
+ */
+vector<pair<string, double> > CMT::Trainable::checkDirectionalDerivatives(
+	const MatrixXd& input,
+	const MatrixXd& output,
+	int numDirections,
+	double epsilon,
+	const Parameters& params)
+{
+	if(input.rows() != dimIn() || output.rows() != dimOut())
+		throw Exception("Data has wrong dimensionality.");
+	if(input.cols() != output.cols())
+		throw Exception("The number of inputs and outputs should be the same.");
+	if(numDirections < 1)
+		throw Exception("The number of directions should be positive.");
+
+	vector<pair<string, int> > blocks = parameterBlocks(params);
 
 	int numParams = numParameters(params);
 
-	lbfgsfloatval_t* y = new lbfgsfloatval_t[numParams];
-	lbfgsfloatval_t* g = new lbfgsfloatval_t[numParams];
-	lbfgsfloatval_t* n = new lbfgsfloatval_t[numParams];
-	lbfgsfloatval_t val1;
-	lbfgsfloatval_t val2;
+	// random unit directions, each restricted to a single block
+	vector<Triplet<double> > triplets;
 
-	// make another copy
-	for(int i = 0; i < numParams; ++i)
-		y[i] = x[i];
+	for(int b = 0, offset = 0, k = 0; b < blocks.size(); offset += blocks[b++].second) {
+		int size = blocks[b].second;
 
-	// arguments to LBFGS function
-	InstanceLBFGS instance(this, &params, &input, &output);
+		if(offset + size > numParams)
+			throw Exception("Parameter blocks do not match the number of parameters.");
 
-	// compute numerical gradient using central differences
-	for(int i = 0; i < numParams; ++i) {
-		y[i] = x[i] + epsilon;
-		val1 = evaluateLBFGS(&instance, y, 0, 0, 0.);
-		y[i] = x[i] - epsilon;
-		val2 = evaluateLBFGS(&instance, y, 0, 0, 0.);
-		y[i] = x[i];
-		n[i] = (val1 - val2) / (2. * epsilon);
+		for(int j = 0; j < numDirections; ++j, ++k) {
+			if(!size)
+				continue;
+
+			VectorXd direction = sampleNormal(size, 1);
+			direction /= direction.norm();
+
+			for(int i = 0; i < size; ++i)
+				triplets.push_back(Triplet<double>(offset + i, k, direction[i]));
+		}
 	}
 
+	SparseMatrixXd directions(numParams, blocks.size() * numDirections);
+	directions.setFromTriplets(triplets.begin(), triplets.end());
+
+	VectorXd numDeriv = numericalDerivatives(input, output, directions, epsilon, params);
+
 	// compute analytical gradient
+	lbfgsfloatval_t* x = parameters(params);
+	lbfgsfloatval_t* g = lbfgs_malloc(numParams);
+
+	InstanceLBFGS instance(this, &params, &input, &output);
 	evaluateLBFGS(&instance, x, g, 0, 0.);
 
-	// squared error
-	double err = 0.;
-	for(int i = 0; i < numParams; ++i)
-		err += (g[i] - n[i]) * (g[i] - n[i]);
+	VectorXd deriv = directions.transpose() * VectorLBFGS(g, numParams);
 
-	// free memory created by call to parameters()
 	lbfgs_free(x);
-	delete[] y;
-	delete[] g;
-	delete[] n;
+	lbfgs_free(g);
+
+	vector<pair<string, double> > errors;
 
-	return sqrt(err);
+	for(int b = 0; b < blocks.size(); ++b)
+		errors.push_back(make_pair(blocks[b].first,
+			(deriv - numDeriv).segment(b * numDirections, numDirections).norm()));
+
+	return errors;
 }
 
 
@@ -511,3 +1479,123 @@ double CMT::Trainable::checkPerformance(
 	// return average time it took to compute gradient (in seconds)
 	return (to.tv_sec + to.tv_usec / 1E6 - from.tv_sec - from.tv_usec / 1E6) / repetitions;
 }
+
+
+
+/**
+ * Estimates derivatives along the columns of the given matrix using central
+ * differences. Directions are evaluated in parallel, each thread perturbing its
+ * own copy of the parameters. Since evaluating a trainable nonlinearity changes
+ * its parameters, threads use independent copies of the model, and directions
+ * are processed one after another if the model cannot be copied.
+ */
+VectorXd CMT::Trainable::numericalDerivatives(
+	const MatrixXd& input,
+	const MatrixXd& output,
+	const SparseMatrixXd& directions,
+	double epsilon,
+	const Parameters& params)
+{
+	int numParams = numParameters(params);
+
+	if(directions.rows() != numParams)
+		throw Exception("Directions have wrong dimensionality.");
+
+	lbfgsfloatval_t* x = parameters(params);
+
+	// evaluate once outside of the parallel region so that errors can be thrown
+	InstanceLBFGS instance(this, &params, &input, &output);
+	evaluateLBFGS(&instance, x, 0, 0, 0.);
+
+	vector<Trainable*> models(1, this);
+	while(models.size() < numThreads() && models.back())
+		models.push_back(copy());
+
+	if(!models.back()) {
+		// model cannot be copied
+		for(int t = 1; t < models.size(); ++t)
+			delete models[t];
+		models.resize(1);
+	}
+
+	int numModels = static_cast<int>(models.size());
+
+	// one copy of the parameters for each thread
+	MatrixXd y = VectorLBFGS(x, numParams).replicate(1, numModels);
+
+	VectorXd derivatives(directions.cols());
+
+	#pragma omp parallel for schedule(dynamic) num_threads(numModels) if(numModels > 1)
+	for(int k = 0; k < directions.cols(); ++k) {
+		int t = threadID();
+		lbfgsfloatval_t* z = y.col(t).data();
+
+		InstanceLBFGS instance(models[t], &params, &input, &output);
+
+		for(SparseMatrixXd::InnerIterator it(directions, k); it; ++it)
+			z[it.index()] = x[it.index()] + epsilon * it.value();
+		double val1 = evaluateLBFGS(&instance, z, 0, 0, 0.);
+
+		for(SparseMatrixXd::InnerIterator it(directions, k); it; ++it)
+			z[it.index()] = x[it.index()] - epsilon * it.value();
+		double val2 = evaluateLBFGS(&instance, z, 0, 0, 0.);
+
+		for(SparseMatrixXd::InnerIterator it(directions, k); it; ++it)
+			z[it.index()] = x[it.index()];
+
+		derivatives[k] = (val1 - val2) / (2. * epsilon);
+	}
+
+	for(int t = 1; t < numModels; ++t)
+		delete models[t];
+
+	// trainable nonlinearities keep the parameters they were last evaluated with
+	evaluateLBFGS(&instance, x, 0, 0, 0.);
+
+	lbfgs_free(x);
+
+	return derivatives;
+}
+
+
+
+/**
+ * Sum of all terms of the log-likelihood which only depend on the outputs. Models
+ * whose parameter gradients add this value separately only need to compute it once
+ * per optimization.
+ */
+double CMT::Trainable::logBaseMeasure(const MatrixXd& output) const {
+	return 0.;
+}
+
+
+
+/**
+ * Returns the log base measure of the outputs without recomputing it if these are
+ * the outputs the model is currently being trained on.
+ */
+double CMT::Trainable::cachedLogBaseMeasure(const MatrixXd& output) const {
+	if(&output == mCachedOutput)
+		return mCachedLogBaseMeasure;
+	return logBaseMeasure(output);
+}
+
+
+
+void CMT::Trainable::setCache(const MatrixXd* output) {
+	if(output)
+		mCachedLogBaseMeasure = logBaseMeasure(*output);
+	mCachedOutput = output;
+}
+
+
+
+CMT::Trainable::CacheGuard::CacheGuard(Trainable* model, const MatrixXd* output) : mModel(model) {
+	mModel->setCache(output);
+}
+
+
+
+CMT::Trainable::CacheGuard::~CacheGuard() {
+	mModel->setCache(0);
+}
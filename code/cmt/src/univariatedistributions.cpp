@@ -5,10 +5,51 @@
 using Eigen::MatrixXd;
 using Eigen::Array;
 using Eigen::Dynamic;
+using Eigen::ArrayXXd;
 
 #include <limits>
 using std::numeric_limits;
 
+Array<double, 1, Dynamic> CMT::UnivariateDistribution::logBaseMeasure(
+	const Array<double, 1, Dynamic>& data) const
+{
+	return Array<double, 1, Dynamic>::Zero(data.size());
+}
+
+
+
+Array<double, 1, Dynamic> CMT::UnivariateDistribution::logKernel(
+	const Array<double, 1, Dynamic>& data,
+	const Array<double, 1, Dynamic>& means) const
+{
+	return logLikelihood(data, means);
+}
+
+
+
+Array<double, 1, Dynamic> CMT::UnivariateDistribution::logKernel(
+	const Array<double, 1, Dynamic>& data,
+	const Array<double, 1, Dynamic>& responses,
+	const Nonlinearity& nonlinearity,
+	Array<double, 1, Dynamic>* gradient) const
+{
+	Array<double, 1, Dynamic> means = nonlinearity(responses);
+
+	if(gradient) {
+		const DifferentiableNonlinearity* differentiableNonlinearity =
+			dynamic_cast<const DifferentiableNonlinearity*>(&nonlinearity);
+
+		if(!differentiableNonlinearity)
+			throw Exception("Nonlinearity has to be differentiable.");
+
+		*gradient = this->gradient(data, means) * differentiableNonlinearity->derivative(responses);
+	}
+
+	return logKernel(data, means);
+}
+
+
+
 CMT::Bernoulli::Bernoulli(double prob) : mProb(prob) {
 	if(prob < 0. || prob > 1.)
 		throw Exception("Probability has to be between 0 and 1.");
@@ -44,16 +85,10 @@ Array<double, 1, Dynamic> CMT::Bernoulli::logLikelihood(const MatrixXd& data) co
 	if(mProb > 0. && 1. - mProb > 0.)
 		return log(mProb) * data.array() + log(1. - mProb) * (1. - data.array());
 
-	Array<double, 1, Dynamic> logLik = Array<double, 1, Dynamic>(data.size());
-
-	double logProb1 = log(mProb);
-	double logProb0 = log(1. - mProb);
-
-	#pragma omp parallel for
-	for(int i = 0; i < data.size(); ++i)
-		logLik[i] = data.data()[i] > 0.5 ? logProb1 : logProb0;
-
-	return logLik;
+	// avoid evaluating 0 * log(0)
+	return (data.array() > 0.5).select(
+		ArrayXXd::Constant(data.rows(), data.cols(), log(mProb)),
+		log(1. - mProb));
 }
 
 
@@ -62,12 +97,7 @@ Array<double, 1, Dynamic> CMT::Bernoulli::logLikelihood(
 	const Array<double, 1, Dynamic>& data,
 	const Array<double, 1, Dynamic>& means) const
 {
-	Array<double, 1, Dynamic> logLik = Array<double, 1, Dynamic>(data.size());
-
-	for(int i = 0; i < data.size(); ++i)
-		logLik[i] = data[i] > 0.5 ? log(means[i]) : log(1. - means[i]);
-
-	return logLik;
+	return (data > 0.5).select(means, 1. - means).log();
 }
 
 
@@ -76,12 +106,56 @@ Array<double, 1, Dynamic> CMT::Bernoulli::gradient(
 	const Array<double, 1, Dynamic>& data,
 	const Array<double, 1, Dynamic>& means) const
 {
-	Array<double, 1, Dynamic> grad = Array<double, 1, Dynamic>(data.size());
+	return -1. / (data > 0.5).select(means, means - 1.);
+}
+
 
-	for(int i = 0; i < data.size(); ++i)
-		grad[i] = data[i] > 0.5 ? -1. / means[i] : 1. / (1. - means[i]);
 
-	return grad;
+Array<double, 1, Dynamic> CMT::Bernoulli::logKernel(
+	const Array<double, 1, Dynamic>& data,
+	const Array<double, 1, Dynamic>& responses,
+	const Nonlinearity& nonlinearity,
+	Array<double, 1, Dynamic>* gradient) const
+{
+	const LogisticFunction* logisticFunction =
+		dynamic_cast<const LogisticFunction*>(&nonlinearity);
+
+	if(!logisticFunction)
+		return UnivariateDistribution::logKernel(data, responses, nonlinearity, gradient);
+
+	double epsilon = logisticFunction->epsilon();
+
+	// responses signed such that the logistic function yields the probability of the data
+	Array<double, 1, Dynamic> signedResponses = (data > 0.5).select(responses, -responses);
+
+	// only exponentiate non-positive numbers to avoid overflow
+	Array<double, 1, Dynamic> expNegAbs = (-signedResponses.abs()).exp();
+	Array<double, 1, Dynamic> sigmoid =
+		(signedResponses >= 0.).select(1., expNegAbs) / (1. + expNegAbs);
+	Array<double, 1, Dynamic> sigmoidNeg =
+		(signedResponses >= 0.).select(expNegAbs, 1.) / (1. + expNegAbs);
+
+	Array<double, 1, Dynamic> logLik;
+
+	if(epsilon > 0.) {
+		Array<double, 1, Dynamic> prob = epsilon / 2. + (1. - epsilon) * sigmoid;
+
+		logLik = prob.log();
+
+		if(gradient)
+			*gradient = (1. - epsilon) * sigmoid * sigmoidNeg / prob;
+	} else {
+		// log-sigmoid in a form which does not underflow
+		logLik = signedResponses.min(0.) - (1. + expNegAbs).log();
+
+		if(gradient)
+			*gradient = sigmoidNeg;
+	}
+
+	if(gradient)
+		*gradient = (data > 0.5).select(-*gradient, *gradient);
+
+	return logLik;
 }
 
 
@@ -120,7 +194,7 @@ MatrixXd CMT::Poisson::sample(const Array<double, 1, Dynamic>& means) const {
 
 
 Array<double, 1, Dynamic> CMT::Poisson::logLikelihood(const MatrixXd& data) const {
-	return data.array() * log(mLambda) - lnGamma(data.array() + 1.) - mLambda;
+	return data.array() * log(mLambda) - lnFactorial(data.array()) - mLambda;
 }
 
 
@@ -129,7 +203,22 @@ Array<double, 1, Dynamic> CMT::Poisson::logLikelihood(
 	const Array<double, 1, Dynamic>& data,
 	const Array<double, 1, Dynamic>& means) const
 {
-	return data * log(means) - lnGamma(data + 1.) - means;
+	return logKernel(data, means) + logBaseMeasure(data);
+}
+
+
+
+Array<double, 1, Dynamic> CMT::Poisson::logBaseMeasure(const Array<double, 1, Dynamic>& data) const {
+	return -lnFactorial(data);
+}
+
+
+
+Array<double, 1, Dynamic> CMT::Poisson::logKernel(
+	const Array<double, 1, Dynamic>& data,
+	const Array<double, 1, Dynamic>& means) const
+{
+	return data * means.log() - means;
 }
 
 
@@ -143,6 +232,40 @@ Array<double, 1, Dynamic> CMT::Poisson::gradient(
 
 
 
+Array<double, 1, Dynamic> CMT::Poisson::logKernel(
+	const Array<double, 1, Dynamic>& data,
+	const Array<double, 1, Dynamic>& responses,
+	const Nonlinearity& nonlinearity,
+	Array<double, 1, Dynamic>* gradient) const
+{
+	const ExponentialFunction* exponentialFunction =
+		dynamic_cast<const ExponentialFunction*>(&nonlinearity);
+
+	if(!exponentialFunction)
+		return UnivariateDistribution::logKernel(data, responses, nonlinearity, gradient);
+
+	double epsilon = exponentialFunction->epsilon();
+
+	Array<double, 1, Dynamic> expResponses = responses.exp();
+
+	if(epsilon > 0.) {
+		Array<double, 1, Dynamic> means = expResponses + epsilon;
+
+		if(gradient)
+			*gradient = expResponses - data * (expResponses / means);
+
+		return data * means.log() - means;
+	}
+
+	// the log-means are the responses
+	if(gradient)
+		*gradient = expResponses - data;
+
+	return data * responses - expResponses;
+}
+
+
+
 CMT::Binomial::Binomial(int n, double p) : mN(n), mP(p) {
 	if(n < 0)
 		throw Exception("Number of throws has to be non-negative.");
@@ -183,25 +306,7 @@ MatrixXd CMT::Binomial::sample(const Array<double, 1, Dynamic>& means) const {
 
 
 Array<double, 1, Dynamic> CMT::Binomial::logLikelihood(const MatrixXd& data) const {
-	ArrayXXd normConst = 
-		lnGamma(mN + 1.) - lnGamma(mN - data.array() + 1.) - lnGamma(data.array() + 1);
-
-	if(mP < 1. && mP > 0.) {
-		return data.array() * log(mP) + (mN - data.array()) * log(1. - mP) + normConst;
-	} else {
-		Array<double, 1, Dynamic> logLik(data.size());
-
-		#pragma omp parallel for
-		for(int i = 0; i < data.size(); ++i)
-			if(data(i) > mN || data(i) < 0.)
-				logLik[i] = -numeric_limits<double>::infinity();
-			else if(data(i) > 0.)
-				logLik[i] = data(i) * log(mP) + (mN - data(i)) * log(1. - mP) + normConst(i);
-			else
-				logLik[i] = (mN - data(i)) * log(1. - mP) + normConst(i);
-
-		return logLik;
-	}
+	return logLikelihood(data.array(), Array<double, 1, Dynamic>::Constant(data.size(), mean()));
 }
 
 
@@ -210,22 +315,33 @@ Array<double, 1, Dynamic> CMT::Binomial::logLikelihood(
 	const Array<double, 1, Dynamic>& data,
 	const Array<double, 1, Dynamic>& means) const
 {
-	Array<double, 1, Dynamic> normConst =
-		lnGamma(mN + 1.) - lnGamma(mN - data + 1.) - lnGamma(data + 1);
-	Array<double, 1, Dynamic> logLik(data.size());
+	return logKernel(data, means) + logBaseMeasure(data);
+}
+
+
+
+Array<double, 1, Dynamic> CMT::Binomial::logBaseMeasure(const Array<double, 1, Dynamic>& data) const {
+	Array<double, 1, Dynamic> logBinom = lnFactorial(ArrayXXd::Constant(1, 1, mN))(0)
+		- lnFactorial(mN - data) - lnFactorial(data);
+
+	// data outside of the support has zero probability
+	return (data < 0. || data > mN).select(-numeric_limits<double>::infinity(), logBinom);
+}
+
+
+
+Array<double, 1, Dynamic> CMT::Binomial::logKernel(
+	const Array<double, 1, Dynamic>& data,
+	const Array<double, 1, Dynamic>& means) const
+{
 	Array<double, 1, Dynamic> p = means / mN;
 
-	#pragma omp parallel for
-	for(int i = 0; i < data.size(); ++i) {
-		if(data(i) > mN || data(i) < 0. || p[i] > 1.)
-			logLik[i] = -numeric_limits<double>::infinity();
-		else if(data(i) > 0.)
-			logLik[i] = data[i] * log(p[i]) + (mN - data[i]) * log(1. - p[i]) + normConst[i];
-		else
-			logLik[i] = (mN - data[i]) * log(1. - p[i]) + normConst[i];
-	}
+	// avoid evaluating 0 * log(0)
+	Array<double, 1, Dynamic> logLik =
+		(data > 0.).select(data * p.log(), 0.) +
+		(data < mN).select((mN - data) * (1. - p).log(), 0.);
 
-	return logLik;
+	return (p > 1.).select(-numeric_limits<double>::infinity(), logLik);
 }
 
 
@@ -7,13 +7,26 @@ using Eigen::Array;
 using Eigen::ArrayXXd;
 using Eigen::ArrayXXi;
 using Eigen::MatrixXd;
+using Eigen::VectorXd;
 using Eigen::VectorXi;
+using Eigen::Ref;
 
 #include "Eigen/SVD"
 using Eigen::JacobiSVD;
 using Eigen::ComputeThinU;
 using Eigen::ComputeThinV;
 
+#include "Eigen/Cholesky"
+using Eigen::LLT;
+using Eigen::Lower;
+using Eigen::Success;
+
+#include "Eigen/Eigenvalues"
+using Eigen::SelfAdjointEigenSolver;
+
+#include "Eigen/QR"
+using Eigen::HouseholderQR;
+
 #include <cmath>
 using std::exp;
 using std::log;
@@ -21,7 +34,11 @@ using std::floor;
 using std::tanh;
 using std::sinh;
 using std::cosh;
+using std::sqrt;
+using std::abs;
+using std::ceil;
 #ifdef __GXX_EXPERIMENTAL_CXX0X__
+using std::log1p;
 using std::lgamma;
 using std::tgamma;
 #endif
@@ -29,6 +46,9 @@ using std::tgamma;
 #include <cstdlib>
 using std::rand;
 
+#include <vector>
+using std::vector;
+
 #include <set>
 using std::set;
 using std::pair;
@@ -36,14 +56,21 @@ using std::pair;
 #include <algorithm>
 using std::greater;
 using std::sort;
+using std::min;
+using std::max;
 
 #include <limits>
 using std::numeric_limits;
 
 #include <random>
 using std::mt19937;
+using std::seed_seq;
 using std::normal_distribution;
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 MatrixXd CMT::signum(const MatrixXd& matrix) {
 	return (matrix.array() > 0.).cast<double>() - (matrix.array() < 0.).cast<double>();
 }
@@ -90,6 +117,41 @@ ArrayXXd CMT::lnGamma(const ArrayXXd& arr) {
 
 
 
+// log-factorials of small integers
+static const int lnFactorialTableSize = 1024;
+
+static vector<double> lnFactorialTable() {
+	vector<double> table(lnFactorialTableSize);
+	for(int k = 0; k < lnFactorialTableSize; ++k)
+		table[k] = lgamma(k + 1.);
+	return table;
+}
+
+static const vector<double> lnFactorials = lnFactorialTable();
+
+
+
+/**
+ * Computes \f$\ln \Gamma(x + 1)\f$. For small non-negative integers, which are
+ * typical for spike counts, values are looked up in a table.
+ */
+ArrayXXd CMT::lnFactorial(const ArrayXXd& arr) {
+	ArrayXXd result(arr.rows(), arr.cols());
+
+	for(int i = 0; i < arr.size(); ++i) {
+		double x = arr(i);
+
+		if(x >= 0. && x < lnFactorialTableSize && x == floor(x))
+			result(i) = lnFactorials[static_cast<int>(x)];
+		else
+			result(i) = lgamma(x + 1.);
+	}
+
+	return result;
+}
+
+
+
 ArrayXXd CMT::tanh(const ArrayXXd& arr) {
 	ArrayXXd result(arr.rows(), arr.cols());
 
@@ -177,49 +239,224 @@ ArrayXXd CMT::sampleGamma(int m, int n, int k) {
 
 
 
+// incremented whenever the seed changes, so that thread generators get reseeded
+static int generatorEpoch = 1;
+
+// drawn from rand() once per epoch and shared by all thread generators
+static unsigned int generatorSeed;
+static int generatorSeedEpoch = 0;
+
+// number of threads which have used a generator so far, for each thread number
+static vector<unsigned int> generatorThreads;
+
 /**
- * Algorithm due to Knuth, 1969.
+ * Returns the random number generator of the calling thread. Each generator is
+ * seeded the first time its thread uses it and again after every call to
+ * setSeed(), and is reused otherwise. Seeds combine a single draw from rand()
+ * with the thread number and a count of the threads which used a generator
+ * under that thread number before. The count keeps threads which are not part
+ * of the same OpenMP team, such as threads started by Python, from sharing
+ * random numbers, while threads of a team do not depend on the order in which
+ * they first use their generators.
  */
-ArrayXXi CMT::samplePoisson(int m, int n, double lambda) {
-	ArrayXXi samples(m, n);
-	double threshold = exp(-lambda);
+static mt19937& threadGenerator() {
+	static thread_local mt19937 gen;
+	static thread_local int epoch = 0;
+	static thread_local unsigned int threadNumber;
+	static thread_local unsigned int threadCount;
+
+	int currentEpoch;
+
+	#pragma omp atomic read
+	currentEpoch = generatorEpoch;
+
+	if(epoch != currentEpoch) {
+		unsigned int seed;
+
+		// only one thread at a time may use rand()
+		#pragma omp critical (randomSeed)
+		{
+			if(generatorSeedEpoch != currentEpoch) {
+				generatorSeed = static_cast<unsigned int>(rand());
+				generatorSeedEpoch = currentEpoch;
+			}
 
-	#pragma omp parallel for
-	for(int i = 0; i < samples.size(); ++i) {
-		double p = rand() / static_cast<double>(RAND_MAX);
+			seed = generatorSeed;
+
+			if(!epoch) {
+				// first use of this thread's generator
+				threadNumber = static_cast<unsigned int>(CMT::threadID());
+				if(generatorThreads.size() <= threadNumber)
+					generatorThreads.resize(threadNumber + 1, 0);
+				threadCount = generatorThreads[threadNumber]++;
+			}
+		}
+
+		seed_seq seq = {seed, threadNumber, threadCount};
+		gen.seed(seq);
+		epoch = currentEpoch;
+	}
+
+	return gen;
+}
+
+
+
+/**
+ * Seeds rand() and causes all thread generators to be reseeded from it.
+ */
+void CMT::setSeed(unsigned int seed) {
+	#pragma omp critical (randomSeed)
+	srand(seed);
+
+	#pragma omp atomic
+	++generatorEpoch;
+}
+
+
+
+/**
+ * Returns a uniform random number in the open interval (0, 1).
+ */
+static inline double uniform(mt19937& gen) {
+	return (gen() + 0.5) / 4294967296.;
+}
+
+
+
+/**
+ * Samples a Poisson distributed random variable. For small rates, uniform random
+ * numbers are multiplied until their product falls below \f$e^{-\lambda}\f$ (Knuth,
+ * 1969). For larger rates, transformed rejection with squeeze (PTRS) is used, which
+ * takes a constant number of uniform random numbers on average (H&ouml;rmann, 1993).
+ */
+static int drawPoisson(double lambda, mt19937& gen) {
+	if(lambda <= 0.)
+		return 0;
+
+	if(lambda < 10.) {
+		double threshold = exp(-lambda);
+		double p = uniform(gen);
 		int k = 0;
 
 		while(p > threshold) {
-			p *= rand() / static_cast<double>(RAND_MAX);
+			p *= uniform(gen);
 			k += 1;
 		}
 
-		samples(i) = k;
+		return k;
 	}
 
-	return samples;
+	double logLambda = log(lambda);
+	double b = 0.931 + 2.53 * sqrt(lambda);
+	double a = -0.059 + 0.02483 * b;
+	double logAlphaInv = log(1.1239 + 1.1328 / (b - 3.4));
+	double vr = 0.9277 - 3.6224 / (b - 2.);
+
+	while(true) {
+		double u = uniform(gen) - 0.5;
+		double v = uniform(gen);
+		double us = 0.5 - abs(u);
+		double k = floor((2. * a / us + b) * u + lambda + 0.43);
+
+		// squeeze
+		if(us >= 0.07 && v <= vr)
+			return static_cast<int>(k);
+
+		if(k < 0. || (us < 0.013 && v > us))
+			continue;
+
+		if(log(v) + logAlphaInv - log(a / (us * us) + b) <= -lambda + k * logLambda - lgamma(k + 1.))
+			return static_cast<int>(k);
+	}
 }
 
 
 
 /**
- * Algorithm due to Knuth, 1969.
+ * Samples a binomially distributed random variable. If \f$np < 10\f$, waiting times
+ * between successes are sampled from a geometric distribution. Otherwise, transformed
+ * rejection with squeeze (BTRS) is used, which takes a constant number of uniform
+ * random numbers on average (H&ouml;rmann, 1993).
  */
+static int drawBinomial(int n, double p, mt19937& gen) {
+	if(n <= 0 || p <= 0.)
+		return 0;
+	if(p >= 1.)
+		return n;
+	if(p > 0.5)
+		return n - drawBinomial(n, 1. - p, gen);
+
+	if(n * p < 10.) {
+		double logQ = log1p(-p);
+		int numSuccesses = 0;
+
+		for(double numTrials = 0.;; ++numSuccesses) {
+			numTrials += ceil(log(uniform(gen)) / logQ);
+			if(numTrials > n)
+				return numSuccesses;
+		}
+	}
+
+	double q = 1. - p;
+	double spq = sqrt(n * p * q);
+	double b = 1.15 + 2.53 * spq;
+	double a = -0.0873 + 0.0248 * b + 0.01 * p;
+	double c = n * p + 0.5;
+	double vr = 0.92 - 4.2 / b;
+	double logAlpha = log((2.83 + 5.1 / b) * spq);
+	double logPQ = log(p / q);
+	double m = floor((n + 1) * p);
+	double h = lgamma(m + 1.) + lgamma(n - m + 1.);
+
+	while(true) {
+		double u = uniform(gen) - 0.5;
+		double v = uniform(gen);
+		double us = 0.5 - abs(u);
+		double k = floor((2. * a / us + b) * u + c);
+
+		if(k < 0. || k > n)
+			continue;
+
+		// squeeze
+		if(us >= 0.07 && v <= vr)
+			return static_cast<int>(k);
+
+		if(log(v) + logAlpha - log(a / (us * us) + b) <= h - lgamma(k + 1.) - lgamma(n - k + 1.) + (k - m) * logPQ)
+			return static_cast<int>(k);
+	}
+}
+
+
+
+ArrayXXi CMT::samplePoisson(int m, int n, double lambda) {
+	ArrayXXi samples(m, n);
+
+	#pragma omp parallel
+	{
+		// each thread uses its own random number generator
+		mt19937& gen = threadGenerator();
+
+		#pragma omp for
+		for(int i = 0; i < samples.size(); ++i)
+			samples(i) = drawPoisson(lambda, gen);
+	}
+
+	return samples;
+}
+
+
+
 ArrayXXi CMT::samplePoisson(const ArrayXXd& lambda) {
 	ArrayXXi samples(lambda.rows(), lambda.cols());
-	ArrayXXd threshold = (-lambda).exp();
-
-	#pragma omp parallel for
-	for(int i = 0; i < samples.size(); ++i) {
-		double p = rand() / static_cast<double>(RAND_MAX);
-		int k = 0;
 
-		while(p > threshold(i)) {
-			k += 1;
-			p *= rand() / static_cast<double>(RAND_MAX);
-		}
+	#pragma omp parallel
+	{
+		mt19937& gen = threadGenerator();
 
-		samples(i) = k;
+		#pragma omp for
+		for(int i = 0; i < samples.size(); ++i)
+			samples(i) = drawPoisson(lambda(i), gen);
 	}
 
 	return samples;
@@ -228,14 +465,15 @@ ArrayXXi CMT::samplePoisson(const ArrayXXd& lambda) {
 
 
 ArrayXXi CMT::sampleBinomial(int w, int h, int n, double p) {
-	ArrayXXi samples = ArrayXXi::Zero(w, h);
+	ArrayXXi samples(w, h);
 
-	#pragma omp parallel for
-	for(int i = 0; i < samples.size(); ++i) {
-		// very naive algorithm for generating binomial samples
-		for(int k = 0; k < n; ++k)
-			if(rand() / static_cast<double>(RAND_MAX) < p)
-				samples(i) += 1; 
+	#pragma omp parallel
+	{
+		mt19937& gen = threadGenerator();
+
+		#pragma omp for
+		for(int i = 0; i < samples.size(); ++i)
+			samples(i) = drawBinomial(n, p, gen);
 	}
 
 	return samples;
@@ -247,14 +485,15 @@ ArrayXXi CMT::sampleBinomial(const ArrayXXi& n, const ArrayXXd& p) {
 	if(n.rows() != p.rows() || n.cols() != p.cols())
 		throw Exception("n and p must be of the same size.");
 
-	ArrayXXi samples = ArrayXXi::Zero(n.rows(), n.cols());
+	ArrayXXi samples(n.rows(), n.cols());
 
-	#pragma omp parallel for
-	for(int i = 0; i < samples.size(); ++i) {
-		// very naive algorithm for generating binomial samples
-		for(int k = 0; k < n(i); ++k)
-			if(rand() / static_cast<double>(RAND_MAX) < p(i))
-				samples(i) += 1; 
+	#pragma omp parallel
+	{
+		mt19937& gen = threadGenerator();
+
+		#pragma omp for
+		for(int i = 0; i < samples.size(); ++i)
+			samples(i) = drawBinomial(n(i), p(i), gen);
 	}
 
 	return samples;
@@ -361,6 +600,140 @@ MatrixXd CMT::pInverse(const MatrixXd& matrix) {
 
 
 
+/**
+ * Computes the lower Cholesky factor of the inverse of a covariance matrix without
+ * explicitly inverting it. If \f$PCP = LL^\top\f$, where \f$P\f$ reverses the order
+ * of rows, then \f$C^{-1} = (PL^{-\top}P)(PL^{-\top}P)^\top\f$ and \f$PL^{-\top}P\f$
+ * is lower triangular. This only takes a factorization and a triangular inversion.
+ *
+ * Badly conditioned covariance matrices are instead inverted via an eigenvalue
+ * decomposition, where very small eigenvalues are increased.
+ *
+ * @param covariance a symmetric positive definite matrix
+ * @return lower triangular matrix \f$A\f$ with \f$AA^\top = C^{-1}\f$
+ */
+MatrixXd CMT::choleskyPrecision(const MatrixXd& covariance) {
+	if(covariance.rows() != covariance.cols())
+		throw Exception("Covariance matrix should be square.");
+
+	int dim = covariance.rows();
+
+	if(!dim)
+		return covariance;
+
+	LLT<MatrixXd> llt(covariance.reverse());
+
+	if(llt.info() == Success) {
+		VectorXd diag = llt.matrixLLT().diagonal();
+
+		// squared ratio of diagonal entries is a lower bound on the condition number
+		if(diag.minCoeff() / diag.maxCoeff() > 1e-6) {
+			MatrixXd choleskyInv = MatrixXd::Identity(dim, dim);
+			llt.matrixL().solveInPlace(choleskyInv);
+			return choleskyInv.transpose().reverse();
+		}
+	}
+
+	SelfAdjointEigenSolver<MatrixXd> eigenSolver(covariance);
+
+	double eigenvalueMax = eigenSolver.eigenvalues().maxCoeff();
+
+	if(!(eigenvalueMax > 0.))
+		throw Exception("Covariance matrix should be positive definite.");
+
+	VectorXd eigenvalues = eigenSolver.eigenvalues().cwiseMax(eigenvalueMax * 1e-12);
+
+	MatrixXd precision = eigenSolver.eigenvectors()
+		* eigenvalues.cwiseInverse().asDiagonal()
+		* eigenSolver.eigenvectors().transpose();
+
+	return precision.llt().matrixL();
+}
+
+
+
+/**
+ * Computes the largest eigenvalues and corresponding eigenvectors of a symmetric
+ * positive semidefinite matrix. If only a few eigenvalues are needed, they are
+ * computed by subspace iteration starting from a random subspace which is larger
+ * than needed (Halko et al., 2011). Otherwise, if the iteration converges too
+ * slowly, or if the tolerance is zero, all eigenvalues are computed.
+ *
+ * If the number of eigenvalues is negative, enough eigenvalues are computed to
+ * explain the given percentage of the trace of the matrix.
+ *
+ * @param matrix a symmetric positive semidefinite matrix
+ * @param eigenvalues will contain eigenvalues in ascending order
+ * @param eigenvectors will contain corresponding eigenvectors in its columns
+ * @param numEigenvalues number of largest eigenvalues needed
+ * @param varExplained percentage of trace explained by eigenvalues, if their number is not given
+ * @param tolerance accuracy of eigenvectors relative to the largest eigenvalue
+ */
+void CMT::largestEigenvectors(
+	const MatrixXd& matrix,
+	VectorXd& eigenvalues,
+	MatrixXd& eigenvectors,
+	int numEigenvalues,
+	double varExplained,
+	double tolerance)
+{
+	if(matrix.rows() != matrix.cols())
+		throw Exception("Matrix should be square.");
+
+	int dim = matrix.rows();
+	double totalVariance = matrix.trace();
+
+	int k = numEigenvalues < 0 ? 10 : numEigenvalues;
+
+	// subspace iteration is only faster if the subspace is much smaller than the space
+	while(tolerance > 0. && 4 * (k + max(k, 10)) <= dim) {
+		int l = k + max(k, 10);
+
+		// stop once iterating becomes about as costly as a full decomposition
+		int maxIter = dim / (l + 2 * l * l / dim);
+		bool converged = false;
+
+		SelfAdjointEigenSolver<MatrixXd> eigenSolver;
+		MatrixXd basis = HouseholderQR<MatrixXd>(matrix * sampleNormal(dim, l).matrix())
+			.householderQ() * MatrixXd::Identity(dim, l);
+
+		for(int i = 0; i < maxIter; ++i) {
+			MatrixXd product = matrix * basis;
+
+			// Rayleigh-Ritz approximation of eigenvectors in subspace
+			eigenSolver.compute(basis.transpose() * product);
+			eigenvalues = eigenSolver.eigenvalues().tail(k);
+			eigenvectors = basis * eigenSolver.eigenvectors().rightCols(k);
+
+			// residuals of the approximate eigenvectors
+			MatrixXd residuals = product * eigenSolver.eigenvectors().rightCols(k)
+				- eigenvectors * eigenvalues.asDiagonal();
+
+			if(k == 0 || residuals.colwise().norm().maxCoeff() <= tolerance * eigenvalues[k - 1]) {
+				converged = true;
+				break;
+			}
+
+			basis = HouseholderQR<MatrixXd>(product).householderQ() * MatrixXd::Identity(dim, l);
+		}
+
+		if(!converged)
+			break;
+
+		if(numEigenvalues >= 0 || eigenvalues.sum() >= varExplained / 100. * totalVariance)
+			return;
+
+		// try again with more eigenvalues
+		k *= 2;
+	}
+
+	SelfAdjointEigenSolver<MatrixXd> eigenSolver(matrix);
+	eigenvalues = eigenSolver.eigenvalues();
+	eigenvectors = eigenSolver.eigenvectors();
+}
+
+
+
 double CMT::logDetPD(const MatrixXd& matrix) {
 	return 2. * matrix.llt().matrixLLT().diagonal().array().log().sum();
 }
@@ -404,3 +777,116 @@ MatrixXd CMT::deleteCols(const MatrixXd& matrix, vector<int> indices) {
 
 	return result;
 }
+
+
+
+int CMT::numThreads() {
+#ifdef _OPENMP
+	return omp_get_max_threads();
+#else
+	return 1;
+#endif
+}
+
+
+
+int CMT::threadID() {
+#ifdef _OPENMP
+	return omp_get_thread_num();
+#else
+	return 0;
+#endif
+}
+
+
+
+CMT::Moments::Moments(int dim) :
+	mNumData(0.),
+	mMean(VectorXd::Zero(dim)),
+	mScatter(MatrixXd::Zero(dim, dim))
+{
+}
+
+
+
+void CMT::Moments::add(const Ref<const MatrixXd>& data) {
+	add(MatrixXd(0, data.cols()), data);
+}
+
+
+
+/**
+ * Adds data formed by stacking inputs on top of outputs. The data is processed
+ * in chunks which are distributed among threads, and partial results are merged
+ * using the update of Chan et al. (1979).
+ *
+ * @param input inputs, possibly without any rows
+ * @param output outputs corresponding to the inputs
+ */
+void CMT::Moments::add(const Ref<const MatrixXd>& input, const Ref<const MatrixXd>& output) {
+	if(input.cols() != output.cols())
+		throw Exception("Number of inputs and outputs must be the same.");
+	if(input.rows() + output.rows() != dim())
+		throw Exception("Data has wrong dimensionality.");
+
+	int numData = static_cast<int>(output.cols());
+	int chunkSize = 1000;
+	int numChunks = (numData + chunkSize - 1) / chunkSize;
+
+	// moments of the chunks processed by each thread
+	vector<Moments> partials(numThreads(), Moments(dim()));
+
+	#pragma omp parallel for schedule(static)
+	for(int c = 0; c < numChunks; ++c) {
+		int from = c * chunkSize;
+		int width = min(chunkSize, numData - from);
+
+		MatrixXd chunk(dim(), width);
+		chunk.topRows(input.rows()) = input.middleCols(from, width);
+		chunk.bottomRows(output.rows()) = output.middleCols(from, width);
+
+		Moments moments(dim());
+		moments.mNumData = width;
+		moments.mMean = chunk.rowwise().mean();
+
+		chunk.colwise() -= moments.mMean;
+		moments.mScatter.selfadjointView<Lower>().rankUpdate(chunk);
+
+		partials[threadID()] += moments;
+	}
+
+	// merge partial results in a fixed order
+	reduceSum(partials);
+
+	*this += partials[0];
+}
+
+
+
+CMT::Moments& CMT::Moments::operator+=(const Moments& moments) {
+	if(moments.dim() != dim())
+		throw Exception("Moments have different dimensionality.");
+
+	if(moments.mNumData <= 0.)
+		return *this;
+
+	double numData = mNumData + moments.mNumData;
+	VectorXd delta = moments.mMean - mMean;
+
+	mScatter += moments.mScatter;
+	mScatter.selfadjointView<Lower>().rankUpdate(delta, mNumData * moments.mNumData / numData);
+	mMean += moments.mNumData / numData * delta;
+	mNumData = numData;
+
+	return *this;
+}
+
+
+
+/**
+ * Covariance normalized by the number of data points, like L{covariance()}.
+ */
+MatrixXd CMT::Moments::covariance() const {
+	MatrixXd cov = mScatter.selfadjointView<Lower>();
+	return cov / mNumData;
+}
@@ -7,12 +7,59 @@ using Eigen::SelfAdjointEigenSolver;
 
 CMT::WhiteningPreconditioner::WhiteningPreconditioner(const ArrayXXd& input, const ArrayXXd& output) {
 	if(input.rows() == 0) {
-		if(output.cols() < output.rows())
+		Moments moments(output.rows());
+		moments.add(output.matrix());
+
+		initialize(moments, 0);
+	} else {
+		if(input.cols() != output.cols())
+			throw Exception("Number of inputs and outputs must be the same."); 
+
+		// compute means and covariances of stacked input and output
+		Moments moments(input.rows() + output.rows());
+		moments.add(input.matrix(), output.matrix());
+
+		initialize(moments, input.rows());
+	}
+}
+
+
+
+CMT::WhiteningPreconditioner::WhiteningPreconditioner(
+	const VectorXd& meanIn,
+	const VectorXd& meanOut,
+	const MatrixXd& preIn,
+	const MatrixXd& preInInv,
+	const MatrixXd& preOut,
+	const MatrixXd& preOutInv,
+	const MatrixXd& predictor) :
+	AffinePreconditioner(
+		meanIn, meanOut, preIn, preInInv, preOut, preOutInv, predictor)
+{
+}
+
+
+
+/**
+ * Computes whitening transforms from the means and covariances of inputs
+ * stacked on top of outputs.
+ *
+ * @param moments moments of stacked inputs and outputs
+ * @param dimIn dimensionality of the inputs
+ */
+void CMT::WhiteningPreconditioner::initialize(const Moments& moments, int dimIn) {
+	if(dimIn < 0 || dimIn > moments.dim())
+		throw Exception("Number of inputs is inconsistent with the dimensionality of the data.");
+
+	int dimOut = moments.dim() - dimIn;
+
+	if(dimIn == 0) {
+		if(moments.numData() < dimOut)
 			throw Exception("Too few inputs to compute whitening transform."); 
 
-		mMeanOut = output.rowwise().mean();
+		mMeanOut = moments.mean();
 
-		MatrixXd cov = covariance(output);
+		MatrixXd cov = moments.covariance();
 
 		SelfAdjointEigenSolver<MatrixXd> eigenSolver;
 
@@ -24,23 +71,16 @@ CMT::WhiteningPreconditioner::WhiteningPreconditioner(const ArrayXXd& input, con
 		// log-Jacobian determinant
 		mLogJacobian = mPreOut.partialPivLu().matrixLU().diagonal().array().abs().log().sum();
 	} else {
-		if(input.cols() != output.cols())
-			throw Exception("Number of inputs and outputs must be the same."); 
-		if(input.cols() < input.rows())
+		if(moments.numData() < dimIn)
 			throw Exception("Too few inputs to compute whitening transform."); 
 
-		mMeanIn = input.rowwise().mean();
-		mMeanOut = output.rowwise().mean();
-
-		// concatenate input and output
-		ArrayXXd data(input.rows() + output.rows(), input.cols());
-		data << input.matrix().colwise() - mMeanIn, output.matrix().colwise() - mMeanOut;
+		mMeanIn = moments.mean().head(dimIn);
+		mMeanOut = moments.mean().tail(dimOut);
 
-		// compute covariances
-		MatrixXd cov = covariance(data);
-		MatrixXd covXX = cov.topLeftCorner(input.rows(), input.rows());
-		MatrixXd covYX = cov.bottomLeftCorner(output.rows(), input.rows());
-		MatrixXd covYY = cov.bottomRightCorner(output.rows(), output.rows());
+		MatrixXd cov = moments.covariance();
+		MatrixXd covXX = cov.topLeftCorner(dimIn, dimIn);
+		MatrixXd covYX = cov.bottomLeftCorner(dimOut, dimIn);
+		MatrixXd covYY = cov.bottomRightCorner(dimOut, dimOut);
 
 		SelfAdjointEigenSolver<MatrixXd> eigenSolver;
 
@@ -64,18 +104,3 @@ CMT::WhiteningPreconditioner::WhiteningPreconditioner(const ArrayXXd& input, con
 		mGradTransform = mPreOut * mPredictor * mPreIn;
 	}
 }
-
-
-
-CMT::WhiteningPreconditioner::WhiteningPreconditioner(
-	const VectorXd& meanIn,
-	const VectorXd& meanOut,
-	const MatrixXd& preIn,
-	const MatrixXd& preInInv,
-	const MatrixXd& preOut,
-	const MatrixXd& preOutInv,
-	const MatrixXd& predictor) :
-	AffinePreconditioner(
-		meanIn, meanOut, preIn, preInInv, preOut, preOutInv, predictor)
-{
-}
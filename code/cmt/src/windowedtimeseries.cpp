@@ -0,0 +1,156 @@
+#include "windowedtimeseries.h"
+
+#include <algorithm>
+using std::min;
+
+#include "Eigen/Core"
+using Eigen::Map;
+using Eigen::MatrixXd;
+using Eigen::VectorXd;
+
+CMT::WindowedTimeSeries::WindowedTimeSeries() : mRows(0), mCols(0) {
+}
+
+
+
+CMT::WindowedTimeSeries::WindowedTimeSeries(const MatrixXd& timeSeries, int windowLength) :
+	mRows(0),
+	mCols(0)
+{
+	*this = WindowedTimeSeries(vector<MatrixXd>(1, timeSeries), vector<int>(1, windowLength));
+}
+
+
+
+CMT::WindowedTimeSeries::WindowedTimeSeries(
+	const vector<MatrixXd>& timeSeries,
+	const vector<int>& windowLengths) :
+	mRows(0),
+	mCols(0),
+	mWindowLengths(windowLengths)
+{
+	if(timeSeries.size() != windowLengths.size())
+		throw Exception("There should be one window length for each time series.");
+
+	for(int i = 0; i < timeSeries.size(); ++i) {
+		if(windowLengths[i] < 1 || windowLengths[i] > timeSeries[i].cols())
+			throw Exception("Window length should be between one and the length of the time series.");
+
+		int numWindows = timeSeries[i].cols() - windowLengths[i] + 1;
+
+		mRows += timeSeries[i].rows() * windowLengths[i];
+		mCols = i > 0 ? min(mCols, numWindows) : numWindows;
+	}
+
+	// windows are aligned at the end, so earlier parts of longer time series are never used
+	for(int i = 0; i < timeSeries.size(); ++i)
+		mTimeSeries.push_back(timeSeries[i].rightCols(mCols + windowLengths[i] - 1));
+}
+
+
+
+CMT::WindowedTimeSeries CMT::WindowedTimeSeries::middleCols(int j, int n) const {
+	if(j < 0 || n < 0 || j + n > mCols)
+		throw Exception("Invalid column range.");
+
+	WindowedTimeSeries windows;
+
+	windows.mRows = mRows;
+	windows.mCols = n;
+	windows.mWindowLengths = mWindowLengths;
+
+	for(int i = 0; i < mTimeSeries.size(); ++i)
+		windows.mTimeSeries.push_back(mTimeSeries[i].middleCols(j, n + mWindowLengths[i] - 1));
+
+	return windows;
+}
+
+
+
+/**
+ * Returns the windows of time series i to i + n - 1. Since all time series are
+ * already aligned, the windows of the selected time series correspond to the
+ * same columns as before.
+ */
+CMT::WindowedTimeSeries CMT::WindowedTimeSeries::middleTimeSeries(int i, int n) const {
+	if(i < 0 || n < 0 || i + n > numTimeSeries())
+		throw Exception("Invalid range of time series.");
+
+	WindowedTimeSeries windows;
+
+	windows.mCols = mCols;
+
+	for(int k = i; k < i + n; ++k) {
+		windows.mRows += mTimeSeries[k].rows() * mWindowLengths[k];
+		windows.mTimeSeries.push_back(mTimeSeries[k]);
+		windows.mWindowLengths.push_back(mWindowLengths[k]);
+	}
+
+	return windows;
+}
+
+
+
+MatrixXd CMT::WindowedTimeSeries::toDense() const {
+	MatrixXd windows(mRows, mCols);
+
+	#pragma omp parallel for
+	for(int t = 0; t < mCols; ++t)
+		for(int i = 0, offset = 0; i < mTimeSeries.size(); ++i) {
+			int size = mTimeSeries[i].rows() * mWindowLengths[i];
+
+			// a window is a contiguous part of a column-major time series
+			windows.col(t).segment(offset, size) =
+				Map<const VectorXd>(mTimeSeries[i].col(t).data(), size);
+
+			offset += size;
+		}
+
+	return windows;
+}
+
+
+
+/**
+ * Computes the product of a matrix with the windows, i.e., filters the time
+ * series with the rows of the matrix. For each time lag, the corresponding
+ * columns of the matrix are multiplied with a shifted time series.
+ */
+MatrixXd CMT::WindowedTimeSeries::leftProduct(const MatrixXd& lhs) const {
+	if(lhs.cols() != mRows)
+		throw Exception("Matrix has wrong number of columns.");
+
+	MatrixXd result = MatrixXd::Zero(lhs.rows(), mCols);
+
+	for(int i = 0, offset = 0; i < mTimeSeries.size(); ++i) {
+		int dim = mTimeSeries[i].rows();
+
+		for(int k = 0; k < mWindowLengths[i]; ++k, offset += dim)
+			result.noalias() += lhs.middleCols(offset, dim) * mTimeSeries[i].middleCols(k, mCols);
+	}
+
+	return result;
+}
+
+
+
+/**
+ * Computes the product of a matrix with the transposed windows, i.e., the
+ * cross-correlation of the rows of the matrix with the time series.
+ */
+MatrixXd CMT::WindowedTimeSeries::leftProductTranspose(const MatrixXd& lhs) const {
+	if(lhs.cols() != mCols)
+		throw Exception("Matrix has wrong number of columns.");
+
+	MatrixXd result(lhs.rows(), mRows);
+
+	for(int i = 0, offset = 0; i < mTimeSeries.size(); ++i) {
+		int dim = mTimeSeries[i].rows();
+
+		for(int k = 0; k < mWindowLengths[i]; ++k, offset += dim)
+			result.middleCols(offset, dim).noalias() =
+				lhs * mTimeSeries[i].middleCols(k, mCols).transpose();
+	}
+
+	return result;
+}
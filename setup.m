@@ -50,6 +50,7 @@ function setup(varargin)
       %% Source file lists for objects (normally used by multiple mex file)
       cmt_files = {'affinepreconditioner.cpp', ...
                    'affinetransform.cpp', ...
+                   'binarymatrix.cpp', ...
                    'binningtransform.cpp', ...
                    'conditionaldistribution.cpp', ...
                    'distribution.cpp', ...
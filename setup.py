@@ -96,6 +96,7 @@ modules = [
 			'code/cmt/python/src/univariatedistributionsinterface.cpp',
 			'code/cmt/src/affinepreconditioner.cpp',
 			'code/cmt/src/affinetransform.cpp',
+			'code/cmt/src/binarymatrix.cpp',
 			'code/cmt/src/binningtransform.cpp',
 			'code/cmt/src/conditionaldistribution.cpp',
 			'code/cmt/src/distribution.cpp',
@@ -111,13 +112,15 @@ modules = [
 			'code/cmt/src/pcatransform.cpp',
 			'code/cmt/src/preconditioner.cpp',
 			'code/cmt/src/regularizer.cpp',
+			'code/cmt/src/stackedaffinetransform.cpp',
 			'code/cmt/src/stm.cpp',
 			'code/cmt/src/tools.cpp',
 			'code/cmt/src/trainable.cpp',
 			'code/cmt/src/utils.cpp',
 			'code/cmt/src/univariatedistributions.cpp',
 			'code/cmt/src/whiteningpreconditioner.cpp',
-			'code/cmt/src/whiteningtransform.cpp'],
+			'code/cmt/src/whiteningtransform.cpp',
+			'code/cmt/src/windowedtimeseries.cpp'],
 		include_dirs=[
 			'code',
 			'code/cmt/include',